@@ -0,0 +1,141 @@
+#include <benchmark/benchmark.h>
+#include <charconv>
+#include <core/security/open_ssl_provider.h>
+#include <core/util/config.h>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <print>
+#include <string_view>
+#include <vector>
+
+namespace lansend::benchmark {
+
+using namespace lansend::core;
+
+namespace {
+
+struct CryptoOptions {
+    std::size_t size_mb = 512;
+    std::size_t record_size = 16 * 1024; // TLS records carry at most 16 KB
+};
+
+// The AEADs behind the TLS suites we offer
+struct Cipher {
+    std::string_view suite;
+    const EVP_CIPHER* (*cipher)();
+};
+
+constexpr Cipher kCiphers[] = {
+    {"TLS_AES_128_GCM_SHA256", EVP_aes_128_gcm},
+    {"TLS_AES_256_GCM_SHA384", EVP_aes_256_gcm},
+    {"TLS_CHACHA20_POLY1305_SHA256", EVP_chacha20_poly1305},
+};
+
+std::optional<CryptoOptions> ParseOptions(const std::vector<std::string_view>& args) {
+    CryptoOptions options;
+    if (args.size() % 2 != 0) {
+        std::println(std::cerr, "missing value for {}", args.back());
+        return std::nullopt;
+    }
+    for (std::size_t i = 0; i < args.size(); i += 2) {
+        auto key = args[i];
+        auto value = args[i + 1];
+        std::from_chars_result result{};
+        if (key == "--size-mb") {
+            result = std::from_chars(value.data(), value.data() + value.size(), options.size_mb);
+        } else if (key == "--record-size") {
+            result = std::from_chars(value.data(),
+                                     value.data() + value.size(),
+                                     options.record_size);
+        } else {
+            result.ec = std::errc::invalid_argument;
+        }
+        if (result.ec != std::errc() || options.size_mb == 0 || options.record_size == 0) {
+            std::println(std::cerr, "invalid option {} {}", key, value);
+            return std::nullopt;
+        }
+    }
+    return options;
+}
+
+// Seal records the way the TLS layer does: a fresh nonce, the record header as additional data
+// and a 16 byte tag per record. Returns the wall seconds, or a negative value on failure.
+double SealRecords(const EVP_CIPHER* cipher, const CryptoOptions& options) {
+    std::vector<unsigned char> key(EVP_CIPHER_get_key_length(cipher), 0x42);
+    std::vector<unsigned char> nonce(12, 0);
+    std::vector<unsigned char> header(5, 0x17);
+    std::vector<unsigned char> plaintext(options.record_size, 0xa5);
+    std::vector<unsigned char> ciphertext(options.record_size + EVP_MAX_BLOCK_LENGTH);
+    unsigned char tag[16];
+
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    if (!ctx || EVP_EncryptInit_ex(ctx, cipher, nullptr, key.data(), nullptr) != 1) {
+        EVP_CIPHER_CTX_free(ctx);
+        return -1.0;
+    }
+
+    std::size_t records = options.size_mb * 1024 * 1024 / options.record_size;
+    Stopwatch stopwatch;
+    for (std::uint64_t record = 0; record < records; ++record) {
+        for (int i = 0; i < 8; ++i) {
+            nonce[4 + i] = static_cast<unsigned char>(record >> (8 * i));
+        }
+        int length = 0;
+        if (EVP_EncryptInit_ex(ctx, nullptr, nullptr, nullptr, nonce.data()) != 1
+            || EVP_EncryptUpdate(ctx,
+                                 nullptr,
+                                 &length,
+                                 header.data(),
+                                 static_cast<int>(header.size()))
+                   != 1
+            || EVP_EncryptUpdate(ctx,
+                                 ciphertext.data(),
+                                 &length,
+                                 plaintext.data(),
+                                 static_cast<int>(plaintext.size()))
+                   != 1
+            || EVP_EncryptFinal_ex(ctx, ciphertext.data() + length, &length) != 1
+            || EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, sizeof(tag), tag) != 1) {
+            EVP_CIPHER_CTX_free(ctx);
+            return -1.0;
+        }
+    }
+    double seconds = stopwatch.wall_seconds();
+
+    EVP_CIPHER_CTX_free(ctx);
+    return seconds;
+}
+
+} // namespace
+
+int RunCryptoBenchmark(const std::vector<std::string_view>& args) {
+    auto options = ParseOptions(args);
+    if (!options) {
+        return 1;
+    }
+
+    bool has_aes = OpenSSLProvider::HasAesInstructions();
+    std::println("crypto: sealing {} MB in {} byte records per suite on one core",
+                 options->size_mb,
+                 options->record_size);
+    std::println("AES instructions: {}, TLS contexts prefer {} (tls-cipher-preference: {})",
+                 has_aes ? "yes" : "no",
+                 OpenSSLProvider::CipherPreferenceName(OpenSSLProvider::ResolveCipherPreference()),
+                 settings.tls_cipher_preference);
+    std::println("{:<32}{:>14}", "suite", "MB/s");
+
+    int exit_code = 0;
+    for (const auto& cipher : kCiphers) {
+        double seconds = SealRecords(cipher.cipher(), *options);
+        if (seconds < 0.0) {
+            std::println(std::cerr, "{} failed", cipher.suite);
+            exit_code = 1;
+            continue;
+        }
+        std::println("{:<32}{:>14.1f}", cipher.suite, options->size_mb / seconds);
+    }
+    return exit_code;
+}
+
+} // namespace lansend::benchmark
@@ -0,0 +1,171 @@
+#include <benchmark/benchmark.h>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <charconv>
+#include <core/constant/route.h>
+#include <core/network/client/http_client.h>
+#include <core/network/server/http_server.h>
+#include <core/security/certificate_manager.h>
+#include <core/security/tls_session_cache.h>
+#include <core/util/config.h>
+#include <filesystem>
+#include <iostream>
+#include <print>
+
+namespace lansend::benchmark {
+
+using namespace lansend::core;
+namespace fs = std::filesystem;
+namespace net = boost::asio;
+
+namespace {
+
+struct HandshakeOptions {
+    std::size_t count = 200;
+    std::uint16_t port = 53419; // Servers use consecutive ports, one per key type
+    std::vector<CertificateKeyType> key_types = {
+        CertificateKeyType::kEcdsaP256,
+        CertificateKeyType::kEd25519,
+        CertificateKeyType::kRsa2048,
+    };
+};
+
+std::optional<HandshakeOptions> ParseOptions(const std::vector<std::string_view>& args) {
+    HandshakeOptions options;
+    if (args.size() % 2 != 0) {
+        std::println(std::cerr, "missing value for {}", args.back());
+        return std::nullopt;
+    }
+    for (std::size_t i = 0; i < args.size(); i += 2) {
+        auto key = args[i];
+        auto value = args[i + 1];
+        std::from_chars_result result{};
+        if (key == "--count") {
+            result = std::from_chars(value.data(), value.data() + value.size(), options.count);
+        } else if (key == "--port") {
+            result = std::from_chars(value.data(), value.data() + value.size(), options.port);
+        } else if (key == "--key-type") {
+            if (value != "all") {
+                auto key_type = CertificateManager::ParseKeyType(value);
+                if (!key_type) {
+                    result.ec = std::errc::invalid_argument;
+                } else {
+                    options.key_types = {*key_type};
+                }
+            }
+        } else {
+            result.ec = std::errc::invalid_argument;
+        }
+        if (result.ec != std::errc() || options.count == 0) {
+            std::println(std::cerr, "invalid option {} {}", key, value);
+            return std::nullopt;
+        }
+    }
+    return options;
+}
+
+} // namespace
+
+int RunHandshakeBenchmark(const std::vector<std::string_view>& args) {
+    auto options = ParseOptions(args);
+    if (!options) {
+        return 1;
+    }
+
+    auto work_dir = fs::temp_directory_path() / "lansend-benchmark";
+    fs::remove_all(work_dir);
+
+    net::io_context ioc;
+    // The client side stays the same, it also owns the shared client TLS context
+    CertificateManager cert_manager(work_dir / "client");
+    auto& session_cache = TlsSessionCache::Instance(cert_manager);
+
+    std::println("handshake: {} connections with one ping each per mode over loopback",
+                 options->count);
+    std::println("{:<12}{:<10}{:>14}{:>14}{:>14}{:>14}",
+                 "key",
+                 "mode",
+                 "keygen ms",
+                 "handshakes/s",
+                 "avg ms",
+                 "resumed");
+
+    int exit_code = 0;
+    std::uint16_t port = options->port;
+    for (auto key_type : options->key_types) {
+        // Generated the way a first start does
+        settings.certificate_key_type = CertificateManager::KeyTypeName(key_type);
+        Stopwatch keygen_stopwatch;
+        CertificateManager server_cert_manager(work_dir / settings.certificate_key_type);
+        double keygen_ms = keygen_stopwatch.wall_seconds() * 1000.0;
+
+        HttpServer server(ioc, server_cert_manager);
+        server.Start(port);
+        auto peer_key = TlsSessionCache::PeerKey({}, "127.0.0.1", port);
+
+        for (bool resume : {false, true}) {
+            auto before = session_cache.stats();
+            std::size_t failures = 0;
+            Stopwatch stopwatch;
+            net::co_spawn(
+                ioc,
+                [&]() -> net::awaitable<void> {
+                    HttpsClient client(ioc, cert_manager);
+                    for (std::size_t i = 0; i < options->count; ++i) {
+                        if (!resume) {
+                            session_cache.Forget(peer_key);
+                        }
+                        // A ping per connection also reads the TLS 1.3 tickets sent after the
+                        // handshake
+                        try {
+                            if (!co_await client.Connect("127.0.0.1", port)) {
+                                failures++;
+                                continue;
+                            }
+                            auto req = client.CreateRequest<http::string_body>(
+                                http::verb::get,
+                                ApiRoute::kPing.data(),
+                                false);
+                            req.prepare_payload();
+                            co_await client.SendRequest(req);
+                        } catch (const std::exception&) {
+                            failures++;
+                        }
+                        co_await client.Disconnect();
+                    }
+                    ioc.stop();
+                },
+                net::detached);
+            ioc.restart();
+            ioc.run();
+            double seconds = stopwatch.wall_seconds();
+
+            auto after = session_cache.stats();
+            auto handshakes = after.handshakes - before.handshakes;
+            auto resumed = after.resumed - before.resumed;
+            double handshake_seconds = after.total_full_seconds - before.total_full_seconds
+                                       + after.total_resumed_seconds
+                                       - before.total_resumed_seconds;
+            if (failures > 0) {
+                std::println(std::cerr, "{} connections failed", failures);
+                exit_code = 1;
+            }
+            std::println("{:<12}{:<10}{:>14.1f}{:>14.1f}{:>14.3f}{:>14}",
+                         CertificateManager::KeyTypeName(key_type),
+                         resume ? "resumed" : "full",
+                         keygen_ms,
+                         handshakes / seconds,
+                         handshakes > 0 ? handshake_seconds * 1000.0 / handshakes : 0.0,
+                         resumed);
+        }
+
+        server.Stop();
+        port++;
+    }
+
+    fs::remove_all(work_dir);
+    return exit_code;
+}
+
+} // namespace lansend::benchmark
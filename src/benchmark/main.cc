@@ -0,0 +1,69 @@
+#include <benchmark/benchmark.h>
+#include <core/security/open_ssl_provider.h>
+#include <core/util/config.h>
+#include <iostream>
+#include <spdlog/spdlog.h>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace lansend;
+using namespace lansend::core;
+
+namespace {
+
+constexpr std::pair<std::string_view, benchmark::BenchmarkFunc> kBenchmarks[] = {
+    {"transfer", benchmark::RunTransferBenchmark},
+    {"handshake", benchmark::RunHandshakeBenchmark},
+    {"crypto", benchmark::RunCryptoBenchmark},
+    {"multicast", benchmark::RunMulticastBenchmark},
+};
+
+void PrintUsage() {
+    std::cout << "usage: lansend-benchmark <benchmark> [options]\n\n"
+              << "benchmarks:\n"
+              << "  transfer [--mode http|upload|ktls|stream|udp|all] [--size-mb N] [--files N]\n"
+              << "           [--runs N] [--port N] [--netem \"<netem parameters>\"]\n"
+              << "      Send random files over loopback and report chunks/s, MB/s and CPU\n"
+              << "      seconds per GB for each transport. --netem emulates a lossy link on lo\n"
+              << "      while the benchmark runs, e.g. --netem \"loss 2% delay 5ms\" (needs root and\n"
+              << "      lo on its default qdisc, which is put back on exit, Ctrl-C included)\n"
+              << "  handshake [--key-type ecdsa-p256|ed25519|rsa-2048|all] [--count N] [--port N]\n"
+              << "      Open TLS connections over loopback, with full and with resumed\n"
+              << "      handshakes, and report key generation time, handshakes/s and average\n"
+              << "      latency for each certificate key type\n"
+              << "  crypto [--size-mb N] [--record-size N]\n"
+              << "      Seal TLS-sized records with each AEAD suite and report MB/s, along with\n"
+              << "      the detected AES instructions and the resulting cipher preference\n"
+              << "  multicast [--receivers N] [--size-mb N] [--rate KiB/s] [--runs N] [--port N]\n"
+              << "            [--loss PERCENT]\n"
+              << "      Fan a random file out to N receivers over loopback, once unicast and\n"
+              << "      once multicast, and report seconds, MB/s and the bytes sent each way.\n"
+              << "      --loss drops that share of the multicast datagrams, e.g. --loss 2, to\n"
+              << "      exercise FEC and the repair over the connections; netem on lo doesn't\n"
+              << "      see looped-back multicast\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    spdlog::set_level(spdlog::level::warn);
+    InitConfig();
+    OpenSSLProvider::InitOpenSSL();
+
+    if (argc < 2) {
+        PrintUsage();
+        return 1;
+    }
+
+    std::string_view name = argv[1];
+    std::vector<std::string_view> args(argv + 2, argv + argc);
+    for (const auto& [benchmark_name, func] : kBenchmarks) {
+        if (benchmark_name == name) {
+            return func(args);
+        }
+    }
+
+    PrintUsage();
+    return 1;
+}
@@ -0,0 +1,269 @@
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <charconv>
+#include <core/network/client/fanout_chunk_cache.h>
+#include <core/network/client/send_session.h>
+#include <core/network/discovery/discovery_manager.h>
+#include <core/network/multicast/multicast_round.h>
+#include <core/network/server/controller/receive_controller.h>
+#include <core/network/server/http_server.h>
+#include <core/security/certificate_manager.h>
+#include <core/util/config.h>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <print>
+#include <random>
+
+namespace lansend::benchmark {
+
+using namespace lansend::core;
+namespace fs = std::filesystem;
+namespace net = boost::asio;
+
+namespace {
+
+struct MulticastOptions {
+    std::size_t receivers = 4;
+    std::size_t size_mb = 64;
+    std::size_t runs = 3;
+    std::uint32_t rate = 40960; // KiB/s
+    std::uint16_t port = 53518;
+    double loss = 0.0; // Share of the multicast datagrams dropped before they are sent
+};
+
+// Datagrams the multicast round drops through DropMulticastDatagram(). Loopback multicast skips
+// the qdisc of lo, so tc can't make it lossy.
+struct MulticastLoss {
+    double rate = 0.0;
+    std::uint64_t dropped = 0;
+    std::mt19937_64 engine{std::random_device{}()};
+};
+
+MulticastLoss multicast_loss;
+
+struct FanoutResult {
+    bool success = false;
+    double wall_seconds = 0.0;
+    std::uint64_t multicast_bytes = 0; // Datagram bytes the round sent
+    std::uint64_t unicast_bytes = 0;   // Chunk bytes all sessions sent on their connections
+    std::uint64_t dropped_datagrams = 0;
+};
+
+template<typename T>
+bool ParseNumber(std::string_view text, T& value) {
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc() && ptr == text.data() + text.size();
+}
+
+std::optional<MulticastOptions> ParseOptions(const std::vector<std::string_view>& args) {
+    MulticastOptions options;
+    for (std::size_t i = 0; i + 1 < args.size(); i += 2) {
+        auto key = args[i];
+        auto value = args[i + 1];
+        bool valid = true;
+        if (key == "--receivers") {
+            valid = ParseNumber(value, options.receivers) && options.receivers > 1;
+        } else if (key == "--size-mb") {
+            valid = ParseNumber(value, options.size_mb) && options.size_mb > 0;
+        } else if (key == "--runs") {
+            valid = ParseNumber(value, options.runs) && options.runs > 0;
+        } else if (key == "--rate") {
+            valid = ParseNumber(value, options.rate) && options.rate > 0;
+        } else if (key == "--port") {
+            valid = ParseNumber(value, options.port);
+        } else if (key == "--loss") {
+            valid = ParseNumber(value, options.loss) && options.loss >= 0.0 && options.loss < 100.0;
+            options.loss /= 100.0;
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            std::println(std::cerr, "invalid option {} {}", key, value);
+            return std::nullopt;
+        }
+    }
+    if (args.size() % 2 != 0) {
+        std::println(std::cerr, "missing value for {}", args.back());
+        return std::nullopt;
+    }
+    return options;
+}
+
+// Fresh random content for every run, otherwise the receivers would deduplicate the chunks
+// they kept from the previous run
+fs::path WritePayload(const fs::path& dir, std::size_t size_mb) {
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    static std::mt19937_64 engine(std::random_device{}());
+    std::vector<std::uint64_t> block(1024 * 1024 / sizeof(std::uint64_t));
+    auto path = dir / "payload.bin";
+    std::ofstream file(path, std::ios::binary);
+    for (std::size_t mb = 0; mb < size_mb; ++mb) {
+        std::ranges::generate(block, std::ref(engine));
+        file.write(reinterpret_cast<const char*>(block.data()),
+                   block.size() * sizeof(std::uint64_t));
+    }
+    return path;
+}
+
+// The sessions a SendSessionManager::SendFanout() would start, driven here to see when they end
+FanoutResult RunFanout(net::io_context& ioc,
+                       CertificateManager& cert_manager,
+                       const fs::path& path,
+                       const MulticastOptions& options,
+                       bool multicast) {
+    FanoutResult result;
+    auto bandwidth = BandwidthScheduler::Create(ioc);
+    auto pool = ConnectionPool::Create(ioc, cert_manager);
+    auto prepared_files = std::make_shared<const PreparedFiles>(SendSession::PrepareFiles({path}));
+    auto cache = std::make_shared<FanoutChunkCache>(options.receivers);
+    std::shared_ptr<MulticastRound> round;
+    multicast_loss.rate = options.loss;
+    multicast_loss.dropped = 0;
+    if (multicast) {
+        round = MulticastRound::Create(ioc,
+                                       bandwidth,
+                                       prepared_files,
+                                       options.receivers,
+                                       DiscoveryManager::LocalAddressTowards(ioc, "127.0.0.1"));
+    }
+
+    std::vector<std::unique_ptr<SendSession>> sessions;
+    for (std::size_t i = 0; i < options.receivers; ++i) {
+        auto session = std::make_unique<SendSession>(ioc, cert_manager, pool, bandwidth);
+        session->JoinFanout(cache, i);
+        if (round) {
+            session->JoinMulticast(round);
+        }
+        sessions.push_back(std::move(session));
+    }
+
+    Stopwatch stopwatch;
+    std::size_t running = sessions.size();
+    for (std::size_t i = 0; i < sessions.size(); ++i) {
+        net::co_spawn(
+            ioc,
+            [&, i]() -> net::awaitable<void> {
+                co_await sessions[i]->Start(prepared_files,
+                                            "127.0.0.1",
+                                            static_cast<unsigned short>(options.port + i));
+                if (--running == 0) {
+                    ioc.stop();
+                }
+            },
+            net::detached);
+    }
+    ioc.restart();
+    ioc.run();
+
+    result.wall_seconds = stopwatch.wall_seconds();
+    result.success = std::ranges::all_of(sessions, [](const auto& session) {
+        return session->session_status() == SessionStatus::kCompleted;
+    });
+    result.multicast_bytes = round ? round->sent_bytes() : 0;
+    result.dropped_datagrams = multicast_loss.dropped;
+    for (const auto& session : sessions) {
+        result.unicast_bytes += session->stats().wire_bytes;
+    }
+    return result;
+}
+
+} // namespace
+
+int RunMulticastBenchmark(const std::vector<std::string_view>& args) {
+    auto options = ParseOptions(args);
+    if (!options) {
+        return 1;
+    }
+
+    auto work_dir = fs::temp_directory_path() / "lansend-benchmark";
+    fs::remove_all(work_dir);
+
+    net::io_context ioc;
+    CertificateManager cert_manager(work_dir / "certificates");
+    std::vector<std::unique_ptr<HttpServer>> servers;
+    for (std::size_t i = 0; i < options->receivers; ++i) {
+        auto server = std::make_unique<HttpServer>(ioc, cert_manager);
+        server->GetReceiveController().SetSaveDirectory(work_dir / std::format("received_{}", i));
+        server->SetReceiveCancelConditionFunc([] { return false; });
+        server->Start(static_cast<unsigned short>(options->port + i));
+        servers.push_back(std::move(server));
+    }
+
+    settings.compression = false;
+    settings.multicast_rate = options->rate;
+
+    const double total_mb = static_cast<double>(options->size_mb);
+    std::println("multicast: {} MB to {} receivers over loopback at {} KiB/s, {:.1f}% datagram "
+                 "loss, {} run(s) per mode",
+                 options->size_mb,
+                 options->receivers,
+                 options->rate,
+                 options->loss * 100.0,
+                 options->runs);
+    std::println("{:<11}{:>6}{:>12}{:>12}{:>14}{:>14}{:>10}",
+                 "mode",
+                 "run",
+                 "seconds",
+                 "MB/s",
+                 "multicast MB",
+                 "unicast MB",
+                 "dropped");
+
+    int exit_code = 0;
+    for (bool multicast : {false, true}) {
+        settings.multicast_transport = multicast;
+        std::string_view mode = multicast ? "multicast" : "unicast";
+        for (std::size_t run = 1; run <= options->runs; ++run) {
+            auto path = WritePayload(work_dir / "payload", options->size_mb);
+            for (std::size_t i = 0; i < options->receivers; ++i) {
+                fs::remove_all(work_dir / std::format("received_{}", i));
+                fs::create_directories(work_dir / std::format("received_{}", i));
+            }
+
+            auto result = RunFanout(ioc, cert_manager, path, *options, multicast);
+            if (!result.success) {
+                std::println(std::cerr, "{} run {} failed", mode, run);
+                exit_code = 1;
+                continue;
+            }
+            // MB/s counts what reached every receiver
+            std::println("{:<11}{:>6}{:>12.3f}{:>12.1f}{:>14.1f}{:>14.1f}{:>10}",
+                         mode,
+                         run,
+                         result.wall_seconds,
+                         total_mb * options->receivers / result.wall_seconds,
+                         result.multicast_bytes / (1024.0 * 1024.0),
+                         result.unicast_bytes / (1024.0 * 1024.0),
+                         result.dropped_datagrams);
+        }
+    }
+
+    for (auto& server : servers) {
+        server->Stop();
+    }
+    fs::remove_all(work_dir);
+    return exit_code;
+}
+
+} // namespace lansend::benchmark
+
+namespace lansend::core {
+
+bool DropMulticastDatagram() {
+    auto& loss = benchmark::multicast_loss;
+    if (loss.rate > 0.0 && std::bernoulli_distribution(loss.rate)(loss.engine)) {
+        ++loss.dropped;
+        return true;
+    }
+    return false;
+}
+
+} // namespace lansend::core
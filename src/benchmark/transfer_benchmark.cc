@@ -0,0 +1,447 @@
+#include <algorithm>
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <charconv>
+#include <csignal>
+#include <cstdlib>
+#include <core/constant/transfer.h>
+#include <core/network/client/send_session.h>
+#include <core/network/server/controller/receive_controller.h>
+#include <core/network/server/http_server.h>
+#include <core/security/certificate_manager.h>
+#include <core/util/config.h>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <print>
+#include <random>
+#include <ranges>
+#include <sstream>
+
+#ifdef __linux__
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace lansend::benchmark {
+
+using namespace lansend::core;
+namespace fs = std::filesystem;
+namespace net = boost::asio;
+
+namespace {
+
+// How the chunks of each file travel to the receiver
+enum class TransferMode {
+    kHttp,   // One request per chunk
+    kUpload, // One chunked request per file
+    kKtls,   // One chunked request per file, sent with kernel TLS and sendfile
+    kStream, // Frames on an upgraded connection
+    kUdp,    // Frames on an upgraded connection, the data frames over lansend-datagram
+};
+
+constexpr std::string_view TransferModeName(TransferMode mode) {
+    switch (mode) {
+    case TransferMode::kHttp:
+        return "http";
+    case TransferMode::kUpload:
+        return "upload";
+    case TransferMode::kKtls:
+        return "ktls";
+    case TransferMode::kStream:
+        return "stream";
+    case TransferMode::kUdp:
+        return "udp";
+    }
+    return "unknown";
+}
+
+struct TransferOptions {
+    std::vector<TransferMode> modes{
+        TransferMode::kHttp,
+        TransferMode::kUpload,
+        TransferMode::kKtls,
+        TransferMode::kStream,
+        TransferMode::kUdp,
+    };
+    std::size_t size_mb = 256;
+    std::size_t files = 1;
+    std::size_t runs = 3;
+    std::uint16_t port = 53418;
+    std::string netem; // netem parameters put on the loopback interface, e.g. "loss 2% delay 5ms"
+};
+
+struct TransferResult {
+    bool success = false;
+    double wall_seconds = 0.0;
+    double cpu_seconds = 0.0;
+};
+
+template<typename T>
+bool ParseNumber(std::string_view text, T& value) {
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc() && ptr == text.data() + text.size();
+}
+
+std::optional<TransferOptions> ParseOptions(const std::vector<std::string_view>& args) {
+    TransferOptions options;
+    for (std::size_t i = 0; i + 1 < args.size(); i += 2) {
+        auto key = args[i];
+        auto value = args[i + 1];
+        bool valid = true;
+        if (key == "--mode") {
+            if (value == "http") {
+                options.modes = {TransferMode::kHttp};
+            } else if (value == "upload") {
+                options.modes = {TransferMode::kUpload};
+            } else if (value == "ktls") {
+                options.modes = {TransferMode::kKtls};
+            } else if (value == "stream") {
+                options.modes = {TransferMode::kStream};
+            } else if (value == "udp") {
+                options.modes = {TransferMode::kUdp};
+            } else if (value != "all") {
+                valid = false;
+            }
+        } else if (key == "--size-mb") {
+            valid = ParseNumber(value, options.size_mb) && options.size_mb > 0;
+        } else if (key == "--files") {
+            valid = ParseNumber(value, options.files) && options.files > 0;
+        } else if (key == "--runs") {
+            valid = ParseNumber(value, options.runs) && options.runs > 0;
+        } else if (key == "--port") {
+            valid = ParseNumber(value, options.port);
+        } else if (key == "--netem") {
+            options.netem = value;
+            valid = !value.empty();
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            std::println(std::cerr, "invalid option {} {}", key, value);
+            return std::nullopt;
+        }
+    }
+    if (args.size() % 2 != 0) {
+        std::println(std::cerr, "missing value for {}", args.back());
+        return std::nullopt;
+    }
+    return options;
+}
+
+// Fresh random content for every run, otherwise the receiver would deduplicate the chunks
+// it kept from the previous run
+std::vector<fs::path> WritePayload(const fs::path& dir, const TransferOptions& options) {
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    static std::mt19937_64 engine(std::random_device{}());
+    std::vector<std::uint64_t> block(1024 * 1024 / sizeof(std::uint64_t));
+    std::vector<fs::path> paths;
+    for (std::size_t i = 0; i < options.files; ++i) {
+        auto path = dir / std::format("payload_{}.bin", i);
+        std::ofstream file(path, std::ios::binary);
+        for (std::size_t mb = 0; mb < options.size_mb; ++mb) {
+            std::ranges::generate(block, std::ref(engine));
+            file.write(reinterpret_cast<const char*>(block.data()),
+                       block.size() * sizeof(std::uint64_t));
+        }
+        paths.push_back(std::move(path));
+    }
+    return paths;
+}
+
+#ifdef __linux__
+// Argument vector of the command restoring lo, kept ready for RestoreLoopbackOnSignal
+std::atomic<char* const*> loopback_restore_argv{nullptr};
+
+extern "C" void RestoreLoopbackOnSignal(int signal) {
+    // Only async-signal-safe calls here, the path and the arguments were prepared beforehand
+    if (char* const* argv = loopback_restore_argv.exchange(nullptr)) {
+        if (pid_t pid = ::fork(); pid == 0) {
+            ::execve(argv[0], argv, environ);
+            ::_exit(127);
+        } else if (pid > 0) {
+            ::waitpid(pid, nullptr, 0);
+        }
+    }
+    std::signal(signal, SIG_DFL);
+    std::raise(signal);
+}
+
+// Path of `name` in PATH, empty if it isn't there
+std::string FindExecutable(std::string_view name) {
+    const char* path = std::getenv("PATH");
+    for (auto dir : std::views::split(std::string_view(path ? path : "/usr/sbin:/sbin"), ':')) {
+        auto candidate = fs::path(std::string_view(dir)) / name;
+        if (::access(candidate.c_str(), X_OK) == 0) {
+            return candidate.string();
+        }
+    }
+    return {};
+}
+
+// Runs a command without a shell and returns its exit status, -1 if it couldn't run. `argv[0]` is
+// the path of the program. Its standard output goes to `output` if given.
+int RunCommand(const std::vector<std::string>& argv, std::string* output = nullptr) {
+    std::vector<char*> args;
+    for (const auto& arg : argv) {
+        args.push_back(const_cast<char*>(arg.c_str()));
+    }
+    args.push_back(nullptr);
+
+    int pipe_fds[2] = {-1, -1};
+    if (output && ::pipe(pipe_fds) != 0) {
+        return -1;
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (output) {
+        posix_spawn_file_actions_adddup2(&actions, pipe_fds[1], STDOUT_FILENO);
+        posix_spawn_file_actions_addclose(&actions, pipe_fds[0]);
+        posix_spawn_file_actions_addclose(&actions, pipe_fds[1]);
+    }
+    pid_t pid = 0;
+    int error = ::posix_spawn(&pid, args[0], &actions, nullptr, args.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (output) {
+        ::close(pipe_fds[1]);
+        char buffer[512];
+        ssize_t size = 0;
+        while (error == 0 && (size = ::read(pipe_fds[0], buffer, sizeof(buffer))) != 0) {
+            if (size > 0) {
+                output->append(buffer, static_cast<std::size_t>(size));
+            } else if (errno != EINTR) {
+                break;
+            }
+        }
+        ::close(pipe_fds[0]);
+    }
+    if (error != 0) {
+        return -1;
+    }
+    int status = 0;
+    while (::waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+std::vector<std::string> SplitWords(std::string_view text) {
+    std::vector<std::string> words;
+    std::istringstream stream{std::string(text)};
+    for (std::string word; stream >> word;) {
+        words.push_back(std::move(word));
+    }
+    return words;
+}
+#endif
+
+// Emulates a lossy link on the loopback interface for as long as it lives, with tc and netem.
+// Needs CAP_NET_ADMIN and lo on its default root qdisc, which is put back afterwards, also when
+// SIGINT or SIGTERM end the benchmark early.
+class LoopbackNetem {
+public:
+    explicit LoopbackNetem(std::string_view parameters) {
+#ifdef __linux__
+        std::string tc = FindExecutable("tc");
+        std::string current;
+        if (tc.empty() || RunCommand({tc, "qdisc", "show", "dev", "lo", "root"}, &current) != 0) {
+            return;
+        }
+        // The kernel default, e.g. "qdisc noqueue 0: root refcnt 2", has handle 0: and comes back
+        // when ours is deleted. tc doesn't take back what it prints for every configured qdisc
+        // (pfifo prints "limit 100p"), so lo is left alone rather than restored approximately.
+        current.resize(std::min(current.find('\n'), current.size()));
+        if (auto words = SplitWords(current); words.size() < 3 || words[2] != "0:") {
+            std::println(std::cerr, "lo already has a root qdisc, remove it to use --netem: {}", current);
+            return;
+        }
+        restore_ = {tc, "qdisc", "del", "dev", "lo", "root"};
+        for (auto& arg : restore_) {
+            restore_argv_.push_back(arg.data());
+        }
+        restore_argv_.push_back(nullptr);
+
+        loopback_restore_argv = restore_argv_.data();
+        struct sigaction action{};
+        action.sa_handler = RestoreLoopbackOnSignal;
+        sigemptyset(&action.sa_mask);
+        ::sigaction(SIGINT, &action, &previous_sigint_);
+        ::sigaction(SIGTERM, &action, &previous_sigterm_);
+        handlers_installed_ = true;
+
+        std::vector<std::string> command{tc, "qdisc", "replace", "dev", "lo", "root", "netem"};
+        std::ranges::move(SplitWords(parameters), std::back_inserter(command));
+        active_ = RunCommand(command) == 0;
+#else
+        (void) parameters;
+#endif
+    }
+    ~LoopbackNetem() {
+#ifdef __linux__
+        if (!handlers_installed_) {
+            return;
+        }
+        bool pending = loopback_restore_argv.exchange(nullptr) != nullptr;
+        ::sigaction(SIGINT, &previous_sigint_, nullptr);
+        ::sigaction(SIGTERM, &previous_sigterm_, nullptr);
+        if (active_ && pending && RunCommand(restore_) != 0) {
+            std::println(std::cerr, "failed to restore the root qdisc of lo");
+        }
+#endif
+    }
+
+    LoopbackNetem(const LoopbackNetem&) = delete;
+    LoopbackNetem& operator=(const LoopbackNetem&) = delete;
+
+    bool active() const { return active_; }
+
+private:
+    bool active_ = false;
+#ifdef __linux__
+    bool handlers_installed_ = false;
+    std::vector<std::string> restore_;
+    std::vector<char*> restore_argv_;
+    struct sigaction previous_sigint_{};
+    struct sigaction previous_sigterm_{};
+#endif
+};
+
+TransferResult RunTransfer(net::io_context& ioc,
+                           CertificateManager& cert_manager,
+                           const std::vector<fs::path>& paths,
+                           std::uint16_t port) {
+    TransferResult result;
+    // A fresh pool per run, every run pays for its connection
+    SendSession session(ioc,
+                        cert_manager,
+                        ConnectionPool::Create(ioc, cert_manager),
+                        BandwidthScheduler::Create(ioc));
+
+    Stopwatch stopwatch;
+    net::co_spawn(
+        ioc,
+        [&]() -> net::awaitable<void> {
+            co_await session.Start(paths, "127.0.0.1", port);
+            ioc.stop();
+        },
+        net::detached);
+    ioc.restart();
+    ioc.run();
+
+    result.wall_seconds = stopwatch.wall_seconds();
+    result.cpu_seconds = stopwatch.cpu_seconds();
+    result.success = session.session_status() == SessionStatus::kCompleted;
+    return result;
+}
+
+} // namespace
+
+int RunTransferBenchmark(const std::vector<std::string_view>& args) {
+    auto options = ParseOptions(args);
+    if (!options) {
+        return 1;
+    }
+
+    std::optional<LoopbackNetem> netem;
+    if (!options->netem.empty()) {
+        netem.emplace(options->netem);
+        if (!netem->active()) {
+            std::println(std::cerr, "failed to set up netem {} on lo", options->netem);
+            return 1;
+        }
+    }
+
+    auto work_dir = fs::temp_directory_path() / "lansend-benchmark";
+    fs::remove_all(work_dir);
+
+    net::io_context ioc;
+    CertificateManager cert_manager(work_dir / "certificates");
+    HttpServer server(ioc, cert_manager);
+    server.GetReceiveController().SetSaveDirectory(work_dir / "received");
+    server.SetReceiveCancelConditionFunc([] { return false; });
+    server.Start(options->port);
+
+    // Raw transport cost only, random data would not compress anyway
+    settings.compression = false;
+
+    const double total_mb = static_cast<double>(options->size_mb * options->files);
+    const std::size_t chunks_per_file = (options->size_mb * 1024 * 1024
+                                         + transfer::kDefaultChunkSize - 1)
+                                        / transfer::kDefaultChunkSize;
+    const std::size_t total_chunks = chunks_per_file * options->files;
+
+    std::println("transfer: {} file(s) x {} MB over loopback, {} run(s) per mode{}",
+                 options->files,
+                 options->size_mb,
+                 options->runs,
+                 options->netem.empty() ? "" : std::format(", netem {}", options->netem));
+    std::println("{:<8}{:>6}{:>12}{:>12}{:>12}{:>12}",
+                 "mode",
+                 "run",
+                 "seconds",
+                 "chunks/s",
+                 "MB/s",
+                 "CPU s/GB");
+
+    int exit_code = 0;
+    for (TransferMode transfer_mode : options->modes) {
+        settings.stream_transport = transfer_mode == TransferMode::kStream
+                                    || transfer_mode == TransferMode::kUdp;
+        settings.udp_transport = transfer_mode == TransferMode::kUdp;
+        settings.chunked_upload = transfer_mode == TransferMode::kUpload
+                                  || transfer_mode == TransferMode::kKtls;
+        settings.kernel_tls = transfer_mode == TransferMode::kKtls;
+        std::string_view mode = TransferModeName(transfer_mode);
+        double wall_total = 0.0;
+        double cpu_total = 0.0;
+        std::size_t succeeded = 0;
+        for (std::size_t run = 1; run <= options->runs; ++run) {
+            auto paths = WritePayload(work_dir / "payload", *options);
+            fs::remove_all(work_dir / "received");
+            fs::create_directories(work_dir / "received");
+
+            auto result = RunTransfer(ioc, cert_manager, paths, options->port);
+            if (!result.success) {
+                std::println(std::cerr, "{} run {} failed", mode, run);
+                exit_code = 1;
+                continue;
+            }
+            succeeded++;
+            wall_total += result.wall_seconds;
+            cpu_total += result.cpu_seconds;
+            std::println("{:<8}{:>6}{:>12.3f}{:>12.1f}{:>12.1f}{:>12.3f}",
+                         mode,
+                         run,
+                         result.wall_seconds,
+                         total_chunks / result.wall_seconds,
+                         total_mb / result.wall_seconds,
+                         result.cpu_seconds / (total_mb / 1024.0));
+        }
+        if (succeeded > 0) {
+            std::println("{:<8}{:>6}{:>12.3f}{:>12.1f}{:>12.1f}{:>12.3f}",
+                         mode,
+                         "avg",
+                         wall_total / succeeded,
+                         total_chunks * succeeded / wall_total,
+                         total_mb * succeeded / wall_total,
+                         cpu_total / (total_mb * succeeded / 1024.0));
+        }
+    }
+
+    server.Stop();
+    fs::remove_all(work_dir);
+    return exit_code;
+}
+
+} // namespace lansend::benchmark
@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <core/network/bandwidth_scheduler.h>
+#include <core/util/config.h>
+#include <limits>
+
+namespace net = boost::asio;
+
+namespace lansend::core {
+
+BandwidthFlow::BandwidthFlow(std::shared_ptr<BandwidthScheduler> scheduler,
+                             std::string peer,
+                             TransferPriority priority,
+                             double weight)
+    : scheduler_(std::move(scheduler))
+    , peer_(std::move(peer))
+    , priority_(priority)
+    , weight_(BandwidthScheduler::PriorityWeight(priority) * weight)
+    , registered_at_(std::chrono::steady_clock::now()) {}
+
+BandwidthFlow::~BandwidthFlow() {
+    leave();
+}
+
+BandwidthFlow::BandwidthFlow(BandwidthFlow&& other) noexcept {
+    *this = std::move(other);
+}
+
+BandwidthFlow& BandwidthFlow::operator=(BandwidthFlow&& other) noexcept {
+    if (this != &other) {
+        leave();
+        scheduler_ = std::move(other.scheduler_);
+        peer_ = std::move(other.peer_);
+        priority_ = other.priority_;
+        weight_ = other.weight_;
+        rate_limit_ = other.rate_limit_;
+        bucket_ = other.bucket_;
+        last_finish_ = other.last_finish_;
+        bytes_ = other.bytes_;
+        throttled_seconds_ = other.throttled_seconds_;
+        registered_at_ = other.registered_at_;
+    }
+    return *this;
+}
+
+net::awaitable<void> BandwidthFlow::Acquire(std::size_t bytes) {
+    if (scheduler_) {
+        co_await scheduler_->acquire(*this, bytes);
+    }
+}
+
+void BandwidthFlow::SetRateLimit(double rate) {
+    if (rate_limit_ == 0.0 && rate > 0.0) {
+        bucket_.tokens = 0.0;
+        bucket_.refilled_at = std::chrono::steady_clock::now();
+    }
+    rate_limit_ = rate;
+}
+
+double BandwidthFlow::target_rate() const {
+    if (!scheduler_) {
+        return 0.0;
+    }
+    double target = 0.0;
+    for (double limit : {BandwidthScheduler::GlobalLimit(),
+                         BandwidthScheduler::DeviceLimit(peer_),
+                         rate_limit_}) {
+        if (limit > 0.0 && (target == 0.0 || limit < target)) {
+            target = limit;
+        }
+    }
+    return target;
+}
+
+double BandwidthFlow::actual_rate() const {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - registered_at_;
+    return elapsed.count() > 0.0 ? bytes_ / elapsed.count() : 0.0;
+}
+
+void BandwidthFlow::leave() {
+    if (scheduler_) {
+        scheduler_->leave(peer_);
+        scheduler_.reset();
+    }
+}
+
+std::shared_ptr<BandwidthScheduler> BandwidthScheduler::Create(net::io_context& ioc) {
+    return std::shared_ptr<BandwidthScheduler>(new BandwidthScheduler(ioc));
+}
+
+BandwidthScheduler::BandwidthScheduler(net::io_context& ioc)
+    : ioc_(ioc)
+    , refill_timer_(ioc)
+    , window_start_(std::chrono::steady_clock::now()) {
+    global_.refilled_at = window_start_;
+}
+
+BandwidthFlow BandwidthScheduler::Register(std::string peer,
+                                           TransferPriority priority,
+                                           double weight) {
+    join(peer);
+    return BandwidthFlow(shared_from_this(), std::move(peer), priority, weight);
+}
+
+void BandwidthScheduler::Reconfigure() {
+    dispatch();
+}
+
+BandwidthScheduler::Stats BandwidthScheduler::stats() const {
+    return Stats{
+        .target_rate = GlobalLimit(),
+        .actual_rate = actual_rate_,
+        .flows = flows_,
+        .classes = classes_,
+    };
+}
+
+double BandwidthScheduler::GlobalLimit() {
+    return settings.rate_limit * 1024.0;
+}
+
+double BandwidthScheduler::DeviceLimit(std::string_view peer) {
+    if (auto it = settings.device_rate_limits.find(std::string(peer));
+        it != settings.device_rate_limits.end()) {
+        return it->second * 1024.0;
+    }
+    return settings.device_rate_limit * 1024.0;
+}
+
+std::optional<TransferPriority> BandwidthScheduler::ParsePriority(std::string_view name) {
+    if (name == "interactive") {
+        return TransferPriority::kInteractive;
+    } else if (name == "normal") {
+        return TransferPriority::kNormal;
+    } else if (name == "background") {
+        return TransferPriority::kBackground;
+    }
+    return std::nullopt;
+}
+
+std::string_view BandwidthScheduler::PriorityName(TransferPriority priority) {
+    switch (priority) {
+    case TransferPriority::kInteractive:
+        return "interactive";
+    case TransferPriority::kNormal:
+        return "normal";
+    case TransferPriority::kBackground:
+        return "background";
+    }
+    return "normal";
+}
+
+double BandwidthScheduler::PriorityWeight(TransferPriority priority) {
+    switch (priority) {
+    case TransferPriority::kInteractive:
+        return 8.0;
+    case TransferPriority::kNormal:
+        return 4.0;
+    case TransferPriority::kBackground:
+        return 1.0;
+    }
+    return 4.0;
+}
+
+net::awaitable<void> BandwidthScheduler::acquire(BandwidthFlow& flow, std::size_t bytes) {
+    if (GlobalLimit() == 0.0 && DeviceLimit(flow.peer_) == 0.0 && flow.rate_limit_ == 0.0) {
+        account(flow, bytes);
+        co_return;
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+    net::steady_timer wakeup(ioc_, net::steady_timer::time_point::max());
+    Waiter waiter{
+        .flow = &flow,
+        .bytes = bytes,
+        .start = std::max(virtual_time_, flow.last_finish_),
+        .wakeup = &wakeup,
+    };
+    flow.last_finish_ = waiter.start + bytes / flow.weight_;
+    WaiterRegistration registration(shared_from_this(), waiter);
+    dispatch();
+
+    if (!waiter.granted) {
+        ++classes_[static_cast<std::size_t>(flow.priority_)].waits;
+        while (!waiter.granted) {
+            boost::system::error_code ec;
+            co_await wakeup.async_wait(net::redirect_error(net::use_awaitable, ec));
+        }
+    }
+    flow.throttled_seconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                                             - start_time)
+                                   .count();
+}
+
+BandwidthScheduler::WaiterRegistration::WaiterRegistration(
+    std::shared_ptr<BandwidthScheduler> scheduler, Waiter& waiter)
+    : scheduler_(std::move(scheduler))
+    , waiter_(waiter) {
+    scheduler_->waiters_.push_back(&waiter_);
+}
+
+BandwidthScheduler::WaiterRegistration::~WaiterRegistration() {
+    // Granted waiters are off the list already
+    std::erase(scheduler_->waiters_, &waiter_);
+}
+
+void BandwidthScheduler::join(const std::string& peer) {
+    auto& entry = peers_[peer];
+    if (entry.flows++ == 0) {
+        entry.bucket.refilled_at = std::chrono::steady_clock::now();
+    }
+    ++flows_;
+}
+
+void BandwidthScheduler::leave(const std::string& peer) {
+    if (auto it = peers_.find(peer); it != peers_.end() && --it->second.flows == 0) {
+        peers_.erase(it);
+    }
+    --flows_;
+}
+
+void BandwidthScheduler::dispatch() {
+    auto now = std::chrono::steady_clock::now();
+    double global_rate = GlobalLimit();
+    refill(global_, global_rate, now);
+    for (auto& [peer, entry] : peers_) {
+        refill(entry.bucket, DeviceLimit(peer), now);
+    }
+    for (auto* waiter : waiters_) {
+        refill(waiter->flow->bucket_, waiter->flow->rate_limit_, now);
+    }
+
+    while (!waiters_.empty() && debtSeconds(global_, global_rate) == 0.0) {
+        // The earliest start among the waiters whose device and flow are out of debt
+        Waiter* next = nullptr;
+        for (auto* waiter : waiters_) {
+            if (waitSeconds(*waiter) > 0.0) {
+                continue;
+            }
+            if (!next || waiter->start < next->start) {
+                next = waiter;
+            }
+        }
+        if (!next) {
+            break;
+        }
+        grant(*next);
+    }
+    if (waiters_.empty()) {
+        return;
+    }
+
+    // Wake up once the buckets holding the next waiter back are out of debt
+    double wait_seconds = std::numeric_limits<double>::max();
+    for (auto* waiter : waiters_) {
+        wait_seconds = std::min(wait_seconds, waitSeconds(*waiter));
+    }
+    wait_seconds = std::max(wait_seconds, debtSeconds(global_, global_rate));
+    auto wait = std::max(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                             std::chrono::duration<double>(wait_seconds)),
+                         std::chrono::steady_clock::duration(std::chrono::milliseconds(1)));
+
+    refill_timer_.expires_after(wait);
+    refill_timer_.async_wait([self = weak_from_this()](boost::system::error_code ec) {
+        if (auto scheduler = self.lock(); scheduler && !ec) {
+            scheduler->dispatch();
+        }
+    });
+}
+
+double BandwidthScheduler::waitSeconds(const Waiter& waiter) const {
+    const auto& flow = *waiter.flow;
+    return std::max(debtSeconds(peers_.at(flow.peer_).bucket, DeviceLimit(flow.peer_)),
+                    debtSeconds(flow.bucket_, flow.rate_limit_));
+}
+
+double BandwidthScheduler::debtSeconds(const Bucket& bucket, double rate) {
+    return rate > 0.0 && bucket.tokens < 0.0 ? -bucket.tokens / rate : 0.0;
+}
+
+void BandwidthScheduler::grant(Waiter& waiter) {
+    std::erase(waiters_, &waiter);
+    auto& flow = *waiter.flow;
+    // Buckets go into debt for requests larger than what they saved up, the following ones
+    // wait until it is paid off
+    if (GlobalLimit() > 0.0) {
+        global_.tokens -= waiter.bytes;
+    }
+    if (DeviceLimit(flow.peer_) > 0.0) {
+        peers_.at(flow.peer_).bucket.tokens -= waiter.bytes;
+    }
+    if (flow.rate_limit_ > 0.0) {
+        flow.bucket_.tokens -= waiter.bytes;
+    }
+    virtual_time_ = std::max(virtual_time_, waiter.start);
+    account(flow, waiter.bytes);
+    waiter.granted = true;
+    waiter.wakeup->cancel();
+}
+
+void BandwidthScheduler::account(BandwidthFlow& flow, std::size_t bytes) {
+    flow.bytes_ += bytes;
+    classes_[static_cast<std::size_t>(flow.priority_)].bytes += bytes;
+
+    auto now = std::chrono::steady_clock::now();
+    window_bytes_ += bytes;
+    if (now - window_start_ >= kRateWindow) {
+        actual_rate_ = window_bytes_ / std::chrono::duration<double>(now - window_start_).count();
+        window_start_ = now;
+        window_bytes_ = 0;
+    }
+}
+
+void BandwidthScheduler::refill(Bucket& bucket,
+                                double rate,
+                                std::chrono::steady_clock::time_point now) {
+    if (rate == 0.0) {
+        bucket.tokens = 0.0;
+    } else {
+        std::chrono::duration<double> elapsed = now - bucket.refilled_at;
+        double burst = rate * std::chrono::duration<double>(kBurstTime).count();
+        bucket.tokens = std::min(bucket.tokens + elapsed.count() * rate, burst);
+    }
+    bucket.refilled_at = now;
+}
+
+} // namespace lansend::core
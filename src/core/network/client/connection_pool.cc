@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <core/network/client/connection_pool.h>
+#include <format>
+#include <spdlog/spdlog.h>
+
+namespace net = boost::asio;
+
+namespace lansend::core {
+
+ConnectionLease::ConnectionLease(std::weak_ptr<ConnectionPool> pool,
+                                 std::string key,
+                                 std::unique_ptr<HttpsClient> client,
+                                 bool reused)
+    : pool_(std::move(pool))
+    , key_(std::move(key))
+    , client_(std::move(client))
+    , reused_(reused) {}
+
+ConnectionLease::~ConnectionLease() {
+    Release();
+}
+
+ConnectionLease& ConnectionLease::operator=(ConnectionLease&& other) noexcept {
+    if (this != &other) {
+        Release();
+        pool_ = std::move(other.pool_);
+        key_ = std::move(other.key_);
+        client_ = std::move(other.client_);
+        reused_ = other.reused_;
+    }
+    return *this;
+}
+
+void ConnectionLease::Discard() {
+    client_.reset();
+}
+
+void ConnectionLease::Release() {
+    if (!client_) {
+        return;
+    }
+    if (auto pool = pool_.lock()) {
+        pool->release(key_, std::move(client_));
+    }
+    client_.reset();
+}
+
+std::shared_ptr<ConnectionPool> ConnectionPool::Create(net::io_context& ioc,
+                                                       CertificateManager& cert_manager) {
+    return std::shared_ptr<ConnectionPool>(new ConnectionPool(ioc, cert_manager));
+}
+
+ConnectionPool::ConnectionPool(net::io_context& ioc, CertificateManager& cert_manager)
+    : ioc_(ioc)
+    , cert_manager_(cert_manager) {}
+
+std::string ConnectionPool::endpointKey(std::string_view host, unsigned short port) {
+    return std::format("{}:{}", host, port);
+}
+
+net::awaitable<ConnectionLease> ConnectionPool::Acquire(std::string host,
+                                                        unsigned short port,
+                                                        std::string device_id) {
+    auto key = endpointKey(host, port);
+
+    if (auto it = idle_.find(key); it != idle_.end()) {
+        auto& connections = it->second;
+        while (!connections.empty()) {
+            auto connection = std::move(connections.back());
+            connections.pop_back();
+
+            if (std::chrono::steady_clock::now() - connection.idle_since >= kIdleTimeout) {
+                ++stats_.expired;
+                continue;
+            }
+            if (!connection.client->IsIdleHealthy()) {
+                spdlog::debug("Pooled connection to {} was closed by the peer", key);
+                ++stats_.unhealthy;
+                continue;
+            }
+
+            if (connections.empty()) {
+                idle_.erase(it);
+            }
+            ++stats_.leases;
+            ++stats_.reused;
+            spdlog::debug("Reusing pooled connection to {}", key);
+            co_return ConnectionLease(weak_from_this(), key, std::move(connection.client), true);
+        }
+        idle_.erase(it);
+    }
+
+    auto client = std::make_unique<HttpsClient>(ioc_, cert_manager_);
+    if (!co_await client->Connect(host, port, device_id)) {
+        co_return ConnectionLease();
+    }
+    ++stats_.leases;
+    co_return ConnectionLease(weak_from_this(), key, std::move(client), false);
+}
+
+void ConnectionPool::Clear() {
+    idle_.clear();
+}
+
+void ConnectionPool::release(const std::string& key, std::unique_ptr<HttpsClient> client) {
+    // Closed, upgraded or half-read connections can't carry another request
+    if (!client->IsIdleHealthy()) {
+        return;
+    }
+
+    auto& connections = idle_[key];
+    if (connections.size() >= kMaxIdlePerDevice) {
+        connections.erase(connections.begin());
+    }
+    connections.push_back(IdleConnection{
+        .client = std::move(client),
+        .idle_since = std::chrono::steady_clock::now(),
+    });
+
+    if (!reaping_) {
+        reaping_ = true;
+        // The reaper keeps the pool alive until the last idle connection is gone
+        net::co_spawn(
+            ioc_,
+            [self = shared_from_this()]() { return self->reapIdle(); },
+            net::detached);
+    }
+}
+
+net::awaitable<void> ConnectionPool::reapIdle() {
+    net::steady_timer timer(ioc_);
+
+    while (!idle_.empty()) {
+        timer.expires_after(kIdleTimeout / 2);
+        co_await timer.async_wait(net::use_awaitable);
+
+        auto now = std::chrono::steady_clock::now();
+        for (auto it = idle_.begin(); it != idle_.end();) {
+            auto& connections = it->second;
+            auto expired = std::erase_if(connections, [now](const IdleConnection& connection) {
+                return now - connection.idle_since >= kIdleTimeout;
+            });
+            stats_.expired += expired;
+            it = connections.empty() ? idle_.erase(it) : std::next(it);
+        }
+    }
+
+    reaping_ = false;
+}
+
+} // namespace lansend::core
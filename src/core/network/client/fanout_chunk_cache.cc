@@ -0,0 +1,103 @@
+#include <core/network/client/fanout_chunk_cache.h>
+#include <spdlog/spdlog.h>
+
+namespace lansend::core {
+
+FanoutChunkCache::FanoutChunkCache(std::size_t receivers, std::size_t receiver_budget)
+    : receiver_budget_(receiver_budget)
+    , receivers_(receivers) {}
+
+FanoutChunkCache::~FanoutChunkCache() {
+    spdlog::info("Fan-out to {} devices: {} chunks read from disk, {} served from memory, {} read "
+                 "again by slow receivers",
+                 receivers_.size(),
+                 disk_reads_,
+                 hits_,
+                 rereads_);
+}
+
+std::shared_ptr<const BinaryData> FanoutChunkCache::Read(std::size_t receiver,
+                                                         const std::string& key,
+                                                         const std::function<BinaryData()>& read) {
+    auto& self = receivers_.at(receiver);
+    if (auto it = entries_.find(key); it != entries_.end() && it->second.waiting[receiver]) {
+        auto data = it->second.data;
+        // Whatever was kept for the receiver before this chunk was skipped by it
+        while (!self.pinned.empty()) {
+            auto pinned = std::move(self.pinned.front());
+            self.pinned.pop_front();
+            bool found = pinned == key;
+            release(receiver, pinned);
+            if (found) {
+                break;
+            }
+        }
+        ++hits_;
+        return data;
+    }
+
+    auto data = std::make_shared<const BinaryData>(read());
+    if (published_.contains(key)) {
+        // Let go for falling behind, or skipped before
+        ++rereads_;
+        return data;
+    }
+    ++disk_reads_;
+    if (data->empty()) {
+        return data;
+    }
+    published_.insert(key);
+
+    Entry entry{.data = data, .waiting = std::vector<bool>(receivers_.size())};
+    for (std::size_t other = 0; other < receivers_.size(); ++other) {
+        if (other == receiver || !receivers_[other].active) {
+            continue;
+        }
+        entry.waiting[other] = true;
+        ++entry.waiting_count;
+    }
+    if (entry.waiting_count == 0) {
+        return data;
+    }
+    entries_.emplace(key, std::move(entry));
+
+    for (std::size_t other = 0; other < receivers_.size(); ++other) {
+        if (!entries_.at(key).waiting[other]) {
+            continue;
+        }
+        auto& behind = receivers_[other];
+        behind.pinned.push_back(key);
+        behind.pinned_bytes += data->size();
+        while (behind.pinned_bytes > receiver_budget_ && behind.pinned.size() > 1) {
+            auto oldest = std::move(behind.pinned.front());
+            behind.pinned.pop_front();
+            release(other, oldest);
+        }
+    }
+    return data;
+}
+
+void FanoutChunkCache::Leave(std::size_t receiver) {
+    auto& self = receivers_.at(receiver);
+    self.active = false;
+    while (!self.pinned.empty()) {
+        auto pinned = std::move(self.pinned.front());
+        self.pinned.pop_front();
+        release(receiver, pinned);
+    }
+}
+
+void FanoutChunkCache::release(std::size_t receiver, const std::string& key) {
+    auto it = entries_.find(key);
+    if (it == entries_.end() || !it->second.waiting[receiver]) {
+        return;
+    }
+    auto& entry = it->second;
+    entry.waiting[receiver] = false;
+    receivers_[receiver].pinned_bytes -= entry.data->size();
+    if (--entry.waiting_count == 0) {
+        entries_.erase(it);
+    }
+}
+
+} // namespace lansend::core
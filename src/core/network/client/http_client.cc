@@ -1,5 +1,6 @@
 #include <core/network/client/http_client.h>
 #include <core/security/open_ssl_provider.h>
+#include <core/util/base64.h>
 #include <spdlog/spdlog.h>
 
 namespace lansend::core {
@@ -7,26 +8,20 @@ namespace lansend::core {
 HttpsClient::HttpsClient(net::io_context& ioc, CertificateManager& cert_manager)
     : ioc_(ioc)
     , cert_manager_(cert_manager)
-    , ssl_ctx_(OpenSSLProvider::BuildClientContext(
-          [&](bool preverified, ssl::verify_context& ctx) -> bool {
-              return cert_manager.VerifyCertificate(preverified, ctx);
-          })) {}
+    , session_cache_(TlsSessionCache::Instance(cert_manager)) {}
 
-HttpsClient::~HttpsClient() {
-    if (ssl_session_) {
-        SSL_SESSION_free(ssl_session_);
-        ssl_session_ = nullptr;
-    }
-}
+HttpsClient::~HttpsClient() = default;
 
-net::awaitable<bool> HttpsClient::Connect(std::string_view host, unsigned short port) {
+net::awaitable<bool> HttpsClient::Connect(std::string_view host,
+                                          unsigned short port,
+                                          std::string_view device_id) {
     try {
         if (connection_) {
             co_await Disconnect();
         }
 
-        connection_ = std::make_unique<beast::ssl_stream<beast::tcp_stream>>(beast::tcp_stream(ioc_),
-                                                                             ssl_ctx_);
+        connection_ = std::make_unique<beast::ssl_stream<beast::tcp_stream>>(
+            beast::tcp_stream(ioc_), session_cache_.context());
 
         if (!OpenSSLProvider::SetHostname(connection_->native_handle(), host)) {
             throw std::runtime_error("Failed to set SNI Hostname");
@@ -39,12 +34,14 @@ net::awaitable<bool> HttpsClient::Connect(std::string_view host, unsigned short
         co_await beast::get_lowest_layer(*connection_).async_connect(results);
         beast::get_lowest_layer(*connection_).expires_never();
 
+        // Resume the last session with this peer when there is one, skipping the certificate
+        // exchange and key agreement with its private key
+        session_cache_.PrepareConnection(connection_->native_handle(),
+                                         TlsSessionCache::PeerKey(device_id, host, port));
+        auto handshake_start = std::chrono::steady_clock::now();
         co_await connection_->async_handshake(ssl::stream_base::client);
-
-        if (ssl_session_) {
-            SSL_SESSION_free(ssl_session_);
-        }
-        ssl_session_ = SSL_get1_session(connection_->native_handle());
+        session_cache_.RecordHandshake(connection_->native_handle(),
+                                       std::chrono::steady_clock::now() - handshake_start);
 
         current_host_ = host;
         current_port_ = port;
@@ -90,10 +87,178 @@ net::awaitable<bool> HttpsClient::Disconnect() {
     }
 }
 
+net::awaitable<bool> HttpsClient::UpgradeToStream(std::string_view session_id) {
+    if (!connection_) {
+        throw std::runtime_error("No active connection");
+    }
+
+    auto req = CreateRequest<http::empty_body>(http::verb::get, ApiRoute::kStream.data(), true);
+    req.set(http::field::connection, "Upgrade");
+    req.set(http::field::upgrade, kStreamProtocol);
+    req.set(kStreamSessionHeader, session_id);
+    co_await http::async_write(*connection_, req);
+
+    // Frames read later continue from this buffer in case the server wrote ahead
+    frame_buffer_.clear();
+    http::response<http::string_body> res;
+    co_await http::async_read(*connection_, frame_buffer_, res);
+
+    if (res.result() != http::status::switching_protocols) {
+        spdlog::info("Server refused to switch to {}: {}", kStreamProtocol, res.body());
+        co_return false;
+    }
+    co_return true;
+}
+
+net::awaitable<std::optional<HttpsClient::DatagramUpgrade>> HttpsClient::UpgradeToDatagram(
+    std::string_view session_id) {
+    if (!connection_) {
+        throw std::runtime_error("No active connection");
+    }
+
+    auto req = CreateRequest<http::empty_body>(http::verb::get, ApiRoute::kStream.data(), true);
+    req.set(http::field::connection, "Upgrade");
+    req.set(http::field::upgrade, kDatagramProtocol);
+    req.set(kStreamSessionHeader, session_id);
+    co_await http::async_write(*connection_, req);
+
+    frame_buffer_.clear();
+    http::response<http::string_body> res;
+    co_await http::async_read(*connection_, frame_buffer_, res);
+
+    if (res.result() != http::status::switching_protocols) {
+        spdlog::info("Server refused to switch to {}: {}", kDatagramProtocol, res.body());
+        co_return std::nullopt;
+    }
+    // The server switched already, a connection it can't be told about is useless
+    std::uint16_t port = 0;
+    try {
+        port = static_cast<std::uint16_t>(std::stoul(std::string(res[kDatagramPortHeader])));
+    } catch (const std::exception&) {
+    }
+    std::optional<DatagramKeys> keys;
+    if (auto random = base64::Decode(res[kDatagramContextHeader])) {
+        keys = ExportDatagramKeys(connection_->native_handle(), session_id, *random);
+    }
+    if (port == 0 || !keys) {
+        throw std::runtime_error("Invalid lansend-datagram upgrade");
+    }
+    auto address = beast::get_lowest_layer(*connection_).socket().remote_endpoint().address();
+    co_return DatagramUpgrade{boost::asio::ip::udp::endpoint(address, port), std::move(*keys)};
+}
+
+net::awaitable<void> HttpsClient::WriteFrame(FrameType type,
+                                             std::uint8_t flags,
+                                             std::uint32_t stream_id,
+                                             std::span<const std::uint8_t> payload) {
+    if (!connection_) {
+        throw std::runtime_error("No active connection");
+    }
+    co_await core::WriteFrame(*connection_, type, flags, stream_id, payload);
+}
+
+net::awaitable<void> HttpsClient::WriteDataFrame(std::uint8_t flags,
+                                                 std::uint32_t stream_id,
+                                                 const DataFrameInfo& info,
+                                                 std::span<const std::uint8_t> data) {
+    if (!connection_) {
+        throw std::runtime_error("No active connection");
+    }
+    co_await core::WriteDataFrame(*connection_, flags, stream_id, info, data);
+}
+
+net::awaitable<Frame> HttpsClient::ReadFrame() {
+    if (!connection_) {
+        throw std::runtime_error("No active connection");
+    }
+    co_return co_await core::ReadFrame(*connection_, frame_buffer_);
+}
+
+net::awaitable<void> HttpsClient::BeginUpload(std::string_view session_id,
+                                              std::string_view file_id,
+                                              std::string_view file_token) {
+    if (!connection_) {
+        throw std::runtime_error("No active connection");
+    }
+
+    auto req = CreateRequest<http::empty_body>(http::verb::post,
+                                               ApiRoute::kUploadFile.data(),
+                                               true);
+    req.set(kStreamSessionHeader, session_id);
+    req.set(kUploadFileIdHeader, file_id);
+    req.set(kUploadFileTokenHeader, file_token);
+    req.chunked(true);
+
+    http::request_serializer<http::empty_body> serializer(req);
+    co_await http::async_write_header(*connection_, serializer);
+}
+
+net::awaitable<void> HttpsClient::WriteUploadRecord(std::uint8_t flags,
+                                                    const DataFrameInfo& info,
+                                                    std::span<const std::uint8_t> data) {
+    if (!connection_) {
+        throw std::runtime_error("No active connection");
+    }
+
+    auto header = EncodeFrameHeader(
+        {FrameType::kData, flags, 0, static_cast<std::uint32_t>(kDataFrameInfoSize + data.size())});
+    auto encoded_info = EncodeDataFrameInfo(info);
+    std::array<net::const_buffer, 3> buffers{
+        net::buffer(header),
+        net::buffer(encoded_info),
+        net::buffer(data.data(), data.size()),
+    };
+    co_await net::async_write(*connection_, http::make_chunk(buffers));
+}
+
+net::awaitable<http::response<http::string_body>> HttpsClient::FinishUpload() {
+    if (!connection_) {
+        throw std::runtime_error("No active connection");
+    }
+
+    co_await net::async_write(*connection_, http::make_chunk_last());
+
+    beast::flat_buffer buffer;
+    http::response<http::string_body> res;
+    co_await http::async_read(*connection_, buffer, res);
+
+    // The server closes the connection after rejecting an upload it did not read to the end
+    if (!res.keep_alive()) {
+        co_await Disconnect();
+    }
+    co_return res;
+}
+
 bool HttpsClient::IsConnected() const {
     return connection_ != nullptr;
 }
 
+bool HttpsClient::IsIdleHealthy() {
+    if (!connection_ || frame_buffer_.size() > 0) {
+        return false;
+    }
+
+    auto& socket = beast::get_lowest_layer(*connection_).socket();
+    if (!socket.is_open()) {
+        return false;
+    }
+
+    // Servers don't send anything unasked, readable bytes are a close_notify or the FIN of a
+    // connection the server dropped. Peek without blocking to tell them from a quiet one.
+    beast::error_code ec;
+    bool was_non_blocking = socket.non_blocking();
+    socket.non_blocking(true, ec);
+    if (ec) {
+        return false;
+    }
+    std::uint8_t byte = 0;
+    socket.receive(net::buffer(&byte, 1), tcp::socket::message_peek, ec);
+    beast::error_code restore_ec;
+    socket.non_blocking(was_non_blocking, restore_ec);
+
+    return ec == net::error::would_block || ec == net::error::try_again;
+}
+
 std::string HttpsClient::current_host() const {
     return current_host_;
 }
@@ -102,6 +267,22 @@ unsigned short HttpsClient::current_port() const {
     return current_port_;
 }
 
+tcp::socket* HttpsClient::socket() {
+    return connection_ ? &beast::get_lowest_layer(*connection_).socket() : nullptr;
+}
+
+void HttpsClient::ExpiresAfter(std::chrono::steady_clock::duration timeout) {
+    if (connection_) {
+        beast::get_lowest_layer(*connection_).expires_after(timeout);
+    }
+}
+
+void HttpsClient::ExpiresNever() {
+    if (connection_) {
+        beast::get_lowest_layer(*connection_).expires_never();
+    }
+}
+
 std::optional<boost::asio::ip::tcp::endpoint> HttpsClient::local_endpoint() const {
     if (!connection_) {
         return std::nullopt;
@@ -15,39 +15,44 @@ namespace lansend::core {
 
 HttpClientService::HttpClientService(boost::asio::io_context& ioc,
                                      CertificateManager& cert_manager,
-                                     FeedbackCallback callback)
+                                     FeedbackCallback callback,
+                                     std::shared_ptr<BandwidthScheduler> bandwidth)
     : ioc_(ioc)
     , cert_manager_(cert_manager)
-    , send_session_manager_(ioc, cert_manager, callback)
+    , connection_pool_(ConnectionPool::Create(ioc, cert_manager))
+    , send_session_manager_(ioc,
+                            cert_manager,
+                            connection_pool_,
+                            bandwidth ? std::move(bandwidth) : BandwidthScheduler::Create(ioc),
+                            callback)
     , callback_(callback) {
     // Constructor implementation
 }
 
 void HttpClientService::SetFeedbackCallback(FeedbackCallback callback) {
     callback_ = callback;
+    send_session_manager_.SetFeedbackCallback(std::move(callback));
 }
 
 void HttpClientService::Ping(std::string_view host, unsigned short port) {
-    auto client_ptr = std::make_shared<HttpsClient>(ioc_, cert_manager_);
     net::co_spawn(
         ioc_,
-        [&]() -> net::awaitable<void> {
+        [this, host = std::string(host), port]() -> net::awaitable<void> {
             try {
-                co_await client_ptr->Connect(host, port);
-                if (client_ptr->IsConnected()) {
-                    auto req = client_ptr->CreateRequest<http::string_body>(http::verb::get,
-                                                                            ApiRoute::kPing.data(),
-                                                                            true);
+                auto client = co_await connection_pool_->Acquire(host, port);
+                if (client) {
+                    auto req = client->CreateRequest<http::string_body>(http::verb::get,
+                                                                        ApiRoute::kPing.data(),
+                                                                        true);
                     req.set(http::field::user_agent, "Lansend");
                     req.prepare_payload();
 
-                    auto res = co_await client_ptr->SendRequest(req);
+                    auto res = co_await client->SendRequest(req);
                     if (res.result() == http::status::ok) {
                         spdlog::info("Ping to {}:{} success", host, port);
                     } else {
                         spdlog::error("Ping to {}:{} failed: {}", host, port, res.body());
                     }
-                    co_await client_ptr->Disconnect();
                 } else {
                     spdlog::error("Ping to {}:{} failed: connection error", host, port);
                 }
@@ -62,45 +67,47 @@ void HttpClientService::ConnectDevice(std::string_view pin_code,
                                       std::string_view ip,
                                       unsigned short port,
                                       std::string_view device_id) {
-    auto client_ptr = std::make_shared<HttpsClient>(ioc_, cert_manager_);
     net::co_spawn(
         ioc_,
-        [&]() -> net::awaitable<void> {
+        [this,
+         pin_code = std::string(pin_code),
+         ip = std::string(ip),
+         port,
+         device_id = std::string(device_id)]() -> net::awaitable<void> {
             try {
-                co_await client_ptr->Connect(ip, port);
-                if (client_ptr->IsConnected()) {
+                auto client = co_await connection_pool_->Acquire(ip, port, device_id);
+                if (client) {
                     json data;
                     data["pin_code"] = pin_code;
                     data["device_info"] = DeviceInfo::LocalDeviceInfo();
 
-                    auto req = client_ptr->CreateRequest<http::string_body>(http::verb::post,
-                                                                            ApiRoute::kConnect.data(),
-                                                                            true);
+                    auto req = client->CreateRequest<http::string_body>(http::verb::post,
+                                                                        ApiRoute::kConnect.data(),
+                                                                        true);
                     req.body() = data.dump();
                     req.prepare_payload();
 
-                    auto res = co_await client_ptr->SendRequest(req);
+                    auto res = co_await client->SendRequest(req);
                     if (res.result() == http::status::ok) {
                         spdlog::info("connect to device {}:{} success", ip, port);
                         feedback(Feedback{.type = FeedbackType::kConnectDeviceResult,
                                           .data = feedback::DeviceConnectResult{
-                                              .device_id = device_id.data(),
+                                              .device_id = device_id,
                                           }});
                     } else {
                         spdlog::error("connect to device {}:{} failed, pin-code mismatch", ip, port);
                         feedback(Feedback{.type = FeedbackType::kConnectDeviceResult,
                                           .data = feedback::DeviceConnectResult{
-                                              .device_id = device_id.data(),
+                                              .device_id = device_id,
                                               .success = false,
                                               .pin_code_error = true,
                                           }});
                     }
-                    co_await client_ptr->Disconnect();
                 } else {
                     spdlog::error("connect to device {}:{} failed, network error", ip, port);
                     feedback(Feedback{.type = FeedbackType::kConnectDeviceResult,
                                       .data = feedback::DeviceConnectResult{
-                                          .device_id = device_id.data(),
+                                          .device_id = device_id,
                                           .success = false,
                                           .network_error = true,
                                       }});
@@ -109,7 +116,7 @@ void HttpClientService::ConnectDevice(std::string_view pin_code,
                 spdlog::error("connect to device {}:{} failed: {}", ip, port, e.what());
                 feedback(Feedback{.type = FeedbackType::kConnectDeviceResult,
                                   .data = feedback::DeviceConnectResult{
-                                      .device_id = device_id.data(),
+                                      .device_id = device_id,
                                       .success = false,
                                       .network_error = true,
                                   }});
@@ -125,6 +132,11 @@ void HttpClientService::SendFiles(std::string_view ip_address,
     send_session_manager_.SendFiles(ip_address, port, file_paths, device_id);
 }
 
+void HttpClientService::SendFanout(const std::vector<SendTarget>& targets,
+                                   const std::vector<std::filesystem::path>& file_paths) {
+    send_session_manager_.SendFanout(targets, file_paths);
+}
+
 void HttpClientService::CancelSend(const std::string& session_id) {
     send_session_manager_.CancelSend(session_id);
 }
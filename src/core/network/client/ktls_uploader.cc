@@ -0,0 +1,230 @@
+#include <boost/asio/connect.hpp>
+#include <boost/beast/version.hpp>
+#include <core/constant/route.h>
+#include <core/network/client/ktls_uploader.h>
+#include <format>
+#include <spdlog/spdlog.h>
+#include <sstream>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace net = boost::asio;
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace ssl = net::ssl;
+using tcp = net::ip::tcp;
+
+namespace lansend::core {
+
+KtlsUploader::KtlsUploader(net::io_context& ioc, CertificateManager& cert_manager)
+    : ioc_(ioc)
+    , ssl_ctx_(OpenSSLProvider::BuildClientContext(
+          [&](bool preverified, ssl::verify_context& ctx) -> bool {
+              return cert_manager.VerifyCertificate(preverified, ctx);
+          },
+          true))
+    , socket_(ioc) {}
+
+KtlsUploader::~KtlsUploader() {
+    Close();
+}
+
+net::awaitable<bool> KtlsUploader::Connect(std::string_view host, unsigned short port) {
+#ifdef __linux__
+    try {
+        Close();
+
+        tcp::resolver resolver(ioc_);
+        auto results = co_await resolver.async_resolve(host,
+                                                       std::to_string(port),
+                                                       net::use_awaitable);
+        co_await net::async_connect(socket_, results, net::use_awaitable);
+        socket_.non_blocking(true);
+
+        ssl_ = SSL_new(ssl_ctx_.native_handle());
+        if (!ssl_ || !SSL_set_fd(ssl_, socket_.native_handle())
+            || !OpenSSLProvider::SetHostname(ssl_, host)) {
+            throw std::runtime_error("Failed to set up the TLS connection");
+        }
+
+        int result;
+        while ((result = SSL_connect(ssl_)) != 1) {
+            co_await waitFor(result);
+        }
+
+        if (!OpenSSLProvider::IsKtlsSendActive(ssl_)) {
+            spdlog::info("Kernel TLS is not available for {} with {}", host, SSL_get_cipher(ssl_));
+            Close();
+            co_return false;
+        }
+
+        host_ = host;
+        port_ = port;
+        spdlog::info("Kernel TLS connection to {}:{} using {}", host, port, SSL_get_cipher(ssl_));
+        co_return true;
+    } catch (const std::exception& e) {
+        spdlog::error("Kernel TLS connection error: {}", e.what());
+        Close();
+        co_return false;
+    }
+#else
+    co_return false;
+#endif
+}
+
+void KtlsUploader::Close() {
+    closeFile();
+    if (ssl_) {
+        SSL_shutdown(ssl_);
+        SSL_free(ssl_);
+        ssl_ = nullptr;
+    }
+    if (socket_.is_open()) {
+        boost::system::error_code ec;
+        socket_.close(ec);
+    }
+    read_buffer_.clear();
+}
+
+net::awaitable<void> KtlsUploader::BeginUpload(std::string_view session_id,
+                                               std::string_view file_id,
+                                               std::string_view file_token,
+                                               const std::filesystem::path& file_path) {
+#ifdef __linux__
+    closeFile();
+    file_fd_ = ::open(file_path.c_str(), O_RDONLY);
+    if (file_fd_ < 0) {
+        throw std::runtime_error(std::format("Failed to open file {}", file_path.string()));
+    }
+#endif
+
+    http::request<http::empty_body> req{http::verb::post, ApiRoute::kUploadFile.data(), 11};
+    req.set(http::field::host, std::format("{}:{}", host_, port_));
+    req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+    req.set(http::field::content_type, "application/octet-stream");
+    req.set(kStreamSessionHeader, session_id);
+    req.set(kUploadFileIdHeader, file_id);
+    req.set(kUploadFileTokenHeader, file_token);
+    req.keep_alive(true);
+    req.chunked(true);
+
+    std::ostringstream header;
+    header << req.base();
+    co_await write(header.str());
+}
+
+net::awaitable<void> KtlsUploader::WriteUploadRecord(std::uint8_t flags,
+                                                     const DataFrameInfo& info,
+                                                     std::uint64_t offset,
+                                                     std::size_t size) {
+    // Each record is one body chunk: | size line | frame header | chunk info | file data | CRLF |
+    auto frame_header = EncodeFrameHeader(
+        {FrameType::kData, flags, 0, static_cast<std::uint32_t>(kDataFrameInfoSize + size)});
+    auto encoded_info = EncodeDataFrameInfo(info);
+    co_await write(std::format("{:x}\r\n", kFrameHeaderSize + kDataFrameInfoSize + size));
+    co_await write(frame_header);
+    co_await write(encoded_info);
+    co_await sendFile(offset, size);
+    co_await write(std::string_view("\r\n"));
+}
+
+net::awaitable<http::response<http::string_body>> KtlsUploader::FinishUpload() {
+    closeFile();
+    co_await write(std::string_view("0\r\n\r\n"));
+
+    http::response_parser<http::string_body> parser;
+    parser.eager(true);
+    while (!parser.is_done()) {
+        if (read_buffer_.size() > 0) {
+            beast::error_code ec;
+            auto used = parser.put(read_buffer_.data(), ec);
+            read_buffer_.consume(used);
+            if (ec && ec != http::error::need_more) {
+                throw boost::system::system_error(ec);
+            }
+            if (parser.is_done() || (!ec && used > 0)) {
+                continue;
+            }
+        }
+
+        auto buffer = read_buffer_.prepare(16 * 1024);
+        std::size_t read = 0;
+        int result;
+        while ((result = SSL_read_ex(ssl_, buffer.data(), buffer.size(), &read)) != 1) {
+            co_await waitFor(result);
+        }
+        read_buffer_.commit(read);
+    }
+
+    auto res = parser.release();
+    if (!res.keep_alive()) {
+        Close();
+    }
+    co_return res;
+}
+
+net::awaitable<void> KtlsUploader::waitFor(int result) {
+    switch (SSL_get_error(ssl_, result)) {
+    case SSL_ERROR_WANT_READ:
+        co_await socket_.async_wait(tcp::socket::wait_read, net::use_awaitable);
+        break;
+    case SSL_ERROR_WANT_WRITE:
+        co_await socket_.async_wait(tcp::socket::wait_write, net::use_awaitable);
+        break;
+    case SSL_ERROR_ZERO_RETURN:
+        throw std::runtime_error("Connection closed by peer");
+    default: {
+        char message[256];
+        ERR_error_string_n(ERR_get_error(), message, sizeof(message));
+        throw std::runtime_error(std::format("TLS error: {}", message));
+    }
+    }
+}
+
+net::awaitable<void> KtlsUploader::write(std::span<const std::uint8_t> data) {
+    if (!ssl_) {
+        throw std::runtime_error("No active connection");
+    }
+    while (!data.empty()) {
+        std::size_t written = 0;
+        int result = SSL_write_ex(ssl_, data.data(), data.size(), &written);
+        if (result != 1) {
+            co_await waitFor(result);
+            continue;
+        }
+        data = data.subspan(written);
+    }
+}
+
+net::awaitable<void> KtlsUploader::write(std::string_view data) {
+    co_await write(std::span(reinterpret_cast<const std::uint8_t*>(data.data()), data.size()));
+}
+
+net::awaitable<void> KtlsUploader::sendFile(std::uint64_t offset, std::size_t size) {
+    if (!ssl_ || file_fd_ < 0) {
+        throw std::runtime_error("No active upload");
+    }
+    while (size > 0) {
+        ossl_ssize_t sent = SSL_sendfile(ssl_, file_fd_, static_cast<off_t>(offset), size, 0);
+        if (sent <= 0) {
+            co_await waitFor(static_cast<int>(sent));
+            continue;
+        }
+        offset += sent;
+        size -= sent;
+    }
+}
+
+void KtlsUploader::closeFile() {
+#ifdef __linux__
+    if (file_fd_ >= 0) {
+        ::close(file_fd_);
+        file_fd_ = -1;
+    }
+#endif
+}
+
+} // namespace lansend::core
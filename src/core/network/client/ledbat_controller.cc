@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <core/network/client/ledbat_controller.h>
+#include <spdlog/spdlog.h>
+
+#ifdef __linux__
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
+namespace lansend::core {
+
+LedbatController::LedbatController()
+    : window_start_(std::chrono::steady_clock::now()) {}
+
+void LedbatController::OnDelay(std::chrono::microseconds delay) {
+    if (delay <= std::chrono::microseconds::zero()) {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (base_delays_.empty() || now - base_delays_.back().minute >= std::chrono::minutes(1)) {
+        base_delays_.push_back(BaseDelay{now, delay});
+        if (base_delays_.size() > kBaseHistory) {
+            base_delays_.pop_front();
+        }
+    } else {
+        base_delays_.back().delay = std::min(base_delays_.back().delay, delay);
+    }
+
+    current_.push_back(delay);
+    if (current_.size() > kCurrentFilter) {
+        current_.pop_front();
+    }
+    adjust();
+}
+
+void LedbatController::OnSent(std::size_t bytes) {
+    auto now = std::chrono::steady_clock::now();
+    window_bytes_ += bytes;
+    if (now - window_start_ >= kRateWindow) {
+        sent_rate_ = window_bytes_ / std::chrono::duration<double>(now - window_start_).count();
+        window_start_ = now;
+        window_bytes_ = 0;
+    }
+}
+
+std::chrono::microseconds LedbatController::base_delay() const {
+    if (base_delays_.empty()) {
+        return std::chrono::microseconds::zero();
+    }
+    return std::ranges::min_element(base_delays_, {}, &BaseDelay::delay)->delay;
+}
+
+std::chrono::microseconds LedbatController::queuing_delay() const {
+    if (current_.empty()) {
+        return std::chrono::microseconds::zero();
+    }
+    return *std::ranges::min_element(current_) - base_delay();
+}
+
+void LedbatController::adjust() {
+    double target = std::chrono::duration<double>(kTargetDelay).count();
+    double queuing = std::chrono::duration<double>(queuing_delay()).count();
+    double off_target = std::clamp((target - queuing) / target, -1.0, 1.0);
+
+    if (off_target >= 0.0) {
+        // Only grow while the session actually uses its rate, an idle sender learns nothing
+        // about the link
+        double ceiling = sent_rate_ > 0.0 ? std::max(2.0 * sent_rate_, kMinRate) : kInitialRate;
+        rate_ = std::min(rate_ * (1.0 + kGain * off_target), std::max(ceiling, rate_));
+    } else {
+        rate_ *= std::max(kMaxDecrease, 1.0 + kGain * off_target);
+    }
+    rate_ = std::max(rate_, kMinRate);
+}
+
+void LedbatController::UseLowerEffort(boost::asio::ip::tcp::socket& socket) {
+#ifdef __linux__
+    int fd = socket.native_handle();
+    // Needs the tcp_lp module, the kernel refuses unknown algorithms and keeps the default
+    static constexpr char kCongestion[] = "lp";
+    if (::setsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, kCongestion, sizeof(kCongestion) - 1)
+        != 0) {
+        spdlog::debug("TCP-LP is not available, background sends rely on their rate alone");
+    }
+    // CS1, marks the traffic as lower effort (RFC 8622) for networks that honour it
+    int tos = 0x20;
+    boost::system::error_code ec;
+    if (auto endpoint = socket.local_endpoint(ec); !ec && endpoint.address().is_v6()) {
+        ::setsockopt(fd, IPPROTO_IPV6, IPV6_TCLASS, &tos, sizeof(tos));
+    } else {
+        ::setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+    }
+#else
+    (void) socket;
+#endif
+}
+
+std::optional<std::chrono::microseconds> LedbatController::SocketRtt(
+    boost::asio::ip::tcp::socket& socket) {
+#ifdef __linux__
+    tcp_info info{};
+    socklen_t length = sizeof(info);
+    if (::getsockopt(socket.native_handle(), IPPROTO_TCP, TCP_INFO, &info, &length) == 0
+        && info.tcpi_rtt > 0) {
+        return std::chrono::microseconds(info.tcpi_rtt);
+    }
+#else
+    (void) socket;
+#endif
+    return std::nullopt;
+}
+
+} // namespace lansend::core
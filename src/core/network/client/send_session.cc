@@ -1,5 +1,6 @@
 #include "core/model/feedback.h"
 #include "core/model/feedback/send_session_end.h"
+#include <algorithm>
 #include <boost/uuid/random_generator.hpp>
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_io.hpp>
@@ -7,9 +8,18 @@
 #include <core/constant/transfer.h>
 #include <core/model.h>
 #include <core/network/client/send_session.h>
+#include <core/network/multicast/multicast_round.h>
+#include <core/network/stream/stream_frame.h>
+#include <core/util/base64.h>
 #include <core/util/binary_message.h>
+#include <core/util/chunk_ranges.h>
+#include <core/util/config.h>
+#include <deque>
+#include <format>
 #include <fstream>
+#include <optional>
 #include <spdlog/spdlog.h>
+#include <thread>
 
 namespace net = boost::asio;
 namespace beast = boost::beast;
@@ -19,14 +29,39 @@ using json = nlohmann::json;
 
 namespace lansend::core {
 
+namespace {
+
+// A session waiting for the multicast round pings the receiver this often, well within the
+// server's idle timeout
+constexpr std::chrono::seconds kMulticastKeepAlive{10};
+
+} // namespace
+
 SendSession::SendSession(boost::asio::io_context& ioc,
                          CertificateManager& cert_manager,
+                         std::shared_ptr<ConnectionPool> connection_pool,
+                         std::shared_ptr<BandwidthScheduler> bandwidth,
                          FeedbackCallback callback)
     : ioc_(ioc)
-    , client_(ioc, cert_manager)
     , cert_manager_(cert_manager)
+    , connection_pool_(std::move(connection_pool))
+    , bandwidth_(std::move(bandwidth))
     , callback_(callback) {}
 
+SendSession::~SendSession() {
+    leaveMulticast();
+    if (datagram_) {
+        datagram_->Close();
+    }
+    if (fanout_) {
+        fanout_->Leave(fanout_receiver_);
+    }
+    // Only a session that went through leaves its connection between requests
+    if (session_status_ != SessionStatus::kCompleted) {
+        client_.Discard();
+    }
+}
+
 void SendSession::Cancel() {
     spdlog::info("Try to cancel send session: {}", session_id_);
     net::co_spawn(ioc_, cancelSend(), net::detached);
@@ -37,19 +72,117 @@ bool SendSession::IsCancelled() const {
            || session_status_ == SessionStatus::kCancelledByReceiver;
 }
 
-boost::asio::awaitable<bool> SendSession::cancelSend() {
-    spdlog::debug("SendSession::CancelSend");
+void SendSession::leaveMulticast() {
+    if (multicast_ && !multicast_reported_) {
+        multicast_reported_ = true;
+        multicast_->Leave();
+    }
+}
+
+net::awaitable<void> SendSession::receiveMulticast(const std::vector<std::string>& file_ids) {
+    if (file_ids.empty()) {
+        leaveMulticast();
+        co_return;
+    }
+    multicast_reported_ = true;
+    multicast_->Join(file_ids);
+
+    // The receiver drops idle connections along with their session, so the connection is kept
+    // busy until the round is over
+    while (!co_await multicast_->WaitDone(kMulticastKeepAlive)) {
+        if (IsCancelled()) {
+            co_return;
+        }
+        auto ping = client_->CreateRequest<http::string_body>(http::verb::get,
+                                                              ApiRoute::kPing.data(),
+                                                              true);
+        ping.prepare_payload();
+        co_await client_->SendRequest(ping);
+    }
+
     try {
+        auto req = client_->CreateRequest<http::string_body>(http::verb::post,
+                                                             ApiRoute::kMulticastDone.data(),
+                                                             true);
         json data;
         data["session_id"] = session_id_;
-
-        auto req = client_.CreateRequest<http::string_body>(http::verb::post,
-                                                            ApiRoute::kCancelSend.data(),
-                                                            false);
         req.body() = data.dump();
         req.prepare_payload();
 
-        auto res = co_await client_.SendRequest(req);
+        auto res = co_await client_->SendRequest(req);
+        if (res.result() != http::status::ok) {
+            // Every chunk is sent as usual, the receiver skips those it has
+            spdlog::warn("Multicast report of session {} failed: {}", session_id_, res.body());
+            co_return;
+        }
+        auto report_dto = json::parse(res.body()).get<MulticastReportDto>();
+
+        std::size_t delivered_chunks = 0;
+        std::size_t missing_chunks = 0;
+        for (const auto& file_id : file_ids) {
+            auto it = transfer_files_.find(file_id);
+            if (it == transfer_files_.end()) {
+                continue;
+            }
+            auto& file_info = it->second;
+            std::unordered_set<std::size_t> missing;
+            if (auto missing_it = report_dto.missing_chunks.find(file_id);
+                missing_it != report_dto.missing_chunks.end()) {
+                missing.insert(missing_it->second.begin(), missing_it->second.end());
+            }
+            for (std::size_t chunk_idx = 0; chunk_idx < file_info.total_chunks; ++chunk_idx) {
+                if (missing.contains(chunk_idx)) {
+                    ++missing_chunks;
+                } else if (file_info.satisfied_chunks.insert(chunk_idx).second) {
+                    file_info.multicast_chunks.insert(chunk_idx);
+                    ++delivered_chunks;
+                }
+            }
+        }
+        spdlog::info("Session {}: {} chunks arrived through multicast, {} left to send",
+                     session_id_,
+                     delivered_chunks,
+                     missing_chunks);
+    } catch (const std::exception& e) {
+        spdlog::warn("Multicast report of session {} failed: {}", session_id_, e.what());
+    }
+}
+
+boost::asio::awaitable<bool> SendSession::cancelSend() {
+    spdlog::debug("SendSession::CancelSend");
+    // An upgraded connection only carries frames and an upload in progress owns the connection,
+    // the sending loop tells the receiver
+    if (stream_active_ || upload_active_) {
+        session_status_ = SessionStatus::kCancelledBySender;
+        co_return true;
+    }
+    try {
+        // The session's own connection may be waiting for a response, cancel on another one
+        auto client = co_await connection_pool_->Acquire(host_, port_, receiver_device_id_);
+        if (!client) {
+            spdlog::error("Failed to cancel send: connection error");
+            co_return false;
+        }
+
+        http::request<http::string_body> req;
+        if (session_id_.empty() && !queue_ticket_.empty()) {
+            // Still in the receiver's queue, the request holding our place is cancelled with it
+            req = client->CreateRequest<http::string_body>(http::verb::post,
+                                                           ApiRoute::kCancelWait.data(),
+                                                           true);
+            req.set(kQueueTicketHeader, queue_ticket_);
+        } else {
+            json data;
+            data["session_id"] = session_id_;
+
+            req = client->CreateRequest<http::string_body>(http::verb::post,
+                                                           ApiRoute::kCancelSend.data(),
+                                                           true);
+            req.body() = data.dump();
+        }
+        req.prepare_payload();
+
+        auto res = co_await client->SendRequest(req);
 
         if (res.result() != http::status::ok) {
             spdlog::error("Failed to cancel send: {}:{}",
@@ -66,51 +199,187 @@ boost::asio::awaitable<bool> SendSession::cancelSend() {
     }
 }
 
-std::vector<FileDto> SendSession::prepareFiles(const std::vector<std::filesystem::path>& file_paths) {
-    std::vector<FileDto> prepared_files;
+std::optional<FileDto> SendSession::prepareFile(const std::filesystem::path& file_path,
+                                               std::string relative_path) {
+    try {
+        FileDto file_dto;
+        boost::uuids::random_generator uuid_gen;
+        file_dto.file_id = boost::uuids::to_string(uuid_gen());
+        spdlog::debug("File ID: {}", file_dto.file_id);
+        file_dto.file_name = file_path.filename().string();
+        file_dto.relative_path = std::move(relative_path);
+        file_dto.file_size = fs::file_size(file_path);
+        file_dto.chunk_size = transfer::kDefaultChunkSize;
+        file_dto.total_chunks = (file_dto.file_size + file_dto.chunk_size - 1)
+                                / file_dto.chunk_size;
+        // Hash the file and its chunks in one pass, chunk checksums are advertised so that the
+        // receiver can reuse identical chunks it already has and are reused when sending
+        auto checksums = FileHasher::CalculateFileAndChunkChecksums(file_path,
+                                                                    file_dto.chunk_size);
+        file_dto.file_checksum = std::move(checksums.file_checksum);
+        file_dto.chunk_checksums = std::move(checksums.chunk_checksums);
+        file_dto.file_type = GetFileType(file_path.string());
+        spdlog::debug(
+            "FileDto: file_id={}, file_name={}, file_size={}, chunk_size={}, total_chunks={}, "
+            "file_checksum={}, file_type={}",
+            file_dto.file_id,
+            file_dto.file_name,
+            file_dto.file_size,
+            file_dto.chunk_size,
+            file_dto.total_chunks,
+            file_dto.file_checksum,
+            FileTypeToString(file_dto.file_type));
+        return file_dto;
+    } catch (const std::exception& e) {
+        spdlog::error("Failed to prepare file {}: {}", file_path.string(), e.what());
+        return std::nullopt;
+    }
+}
+
+void SendSession::trackDelay(std::size_t bytes,
+                             std::optional<std::chrono::steady_clock::duration> latency) {
+    if (!ledbat_) {
+        return;
+    }
+
+    tcp::socket* socket = nullptr;
+    if (upload_via_sendfile_ && ktls_uploader_) {
+        socket = &ktls_uploader_->socket();
+    } else if (client_) {
+        socket = client_->socket();
+    }
+    auto delay = socket ? LedbatController::SocketRtt(*socket) : std::nullopt;
+    if (!delay && latency) {
+        delay = std::chrono::duration_cast<std::chrono::microseconds>(*latency);
+    }
+    ledbat_->OnSent(bytes);
+    if (delay) {
+        ledbat_->OnDelay(*delay);
+    }
+    bandwidth_flow_.SetRateLimit(ledbat_->rate());
+}
+
+PreparedFiles SendSession::PrepareFiles(const std::vector<std::filesystem::path>& file_paths) {
+    // Hashing dominates the preparation of large folders, so files are hashed in parallel while
+    // the folders are still walked. Deque elements stay in place as more are added.
+    std::deque<std::pair<fs::path, std::string>> entries;
+    std::deque<std::optional<FileDto>> prepared;
+    net::thread_pool pool(std::max(1u, std::thread::hardware_concurrency()));
+    auto add_entry = [&](const fs::path& path, std::string relative_path) {
+        const auto& entry = entries.emplace_back(path, std::move(relative_path));
+        auto& slot = prepared.emplace_back();
+        net::post(pool, [&entry, &slot] { slot = prepareFile(entry.first, entry.second); });
+    };
+
+    // Folders are expanded into their regular files, each keeping its path relative to the
+    // folder's parent so that the receiver recreates the folder itself
     for (const auto& file_path : file_paths) {
-        if (fs::exists(file_path)) {
-            FileDto file_dto;
-            boost::uuids::random_generator uuid_gen;
-            file_dto.file_id = boost::uuids::to_string(uuid_gen());
-            spdlog::debug("File ID: {}", file_dto.file_id);
-            file_dto.file_name = file_path.filename().string();
-            file_dto.file_size = fs::file_size(file_path);
-            file_dto.chunk_size = transfer::kDefaultChunkSize;
-            file_dto.total_chunks = (file_dto.file_size + file_dto.chunk_size - 1)
-                                    / file_dto.chunk_size;
-            file_dto.file_checksum = FileHasher::CalculateFileChecksum(file_path);
-            file_dto.file_type = GetFileType(file_path.string());
-            spdlog::debug(
-                "FileDto: file_id={}, file_name={}, file_size={}, chunk_size={}, total_chunks={}, "
-                "file_checksum={}, file_type={}",
-                file_dto.file_id,
-                file_dto.file_name,
-                file_dto.file_size,
-                file_dto.chunk_size,
-                file_dto.total_chunks,
-                file_dto.file_checksum,
-                FileTypeToString(file_dto.file_type));
-            prepared_files.emplace_back(file_dto);
-            transfer_files_.emplace(file_dto.file_id,
-                                    TransferFileInfo{file_path,
-                                                     file_dto.file_size,
-                                                     file_dto.total_chunks,
-                                                     ""});
+        if (fs::is_directory(file_path)) {
+            fs::path folder = fs::absolute(file_path).lexically_normal();
+            if (!folder.has_filename()) {
+                folder = folder.parent_path();
+            }
+            std::error_code ec;
+            for (fs::recursive_directory_iterator
+                     iter(folder, fs::directory_options::skip_permission_denied, ec),
+                 end;
+                 !ec && iter != end;
+                 iter.increment(ec)) {
+                if (iter->is_regular_file()) {
+                    add_entry(
+                        iter->path(),
+                        iter->path().lexically_relative(folder.parent_path()).generic_string());
+                }
+            }
+            if (ec) {
+                spdlog::warn("Failed to walk folder {}: {}", folder.string(), ec.message());
+            }
+        } else if (fs::exists(file_path)) {
+            add_entry(file_path, std::string{});
         } else {
             spdlog::error("File not found: {}", file_path.string());
         }
     }
+
+    pool.join();
+
+    PreparedFiles prepared_files;
+    prepared_files.reserve(prepared.size());
+    std::size_t inline_budget = transfer::kMaxInlineTotalSize;
+    for (std::size_t i = 0; i < prepared.size(); ++i) {
+        if (!prepared[i]) {
+            continue;
+        }
+        auto& file_dto = *prepared[i];
+
+        // Embed tiny files in the request so the receiver can save them without any further
+        // round trip, the receiver validates the content against the file checksum
+        if (file_dto.file_size > 0 && file_dto.file_size <= transfer::kInlineFileThreshold
+            && file_dto.file_size <= inline_budget) {
+            BinaryData content(file_dto.file_size);
+            std::ifstream file(entries[i].first, std::ios::binary);
+            if (file.read(reinterpret_cast<char*>(content.data()), content.size())) {
+                file_dto.inline_content = base64::Encode(content);
+                inline_budget -= file_dto.file_size;
+            }
+        }
+        prepared_files.push_back(PreparedFile{std::move(file_dto), entries[i].first});
+    }
+    spdlog::info("Prepared {} files", prepared_files.size());
     return prepared_files;
 }
 
-boost::asio::awaitable<void> SendSession::Start(const std::vector<std::filesystem::path>& file_paths,
-                                                std::string_view host,
-                                                unsigned int port,
+std::vector<FileDto> SendSession::registerFiles(const PreparedFiles& prepared_files) {
+    std::vector<FileDto> file_dtos;
+    file_dtos.reserve(prepared_files.size());
+    for (const auto& [file_dto, file_path] : prepared_files) {
+        transfer_files_.emplace(file_dto.file_id,
+                                TransferFileInfo{
+                                    .file_path = file_path,
+                                    .file_size = file_dto.file_size,
+                                    .total_chunks = file_dto.total_chunks,
+                                    .file_checksum = file_dto.file_checksum,
+                                    .chunk_checksums = file_dto.chunk_checksums,
+                                    .file_type = file_dto.file_type,
+                                });
+        file_dtos.push_back(file_dto);
+    }
+    return file_dtos;
+}
+
+std::shared_ptr<const BinaryData> SendSession::readChunk(std::ifstream& file,
+                                                         std::string_view file_id,
+                                                         std::size_t chunk_idx,
+                                                         std::size_t size) {
+    auto read = [&]() {
+        BinaryData chunk_data(size);
+        file.seekg(chunk_idx * transfer::kDefaultChunkSize);
+        file.read(reinterpret_cast<char*>(chunk_data.data()), size);
+        if (file.gcount() == 0) {
+            chunk_data.clear();
+        }
+        return chunk_data;
+    };
+    if (fanout_) {
+        return fanout_->Read(fanout_receiver_, std::format("{}:{}", file_id, chunk_idx), read);
+    }
+    return std::make_shared<const BinaryData>(read());
+}
+
+boost::asio::awaitable<void> SendSession::Start(std::vector<std::filesystem::path> file_paths,
+                                                std::string host,
+                                                unsigned short port,
+                                                SessionStartedCallback callback) {
+    auto prepared_files = std::make_shared<const PreparedFiles>(PrepareFiles(file_paths));
+    co_await Start(std::move(prepared_files), std::move(host), port, std::move(callback));
+}
+
+boost::asio::awaitable<void> SendSession::Start(std::shared_ptr<const PreparedFiles> prepared_files,
+                                                std::string host,
+                                                unsigned short port,
                                                 SessionStartedCallback callback) {
     spdlog::debug("SendSession::Start");
-    auto prepared_files = prepareFiles(file_paths);
-    if (prepared_files.empty()) {
+    if (prepared_files->empty()) {
         spdlog::error("No files to send");
         co_return;
     }
@@ -122,10 +391,19 @@ boost::asio::awaitable<void> SendSession::Start(const std::vector<std::filesyste
     try {
         RequestSendDto send_request_dto;
         send_request_dto.device_info = DeviceInfo::LocalDeviceInfo();
-        send_request_dto.files = std::move(prepared_files);
+        send_request_dto.files = registerFiles(*prepared_files);
+        send_request_dto.queue_supported = true;
+        if (multicast_) {
+            send_request_dto.multicast_group = multicast_->group().address().to_string();
+            send_request_dto.multicast_port = multicast_->group().port();
+            send_request_dto.multicast_transfer_id = multicast_->transfer_id();
+            send_request_dto.multicast_key = base64::Encode(multicast_->key());
+        }
 
-        bool connected = co_await client_.Connect(host, port);
-        if (!connected) {
+        host_ = host;
+        port_ = port;
+        client_ = co_await connection_pool_->Acquire(host, port, receiver_device_id_);
+        if (!client_) {
             spdlog::error("Failed to connect to server");
 
             // feedback network error
@@ -140,8 +418,8 @@ boost::asio::awaitable<void> SendSession::Start(const std::vector<std::filesyste
         // Local endpoint information for this specific connection
         // Different from the local device info which used for http server
         send_request_dto.device_info.ip_address
-            = client_.local_endpoint().value().address().to_string();
-        send_request_dto.device_info.port = client_.local_endpoint().value().port();
+            = client_->local_endpoint().value().address().to_string();
+        send_request_dto.device_info.port = client_->local_endpoint().value().port();
 
         do {
             bool accepted = co_await requestSend(send_request_dto);
@@ -150,6 +428,10 @@ boost::asio::awaitable<void> SendSession::Start(const std::vector<std::filesyste
                     spdlog::info("send request was cancelled");
                     co_return;
                 } else if (session_status_ == SessionStatus::kWaiting) {
+                    if (!queue_ticket_.empty()) {
+                        // The receiver keeps our place, go back to wait for the turn right away
+                        continue;
+                    }
                     // Receiver is busy, wait for a while and retry
                     spdlog::info("Receiver is busy, retrying in 1 second...");
                     auto timer = net::steady_timer(co_await net::this_coro::executor,
@@ -167,7 +449,7 @@ boost::asio::awaitable<void> SendSession::Start(const std::vector<std::filesyste
                         },
                     });
 
-                    co_await client_.Disconnect();
+                    co_await client_->Disconnect();
                     session_status_ = SessionStatus::kDeclined;
                     co_return;
                 }
@@ -185,36 +467,179 @@ boost::asio::awaitable<void> SendSession::Start(const std::vector<std::filesyste
         });
 
         session_status_ = SessionStatus::kSending;
+        stats_ = SessionStats{};
+        auto start_time = std::chrono::steady_clock::now();
+        auto priority = BandwidthScheduler::ParsePriority(settings.transfer_priority);
+        bandwidth_flow_ = bandwidth_->Register(receiver_device_id_.empty() ? host_
+                                                                           : receiver_device_id_,
+                                               priority.value_or(TransferPriority::kNormal));
+        if (priority == TransferPriority::kBackground) {
+            ledbat_.emplace();
+            bandwidth_flow_.SetRateLimit(ledbat_->rate());
+            if (auto* socket = client_->socket()) {
+                LedbatController::UseLowerEffort(*socket);
+            }
+        }
+        if (!multicast_joined_) {
+            leaveMulticast();
+        }
 
         std::vector<std::pair<std::string, size_t>> files_by_size;
         for (const auto& [file_id, file_info] : transfer_files_) {
             files_by_size.emplace_back(file_id, file_info.file_size);
         }
+        // The receiver relies on this exact order to plan chunks shared between files
         std::sort(files_by_size.begin(), files_by_size.end(), [](const auto& a, const auto& b) {
-            return a.second < b.second;
+            return std::tie(a.second, a.first) < std::tie(b.second, b.first);
         });
 
-        spdlog::info("Sorted files by size:");
+        // Small files are packed into batches so that a folder of many tiny files doesn't cost
+        // a few round trips per file, files with locally satisfied chunks are sent on their own
+        std::vector<std::string> packed_files;
+        std::vector<std::string> single_files;
+        spdlog::debug("Sorted files by size:");
         for (const auto& [file_id, file_size] : files_by_size) {
-            spdlog::info("File ID: {}, Size: {}", file_id, file_size);
+            spdlog::debug("File ID: {}, Size: {}", file_id, file_size);
+            const auto& file_info = transfer_files_.at(file_id);
+            if (file_info.delivered_inline) {
+                // Already saved by the receiver from the request payload
+                stats_.file_count++;
+                stats_.raw_bytes += file_size;
+                stats_.wire_bytes += file_size;
+
+                // feedback file sending completed
+                feedback(Feedback{
+                    .type = FeedbackType::kFileSendingCompleted,
+                    .data = feedback::FileSendingCompleted{
+                        .session_id = session_id_,
+                        .filename = file_info.file_path.string(),
+                    },
+                });
+                continue;
+            }
+            if (batch_supported_ && file_size <= transfer::kPackedFileThreshold
+                && file_info.satisfied_chunks.empty()) {
+                packed_files.push_back(file_id);
+            } else {
+                single_files.push_back(file_id);
+            }
+        }
+        spdlog::info("Start sending files ({} packed, {} single)",
+                     packed_files.size(),
+                     single_files.size());
+
+        if (!packed_files.empty()) {
+            co_await sendBatches(packed_files);
+            if (session_status_ == SessionStatus::kCancelledBySender
+                || session_status_ == SessionStatus::kCancelledByReceiver) {
+                spdlog::info("File transfer cancelled");
+                co_return;
+            }
+            if (session_status_ == SessionStatus::kFailed) {
+                spdlog::info("Send session {} failed", session_id_);
+                co_return;
+            }
+        }
+
+        // The receiver gets what it can of the remaining files from the multicast round first
+        if (multicast_joined_) {
+            co_await receiveMulticast(single_files);
+            if (session_status_ == SessionStatus::kCancelledBySender
+                || session_status_ == SessionStatus::kCancelledByReceiver) {
+                spdlog::info("File transfer cancelled");
+                co_return;
+            }
+        }
+
+        // Chunks of the remaining files go over frames instead of one HTTP request each, their
+        // data frames over UDP if asked to
+        if (!single_files.empty() && stream_supported_ && datagram_supported_
+            && settings.udp_transport) {
+            if (auto upgrade = co_await client_->UpgradeToDatagram(session_id_)) {
+                datagram_ = DatagramSender::Create(ioc_,
+                                                   upgrade->receiver,
+                                                   std::move(upgrade->keys));
+                stream_active_ = true;
+                spdlog::info("Switched session {} to {}", session_id_, kDatagramProtocol);
+            }
+        }
+        if (!single_files.empty() && !stream_active_ && stream_supported_
+            && settings.stream_transport) {
+            stream_active_ = co_await client_->UpgradeToStream(session_id_);
+            if (stream_active_) {
+                spdlog::info("Switched session {} to {}", session_id_, kStreamProtocol);
+            }
+        }
+
+        // Uploads can skip the user space copy when the kernel encrypts the connection
+        if (!single_files.empty() && !stream_active_ && upload_supported_
+            && settings.chunked_upload && settings.kernel_tls) {
+            ktls_uploader_ = std::make_unique<KtlsUploader>(ioc_, cert_manager_);
+            if (!co_await ktls_uploader_->Connect(host, port)) {
+                spdlog::warn("Kernel TLS unavailable, falling back to regular uploads");
+                ktls_uploader_.reset();
+            } else if (ledbat_) {
+                LedbatController::UseLowerEffort(ktls_uploader_->socket());
+            }
         }
-        spdlog::info("Start sending files");
 
-        // Start sending files one by one in order of increasing size
-        for (const auto& [file_id, _] : files_by_size) {
+        // Send the remaining files one by one in order of increasing size
+        for (const auto& file_id : single_files) {
             co_await sendFile(file_id);
             if (session_status_ == SessionStatus::kCancelledBySender
                 || session_status_ == SessionStatus::kCancelledByReceiver) {
                 spdlog::info("File transfer cancelled");
+                co_await closeStream(FrameType::kCancel);
                 co_return;
             }
             if (session_status_ == SessionStatus::kFailed) {
                 spdlog::info("Send session {} failed", session_id_);
+                co_await closeStream(FrameType::kCancel);
                 co_return;
             }
         }
+        co_await closeStream(FrameType::kEnd);
+        ktls_uploader_.reset();
         spdlog::info("All files sent successfully, closing session: {}", session_id_);
         session_status_ = SessionStatus::kCompleted;
+        if (ledbat_) {
+            // The connection may run TCP-LP now, keep it away from other sessions
+            client_.Discard();
+        } else {
+            client_.Release();
+        }
+
+        stats_.target_rate = bandwidth_flow_.target_rate() / (1024.0 * 1024.0);
+        stats_.throttled_seconds = bandwidth_flow_.throttled_seconds();
+        stats_.Finish(
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count());
+        spdlog::info("Session {}: {} files, {} bytes in {:.2f}s ({:.2f} MB/s, {:.1f} files/s), "
+                     "{} bytes on wire, {} bytes deduplicated, compression ratio {:.2f}",
+                     session_id_,
+                     stats_.file_count,
+                     stats_.raw_bytes,
+                     stats_.elapsed_seconds,
+                     stats_.effective_throughput,
+                     stats_.files_per_second,
+                     stats_.wire_bytes,
+                     stats_.deduplicated_bytes,
+                     stats_.compression_ratio);
+        if (ledbat_) {
+            spdlog::info("Session {}: background rate {:.2f} MB/s, base delay {}us, queueing delay "
+                         "{}us",
+                         session_id_,
+                         ledbat_->rate() / (1024.0 * 1024.0),
+                         ledbat_->base_delay().count(),
+                         ledbat_->queuing_delay().count());
+        }
+        if (stats_.target_rate > 0.0) {
+            spdlog::info("Session {}: {:.2f} MB/s on wire for a target of {:.2f} MB/s, {:.2f}s "
+                         "throttled",
+                         session_id_,
+                         stats_.wire_rate,
+                         stats_.target_rate,
+                         stats_.throttled_seconds);
+        }
 
         // feedback session completed
         feedback(Feedback{
@@ -222,6 +647,7 @@ boost::asio::awaitable<void> SendSession::Start(const std::vector<std::filesyste
             .data = feedback::SendSessionEnd{
                 .session_id = session_id_,
                 .success = true,
+                .stats = stats_,
             },
         });
     } catch (const std::exception& e) {
@@ -236,22 +662,51 @@ boost::asio::awaitable<void> SendSession::Start(const std::vector<std::filesyste
 net::awaitable<bool> SendSession::requestSend(const RequestSendDto& send_request_dto) {
     spdlog::debug("SendSession::SendRequest");
     try {
-        json data = send_request_dto;
-        auto req = client_.CreateRequest<http::string_body>(http::verb::post,
+        http::request<http::string_body> req;
+        if (queue_ticket_.empty()) {
+            json data = send_request_dto;
+            req = client_->CreateRequest<http::string_body>(http::verb::post,
                                                             ApiRoute::kRequestSend.data(),
                                                             true);
-
-        req.body() = data.dump();
+            req.body() = data.dump();
+            spdlog::debug("Sending SendRequestDto: {}", req.body());
+        } else {
+            // Queued by the receiver, it still has our request
+            req = client_->CreateRequest<http::string_body>(http::verb::post,
+                                                            ApiRoute::kWaitTurn.data(),
+                                                            true);
+            req.set(kQueueTicketHeader, queue_ticket_);
+        }
         req.prepare_payload();
 
-        spdlog::debug("Sending SendRequestDto: {}", req.body());
-        auto res = co_await client_.SendRequest(req);
+        auto res = co_await client_->SendRequest(req);
 
         if (session_status_ == SessionStatus::kCancelledBySender) {
             spdlog::debug("Sender cancelled waiting for user confirmation");
             co_return false;
         }
 
+        if (res.result() == http::status::accepted) {
+            auto queued_dto = json::parse(res.body()).get<RequestQueuedDto>();
+            queue_ticket_ = std::move(queued_dto.ticket);
+            if (queued_dto.position != queue_position_) {
+                spdlog::info("The receiver is busy, waiting at position {} of its queue",
+                             queued_dto.position);
+                queue_position_ = queued_dto.position;
+
+                // feedback position in the receiver's queue
+                feedback(Feedback{
+                    .type = FeedbackType::kRecipientBusy,
+                    .data = feedback::RecipientBusy{
+                        .device_id = receiver_device_id_,
+                        .position = queue_position_,
+                    },
+                });
+            }
+            session_status_ = SessionStatus::kWaiting;
+            co_return false;
+        }
+
         if (res.result() != http::status::ok) {
             if (res.result() == http::status::forbidden) {
                 spdlog::info("Send request is forbidden: {}", res.body());
@@ -259,6 +714,14 @@ net::awaitable<bool> SendSession::requestSend(const RequestSendDto& send_request
                     spdlog::info(
                         "The receiver is busy right now, automatically reject the request");
                     session_status_ = SessionStatus::kWaiting;
+                } else if (res.body() == "invalid ticket") {
+                    // The receiver dropped us from its queue, line up again
+                    spdlog::info("Lost the place in the receiver's queue, requesting again");
+                    queue_ticket_.clear();
+                    queue_position_ = 0;
+                    co_return co_await requestSend(send_request_dto);
+                } else if (res.body() == "sender cancelled") {
+                    session_status_ = SessionStatus::kCancelledBySender;
                 } else if (res.body() == "declined") {
                     spdlog::info("Send request is cancelled by the sender");
                     session_status_ = SessionStatus::kDeclined;
@@ -289,6 +752,20 @@ net::awaitable<bool> SendSession::requestSend(const RequestSendDto& send_request
 
         session_id_ = std::move(response_dto.session_id);
         spdlog::info("Send Request is accepted, session_id: {}", session_id_);
+        if (settings.compression) {
+            accepted_compressions_ = std::move(response_dto.accepted_compressions);
+        }
+        batch_supported_ = response_dto.batch_supported;
+        stream_supported_ = response_dto.stream_supported;
+        datagram_supported_ = response_dto.datagram_supported;
+        upload_supported_ = response_dto.upload_supported;
+        continue_supported_ = response_dto.continue_supported;
+        multicast_joined_ = multicast_ && response_dto.multicast_joined;
+        for (const auto& file_id : response_dto.inline_received) {
+            if (auto it = transfer_files_.find(file_id); it != transfer_files_.end()) {
+                it->second.delivered_inline = true;
+            }
+        }
         session_status_ = SessionStatus::kSending;
 
         for (auto& [file_id, file_token] : response_dto.file_tokens) {
@@ -296,6 +773,15 @@ net::awaitable<bool> SendSession::requestSend(const RequestSendDto& send_request
             if (it != transfer_files_.end()) {
                 // Update file token and start sending the file
                 it->second.file_token = std::move(file_token);
+                if (auto satisfied = response_dto.satisfied_chunks.find(file_id);
+                    satisfied != response_dto.satisfied_chunks.end()) {
+                    it->second.satisfied_chunks.insert(satisfied->second.begin(),
+                                                       satisfied->second.end());
+                    spdlog::info("Receiver already has {}/{} chunks of file {}",
+                                 it->second.satisfied_chunks.size(),
+                                 it->second.total_chunks,
+                                 file_id);
+                }
             } else {
                 // Remove unwanted file
                 spdlog::info("File {} is unwanted, remove it", file_id);
@@ -318,7 +804,7 @@ boost::asio::awaitable<void> SendSession::sendFile(std::string_view file_id) {
             || session_status_ == SessionStatus::kCancelledByReceiver) {
             co_return;
         }
-        if (!client_.IsConnected()) {
+        if (!client_ || !client_->IsConnected()) {
             throw std::runtime_error("No active connection for sending chunk");
         }
         TransferFileInfo& file_info = transfer_files_.at(file_id.data());
@@ -329,29 +815,144 @@ boost::asio::awaitable<void> SendSession::sendFile(std::string_view file_id) {
             throw std::runtime_error("Failed to open file");
         }
 
+        AdaptiveCompressor compressor(file_info.file_type, accepted_compressions_);
+        stats_.file_count++;
+        stats_.raw_bytes += file_info.file_size;
+
+        // The last chunk actually sent asks the receiver to finalize the file in the same
+        // round trip, receivers that ignore the flag are verified separately afterwards
+        std::size_t final_chunk_idx = file_info.total_chunks;
+        for (std::size_t chunk_idx = file_info.total_chunks; chunk_idx-- > 0;) {
+            if (!file_info.satisfied_chunks.contains(chunk_idx)) {
+                final_chunk_idx = chunk_idx;
+                break;
+            }
+        }
+        bool finalized = false;
+
+        // Without an upgraded connection, the whole file goes in one chunked request
+        bool uploading = !stream_active_ && upload_supported_ && settings.chunked_upload;
+        // sendfile needs the chunk checksums up front since the data is never read here
+        upload_via_sendfile_ = uploading && ktls_uploader_
+                               && file_info.chunk_checksums.size() == file_info.total_chunks;
+        if (upload_via_sendfile_) {
+            co_await ktls_uploader_->BeginUpload(session_id_,
+                                                 file_id,
+                                                 file_info.file_token,
+                                                 file_info.file_path);
+            upload_active_ = true;
+        } else if (uploading) {
+            co_await client_->BeginUpload(session_id_, file_id, file_info.file_token);
+            upload_active_ = true;
+        }
+
+        std::uint32_t stream_id = 0;
+        if (stream_active_) {
+            stream_id = next_stream_id_++;
+            stream_files_[stream_id] = std::string(file_id);
+            json open_data;
+            open_data["file_id"] = file_id;
+            open_data["file_token"] = file_info.file_token;
+            auto payload = open_data.dump();
+            co_await writeFrame(FrameType::kOpen,
+                                0,
+                                stream_id,
+                                BinaryData(payload.begin(), payload.end()));
+        }
+
         for (std::size_t chunk_idx = 0; chunk_idx < file_info.total_chunks; ++chunk_idx) {
+            // The receiver fills this chunk from its local copy before verification
+            if (file_info.satisfied_chunks.contains(chunk_idx)) {
+                auto& skipped_bytes = file_info.multicast_chunks.contains(chunk_idx)
+                                          ? stats_.multicast_bytes
+                                          : stats_.deduplicated_bytes;
+                skipped_bytes += std::min(transfer::kDefaultChunkSize,
+                                          file_info.file_size
+                                              - chunk_idx * transfer::kDefaultChunkSize);
+                continue;
+            }
+
             std::size_t current_chunk_size = std::min(transfer::kDefaultChunkSize,
                                                       file_info.file_size
                                                           - chunk_idx * transfer::kDefaultChunkSize);
-            BinaryData chunk_data(current_chunk_size);
+            bool chunk_sent = false;
+            if (upload_via_sendfile_) {
+                // The chunk goes from the page cache to the socket, it is neither read nor
+                // compressed here
+                SendChunkDto send_chunk_dto{
+                    session_id_,
+                    file_id.data(),
+                    file_info.file_token,
+                    chunk_idx,
+                    file_info.chunk_checksums[chunk_idx],
+                };
+                if (chunk_idx == final_chunk_idx) {
+                    send_chunk_dto.is_final = true;
+                    send_chunk_dto.file_checksum = file_info.file_checksum;
+                }
+                co_await bandwidth_flow_.Acquire(current_chunk_size);
+                chunk_sent = co_await writeSendfileRecord(send_chunk_dto,
+                                                          chunk_idx * transfer::kDefaultChunkSize,
+                                                          current_chunk_size);
+                trackDelay(current_chunk_size);
+                stats_.wire_bytes += current_chunk_size;
+            } else {
+                auto chunk_data = readChunk(file, file_id, chunk_idx, current_chunk_size);
+                if (chunk_data->empty()) {
+                    break;
+                }
 
-            file.read(reinterpret_cast<char*>(chunk_data.data()), transfer::kDefaultChunkSize);
+                SendChunkDto send_chunk_dto{
+                    session_id_,
+                    file_id.data(),
+                    file_info.file_token,
+                    chunk_idx,
+                    chunk_idx < file_info.chunk_checksums.size()
+                        ? file_info.chunk_checksums[chunk_idx]
+                        : FileHasher::CalculateDataChecksum(*chunk_data),
+                };
+                if (chunk_idx == final_chunk_idx) {
+                    send_chunk_dto.is_final = true;
+                    send_chunk_dto.file_checksum = file_info.file_checksum;
+                }
 
-            if (file.gcount() == 0) {
-                break;
-            }
+                // The checksum always covers the raw data, compression only changes the payload
+                if (auto compressed = compressor.Compress(*chunk_data); compressed) {
+                    send_chunk_dto.compression = compressed->algorithm;
+                    send_chunk_dto.uncompressed_size = chunk_data->size();
+                    stats_.compressed_chunks++;
+                    stats_.compression_input_bytes += chunk_data->size();
+                    stats_.compression_output_bytes += compressed->data.size();
+                    chunk_data = std::make_shared<const BinaryData>(std::move(compressed->data));
+                }
 
-            SendChunkDto send_chunk_dto{
-                session_id_,
-                file_id.data(),
-                file_info.file_token,
-                chunk_idx,
-                FileHasher::CalculateDataChecksum(chunk_data),
-            };
+                co_await bandwidth_flow_.Acquire(chunk_data->size());
+                auto send_start = std::chrono::steady_clock::now();
+                if (stream_active_) {
+                    chunk_sent = co_await sendChunkFrame(stream_id,
+                                                         send_chunk_dto,
+                                                         *chunk_data,
+                                                         &finalized);
+                } else if (uploading) {
+                    chunk_sent = co_await writeUploadRecord(send_chunk_dto, *chunk_data);
+                } else {
+                    chunk_sent = co_await sendChunk(send_chunk_dto, *chunk_data, &finalized);
+                }
+                auto send_time = std::chrono::steady_clock::now() - send_start;
+                compressor.RecordSend(chunk_data->size(), send_time);
+                // Only a full chunk answered by the receiver is comparable with the others
+                bool acked_full_chunk = !stream_active_ && !uploading
+                                        && chunk_data->size() == transfer::kDefaultChunkSize;
+                trackDelay(chunk_data->size(),
+                           acked_full_chunk ? std::make_optional(send_time) : std::nullopt);
+                stats_.wire_bytes += chunk_data->size();
+            }
 
-            bool chunk_sent = co_await sendChunk(send_chunk_dto, chunk_data);
             // judge if send is cancelled
             if (!chunk_sent) {
+                if (uploading) {
+                    co_await abortUpload();
+                }
                 if (session_status_ == SessionStatus::kCancelledBySender
                     || session_status_ == SessionStatus::kCancelledByReceiver) {
                     spdlog::info("File transfer cancelled");
@@ -397,9 +998,26 @@ boost::asio::awaitable<void> SendSession::sendFile(std::string_view file_id) {
 
         file.close();
 
+        if (uploading && !co_await finishUpload(&finalized, file_id)) {
+            if (session_status_ != SessionStatus::kCancelledByReceiver) {
+                throw std::runtime_error("Failed to upload file");
+            }
+            co_return;
+        }
+        if (!file_info.rejected_chunks.empty()
+            && !co_await resendRejectedChunks(file_id, stream_id, &finalized)) {
+            if (IsCancelled()) {
+                co_return;
+            }
+            throw std::runtime_error("Rejected chunks could not be sent again");
+        }
+
         spdlog::info("File {} sent successfully", file_info.file_path.string());
-        bool finalized = co_await verifyIntegrity(
-            {session_id_, file_id.data(), file_info.file_token});
+        if (!finalized) {
+            finalized = stream_active_ ? co_await verifyOverStream(stream_id)
+                                       : co_await verifyIntegrity(
+                                           {session_id_, file_id.data(), file_info.file_token});
+        }
         if (!finalized) {
             if (session_status_ == SessionStatus::kCancelledBySender
                 || session_status_ == SessionStatus::kCancelledByReceiver) {
@@ -451,26 +1069,461 @@ boost::asio::awaitable<void> SendSession::sendFile(std::string_view file_id) {
     }
 }
 
+boost::asio::awaitable<void> SendSession::sendBatches(const std::vector<std::string>& file_ids) {
+    spdlog::debug("SendSession::SendBatches");
+    try {
+        std::size_t next_file = 0;
+        while (next_file < file_ids.size()) {
+            if (session_status_ == SessionStatus::kCancelledBySender
+                || session_status_ == SessionStatus::kCancelledByReceiver) {
+                co_return;
+            }
+
+            SendBatchDto send_batch_dto{session_id_, {}};
+            BinaryData batch_data;
+            batch_data.reserve(transfer::kMaxBatchSize);
+
+            // Fill the batch up to its size and file limits, a batch always holds one file
+            while (next_file < file_ids.size()
+                   && send_batch_dto.entries.size() < transfer::kMaxBatchFiles) {
+                const auto& file_id = file_ids[next_file];
+                const auto& file_info = transfer_files_.at(file_id);
+                if (!send_batch_dto.entries.empty()
+                    && batch_data.size() + file_info.file_size > transfer::kMaxBatchSize) {
+                    break;
+                }
+
+                std::size_t offset = batch_data.size();
+                batch_data.resize(offset + file_info.file_size);
+                std::ifstream file(file_info.file_path, std::ios::binary);
+                file.read(reinterpret_cast<char*>(batch_data.data() + offset),
+                          file_info.file_size);
+                if (!file || static_cast<std::size_t>(file.gcount()) != file_info.file_size) {
+                    spdlog::error("Failed to read file: {}", file_info.file_path.string());
+                    throw std::runtime_error("Failed to read file");
+                }
+
+                send_batch_dto.entries.push_back(
+                    BatchEntryDto{file_id, file_info.file_token, offset, file_info.file_size});
+                ++next_file;
+            }
+
+            co_await bandwidth_flow_.Acquire(batch_data.size());
+            bool batch_sent = co_await sendBatch(send_batch_dto, batch_data);
+            trackDelay(batch_data.size());
+            if (!batch_sent) {
+                if (session_status_ == SessionStatus::kCancelledBySender
+                    || session_status_ == SessionStatus::kCancelledByReceiver) {
+                    spdlog::info("File transfer cancelled");
+                } else {
+                    spdlog::error("Failed to send batch of {} files",
+                                  send_batch_dto.entries.size());
+                    session_status_ = SessionStatus::kFailed;
+
+                    // feedback session failed
+                    feedback(Feedback{
+                        .type = FeedbackType::kSendSessionEnded,
+                        .data = feedback::SendSessionEnd{
+                            .session_id = session_id_,
+                            .device_id = receiver_device_id_,
+                            .success = false,
+                            .error_message = "Failed to send batch",
+                        },
+                    });
+                }
+                co_return;
+            }
+
+            stats_.file_count += send_batch_dto.entries.size();
+            stats_.raw_bytes += batch_data.size();
+            stats_.wire_bytes += batch_data.size();
+
+            for (const auto& entry : send_batch_dto.entries) {
+                // feedback file sending completed
+                feedback(Feedback{
+                    .type = FeedbackType::kFileSendingCompleted,
+                    .data = feedback::FileSendingCompleted{
+                        .session_id = session_id_,
+                        .filename = transfer_files_.at(entry.file_id).file_path.string(),
+                    },
+                });
+            }
+
+            spdlog::info("Sent batch of {} files ({} bytes), {}/{} packed files done",
+                         send_batch_dto.entries.size(),
+                         batch_data.size(),
+                         next_file,
+                         file_ids.size());
+        }
+    } catch (const std::exception& e) {
+        if (session_status_ != SessionStatus::kCancelledBySender
+            && session_status_ != SessionStatus::kCancelledByReceiver) {
+            spdlog::error("Error occurred on SendSession::SendBatches: {}", e.what());
+            session_status_ = SessionStatus::kFailed;
+
+            // feedback session failed
+            feedback(Feedback{
+                .type = FeedbackType::kSendSessionEnded,
+                .data = feedback::SendSessionEnd{
+                    .session_id = session_id_,
+                    .device_id = receiver_device_id_,
+                    .success = false,
+                    .error_message = e.what(),
+                },
+            });
+        }
+    }
+}
+
 net::awaitable<bool> SendSession::sendChunk(const SendChunkDto& send_chunk_dto,
-                                            const BinaryData& chunk_data) {
+                                            const BinaryData& chunk_data,
+                                            bool* finalized) {
     spdlog::debug("SendSession::SendChunk");
+    auto& file_info = transfer_files_.at(send_chunk_dto.file_id);
+    auto backoff = std::chrono::milliseconds(transfer::kChunkRetryBackoffMs);
+    for (std::size_t attempt = 0;; ++attempt) {
+        std::string error;
+        try {
+            if (session_status_ == SessionStatus::kCancelledBySender) {
+                co_return false;
+            }
+            // The previous attempt couldn't replace its connection
+            if (!client_) {
+                throw boost::system::system_error(net::error::not_connected);
+            }
+
+            json metadata = send_chunk_dto;
+
+            BinaryMessage binary_message = CreateBinaryMessage(metadata, chunk_data);
+
+            auto req = client_->CreateRequest<http::vector_body<uint8_t>>(
+                http::verb::post, ApiRoute::kSendChunk.data(), true);
+            req.set(kStreamSessionHeader, session_id_);
+            req.set(kUploadFileIdHeader, send_chunk_dto.file_id);
+            req.set(kUploadFileTokenHeader, send_chunk_dto.file_token);
+
+            req.body() = std::move(binary_message);
+            req.prepare_payload();
+
+            // A receiver that stops answering counts as a lost connection
+            client_->ExpiresAfter(std::chrono::seconds(transfer::kChunkTimeoutSeconds));
+            auto res = co_await sendUploadRequest(req);
+            client_->ExpiresNever();
+            // Check if the session is cancelled by sender
+            // Since status modification takes place parallelly to this co_await
+            if (session_status_ == SessionStatus::kCancelledBySender) {
+                co_return false;
+            }
+
+            recordReceivedChunks(file_info, res);
+            if (res.result() == http::status::ok) {
+                spdlog::debug("Chunk {} sent successfully", send_chunk_dto.current_chunk_index);
+                file_info.acked_chunks.insert(send_chunk_dto.current_chunk_index);
+                if (finalized != nullptr) {
+                    *finalized = send_chunk_dto.is_final && res.body() == "finalized";
+                }
+                co_return true;
+            } else if (res.result() == http::status::unprocessable_entity) {
+                // Sent again with the other rejected chunks of the file once the rest is through
+                spdlog::warn("Receiver rejected chunk {} of file_id {}",
+                             send_chunk_dto.current_chunk_index,
+                             send_chunk_dto.file_id);
+                file_info.rejected_chunks.insert(send_chunk_dto.current_chunk_index);
+                co_return true;
+            } else if (res.result() == http::status::forbidden
+                       && res.body() == "receiver cancelled") {
+                spdlog::info("File transfer cancelled by receiver");
+                session_status_ = SessionStatus::kCancelledByReceiver;
+
+                // feedback receiver cancellation
+                feedback(Feedback{
+                    .type = FeedbackType::kSendSessionEnded,
+                    .data = feedback::SendSessionEnd{
+                        .session_id = session_id_,
+                        .device_id = receiver_device_id_,
+                        .success = false,
+                        .cancelled_by_receiver = true,
+                    },
+                });
+
+                co_return false;
+            } else {
+                throw std::runtime_error(
+                    std::format("{}:{}", std::string_view(res.reason()), res.body()));
+            }
+        } catch (const boost::system::system_error& e) {
+            // The connection broke or timed out, the chunk may have arrived or not
+            if (session_status_ == SessionStatus::kCancelledBySender
+                || session_status_ == SessionStatus::kCancelledByReceiver) {
+                co_return false;
+            }
+            error = e.what();
+        } catch (const std::exception& e) {
+            if (session_status_ == SessionStatus::kCancelledBySender
+                || session_status_ == SessionStatus::kCancelledByReceiver) {
+                co_return false;
+            } else {
+                spdlog::error("Error occurred on SendSession::SendChunk: {}", e.what());
+                co_return false;
+            }
+        }
+
+        if (attempt == transfer::kMaxChunkRetries) {
+            spdlog::error("Error occurred on SendSession::SendChunk: {}", error);
+            co_return false;
+        }
+        spdlog::warn("Chunk {} of file_id {} failed: {}, retrying in {} ms",
+                     send_chunk_dto.current_chunk_index,
+                     send_chunk_dto.file_id,
+                     error,
+                     backoff.count());
+        auto timer = net::steady_timer(co_await net::this_coro::executor, backoff);
+        co_await timer.async_wait(net::use_awaitable);
+        backoff *= 2;
+
+        // A retry of a chunk that did arrive is answered as a duplicate
+        client_.Discard();
+        client_ = co_await connection_pool_->Acquire(host_, port_, receiver_device_id_);
+        if (client_ && ledbat_) {
+            if (auto* socket = client_->socket()) {
+                LedbatController::UseLowerEffort(*socket);
+            }
+        }
+    }
+}
+
+void SendSession::recordReceivedChunks(TransferFileInfo& file_info,
+                                       const http::response<http::string_body>& res) {
+    auto header = res.find(kReceivedChunksHeader);
+    if (header == res.end()) {
+        return;
+    }
+    std::string_view value = header->value();
+    if (auto chunks = chunk_ranges::Parse(value, file_info.total_chunks)) {
+        file_info.acked_chunks.insert(chunks->begin(), chunks->end());
+    } else {
+        spdlog::warn("Invalid {} header: {}", kReceivedChunksHeader, value);
+    }
+}
+
+net::awaitable<bool> SendSession::writeUploadRecord(const SendChunkDto& send_chunk_dto,
+                                                   const BinaryData& chunk_data) {
+    spdlog::debug("SendSession::WriteUploadRecord");
+    try {
+        if (session_status_ == SessionStatus::kCancelledBySender) {
+            co_return false;
+        }
+
+        co_await client_->WriteUploadRecord(
+            send_chunk_dto.is_final ? frame_flag::kFinal : 0,
+            DataFrameInfo{
+                .chunk_index = send_chunk_dto.current_chunk_index,
+                .compression = send_chunk_dto.compression,
+                .uncompressed_size = static_cast<std::uint32_t>(send_chunk_dto.uncompressed_size),
+                .chunk_checksum = send_chunk_dto.chunk_checksum,
+            },
+            chunk_data);
+        co_return true;
+    } catch (const std::exception& e) {
+        if (session_status_ != SessionStatus::kCancelledBySender
+            && session_status_ != SessionStatus::kCancelledByReceiver) {
+            spdlog::error("Error occurred on SendSession::WriteUploadRecord: {}", e.what());
+        }
+        co_return false;
+    }
+}
+
+net::awaitable<bool> SendSession::writeSendfileRecord(const SendChunkDto& send_chunk_dto,
+                                                     std::uint64_t offset,
+                                                     std::size_t size) {
+    spdlog::debug("SendSession::WriteSendfileRecord");
     try {
         if (session_status_ == SessionStatus::kCancelledBySender) {
             co_return false;
         }
 
-        json metadata = send_chunk_dto;
+        co_await ktls_uploader_->WriteUploadRecord(
+            send_chunk_dto.is_final ? frame_flag::kFinal : 0,
+            DataFrameInfo{
+                .chunk_index = send_chunk_dto.current_chunk_index,
+                .chunk_checksum = send_chunk_dto.chunk_checksum,
+            },
+            offset,
+            size);
+        co_return true;
+    } catch (const std::exception& e) {
+        if (session_status_ != SessionStatus::kCancelledBySender
+            && session_status_ != SessionStatus::kCancelledByReceiver) {
+            spdlog::error("Error occurred on SendSession::WriteSendfileRecord: {}", e.what());
+        }
+        co_return false;
+    }
+}
 
-        BinaryMessage binary_message = CreateBinaryMessage(metadata, chunk_data);
+net::awaitable<bool> SendSession::finishUpload(bool* finalized, std::string_view file_id) {
+    spdlog::debug("SendSession::FinishUpload");
+    upload_active_ = false;
+    try {
+        auto res = upload_via_sendfile_ ? co_await ktls_uploader_->FinishUpload()
+                                        : co_await client_->FinishUpload();
 
-        auto req = client_.CreateRequest<http::vector_body<uint8_t>>(http::verb::post,
-                                                                     ApiRoute::kSendChunk.data(),
-                                                                     true);
+        if (res.result() == http::status::ok) {
+            if (finalized != nullptr) {
+                *finalized = res.body() == "finalized";
+            }
+            // An upload isn't answered per chunk, the chunks missing from the receiver's list
+            // were rejected
+            if (!file_id.empty() && res.find(kReceivedChunksHeader) != res.end()) {
+                auto& file_info = transfer_files_.at(std::string(file_id));
+                recordReceivedChunks(file_info, res);
+                for (std::size_t chunk_idx = 0; chunk_idx < file_info.total_chunks; ++chunk_idx) {
+                    if (!file_info.satisfied_chunks.contains(chunk_idx)
+                        && !file_info.acked_chunks.contains(chunk_idx)) {
+                        file_info.rejected_chunks.insert(chunk_idx);
+                    }
+                }
+            }
+            co_return true;
+        } else if (res.result() == http::status::forbidden && res.body() == "receiver cancelled") {
+            spdlog::info("File transfer cancelled by receiver");
+            session_status_ = SessionStatus::kCancelledByReceiver;
+
+            // feedback receiver cancellation
+            feedback(Feedback{
+                .type = FeedbackType::kSendSessionEnded,
+                .data = feedback::SendSessionEnd{
+                    .session_id = session_id_,
+                    .device_id = receiver_device_id_,
+                    .success = false,
+                    .cancelled_by_receiver = true,
+                },
+            });
+
+            co_return false;
+        } else {
+            throw std::runtime_error(
+                std::format("{}:{}", std::string_view(res.reason()), res.body()));
+        }
+    } catch (const std::exception& e) {
+        spdlog::error("Error occurred on SendSession::FinishUpload: {}", e.what());
+        co_return false;
+    }
+}
+
+net::awaitable<void> SendSession::abortUpload() {
+    if (!upload_active_) {
+        co_return;
+    }
+    // End the body early so that the connection can still carry the cancellation
+    bool cancelled = session_status_ == SessionStatus::kCancelledBySender;
+    if (co_await finishUpload(nullptr) && cancelled) {
+        co_await cancelSend();
+    }
+}
+
+net::awaitable<bool> SendSession::resendRejectedChunks(std::string_view file_id,
+                                                       std::uint32_t stream_id,
+                                                       bool* finalized) {
+    spdlog::debug("SendSession::ResendRejectedChunks");
+    auto& file_info = transfer_files_.at(std::string(file_id));
+    auto backoff = std::chrono::milliseconds(transfer::kChunkRetryBackoffMs);
+    for (std::size_t round = 0; round < transfer::kMaxChunkRetries; ++round) {
+        if (file_info.rejected_chunks.empty()) {
+            co_return true;
+        }
+        if (IsCancelled()) {
+            co_return false;
+        }
+        auto timer = net::steady_timer(co_await net::this_coro::executor, backoff);
+        co_await timer.async_wait(net::use_awaitable);
+        backoff *= 2;
+
+        std::vector<std::size_t> chunks(file_info.rejected_chunks.begin(),
+                                        file_info.rejected_chunks.end());
+        std::ranges::sort(chunks);
+        file_info.rejected_chunks.clear();
+        spdlog::info("Sending {} rejected chunks of file_id {} again, round {}",
+                     chunks.size(),
+                     file_id,
+                     round + 1);
+
+        std::ifstream file(file_info.file_path, std::ios::binary);
+        if (!file) {
+            spdlog::error("Failed to open file: {}", file_info.file_path.string());
+            co_return false;
+        }
+        for (std::size_t chunk_idx : chunks) {
+            std::size_t size = std::min(transfer::kDefaultChunkSize,
+                                        file_info.file_size
+                                            - chunk_idx * transfer::kDefaultChunkSize);
+            auto chunk_data = readChunk(file, file_id, chunk_idx, size);
+            if (chunk_data->empty()) {
+                co_return false;
+            }
+            // Sent uncompressed, the final flag already went with the first attempt
+            SendChunkDto send_chunk_dto{
+                session_id_,
+                std::string(file_id),
+                file_info.file_token,
+                chunk_idx,
+                chunk_idx < file_info.chunk_checksums.size()
+                    ? file_info.chunk_checksums[chunk_idx]
+                    : FileHasher::CalculateDataChecksum(*chunk_data),
+            };
+
+            co_await bandwidth_flow_.Acquire(chunk_data->size());
+            bool chunk_sent = stream_active_ ? co_await sendChunkFrame(stream_id,
+                                                                       send_chunk_dto,
+                                                                       *chunk_data,
+                                                                       nullptr)
+                                             : co_await sendChunk(send_chunk_dto, *chunk_data);
+            if (!chunk_sent) {
+                co_return false;
+            }
+            stats_.wire_bytes += chunk_data->size();
+            stats_.retransmitted_bytes += chunk_data->size();
+        }
+        // NAKs of this round's frames come back with their acks
+        while (stream_active_ && frames_in_flight_ > 0) {
+            if (!co_await readStreamAck(nullptr)) {
+                co_return false;
+            }
+        }
+    }
+    if (!file_info.rejected_chunks.empty()) {
+        spdlog::error("Receiver still rejects {} chunks of file_id {}",
+                      file_info.rejected_chunks.size(),
+                      file_id);
+        co_return false;
+    }
+    // Resent chunks don't carry the final flag, the file is verified separately
+    if (finalized != nullptr) {
+        *finalized = false;
+    }
+    co_return true;
+}
+
+net::awaitable<bool> SendSession::sendBatch(const SendBatchDto& send_batch_dto,
+                                            const BinaryData& batch_data) {
+    spdlog::debug("SendSession::SendBatch");
+    try {
+        if (session_status_ == SessionStatus::kCancelledBySender) {
+            co_return false;
+        }
+
+        json metadata = send_batch_dto;
+
+        BinaryMessage binary_message = CreateBinaryMessage(metadata, batch_data);
+
+        auto req = client_->CreateRequest<http::vector_body<uint8_t>>(http::verb::post,
+                                                                      ApiRoute::kSendBatch.data(),
+                                                                      true);
+        req.set(kStreamSessionHeader, session_id_);
 
         req.body() = std::move(binary_message);
         req.prepare_payload();
 
-        auto res = co_await client_.SendRequest(req);
+        auto res = co_await sendUploadRequest(req);
         // Check if the session is cancelled by sender
         // Since status modification takes place parallelly to this co_await
         if (session_status_ == SessionStatus::kCancelledBySender) {
@@ -478,7 +1531,7 @@ net::awaitable<bool> SendSession::sendChunk(const SendChunkDto& send_chunk_dto,
         }
 
         if (res.result() == http::status::ok) {
-            spdlog::debug("Chunk {} sent successfully", send_chunk_dto.current_chunk_index);
+            spdlog::debug("Batch of {} files sent successfully", send_batch_dto.entries.size());
             co_return true;
         } else if (res.result() == http::status::forbidden && res.body() == "receiver cancelled") {
             spdlog::info("File transfer cancelled by receiver");
@@ -501,13 +1554,203 @@ net::awaitable<bool> SendSession::sendChunk(const SendChunkDto& send_chunk_dto,
                 std::format("{}:{}", std::string_view(res.reason()), res.body()));
         }
     } catch (const std::exception& e) {
-        if (session_status_ == SessionStatus::kCancelledBySender
-            || session_status_ == SessionStatus::kCancelledByReceiver) {
+        if (session_status_ != SessionStatus::kCancelledBySender
+            && session_status_ != SessionStatus::kCancelledByReceiver) {
+            spdlog::error("Error occurred on SendSession::SendBatch: {}", e.what());
+        }
+        co_return false;
+    }
+}
+
+net::awaitable<http::response<http::string_body>> SendSession::sendUploadRequest(
+    http::request<http::vector_body<std::uint8_t>>& req) {
+    bool body_sent = true;
+    http::response<http::string_body> res;
+    if (continue_supported_
+        && (!continue_probed_ || req.body().size() > transfer::kContinueBodyThreshold)) {
+        continue_probed_ = true;
+        res = co_await client_->SendRequestWithContinue(req, &body_sent);
+    } else {
+        res = co_await client_->SendRequest(req);
+    }
+    if (res.result() == http::status::forbidden && body_sent) {
+        spdlog::info("Receiver refused a request after its {} byte body was sent",
+                     req.body().size());
+        stats_.wasted_bytes += req.body().size();
+    }
+    co_return res;
+}
+
+net::awaitable<bool> SendSession::sendChunkFrame(std::uint32_t stream_id,
+                                                 const SendChunkDto& send_chunk_dto,
+                                                 const BinaryData& chunk_data,
+                                                 bool* finalized) {
+    spdlog::debug("SendSession::SendChunkFrame");
+    try {
+        if (session_status_ == SessionStatus::kCancelledBySender) {
             co_return false;
-        } else {
-            spdlog::error("Error occurred on SendSession::SendChunk: {}", e.what());
+        }
+
+        co_await writeDataFrame(
+            send_chunk_dto.is_final ? frame_flag::kFinal : 0,
+            stream_id,
+            DataFrameInfo{
+                .chunk_index = send_chunk_dto.current_chunk_index,
+                .compression = send_chunk_dto.compression,
+                .uncompressed_size = static_cast<std::uint32_t>(send_chunk_dto.uncompressed_size),
+                .chunk_checksum = send_chunk_dto.chunk_checksum,
+            },
+            chunk_data);
+        ++frames_in_flight_;
+
+        // Keep a window of chunks in flight, the final chunk waits for all of them so that its
+        // ack tells whether the receiver finalized the file
+        while (frames_in_flight_ >= transfer::kStreamWindow
+               || (send_chunk_dto.is_final && frames_in_flight_ > 0)) {
+            if (!co_await readStreamAck(finalized)) {
+                co_return false;
+            }
+        }
+        co_return true;
+    } catch (const std::exception& e) {
+        if (session_status_ != SessionStatus::kCancelledBySender
+            && session_status_ != SessionStatus::kCancelledByReceiver) {
+            spdlog::error("Error occurred on SendSession::SendChunkFrame: {}", e.what());
+        }
+        co_return false;
+    }
+}
+
+net::awaitable<bool> SendSession::verifyOverStream(std::uint32_t stream_id) {
+    spdlog::debug("SendSession::VerifyOverStream");
+    try {
+        if (session_status_ == SessionStatus::kCancelledBySender) {
             co_return false;
         }
+
+        co_await writeFrame(FrameType::kVerify, 0, stream_id);
+        ++frames_in_flight_;
+
+        bool finalized = false;
+        while (frames_in_flight_ > 0) {
+            if (!co_await readStreamAck(&finalized)) {
+                co_return false;
+            }
+        }
+        co_return finalized;
+    } catch (const std::exception& e) {
+        if (session_status_ != SessionStatus::kCancelledBySender
+            && session_status_ != SessionStatus::kCancelledByReceiver) {
+            spdlog::error("Error occurred on SendSession::VerifyOverStream: {}", e.what());
+        }
+        co_return false;
+    }
+}
+
+net::awaitable<void> SendSession::writeFrame(FrameType type,
+                                             std::uint8_t flags,
+                                             std::uint32_t stream_id,
+                                             std::span<const std::uint8_t> payload) {
+    if (datagram_) {
+        co_await datagram_->WriteFrame(type, flags, stream_id, payload);
+    } else {
+        co_await client_->WriteFrame(type, flags, stream_id, payload);
+    }
+}
+
+net::awaitable<void> SendSession::writeDataFrame(std::uint8_t flags,
+                                                 std::uint32_t stream_id,
+                                                 const DataFrameInfo& info,
+                                                 std::span<const std::uint8_t> data) {
+    if (datagram_) {
+        co_await datagram_->WriteDataFrame(flags, stream_id, info, data);
+    } else {
+        co_await client_->WriteDataFrame(flags, stream_id, info, data);
+    }
+}
+
+net::awaitable<bool> SendSession::readStreamAck(bool* finalized) {
+    Frame frame = co_await client_->ReadFrame();
+    std::string_view message(reinterpret_cast<const char*>(frame.payload.data()),
+                             frame.payload.size());
+    auto file = stream_files_.find(frame.header.stream_id);
+    switch (frame.header.type) {
+    case FrameType::kAck:
+        --frames_in_flight_;
+        if (finalized != nullptr) {
+            *finalized = (frame.header.flags & frame_flag::kFinalized) != 0;
+        }
+        // Verify frames are acked without a chunk index
+        if (file != stream_files_.end() && !frame.payload.empty()) {
+            transfer_files_.at(file->second)
+                .acked_chunks.insert(DecodeAckPayload(frame.payload));
+        }
+        co_return true;
+    case FrameType::kNak: {
+        --frames_in_flight_;
+        if (file == stream_files_.end()) {
+            throw std::runtime_error(
+                std::format("Chunk rejected on unknown stream {}", frame.header.stream_id));
+        }
+        auto chunk_index = DecodeAckPayload(frame.payload);
+        spdlog::warn("Receiver rejected chunk {} of file_id {}", chunk_index, file->second);
+        transfer_files_.at(file->second).rejected_chunks.insert(chunk_index);
+        co_return true;
+    }
+    case FrameType::kCancel:
+        if (message == "receiver cancelled") {
+            spdlog::info("File transfer cancelled by receiver");
+            session_status_ = SessionStatus::kCancelledByReceiver;
+
+            // feedback receiver cancellation
+            feedback(Feedback{
+                .type = FeedbackType::kSendSessionEnded,
+                .data = feedback::SendSessionEnd{
+                    .session_id = session_id_,
+                    .device_id = receiver_device_id_,
+                    .success = false,
+                    .cancelled_by_receiver = true,
+                },
+            });
+        } else {
+            spdlog::info("Stream closed by receiver: {}", message);
+        }
+        co_return false;
+    case FrameType::kError:
+        spdlog::error("Receiver failed to process the stream: {}", message);
+        co_return false;
+    default:
+        throw std::runtime_error(std::format("Unexpected frame type {}",
+                                             static_cast<int>(frame.header.type)));
+    }
+}
+
+net::awaitable<void> SendSession::closeStream(FrameType type) {
+    if (!stream_active_) {
+        co_return;
+    }
+    stream_active_ = false;
+    bool closed = true;
+    try {
+        co_await writeFrame(type, 0, 0);
+        // The receiver reads HTTP again once it got the end, which only the acks tell
+        if (datagram_ && !co_await datagram_->Flush(std::chrono::seconds(5))) {
+            spdlog::debug("Datagram connection wasn't flushed");
+            closed = false;
+        }
+    } catch (const std::exception& e) {
+        spdlog::debug("Failed to close the stream: {}", e.what());
+        closed = false;
+    }
+    if (datagram_) {
+        stats_.retransmitted_bytes += datagram_->retransmitted_bytes();
+        datagram_->Close();
+        datagram_.reset();
+    }
+    // After a clean end the receiver reads HTTP again and the connection can go back to the pool,
+    // older receivers close it instead
+    if (!closed || type != FrameType::kEnd || frames_in_flight_ > 0) {
+        co_await client_->Disconnect();
     }
 }
 
@@ -520,14 +1763,14 @@ net::awaitable<bool> SendSession::verifyIntegrity(const VerifyIntegrityDto& veri
 
         json metadata = verify_integrity_dto;
 
-        auto req = client_.CreateRequest<http::string_body>(http::verb::post,
-                                                            ApiRoute::kVerifyIntegrity.data(),
-                                                            true);
+        auto req = client_->CreateRequest<http::string_body>(http::verb::post,
+                                                             ApiRoute::kVerifyIntegrity.data(),
+                                                             true);
 
         req.body() = metadata.dump();
         req.prepare_payload();
 
-        auto res = co_await client_.SendRequest(req);
+        auto res = co_await client_->SendRequest(req);
         if (session_status_ == SessionStatus::kCancelledBySender) {
             co_return false;
         }
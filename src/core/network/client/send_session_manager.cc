@@ -1,6 +1,9 @@
 #include "core/model/feedback.h"
 #include <boost/asio.hpp>
 #include <core/network/client/send_session_manager.h>
+#include <core/network/discovery/discovery_manager.h>
+#include <core/network/multicast/multicast_round.h>
+#include <core/util/config.h>
 #include <core/security/certificate_manager.h>
 #include <exception>
 
@@ -10,24 +13,81 @@ namespace lansend::core {
 
 SendSessionManager::SendSessionManager(boost::asio::io_context& ioc,
                                        CertificateManager& cert_manager,
+                                       std::shared_ptr<ConnectionPool> connection_pool,
+                                       std::shared_ptr<BandwidthScheduler> bandwidth,
                                        FeedbackCallback callback)
     : ioc_(ioc)
     , cert_manager_(cert_manager)
+    , connection_pool_(std::move(connection_pool))
+    , bandwidth_(std::move(bandwidth))
     , callback_(callback) {};
 
 void SendSessionManager::SendFiles(std::string_view host,
                                    unsigned short port,
                                    const std::vector<std::filesystem::path>& file_paths,
                                    std::string_view device_id) {
-    auto send_session = std::make_shared<SendSession>(ioc_, cert_manager_);
+    auto send_session = std::make_shared<SendSession>(ioc_,
+                                                      cert_manager_,
+                                                      connection_pool_,
+                                                      bandwidth_,
+                                                      callback_);
     send_session->RecordReceiverId(device_id);
+    startSession(send_session,
+                 send_session->Start(file_paths, std::string(host), port, [this, send_session]() {
+                     this->addSendSession(send_session);
+                 }));
+}
+
+void SendSessionManager::SendFanout(const std::vector<SendTarget>& targets,
+                                    const std::vector<std::filesystem::path>& file_paths) {
+    if (targets.empty()) {
+        return;
+    }
+    auto prepared_files = std::make_shared<const PreparedFiles>(
+        SendSession::PrepareFiles(file_paths));
+    auto cache = std::make_shared<FanoutChunkCache>(targets.size());
+    spdlog::info("Fan-out send of {} files to {} devices", prepared_files->size(), targets.size());
+    std::shared_ptr<MulticastRound> multicast;
+    if (settings.multicast_transport && targets.size() > 1) {
+        try {
+            // The targets share a network, the round goes out where the first one is reached
+            multicast = MulticastRound::Create(
+                ioc_,
+                bandwidth_,
+                prepared_files,
+                targets.size(),
+                DiscoveryManager::LocalAddressTowards(ioc_, targets.front().host));
+        } catch (const std::exception& e) {
+            spdlog::warn("Multicast unavailable, sending to each device on its own: {}", e.what());
+        }
+    }
+
+    for (std::size_t i = 0; i < targets.size(); ++i) {
+        const auto& target = targets[i];
+        auto send_session = std::make_shared<SendSession>(ioc_,
+                                                          cert_manager_,
+                                                          connection_pool_,
+                                                          bandwidth_,
+                                                          callback_);
+        send_session->RecordReceiverId(target.device_id);
+        send_session->JoinFanout(cache, i);
+        if (multicast) {
+            send_session->JoinMulticast(multicast);
+        }
+        startSession(send_session,
+                     send_session->Start(prepared_files,
+                                         target.host,
+                                         target.port,
+                                         [this, send_session]() {
+                                             this->addSendSession(send_session);
+                                         }));
+    }
+}
+
+void SendSessionManager::startSession(std::shared_ptr<SendSession> send_session,
+                                      net::awaitable<void> start) {
     net::co_spawn(ioc_,
-                  send_session->Start(file_paths,
-                                      host,
-                                      port,
-                                      [this, send_session]() {
-                                          this->addSendSession(send_session);
-                                      }),
+                  std::move(start),
                   [this, send_session](std::exception_ptr p) {
                       // Clean up the session
                       const auto& session_id = send_session->session_id();
@@ -51,32 +111,33 @@ void SendSessionManager::CancelSend(const std::string& session_id) {
 }
 
 void SendSessionManager::CancelWaitForConfirmation(std::string_view ip, unsigned short port) {
-    auto client_ptr = std::make_shared<HttpsClient>(ioc_, cert_manager_);
     net::co_spawn(
         ioc_,
-        [&]() -> net::awaitable<void> {
+        [this, ip = std::string(ip), port]() -> net::awaitable<void> {
             try {
-                co_await client_ptr->Connect(ip, port);
-                if (client_ptr->IsConnected()) {
-                    auto req = client_ptr
-                                   ->CreateRequest<http::string_body>(http::verb::get,
-                                                                      ApiRoute::kCancelWait.data(),
-                                                                      true);
+                auto client = co_await connection_pool_->Acquire(ip, port);
+                if (client) {
+                    auto req = client->CreateRequest<http::string_body>(http::verb::post,
+                                                                        ApiRoute::kCancelWait.data(),
+                                                                        true);
 
+                    // Our sessions to the receiver don't know their id yet, it finds them by
+                    // our device id whether they are queued or waiting for confirmation
                     nlohmann::json data;
                     auto& local_device = DeviceInfo::LocalDeviceInfo();
+                    data["device_id"] = local_device.device_id;
                     data["ip"] = local_device.ip_address;
                     data["port"] = local_device.port;
                     req.set(http::field::user_agent, "Lansend");
+                    req.body() = data.dump();
                     req.prepare_payload();
 
-                    auto res = co_await client_ptr->SendRequest(req);
+                    auto res = co_await client->SendRequest(req);
                     if (res.result() == http::status::ok) {
                         spdlog::info("cancel wait success");
                     } else {
                         spdlog::error("cancel wait failed");
                     }
-                    co_await client_ptr->Disconnect();
                 } else {
                     spdlog::error("cancel wait failed");
                 }
@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <core/network/datagram/bbr_controller.h>
+
+namespace lansend::core {
+
+BbrController::BbrController()
+    : delivered_time_(Clock::now())
+    , first_sent_time_(delivered_time_)
+    , cycle_stamp_(delivered_time_) {}
+
+BbrController::PacketState BbrController::OnSend(std::size_t bytes_in_flight,
+                                                  Clock::time_point now) {
+    if (bytes_in_flight == 0) {
+        // Nothing to measure against, the next rate sample starts here
+        first_sent_time_ = now;
+        delivered_time_ = now;
+    }
+    return PacketState{
+        .delivered = delivered_,
+        .delivered_time = delivered_time_,
+        .first_sent_time = first_sent_time_,
+        .sent_time = now,
+        .app_limited = app_limited_until_ != 0,
+    };
+}
+
+void BbrController::OnAck(const PacketState& packet,
+                          std::size_t bytes,
+                          std::optional<std::chrono::microseconds> rtt,
+                          std::size_t bytes_in_flight,
+                          Clock::time_point now) {
+    delivered_ += bytes;
+    delivered_time_ = now;
+    if (app_limited_until_ != 0 && delivered_ > app_limited_until_) {
+        app_limited_until_ = 0;
+    }
+
+    if (rtt && *rtt > std::chrono::microseconds::zero()
+        && (!min_rtt_ || *rtt <= *min_rtt_ || now - min_rtt_stamp_ > kMinRttWindow)) {
+        min_rtt_ = *rtt;
+        min_rtt_stamp_ = now;
+    }
+
+    bool round_start = false;
+    if (packet.delivered >= next_round_delivered_) {
+        next_round_delivered_ = delivered_;
+        ++round_;
+        round_start = true;
+        checkRoundLoss();
+    }
+
+    // The rate is taken over the longer of the send and the ack interval, acks that arrive in a
+    // burst would overstate it otherwise
+    first_sent_time_ = packet.sent_time;
+    auto interval = std::max(packet.sent_time - packet.first_sent_time,
+                             delivered_time_ - packet.delivered_time);
+    if (interval >= min_rtt_.value_or(kInitialRtt) && interval > Clock::duration::zero()) {
+        double rate = (delivered_ - packet.delivered)
+                      / std::chrono::duration<double>(interval).count();
+        if (!packet.app_limited || rate >= bottleneck_bandwidth_) {
+            updateBandwidth(rate);
+        }
+    }
+    updateState(round_start, bytes_in_flight, now);
+}
+
+void BbrController::OnLoss(std::size_t bytes) {
+    round_lost_ += bytes;
+}
+
+void BbrController::OnAppLimited(std::size_t bytes_in_flight) {
+    app_limited_until_ = std::max<std::uint64_t>(delivered_ + bytes_in_flight, 1);
+}
+
+double BbrController::pacing_rate() const {
+    double gain = 1.0;
+    switch (state_) {
+    case State::kStartup:
+        gain = kStartupGain;
+        break;
+    case State::kDrain:
+        gain = 1.0 / kStartupGain;
+        break;
+    case State::kProbeBandwidth:
+        gain = kGainCycle[cycle_index_];
+        break;
+    }
+    if (bottleneck_bandwidth_ <= 0.0) {
+        return gain * kMinWindow
+               / std::chrono::duration<double>(min_rtt_.value_or(kInitialRtt)).count();
+    }
+    return gain * bottleneck_bandwidth_;
+}
+
+std::size_t BbrController::congestion_window() const {
+    double gain = state_ == State::kStartup ? kStartupGain : kCwndGain;
+    auto window = static_cast<std::size_t>(gain * bandwidthDelayProduct());
+    if (inflight_cap_) {
+        window = std::min(window, *inflight_cap_);
+    }
+    return std::max(kMinWindow, window);
+}
+
+void BbrController::updateBandwidth(double rate) {
+    if (bandwidth_filter_.empty() || bandwidth_filter_.back().round != round_) {
+        bandwidth_filter_.push_back(RoundMax{round_, rate});
+    } else {
+        bandwidth_filter_.back().bandwidth = std::max(bandwidth_filter_.back().bandwidth, rate);
+    }
+    while (bandwidth_filter_.front().round + kBandwidthWindowRounds <= round_) {
+        bandwidth_filter_.pop_front();
+    }
+    bottleneck_bandwidth_ = std::ranges::max_element(bandwidth_filter_, {}, &RoundMax::bandwidth)
+                                ->bandwidth;
+}
+
+void BbrController::checkRoundLoss() {
+    std::uint64_t round_delivered = delivered_ - round_start_delivered_;
+    // The first ack starts round 1 and ends no round
+    if (round_ > 1
+        && round_lost_ > kLossThreshold * static_cast<double>(round_delivered + round_lost_)) {
+        inflight_cap_ = std::max(kMinWindow,
+                                 static_cast<std::size_t>(kLossBeta * congestion_window()));
+        if (state_ == State::kStartup) {
+            // The pipe is full once it overflows
+            state_ = State::kDrain;
+        }
+    }
+    round_start_delivered_ = delivered_;
+    round_lost_ = 0;
+}
+
+void BbrController::updateState(bool round_start,
+                                std::size_t bytes_in_flight,
+                                Clock::time_point now) {
+    switch (state_) {
+    case State::kStartup:
+        if (!round_start || app_limited_until_ != 0) {
+            break;
+        }
+        if (bottleneck_bandwidth_ >= full_bandwidth_ * kFullBandwidthGrowth) {
+            full_bandwidth_ = bottleneck_bandwidth_;
+            full_bandwidth_rounds_ = 0;
+        } else if (++full_bandwidth_rounds_ >= kFullBandwidthRounds) {
+            state_ = State::kDrain;
+        }
+        break;
+    case State::kDrain:
+        if (bytes_in_flight <= bandwidthDelayProduct()) {
+            // Cruise first, the probing phase comes around soon enough
+            state_ = State::kProbeBandwidth;
+            cycle_index_ = 2;
+            cycle_stamp_ = now;
+        }
+        break;
+    case State::kProbeBandwidth:
+        if (now - cycle_stamp_ > min_rtt_.value_or(kInitialRtt)) {
+            cycle_index_ = (cycle_index_ + 1) % std::size(kGainCycle);
+            cycle_stamp_ = now;
+            if (cycle_index_ == 0 && inflight_cap_) {
+                // Probe above the cap as well, a lossy round brings it down again
+                inflight_cap_ = static_cast<std::size_t>(*inflight_cap_ * kGainCycle[0]);
+            }
+        }
+        break;
+    }
+}
+
+double BbrController::bandwidthDelayProduct() const {
+    return bottleneck_bandwidth_
+           * std::chrono::duration<double>(min_rtt_.value_or(kInitialRtt)).count();
+}
+
+} // namespace lansend::core
@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <core/network/datagram/datagram_packet.h>
+#include <stdexcept>
+#include <tuple>
+
+namespace lansend::core {
+
+namespace {
+
+void PutUint16(std::uint8_t* out, std::uint16_t value) {
+    out[0] = static_cast<std::uint8_t>(value >> 8);
+    out[1] = static_cast<std::uint8_t>(value);
+}
+
+void PutUint32(std::uint8_t* out, std::uint32_t value) {
+    PutUint16(out, static_cast<std::uint16_t>(value >> 16));
+    PutUint16(out + 2, static_cast<std::uint16_t>(value));
+}
+
+void PutUint64(std::uint8_t* out, std::uint64_t value) {
+    PutUint32(out, static_cast<std::uint32_t>(value >> 32));
+    PutUint32(out + 4, static_cast<std::uint32_t>(value));
+}
+
+std::uint16_t GetUint16(const std::uint8_t* in) {
+    return static_cast<std::uint16_t>((in[0] << 8) | in[1]);
+}
+
+std::uint32_t GetUint32(const std::uint8_t* in) {
+    return (static_cast<std::uint32_t>(GetUint16(in)) << 16) | GetUint16(in + 2);
+}
+
+std::uint64_t GetUint64(const std::uint8_t* in) {
+    return (static_cast<std::uint64_t>(GetUint32(in)) << 32) | GetUint32(in + 4);
+}
+
+constexpr std::string_view kExporterLabel = "EXPORTER-lansend-datagram";
+constexpr std::size_t kAckRangeSize = 16;
+
+BinaryData EncodeDatagramHeader(const DatagramHeader& header) {
+    BinaryData data(kDatagramHeaderSize);
+    PutUint32(data.data(), kDatagramMagic);
+    data[4] = kDatagramVersion;
+    data[5] = static_cast<std::uint8_t>(header.type);
+    PutUint64(data.data() + 8, header.packet_number);
+    return data;
+}
+
+// The salt followed by the packet number, unique for every packet of a direction
+BinaryData DatagramNonce(const DatagramKey& key, std::uint64_t packet_number) {
+    BinaryData nonce(FileEncryptor::IV_SIZE);
+    std::copy(key.salt.begin(), key.salt.end(), nonce.begin());
+    PutUint64(nonce.data() + key.salt.size(), packet_number);
+    return nonce;
+}
+
+} // namespace
+
+std::optional<DatagramKeys> ExportDatagramKeys(SSL* ssl,
+                                               std::string_view session_id,
+                                               std::span<const std::uint8_t> random) {
+    constexpr std::size_t kSaltSize = std::tuple_size_v<decltype(DatagramKey::salt)>;
+    if (random.size() != kDatagramContextSize) {
+        return std::nullopt;
+    }
+    BinaryData context(session_id.begin(), session_id.end());
+    context.insert(context.end(), random.begin(), random.end());
+    std::array<std::uint8_t, 2 * (FileEncryptor::KEY_SIZE + kSaltSize)> material{};
+    if (ssl == nullptr
+        || SSL_export_keying_material(ssl,
+                                      material.data(),
+                                      material.size(),
+                                      kExporterLabel.data(),
+                                      kExporterLabel.size(),
+                                      context.data(),
+                                      context.size(),
+                                      1)
+               != 1) {
+        return std::nullopt;
+    }
+    auto next = material.begin();
+    DatagramKeys keys;
+    for (auto* key : {&keys.sender, &keys.receiver}) {
+        key->key.assign(next, next + FileEncryptor::KEY_SIZE);
+        next += FileEncryptor::KEY_SIZE;
+    }
+    for (auto* key : {&keys.sender, &keys.receiver}) {
+        std::copy(next, next + kSaltSize, key->salt.begin());
+        next += kSaltSize;
+    }
+    std::fill(material.begin(), material.end(), 0);
+    return keys;
+}
+
+BinaryData SealDatagram(const DatagramHeader& header,
+                        std::span<const std::uint8_t> payload,
+                        const DatagramKey& key) {
+    BinaryData packet = EncodeDatagramHeader(header);
+    BinaryData tag;
+    auto ciphertext = FileEncryptor::EncryptData(BinaryData(payload.begin(), payload.end()),
+                                                 key.key,
+                                                 DatagramNonce(key, header.packet_number),
+                                                 tag,
+                                                 packet);
+    if (!ciphertext) {
+        throw std::runtime_error("Failed to seal datagram: " + ciphertext.error());
+    }
+    packet.insert(packet.end(), ciphertext->begin(), ciphertext->end());
+    packet.insert(packet.end(), tag.begin(), tag.end());
+    return packet;
+}
+
+std::optional<std::pair<DatagramHeader, BinaryData>> OpenDatagram(
+    std::span<const std::uint8_t> packet, const DatagramKey& key) {
+    if (packet.size() < kDatagramHeaderSize + FileEncryptor::TAG_SIZE
+        || GetUint32(packet.data()) != kDatagramMagic || packet[4] != kDatagramVersion) {
+        return std::nullopt;
+    }
+    DatagramHeader header{
+        .type = static_cast<DatagramType>(packet[5]),
+        .packet_number = GetUint64(packet.data() + 8),
+    };
+    auto tag_begin = packet.end() - FileEncryptor::TAG_SIZE;
+    auto payload = FileEncryptor::DecryptData(
+        BinaryData(packet.begin() + kDatagramHeaderSize, tag_begin),
+        key.key,
+        DatagramNonce(key, header.packet_number),
+        BinaryData(tag_begin, packet.end()),
+        BinaryData(packet.begin(), packet.begin() + kDatagramHeaderSize));
+    if (!payload) {
+        return std::nullopt;
+    }
+    return std::make_pair(header, std::move(*payload));
+}
+
+BinaryData EncodeDataFragment(std::uint64_t message_id,
+                              std::uint32_t offset,
+                              std::uint32_t message_length,
+                              std::span<const std::uint8_t> fragment) {
+    BinaryData payload(kDataFragmentHeaderSize + fragment.size());
+    PutUint64(payload.data(), message_id);
+    PutUint32(payload.data() + 8, offset);
+    PutUint32(payload.data() + 12, message_length);
+    std::copy(fragment.begin(), fragment.end(), payload.begin() + kDataFragmentHeaderSize);
+    return payload;
+}
+
+std::optional<DataFragment> DecodeDataFragment(std::span<const std::uint8_t> payload) {
+    if (payload.size() < kDataFragmentHeaderSize) {
+        return std::nullopt;
+    }
+    DataFragment fragment{
+        .message_id = GetUint64(payload.data()),
+        .offset = GetUint32(payload.data() + 8),
+        .message_length = GetUint32(payload.data() + 12),
+        .data = payload.subspan(kDataFragmentHeaderSize),
+    };
+    if (static_cast<std::uint64_t>(fragment.offset) + fragment.data.size()
+        > fragment.message_length) {
+        return std::nullopt;
+    }
+    return fragment;
+}
+
+BinaryData EncodeDatagramAck(const DatagramAck& ack) {
+    std::size_t ranges = std::min(ack.ranges.size(), kMaxAckRanges);
+    BinaryData payload(8 + ranges * kAckRangeSize);
+    PutUint32(payload.data(),
+              static_cast<std::uint32_t>(
+                  std::clamp<std::int64_t>(ack.ack_delay.count(), 0, UINT32_MAX)));
+    PutUint16(payload.data() + 4, static_cast<std::uint16_t>(ranges));
+    for (std::size_t i = 0; i < ranges; ++i) {
+        PutUint64(payload.data() + 8 + i * kAckRangeSize, ack.ranges[i].first);
+        PutUint64(payload.data() + 16 + i * kAckRangeSize, ack.ranges[i].second);
+    }
+    return payload;
+}
+
+std::optional<DatagramAck> DecodeDatagramAck(std::span<const std::uint8_t> payload) {
+    if (payload.size() < 8) {
+        return std::nullopt;
+    }
+    std::size_t ranges = GetUint16(payload.data() + 4);
+    if (ranges > kMaxAckRanges || payload.size() != 8 + ranges * kAckRangeSize) {
+        return std::nullopt;
+    }
+    DatagramAck ack{.ack_delay = std::chrono::microseconds(GetUint32(payload.data()))};
+    for (std::size_t i = 0; i < ranges; ++i) {
+        std::uint64_t first = GetUint64(payload.data() + 8 + i * kAckRangeSize);
+        std::uint64_t last = GetUint64(payload.data() + 16 + i * kAckRangeSize);
+        if (first > last) {
+            return std::nullopt;
+        }
+        ack.ranges.emplace_back(first, last);
+    }
+    return ack;
+}
+
+} // namespace lansend::core
@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <core/network/datagram/datagram_receiver.h>
+#include <format>
+#include <spdlog/spdlog.h>
+
+namespace net = boost::asio;
+
+namespace lansend::core {
+
+DatagramReceiver::DatagramReceiver(net::io_context& ioc, DatagramKeys keys)
+    : socket_(ioc)
+    , keys_(std::move(keys))
+    , ack_timer_(ioc)
+    , ready_(ioc) {}
+
+std::shared_ptr<DatagramReceiver> DatagramReceiver::Create(net::io_context& ioc,
+                                                           const net::ip::address& address,
+                                                           DatagramKeys keys) {
+    std::shared_ptr<DatagramReceiver> receiver(new DatagramReceiver(ioc, std::move(keys)));
+    receiver->socket_.open(address.is_v4() ? net::ip::udp::v4() : net::ip::udp::v6());
+    boost::system::error_code ec;
+    // Best effort, packets the buffer can't hold are resent
+    receiver->socket_.set_option(net::socket_base::receive_buffer_size(4 * 1024 * 1024), ec);
+    receiver->socket_.bind(net::ip::udp::endpoint(address, 0));
+    receiver->port_ = receiver->socket_.local_endpoint().port();
+
+    net::co_spawn(
+        ioc,
+        [receiver]() -> net::awaitable<void> { co_await receiver->receiveLoop(); },
+        net::detached);
+    return receiver;
+}
+
+net::awaitable<Frame> DatagramReceiver::ReadFrame(std::chrono::steady_clock::duration timeout) {
+    auto self = shared_from_this();
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (frames_.empty() && !closed_ && std::chrono::steady_clock::now() < deadline) {
+        // Cancelled once frames are queued
+        ready_.expires_at(deadline);
+        boost::system::error_code ec;
+        co_await ready_.async_wait(net::redirect_error(net::use_awaitable, ec));
+    }
+    if (frames_.empty()) {
+        if (!error_.empty()) {
+            throw boost::system::system_error(net::error::connection_aborted, error_);
+        }
+        throw boost::system::system_error(closed_ ? net::error::operation_aborted
+                                                  : net::error::timed_out);
+    }
+    Frame frame = std::move(frames_.front());
+    frames_.pop_front();
+    co_return frame;
+}
+
+void DatagramReceiver::Close() {
+    if (closed_) {
+        return;
+    }
+    closed_ = true;
+    boost::system::error_code ec;
+    socket_.close(ec);
+    ack_timer_.cancel();
+    ready_.cancel();
+    spdlog::info("Datagram connection: {} packets received, {} duplicates",
+                 packets_,
+                 duplicate_packets_);
+}
+
+net::awaitable<void> DatagramReceiver::receiveLoop() {
+    // One byte more than a packet can have, to tell longer datagrams apart
+    BinaryData buffer(transfer::kDatagramSize + 1);
+    net::ip::udp::endpoint sender;
+    while (!closed_) {
+        boost::system::error_code ec;
+        std::size_t size = co_await socket_.async_receive_from(
+            net::buffer(buffer), sender, net::redirect_error(net::use_awaitable, ec));
+        if (closed_) {
+            break;
+        }
+        if (ec == net::error::message_size || ec == net::error::connection_refused) {
+            continue;
+        }
+        if (ec) {
+            fail(std::format("Datagram connection broke: {}", ec.message()));
+            break;
+        }
+        if (sender_ && sender != *sender_) {
+            continue;
+        }
+        auto packet = OpenDatagram(std::span(buffer.data(), size), keys_.sender);
+        if (!packet || packet->first.type != DatagramType::kData) {
+            continue;
+        }
+        auto fragment = DecodeDataFragment(packet->second);
+        if (!fragment) {
+            continue;
+        }
+        sender_ = sender;
+
+        std::uint64_t delivered = next_message_id_;
+        if (!onData(*fragment)) {
+            continue;
+        }
+        ++packets_;
+        if (!recordPacket(packet->first.packet_number)) {
+            ++duplicate_packets_;
+        }
+        // Acks of a frame's last packet go out right away, the sender may wait for them
+        if (++unacked_packets_ >= kAckEvery || next_message_id_ != delivered) {
+            sendAck();
+        } else {
+            scheduleAck();
+        }
+    }
+}
+
+bool DatagramReceiver::onData(const DataFragment& fragment) {
+    if (fragment.message_id < next_message_id_) {
+        // Handed on already, the ack for it got lost
+        return true;
+    }
+    if (fragment.message_id >= next_message_id_ + kMaxMessagesAhead) {
+        return false;
+    }
+    std::size_t fragments = (fragment.message_length + kDatagramFragmentSize - 1)
+                            / kDatagramFragmentSize;
+    std::size_t index = fragment.offset / kDatagramFragmentSize;
+    if (fragment.message_length < kFrameHeaderSize
+        || fragment.message_length > kFrameHeaderSize + kMaxFramePayloadSize
+        || fragment.offset % kDatagramFragmentSize != 0
+        || fragment.data.size()
+               != std::min<std::size_t>(kDatagramFragmentSize,
+                                        fragment.message_length - fragment.offset)) {
+        return false;
+    }
+
+    auto iter = messages_.find(fragment.message_id);
+    if (iter == messages_.end()) {
+        iter = messages_
+                   .emplace(fragment.message_id,
+                            PartialMessage{BinaryData(fragment.message_length),
+                                           std::vector<bool>(fragments),
+                                           fragments})
+                   .first;
+    } else if (iter->second.data.size() != fragment.message_length) {
+        return false;
+    }
+    auto& message = iter->second;
+    if (!message.received[index]) {
+        message.received[index] = true;
+        --message.missing;
+        std::copy(fragment.data.begin(),
+                  fragment.data.end(),
+                  message.data.begin() + fragment.offset);
+        if (message.missing == 0 && fragment.message_id == next_message_id_) {
+            deliver();
+        }
+    }
+    return true;
+}
+
+bool DatagramReceiver::recordPacket(std::uint64_t packet_number) {
+    auto next = received_ranges_.upper_bound(packet_number);
+    if (next == received_ranges_.end()) {
+        largest_received_time_ = std::chrono::steady_clock::now();
+    }
+    if (next != received_ranges_.begin()) {
+        auto previous = std::prev(next);
+        if (previous->second >= packet_number) {
+            return false;
+        }
+        if (previous->second + 1 == packet_number) {
+            previous->second = packet_number;
+            if (next != received_ranges_.end() && next->first == packet_number + 1) {
+                previous->second = next->second;
+                received_ranges_.erase(next);
+            }
+            return true;
+        }
+    }
+    if (next != received_ranges_.end() && next->first == packet_number + 1) {
+        auto last = next->second;
+        received_ranges_.erase(next);
+        received_ranges_.emplace(packet_number, last);
+        return true;
+    }
+    received_ranges_.emplace(packet_number, packet_number);
+    if (received_ranges_.size() > kMaxReceivedRanges) {
+        received_ranges_.erase(received_ranges_.begin());
+    }
+    return true;
+}
+
+void DatagramReceiver::sendAck() {
+    unacked_packets_ = 0;
+    if (!sender_ || received_ranges_.empty() || closed_) {
+        return;
+    }
+    DatagramAck ack{
+        .ack_delay = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - largest_received_time_),
+    };
+    for (auto iter = received_ranges_.rbegin();
+         iter != received_ranges_.rend() && ack.ranges.size() < kMaxAckRanges;
+         ++iter) {
+        ack.ranges.emplace_back(iter->first, iter->second);
+    }
+    auto packet = SealDatagram({DatagramType::kAck, next_ack_number_++},
+                               EncodeDatagramAck(ack),
+                               keys_.receiver);
+    // Acks are small and rare next to the data, a lost one is made up for by the next
+    boost::system::error_code ec;
+    socket_.send_to(net::buffer(packet), *sender_, 0, ec);
+}
+
+void DatagramReceiver::scheduleAck() {
+    if (ack_scheduled_) {
+        return;
+    }
+    ack_scheduled_ = true;
+    ack_timer_.expires_after(kDatagramMaxAckDelay);
+    ack_timer_.async_wait([self = shared_from_this()](const boost::system::error_code& ec) {
+        self->ack_scheduled_ = false;
+        if (!ec && self->unacked_packets_ > 0) {
+            self->sendAck();
+        }
+    });
+}
+
+void DatagramReceiver::deliver() {
+    for (auto iter = messages_.find(next_message_id_);
+         iter != messages_.end() && iter->first == next_message_id_ && iter->second.missing == 0;
+         iter = messages_.erase(iter), ++next_message_id_) {
+        auto& data = iter->second.data;
+        Frame frame;
+        frame.header = DecodeFrameHeader(
+            std::span<const std::uint8_t, kFrameHeaderSize>(data.data(), kFrameHeaderSize));
+        if (frame.header.length != data.size() - kFrameHeaderSize) {
+            fail(std::format("Invalid datagram frame length {}", frame.header.length));
+            return;
+        }
+        frame.payload.assign(data.begin() + kFrameHeaderSize, data.end());
+        frames_.push_back(std::move(frame));
+    }
+    ready_.cancel();
+}
+
+void DatagramReceiver::fail(std::string error) {
+    spdlog::error("{}", error);
+    error_ = std::move(error);
+    Close();
+}
+
+} // namespace lansend::core
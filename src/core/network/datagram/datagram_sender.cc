@@ -0,0 +1,363 @@
+#include <algorithm>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <core/network/datagram/datagram_sender.h>
+#include <format>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+namespace net = boost::asio;
+
+namespace lansend::core {
+
+DatagramSender::DatagramSender(net::io_context& ioc, DatagramKeys keys)
+    : socket_(ioc)
+    , keys_(std::move(keys))
+    , progress_(Clock::now())
+    , next_send_time_(progress_)
+    , wake_(ioc) {}
+
+std::shared_ptr<DatagramSender> DatagramSender::Create(net::io_context& ioc,
+                                                       const net::ip::udp::endpoint& receiver,
+                                                       DatagramKeys keys) {
+    std::shared_ptr<DatagramSender> sender(new DatagramSender(ioc, std::move(keys)));
+    sender->socket_.open(receiver.protocol());
+    boost::system::error_code ec;
+    // Best effort, the default buffer only holds a few packets of a burst
+    sender->socket_.set_option(net::socket_base::send_buffer_size(4 * 1024 * 1024), ec);
+    sender->socket_.connect(receiver);
+
+    net::co_spawn(
+        ioc,
+        [sender]() -> net::awaitable<void> { co_await sender->sendLoop(); },
+        net::detached);
+    net::co_spawn(
+        ioc,
+        [sender]() -> net::awaitable<void> { co_await sender->receiveLoop(); },
+        net::detached);
+    return sender;
+}
+
+net::awaitable<void> DatagramSender::WriteFrame(FrameType type,
+                                                std::uint8_t flags,
+                                                std::uint32_t stream_id,
+                                                std::span<const std::uint8_t> payload) {
+    auto header = EncodeFrameHeader(
+        {type, flags, stream_id, static_cast<std::uint32_t>(payload.size())});
+    BinaryData message(header.begin(), header.end());
+    message.insert(message.end(), payload.begin(), payload.end());
+    co_await enqueue(std::move(message));
+}
+
+net::awaitable<void> DatagramSender::WriteDataFrame(std::uint8_t flags,
+                                                    std::uint32_t stream_id,
+                                                    const DataFrameInfo& info,
+                                                    std::span<const std::uint8_t> data) {
+    auto header = EncodeFrameHeader(
+        {FrameType::kData,
+         flags,
+         stream_id,
+         static_cast<std::uint32_t>(kDataFrameInfoSize + data.size())});
+    auto encoded_info = EncodeDataFrameInfo(info);
+    BinaryData message;
+    message.reserve(kFrameHeaderSize + kDataFrameInfoSize + data.size());
+    message.insert(message.end(), header.begin(), header.end());
+    message.insert(message.end(), encoded_info.begin(), encoded_info.end());
+    message.insert(message.end(), data.begin(), data.end());
+    co_await enqueue(std::move(message));
+}
+
+net::awaitable<void> DatagramSender::enqueue(BinaryData message) {
+    auto self = shared_from_this();
+    if (closed_) {
+        throw std::runtime_error(error_.empty() ? "Datagram connection closed" : error_);
+    }
+    std::uint64_t message_id = next_message_id_++;
+    std::size_t fragments = (message.size() + kDatagramFragmentSize - 1) / kDatagramFragmentSize;
+    for (std::size_t i = 0; i < fragments; ++i) {
+        pending_.push_back(Fragment{message_id, static_cast<std::uint32_t>(i)});
+    }
+    buffered_bytes_ += message.size();
+    messages_.emplace(message_id, Message{std::move(message), std::vector<bool>(fragments)});
+    wake_.cancel();
+
+    while (buffered_bytes_ > kMaxBufferedBytes && !closed_) {
+        net::steady_timer timer(socket_.get_executor(), Clock::time_point::max());
+        waiters_.push_back(&timer);
+        boost::system::error_code ec;
+        co_await timer.async_wait(net::redirect_error(net::use_awaitable, ec));
+        std::erase(waiters_, &timer);
+    }
+    if (closed_) {
+        throw std::runtime_error(error_.empty() ? "Datagram connection closed" : error_);
+    }
+}
+
+net::awaitable<bool> DatagramSender::Flush(Clock::duration timeout) {
+    auto self = shared_from_this();
+    auto deadline = Clock::now() + timeout;
+    while (!messages_.empty() && !closed_ && Clock::now() < deadline) {
+        net::steady_timer timer(socket_.get_executor(), deadline);
+        waiters_.push_back(&timer);
+        boost::system::error_code ec;
+        co_await timer.async_wait(net::redirect_error(net::use_awaitable, ec));
+        std::erase(waiters_, &timer);
+    }
+    co_return messages_.empty() && error_.empty();
+}
+
+void DatagramSender::Close() {
+    if (closed_) {
+        return;
+    }
+    closed_ = true;
+    boost::system::error_code ec;
+    socket_.close(ec);
+    wake();
+    spdlog::info("Datagram connection: {} bytes sent, {} resent, {} packets lost, RTT {} us, "
+                 "bottleneck {:.2f} MB/s",
+                 sent_bytes_,
+                 retransmitted_bytes_,
+                 lost_packets_,
+                 smoothed_rtt_.value_or(std::chrono::microseconds::zero()).count(),
+                 congestion_.bottleneck_bandwidth() / (1024.0 * 1024.0));
+}
+
+net::awaitable<void> DatagramSender::sendLoop() {
+    while (!closed_) {
+        auto now = Clock::now();
+        checkTimeout(now);
+        if (closed_) {
+            break;
+        }
+
+        auto wake_at = Clock::time_point::max();
+        if (!in_flight_.empty()) {
+            wake_at = in_flight_.begin()->second.state.sent_time + probeTimeout();
+        }
+        if (!pending_.empty()
+            && (probes_ > 0 || bytes_in_flight_ < congestion_.congestion_window())) {
+            if (next_send_time_ <= now) {
+                co_await sendPacket(now);
+                continue;
+            }
+            wake_at = std::min(wake_at, next_send_time_);
+        } else if (pending_.empty()) {
+            congestion_.OnAppLimited(bytes_in_flight_);
+        }
+
+        // Cancelled by new frames and acks
+        wake_.expires_at(wake_at);
+        boost::system::error_code ec;
+        co_await wake_.async_wait(net::redirect_error(net::use_awaitable, ec));
+    }
+}
+
+net::awaitable<void> DatagramSender::sendPacket(Clock::time_point now) {
+    Fragment fragment = pending_.front();
+    pending_.pop_front();
+    if (probes_ > 0) {
+        --probes_;
+    }
+    auto message = messages_.find(fragment.message_id);
+    if (message == messages_.end() || message->second.acked[fragment.index]) {
+        // A packet declared lost got acked after all
+        co_return;
+    }
+
+    const auto& data = message->second.data;
+    std::size_t offset = fragment.index * kDatagramFragmentSize;
+    std::size_t size = std::min(kDatagramFragmentSize, data.size() - offset);
+    std::uint64_t packet_number = next_packet_number_++;
+    auto packet = SealDatagram({DatagramType::kData, packet_number},
+                               EncodeDataFragment(fragment.message_id,
+                                                  static_cast<std::uint32_t>(offset),
+                                                  static_cast<std::uint32_t>(data.size()),
+                                                  std::span(data).subspan(offset, size)),
+                               keys_.sender);
+
+    if (in_flight_.empty()) {
+        progress_ = std::max(progress_, now);
+    }
+    auto state = congestion_.OnSend(bytes_in_flight_, now);
+    in_flight_.emplace(packet_number, SentPacket{fragment, packet.size(), state});
+    bytes_in_flight_ += packet.size();
+    next_send_time_ = std::max(next_send_time_, now - kPacingBurst)
+                      + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(
+                          packet.size() / congestion_.pacing_rate()));
+    sent_bytes_ += packet.size();
+    if (fragment.resent) {
+        retransmitted_bytes_ += packet.size();
+    }
+
+    boost::system::error_code ec;
+    co_await socket_.async_send(net::buffer(packet), net::redirect_error(net::use_awaitable, ec));
+    if (ec && !closed_) {
+        // The packet is resent like any lost one, only the first error is logged
+        if (send_errors_++ == 0) {
+            spdlog::warn("Failed to send datagram: {}", ec.message());
+        }
+    }
+}
+
+net::awaitable<void> DatagramSender::receiveLoop() {
+    // One byte more than a packet can have, to tell longer datagrams apart
+    BinaryData buffer(transfer::kDatagramSize + 1);
+    while (!closed_) {
+        boost::system::error_code ec;
+        std::size_t size = co_await socket_.async_receive(
+            net::buffer(buffer), net::redirect_error(net::use_awaitable, ec));
+        if (closed_) {
+            break;
+        }
+        if (ec == net::error::connection_refused || ec == net::error::message_size) {
+            // ICMP for an earlier packet, the probe timeout takes care of a receiver that is gone
+            continue;
+        }
+        if (ec) {
+            fail(std::format("Datagram connection broke: {}", ec.message()));
+            break;
+        }
+        auto packet = OpenDatagram(std::span(buffer.data(), size), keys_.receiver);
+        if (!packet || packet->first.type != DatagramType::kAck) {
+            continue;
+        }
+        if (auto ack = DecodeDatagramAck(packet->second)) {
+            onAck(*ack, Clock::now());
+            wake();
+        }
+    }
+}
+
+void DatagramSender::onAck(const DatagramAck& ack, Clock::time_point now) {
+    if (ack.ranges.empty()) {
+        return;
+    }
+    std::uint64_t largest = ack.ranges.front().second;
+    bool progressed = false;
+    for (const auto& [first, last] : ack.ranges) {
+        for (auto iter = in_flight_.lower_bound(first);
+             iter != in_flight_.end() && iter->first <= last;) {
+            auto& [fragment, bytes, state] = iter->second;
+            std::optional<std::chrono::microseconds> rtt;
+            if (iter->first == largest) {
+                rtt = std::chrono::duration_cast<std::chrono::microseconds>(now - state.sent_time);
+                updateRtt(*rtt, ack.ack_delay);
+            }
+            bytes_in_flight_ -= bytes;
+            congestion_.OnAck(state, bytes, rtt, bytes_in_flight_, now);
+
+            auto message = messages_.find(fragment.message_id);
+            if (message != messages_.end() && !message->second.acked[fragment.index]) {
+                message->second.acked[fragment.index] = true;
+                if (++message->second.acked_fragments == message->second.acked.size()) {
+                    buffered_bytes_ -= message->second.data.size();
+                    messages_.erase(message);
+                }
+            }
+            iter = in_flight_.erase(iter);
+            progressed = true;
+        }
+    }
+    if (progressed) {
+        progress_ = now;
+        timeouts_ = 0;
+    }
+    largest_acked_ = std::max(largest_acked_.value_or(0), largest);
+    detectLoss(now);
+}
+
+void DatagramSender::updateRtt(std::chrono::microseconds sample,
+                               std::chrono::microseconds ack_delay) {
+    latest_rtt_ = sample;
+    // The receiver's ack delay only counts while it doesn't make the sample implausibly short
+    auto min_rtt = congestion_.min_rtt().value_or(sample);
+    if (sample - ack_delay >= min_rtt) {
+        sample -= ack_delay;
+    }
+    if (!smoothed_rtt_) {
+        smoothed_rtt_ = sample;
+        rtt_variation_ = sample / 2;
+        return;
+    }
+    auto deviation = sample > *smoothed_rtt_ ? sample - *smoothed_rtt_ : *smoothed_rtt_ - sample;
+    rtt_variation_ = (3 * rtt_variation_ + deviation) / 4;
+    smoothed_rtt_ = (7 * *smoothed_rtt_ + sample) / 8;
+}
+
+void DatagramSender::detectLoss(Clock::time_point now) {
+    if (!largest_acked_) {
+        return;
+    }
+    auto loss_delay = std::max<Clock::duration>(
+        9 * std::max(smoothed_rtt_.value_or(latest_rtt_), latest_rtt_) / 8,
+        kTimerGranularity);
+    // Packets are sent in order, once one isn't lost the later ones aren't either
+    for (auto iter = in_flight_.begin();
+         iter != in_flight_.end() && iter->first < *largest_acked_;) {
+        if (*largest_acked_ - iter->first < kPacketThreshold
+            && iter->second.state.sent_time > now - loss_delay) {
+            break;
+        }
+        iter = lose(iter);
+    }
+}
+
+void DatagramSender::checkTimeout(Clock::time_point now) {
+    if (in_flight_.empty()) {
+        return;
+    }
+    if (now - progress_ >= std::chrono::seconds(transfer::kDatagramIdleSeconds)) {
+        fail("Receiver stopped acking datagrams");
+        return;
+    }
+    auto timeout = probeTimeout();
+    if (now < in_flight_.begin()->second.state.sent_time + timeout) {
+        return;
+    }
+    // Without an ack nothing tells which packets arrived. The oldest one goes again as a probe,
+    // the ack for it makes detectLoss find the others that were lost.
+    lose(in_flight_.begin());
+    ++probes_;
+    ++timeouts_;
+}
+
+std::map<std::uint64_t, DatagramSender::SentPacket>::iterator DatagramSender::lose(
+    std::map<std::uint64_t, SentPacket>::iterator packet) {
+    bytes_in_flight_ -= packet->second.bytes;
+    congestion_.OnLoss(packet->second.bytes);
+    ++lost_packets_;
+    Fragment fragment = packet->second.fragment;
+    fragment.resent = true;
+    // Lost fragments go before new ones, the oldest first
+    pending_.insert(std::ranges::find_if(pending_, [](const Fragment& f) { return !f.resent; }),
+                    fragment);
+    return in_flight_.erase(packet);
+}
+
+void DatagramSender::fail(std::string error) {
+    spdlog::error("{}", error);
+    error_ = std::move(error);
+    Close();
+}
+
+DatagramSender::Clock::duration DatagramSender::probeTimeout() const {
+    Clock::duration timeout = kInitialProbeTimeout;
+    if (smoothed_rtt_) {
+        timeout = *smoothed_rtt_
+                  + std::max<Clock::duration>(4 * rtt_variation_, kTimerGranularity)
+                  + kDatagramMaxAckDelay;
+    }
+    return timeout * (1 << std::min<std::size_t>(timeouts_, 6));
+}
+
+void DatagramSender::wake() {
+    wake_.cancel();
+    for (auto* waiter : waiters_) {
+        waiter->cancel();
+    }
+}
+
+} // namespace lansend::core
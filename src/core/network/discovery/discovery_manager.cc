@@ -7,6 +7,7 @@
 #include <chrono>
 #include <core/model.h>
 #include <core/network/discovery/discovery_manager.h>
+#include <format>
 #include <random>
 #include <spdlog/spdlog.h>
 #include <string>
@@ -118,6 +119,58 @@ std::vector<DeviceInfo> DiscoveryManager::GetDevices() const {
     return devices;
 }
 
+ip::address_v4 DiscoveryManager::PickMulticastGroup() {
+    std::random_device rd;
+    std::uniform_int_distribution<unsigned> dis(1, 254);
+    return ip::make_address_v4(std::format("239.255.{}.{}", dis(rd), dis(rd)));
+}
+
+ip::address_v4 DiscoveryManager::LocalAddressTowards(io_context& ioc, std::string_view peer) {
+    boost::system::error_code ec;
+    auto address = ip::make_address_v4(peer, ec);
+    if (ec) {
+        return ip::address_v4::any();
+    }
+    // 连接 UDP 套接字只做路由查找，不发送数据
+    ip::udp::socket socket(ioc);
+    socket.open(ip::udp::v4(), ec);
+    if (!ec) {
+        socket.connect(ip::udp::endpoint(address, kMulticastPort), ec);
+    }
+    if (!ec) {
+        auto local = socket.local_endpoint(ec);
+        if (!ec) {
+            return local.address().to_v4();
+        }
+    }
+    return ip::address_v4::any();
+}
+
+void DiscoveryManager::OpenMulticastSender(ip::udp::socket& socket,
+                                           const ip::address_v4& interface) {
+    socket.open(ip::udp::v4());
+    socket.set_option(ip::multicast::hops(1));
+    socket.set_option(ip::multicast::enable_loopback(true));
+    // 多网卡时不依赖默认路由，组播与会话连接走同一网卡
+    if (!interface.is_unspecified()) {
+        socket.set_option(ip::multicast::outbound_interface(interface));
+    }
+    // 数据报按速率发出，较大的发送缓冲区避免突发时丢包
+    socket.set_option(socket_base::send_buffer_size(4 * 1024 * 1024));
+}
+
+void DiscoveryManager::JoinMulticastGroup(ip::udp::socket& socket,
+                                          const ip::udp::endpoint& group,
+                                          const ip::address_v4& interface) {
+    // 与广播监听一样允许同一台机器上的多个接收者绑定同一端口
+    socket.open(ip::udp::v4());
+    socket.set_option(socket_base::reuse_address(true));
+    socket.bind(ip::udp::endpoint(ip::address_v4::any(), group.port()));
+    socket.set_option(ip::multicast::join_group(group.address().to_v4(), interface));
+    boost::system::error_code ec;
+    socket.set_option(socket_base::receive_buffer_size(16 * 1024 * 1024), ec);
+}
+
 void DiscoveryManager::SetDeviceFoundCallback(std::function<void(const DeviceInfo&)> callback) {
     device_found_callback_ = callback;
 }
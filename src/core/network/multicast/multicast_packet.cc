@@ -0,0 +1,130 @@
+#include <core/network/multicast/multicast_packet.h>
+#include <stdexcept>
+
+namespace lansend::core {
+
+namespace {
+
+void PutUint16(std::uint8_t* out, std::uint16_t value) {
+    out[0] = static_cast<std::uint8_t>(value >> 8);
+    out[1] = static_cast<std::uint8_t>(value);
+}
+
+void PutUint32(std::uint8_t* out, std::uint32_t value) {
+    PutUint16(out, static_cast<std::uint16_t>(value >> 16));
+    PutUint16(out + 2, static_cast<std::uint16_t>(value));
+}
+
+void PutUint64(std::uint8_t* out, std::uint64_t value) {
+    PutUint32(out, static_cast<std::uint32_t>(value >> 32));
+    PutUint32(out + 4, static_cast<std::uint32_t>(value));
+}
+
+std::uint16_t GetUint16(const std::uint8_t* in) {
+    return static_cast<std::uint16_t>((in[0] << 8) | in[1]);
+}
+
+std::uint32_t GetUint32(const std::uint8_t* in) {
+    return (static_cast<std::uint32_t>(GetUint16(in)) << 16) | GetUint16(in + 2);
+}
+
+std::uint64_t GetUint64(const std::uint8_t* in) {
+    return (static_cast<std::uint64_t>(GetUint32(in)) << 32) | GetUint32(in + 4);
+}
+
+// Unique for every symbol of a round
+BinaryData MulticastNonce(const MulticastPacketHeader& header) {
+    BinaryData nonce(FileEncryptor::IV_SIZE);
+    PutUint32(nonce.data(), header.file_index);
+    PutUint32(nonce.data() + 4, header.chunk_index);
+    PutUint16(nonce.data() + 8, header.block);
+    nonce[10] = header.symbol;
+    return nonce;
+}
+
+} // namespace
+
+std::array<std::uint8_t, kMulticastHeaderSize> EncodeMulticastHeader(
+    const MulticastPacketHeader& header) {
+    std::array<std::uint8_t, kMulticastHeaderSize> data{};
+    PutUint32(data.data(), kMulticastMagic);
+    data[4] = kMulticastVersion;
+    data[5] = header.repair_symbols;
+    PutUint64(data.data() + 8, header.transfer_id);
+    PutUint32(data.data() + 16, header.file_index);
+    PutUint32(data.data() + 20, header.chunk_index);
+    PutUint32(data.data() + 24, header.chunk_size);
+    PutUint16(data.data() + 28, header.block);
+    data[30] = header.symbol;
+    data[31] = header.data_symbols;
+    return data;
+}
+
+std::optional<MulticastPacketHeader> DecodeMulticastHeader(std::span<const std::uint8_t> data) {
+    if (data.size() < kMulticastHeaderSize || GetUint32(data.data()) != kMulticastMagic
+        || data[4] != kMulticastVersion) {
+        return std::nullopt;
+    }
+    MulticastPacketHeader header{
+        .transfer_id = GetUint64(data.data() + 8),
+        .file_index = GetUint32(data.data() + 16),
+        .chunk_index = GetUint32(data.data() + 20),
+        .chunk_size = GetUint32(data.data() + 24),
+        .block = GetUint16(data.data() + 28),
+        .symbol = data[30],
+        .data_symbols = data[31],
+        .repair_symbols = data[5],
+    };
+    if (header.data_symbols == 0 || header.symbol >= header.data_symbols + header.repair_symbols) {
+        return std::nullopt;
+    }
+    return header;
+}
+
+BinaryData GenerateMulticastKey() {
+    auto key = FileEncryptor::GenerateKey();
+    if (!key) {
+        throw std::runtime_error("Failed to generate multicast key: " + key.error());
+    }
+    return std::move(*key);
+}
+
+BinaryData SealMulticastPacket(const MulticastPacketHeader& header,
+                               std::span<const std::uint8_t> symbol,
+                               const BinaryData& key) {
+    auto encoded = EncodeMulticastHeader(header);
+    BinaryData packet(encoded.begin(), encoded.end());
+    BinaryData tag;
+    auto ciphertext = FileEncryptor::EncryptData(BinaryData(symbol.begin(), symbol.end()),
+                                                 key,
+                                                 MulticastNonce(header),
+                                                 tag,
+                                                 packet);
+    if (!ciphertext) {
+        throw std::runtime_error("Failed to seal multicast packet: " + ciphertext.error());
+    }
+    packet.insert(packet.end(), ciphertext->begin(), ciphertext->end());
+    packet.insert(packet.end(), tag.begin(), tag.end());
+    return packet;
+}
+
+std::optional<std::pair<MulticastPacketHeader, BinaryData>> OpenMulticastPacket(
+    std::span<const std::uint8_t> packet, const BinaryData& key) {
+    auto header = DecodeMulticastHeader(packet);
+    if (!header || packet.size() != kMulticastPacketSize) {
+        return std::nullopt;
+    }
+    auto tag_begin = packet.end() - FileEncryptor::TAG_SIZE;
+    auto symbol = FileEncryptor::DecryptData(
+        BinaryData(packet.begin() + kMulticastHeaderSize, tag_begin),
+        key,
+        MulticastNonce(*header),
+        BinaryData(tag_begin, packet.end()),
+        BinaryData(packet.begin(), packet.begin() + kMulticastHeaderSize));
+    if (!symbol) {
+        return std::nullopt;
+    }
+    return std::make_pair(*header, std::move(*symbol));
+}
+
+} // namespace lansend::core
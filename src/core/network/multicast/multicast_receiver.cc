@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <core/constant/transfer.h>
+#include <core/network/discovery/discovery_manager.h>
+#include <core/network/multicast/multicast_receiver.h>
+#include <core/util/erasure_code.h>
+#include <spdlog/spdlog.h>
+
+namespace net = boost::asio;
+
+namespace lansend::core {
+
+namespace {
+
+constexpr std::size_t kBlockBytes = transfer::kMulticastDataSymbols
+                                    * transfer::kMulticastSymbolSize;
+
+} // namespace
+
+MulticastReceiver::MulticastReceiver(net::io_context& ioc,
+                                     std::uint64_t transfer_id,
+                                     BinaryData key,
+                                     ChunkHandler handler)
+    : socket_(ioc)
+    , transfer_id_(transfer_id)
+    , key_(std::move(key))
+    , handler_(std::move(handler))
+    , queued_(ioc, std::chrono::steady_clock::time_point::max())
+    , finished_(ioc, std::chrono::steady_clock::time_point::max()) {}
+
+std::shared_ptr<MulticastReceiver> MulticastReceiver::Create(net::io_context& ioc,
+                                                             const net::ip::udp::endpoint& group,
+                                                             const net::ip::address_v4& interface,
+                                                             std::uint64_t transfer_id,
+                                                             BinaryData key,
+                                                             ChunkHandler handler) {
+    std::shared_ptr<MulticastReceiver> receiver(
+        new MulticastReceiver(ioc, transfer_id, std::move(key), std::move(handler)));
+    DiscoveryManager::JoinMulticastGroup(receiver->socket_, group, interface);
+    spdlog::info("Joined multicast group {}:{} for transfer {:x}",
+                 group.address().to_string(),
+                 group.port(),
+                 transfer_id);
+
+    net::co_spawn(
+        ioc,
+        [receiver]() -> net::awaitable<void> { co_await receiver->receive(); },
+        net::detached);
+    net::co_spawn(
+        ioc,
+        [receiver]() -> net::awaitable<void> { co_await receiver->deliver(); },
+        net::detached);
+    return receiver;
+}
+
+void MulticastReceiver::Close() {
+    if (closed_) {
+        return;
+    }
+    closed_ = true;
+    boost::system::error_code ec;
+    socket_.close(ec);
+    queued_.cancel();
+    spdlog::info("Multicast transfer {:x}: {} datagrams, {} forged, {} chunks restored, {} symbols "
+                 "recovered by FEC, {} chunks given up",
+                 transfer_id_,
+                 datagrams_,
+                 forged_datagrams_,
+                 chunks_,
+                 recovered_symbols_,
+                 dropped_chunks_ + pending_.size());
+    pending_.clear();
+}
+
+net::awaitable<void> MulticastReceiver::Stop() {
+    auto self = shared_from_this();
+    Close();
+    if (!delivered_) {
+        boost::system::error_code ec;
+        co_await finished_.async_wait(net::redirect_error(net::use_awaitable, ec));
+    }
+}
+
+net::awaitable<void> MulticastReceiver::receive() {
+    // One byte more than a packet can have, to tell longer datagrams apart
+    BinaryData buffer(kMulticastPacketSize + 1);
+    net::ip::udp::endpoint sender;
+    while (!closed_) {
+        boost::system::error_code ec;
+        std::size_t size = co_await socket_.async_receive_from(
+            net::buffer(buffer), sender, net::redirect_error(net::use_awaitable, ec));
+        if (ec == net::error::message_size) {
+            continue;
+        }
+        if (ec) {
+            if (!closed_) {
+                spdlog::error("Multicast transfer {:x} stopped receiving: {}",
+                              transfer_id_,
+                              ec.message());
+                Close();
+            }
+            break;
+        }
+        std::span<const std::uint8_t> packet(buffer.data(), size);
+        auto header = DecodeMulticastHeader(packet);
+        if (!header || header->transfer_id != transfer_id_) {
+            continue;
+        }
+        // Anyone on the network can send to the group, only the sender has the key
+        auto opened = OpenMulticastPacket(packet, key_);
+        if (!opened) {
+            ++forged_datagrams_;
+            continue;
+        }
+        ++datagrams_;
+        onDatagram(opened->first, opened->second);
+    }
+}
+
+net::awaitable<void> MulticastReceiver::deliver() {
+    while (true) {
+        if (queue_.empty()) {
+            if (closed_) {
+                break;
+            }
+            boost::system::error_code ec;
+            co_await queued_.async_wait(net::redirect_error(net::use_awaitable, ec));
+            continue;
+        }
+        auto chunk = std::move(queue_.front());
+        queue_.pop_front();
+        try {
+            co_await handler_(std::move(chunk));
+        } catch (const std::exception& e) {
+            spdlog::warn("Failed to take multicast chunk: {}", e.what());
+        }
+    }
+    delivered_ = true;
+    finished_.cancel();
+}
+
+void MulticastReceiver::onDatagram(const MulticastPacketHeader& header,
+                                   std::span<const std::uint8_t> payload) {
+    ChunkKey key{header.file_index, header.chunk_index};
+    if (completed_.contains(key) || header.chunk_size == 0
+        || header.chunk_size > transfer::kMaxChunkSize) {
+        return;
+    }
+    // The sender splits every chunk the same way, packets that disagree are ignored
+    std::size_t blocks = (header.chunk_size + kBlockBytes - 1) / kBlockBytes;
+    if (header.block >= blocks) {
+        return;
+    }
+    std::size_t block_size = std::min<std::size_t>(kBlockBytes,
+                                                   header.chunk_size - header.block * kBlockBytes);
+    std::size_t data_symbols = (block_size + transfer::kMulticastSymbolSize - 1)
+                               / transfer::kMulticastSymbolSize;
+    if (header.data_symbols != data_symbols) {
+        return;
+    }
+
+    auto iter = pending_.find(key);
+    if (iter == pending_.end()) {
+        if (pending_.size() >= kMaxPendingChunks) {
+            // The sender moved on long ago, the oldest chunk won't get any more symbols
+            auto oldest = std::min_element(pending_.begin(),
+                                           pending_.end(),
+                                           [](const auto& a, const auto& b) {
+                                               return a.second.last_datagram
+                                                      < b.second.last_datagram;
+                                           });
+            completed_.insert(oldest->first);
+            pending_.erase(oldest);
+            ++dropped_chunks_;
+        }
+        iter = pending_.emplace(key, PendingChunk{header.chunk_size, std::vector<Block>(blocks)})
+                   .first;
+    } else if (iter->second.chunk_size != header.chunk_size) {
+        return;
+    }
+    auto& chunk = iter->second;
+    chunk.last_datagram = datagrams_;
+
+    auto& block = chunk.blocks[header.block];
+    if (block.symbols.empty()) {
+        block.symbols.resize(data_symbols + header.repair_symbols);
+        block.data_symbols = data_symbols;
+    }
+    if (block.restored || block.symbols.size() != data_symbols + header.repair_symbols
+        || block.symbols[header.symbol]) {
+        return;
+    }
+    block.symbols[header.symbol] = BinaryData(payload.begin(), payload.end());
+    ++block.received;
+
+    if (block.received >= block.data_symbols && restoreBlock(block)
+        && ++chunk.restored_blocks == chunk.blocks.size()) {
+        completeChunk(key, chunk);
+    }
+}
+
+bool MulticastReceiver::restoreBlock(Block& block) {
+    auto data_end = block.symbols.begin() + block.data_symbols;
+    auto lost = std::count_if(block.symbols.begin(), data_end, [](const auto& symbol) {
+        return !symbol.has_value();
+    });
+    if (lost > 0) {
+        ErasureCode code(block.data_symbols, block.symbols.size() - block.data_symbols);
+        if (!code.Decode(block.symbols)) {
+            return false;
+        }
+        recovered_symbols_ += lost;
+    }
+    block.symbols.resize(block.data_symbols);
+    block.restored = true;
+    return true;
+}
+
+void MulticastReceiver::completeChunk(const ChunkKey& key, PendingChunk& chunk) {
+    MulticastChunk restored{.file_index = key.first, .chunk_index = key.second};
+    restored.data.reserve(chunk.blocks.size() * kBlockBytes);
+    for (const auto& block : chunk.blocks) {
+        for (const auto& symbol : block.symbols) {
+            restored.data.insert(restored.data.end(), symbol->begin(), symbol->end());
+        }
+    }
+    restored.data.resize(chunk.chunk_size);
+    completed_.insert(key);
+    pending_.erase(key);
+
+    if (queue_.size() >= kMaxQueuedChunks) {
+        // The chunk is sent again over the session's connection
+        ++dropped_chunks_;
+        return;
+    }
+    ++chunks_;
+    queue_.push_back(std::move(restored));
+    queued_.cancel();
+}
+
+} // namespace lansend::core
@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <core/constant/transfer.h>
+#include <core/network/discovery/discovery_manager.h>
+#include <core/network/multicast/multicast_round.h>
+#include <core/util/config.h>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <spdlog/spdlog.h>
+
+namespace net = boost::asio;
+
+namespace lansend::core {
+
+namespace {
+
+constexpr std::size_t kBlockBytes = transfer::kMulticastDataSymbols
+                                    * transfer::kMulticastSymbolSize;
+
+std::uint64_t RandomTransferId() {
+    std::random_device rd;
+    return (static_cast<std::uint64_t>(rd()) << 32) | rd();
+}
+
+} // namespace
+
+MulticastRound::MulticastRound(net::io_context& ioc,
+                               std::shared_ptr<BandwidthScheduler> bandwidth,
+                               std::shared_ptr<const PreparedFiles> files,
+                               std::size_t sessions)
+    : ioc_(ioc)
+    , bandwidth_(std::move(bandwidth))
+    , files_(std::move(files))
+    , socket_(ioc)
+    , group_(DiscoveryManager::PickMulticastGroup(), DiscoveryManager::kMulticastPort)
+    , transfer_id_(RandomTransferId())
+    , key_(GenerateMulticastKey())
+    , code_(transfer::kMulticastDataSymbols, transfer::kMulticastRepairSymbols)
+    , sessions_(sessions)
+    , gather_timer_(ioc) {
+    for (std::size_t i = 0; i < files_->size(); ++i) {
+        file_indexes_.emplace((*files_)[i].dto.file_id, static_cast<std::uint32_t>(i));
+    }
+}
+
+std::shared_ptr<MulticastRound> MulticastRound::Create(
+    net::io_context& ioc,
+    std::shared_ptr<BandwidthScheduler> bandwidth,
+    std::shared_ptr<const PreparedFiles> files,
+    std::size_t sessions,
+    const net::ip::address_v4& interface) {
+    std::shared_ptr<MulticastRound> round(
+        new MulticastRound(ioc, std::move(bandwidth), std::move(files), sessions));
+    DiscoveryManager::OpenMulticastSender(round->socket_, interface);
+    return round;
+}
+
+void MulticastRound::Join(const std::vector<std::string>& file_ids) {
+    if (state_ != State::kGathering) {
+        return;
+    }
+    for (const auto& file_id : file_ids) {
+        auto iter = file_indexes_.find(file_id);
+        if (iter != file_indexes_.end()
+            && (*files_)[iter->second].dto.file_size > transfer::kPackedFileThreshold) {
+            wanted_.insert(iter->second);
+        }
+    }
+    ++joined_;
+    report();
+}
+
+void MulticastRound::Leave() {
+    if (state_ == State::kGathering) {
+        report();
+    }
+}
+
+net::awaitable<bool> MulticastRound::WaitDone(std::chrono::steady_clock::duration timeout) {
+    if (state_ != State::kDone) {
+        auto self = shared_from_this();
+        // Cancelled by finish() when the round ends first
+        net::steady_timer timer(ioc_, timeout);
+        waiters_.push_back(&timer);
+        boost::system::error_code ec;
+        co_await timer.async_wait(net::redirect_error(net::use_awaitable, ec));
+        std::erase(waiters_, &timer);
+    }
+    co_return state_ == State::kDone;
+}
+
+void MulticastRound::report() {
+    ++reported_;
+    if (reported_ >= sessions_) {
+        start();
+    } else if (reported_ == 1) {
+        // Receivers still waiting for their user's confirmation don't hold up the others
+        gather_timer_.expires_after(kGatherTime);
+        gather_timer_.async_wait([self = shared_from_this()](const boost::system::error_code& ec) {
+            if (!ec) {
+                self->start();
+            }
+        });
+    }
+}
+
+void MulticastRound::start() {
+    if (state_ != State::kGathering) {
+        return;
+    }
+    gather_timer_.cancel();
+    state_ = State::kSending;
+    if (wanted_.empty()) {
+        finish();
+        return;
+    }
+    spdlog::info("Multicasting {} files to {}:{} for {} of {} receivers",
+                 wanted_.size(),
+                 group_.address().to_string(),
+                 group_.port(),
+                 joined_,
+                 sessions_);
+    net::co_spawn(
+        ioc_,
+        [self = shared_from_this()]() -> net::awaitable<void> { co_await self->send(); },
+        net::detached);
+}
+
+void MulticastRound::finish() {
+    state_ = State::kDone;
+    for (auto* waiter : waiters_) {
+        waiter->cancel();
+    }
+}
+
+net::awaitable<void> MulticastRound::send() {
+    auto start_time = std::chrono::steady_clock::now();
+    try {
+        flow_ = bandwidth_->Register("multicast");
+        flow_.SetRateLimit(settings.multicast_rate * 1024.0);
+
+        for (auto file_index : wanted_) {
+            const auto& [file_dto, file_path] = (*files_)[file_index];
+            std::ifstream file(file_path, std::ios::binary);
+            if (!file) {
+                spdlog::error("Failed to open file {} for multicast", file_path.string());
+                continue;
+            }
+            for (std::size_t chunk_idx = 0; chunk_idx < file_dto.total_chunks; ++chunk_idx) {
+                std::size_t size = std::min(file_dto.chunk_size,
+                                            file_dto.file_size - chunk_idx * file_dto.chunk_size);
+                BinaryData chunk(size);
+                file.seekg(chunk_idx * file_dto.chunk_size);
+                file.read(reinterpret_cast<char*>(chunk.data()), size);
+                if (static_cast<std::size_t>(file.gcount()) != size) {
+                    spdlog::error("Failed to read chunk {} of file {} for multicast",
+                                  chunk_idx,
+                                  file_path.string());
+                    break;
+                }
+                co_await sendChunk(file_index, static_cast<std::uint32_t>(chunk_idx), chunk);
+            }
+        }
+    } catch (const std::exception& e) {
+        spdlog::error("Multicast round {:x} failed: {}", transfer_id_, e.what());
+    }
+
+    double seconds
+        = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    spdlog::info("Multicast round {:x}: {} bytes in {} datagrams in {:.2f}s ({:.2f} MB/s), {} "
+                 "send errors",
+                 transfer_id_,
+                 sent_bytes_,
+                 datagrams_,
+                 seconds,
+                 seconds > 0 ? sent_bytes_ / seconds / (1024.0 * 1024.0) : 0.0,
+                 send_errors_);
+    flow_ = BandwidthFlow{};
+    boost::system::error_code ec;
+    socket_.close(ec);
+    finish();
+}
+
+net::awaitable<void> MulticastRound::sendChunk(std::uint32_t file_index,
+                                               std::uint32_t chunk_index,
+                                               const BinaryData& chunk) {
+    constexpr std::size_t kSymbolSize = transfer::kMulticastSymbolSize;
+    MulticastPacketHeader header{
+        .transfer_id = transfer_id_,
+        .file_index = file_index,
+        .chunk_index = chunk_index,
+        .chunk_size = static_cast<std::uint32_t>(chunk.size()),
+        .repair_symbols = static_cast<std::uint8_t>(transfer::kMulticastRepairSymbols),
+    };
+    for (std::size_t offset = 0; offset < chunk.size(); offset += kBlockBytes, ++header.block) {
+        std::size_t block_size = std::min(kBlockBytes, chunk.size() - offset);
+        std::size_t data_symbols = (block_size + kSymbolSize - 1) / kSymbolSize;
+
+        // The last symbol stays padded with zeros
+        std::vector<BinaryData> symbols(data_symbols, BinaryData(kSymbolSize));
+        for (std::size_t i = 0; i < data_symbols; ++i) {
+            auto begin = chunk.begin() + offset + i * kSymbolSize;
+            std::copy(begin, begin + std::min(kSymbolSize, block_size - i * kSymbolSize),
+                      symbols[i].begin());
+        }
+        auto repair = data_symbols == code_.data_symbols()
+                          ? code_.Encode(symbols)
+                          : ErasureCode(data_symbols, transfer::kMulticastRepairSymbols)
+                                .Encode(symbols);
+        symbols.insert(symbols.end(),
+                       std::make_move_iterator(repair.begin()),
+                       std::make_move_iterator(repair.end()));
+
+        co_await flow_.Acquire(symbols.size() * kMulticastPacketSize);
+        header.data_symbols = static_cast<std::uint8_t>(data_symbols);
+        for (std::size_t i = 0; i < symbols.size(); ++i) {
+            header.symbol = static_cast<std::uint8_t>(i);
+            auto packet = SealMulticastPacket(header, symbols[i], key_);
+#ifdef LANSEND_MULTICAST_DROP_HOOK
+            if (DropMulticastDatagram()) {
+                continue;
+            }
+#endif
+            boost::system::error_code ec;
+            co_await socket_.async_send_to(net::buffer(packet),
+                                           group_,
+                                           net::redirect_error(net::use_awaitable, ec));
+            if (ec) {
+                // A lost datagram is repaired like any other, only the first error is logged
+                if (send_errors_++ == 0) {
+                    spdlog::warn("Failed to send multicast datagram: {}", ec.message());
+                }
+                continue;
+            }
+            ++datagrams_;
+            sent_bytes_ += packet.size();
+        }
+    }
+}
+
+} // namespace lansend::core
@@ -1,17 +1,28 @@
 #include <algorithm>
+#include <array>
+#include <boost/asio/redirect_error.hpp>
 #include <boost/beast/http/string_body_fwd.hpp>
 #include <boost/beast/http/vector_body.hpp>
 #include <boost/uuid/random_generator.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include <core/constant/route.h>
 #include <core/model.h>
+#include <core/network/datagram/datagram_receiver.h>
+#include <core/network/discovery/discovery_manager.h>
 #include <core/network/server/controller/receive_controller.h>
 #include <core/network/server/http_server.h>
+#include <core/network/stream/stream_frame.h>
+#include <core/util/base64.h>
 #include <core/util/binary_message.h>
+#include <core/util/chunk_ranges.h>
+#include <core/util/compression.h>
+#include <core/util/config.h>
+#include <core/util/file_io.h>
 #include <fstream>
 #include <nlohmann/json.hpp>
 #include <ranges>
 #include <regex>
+#include <span>
 #include <spdlog/spdlog.h>
 #include <string>
 #include <unordered_map>
@@ -24,15 +35,71 @@ using json = nlohmann::json;
 
 namespace lansend::core {
 
+namespace {
+
+// Only keep relative paths that stay inside the save directory, otherwise the file is saved
+// under its plain name
+std::string SanitizeRelativePath(const std::string& relative_path) {
+    if (relative_path.empty()) {
+        return {};
+    }
+    fs::path path = fs::path(relative_path).lexically_normal();
+    if (path.empty() || path.has_root_path() || !path.has_filename() || path == "."
+        || *path.begin() == "..") {
+        spdlog::warn("Ignoring invalid relative path \"{}\"", relative_path);
+        return {};
+    }
+    return path.generic_string();
+}
+
+// Ended sessions are remembered this long, so that requests still on their way are told why
+// they are refused
+constexpr std::chrono::minutes kEndedSessionLinger{1};
+
+// A queued send request is held open this long before the sender is told its position, and
+// dropped if the sender doesn't come back to /wait-turn within the lifetime
+constexpr std::chrono::seconds kQueueHoldTime{10};
+constexpr std::chrono::seconds kQueueTicketLifetime{5};
+
+// Read body bytes into `data` until it is full or the body ends, returns how many were read
+net::awaitable<std::size_t> ReadBody(BodyStreamParser& parser,
+                                     SslStream& stream,
+                                     beast::flat_buffer& buffer,
+                                     std::span<std::uint8_t> data) {
+    std::size_t filled = 0;
+    while (filled < data.size() && !parser.is_done()) {
+        parser.get().body().data = data.data() + filled;
+        parser.get().body().size = data.size() - filled;
+
+        beast::error_code ec;
+        beast::get_lowest_layer(stream).expires_after(std::chrono::seconds(30));
+        co_await http::async_read(stream,
+                                  buffer,
+                                  parser,
+                                  net::redirect_error(net::use_awaitable, ec));
+        beast::get_lowest_layer(stream).expires_never();
+        if (ec && ec != http::error::need_buffer) {
+            throw boost::system::system_error(ec);
+        }
+        filled = data.size() - parser.get().body().size;
+    }
+    co_return filled;
+}
+
+} // namespace
+
 ReceiveController::ReceiveController(HttpServer& server,
                                      const std::filesystem::path& save_dir,
                                      FeedbackCallback callback)
     : server_(server)
     , save_dir_(save_dir)
-    , callback_(callback) {
+    , callback_(callback)
+    , chunk_index_(path::kConfigDir / "chunk_index.json")
+    , disk_writer_(DiskWriteScheduler::Create(server.io_context())) {
     if (!std::filesystem::exists(save_dir_)) {
         std::filesystem::create_directories(save_dir_);
     }
+    chunk_index_.Load();
     installRoutes();
 }
 
@@ -43,31 +110,24 @@ void ReceiveController::SetSaveDirectory(const std::filesystem::path& save_dir)
     }
 }
 
-ReceiveSessionStatus ReceiveController::session_status() const {
-    return session_status_;
-}
-
-std::string_view ReceiveController::sender_ip() const {
-    return sender_ip_;
-}
-
-unsigned short ReceiveController::sender_port() const {
-    return sender_port_;
+std::size_t ReceiveController::active_sessions() const {
+    return std::ranges::count_if(sessions_, [](const auto& entry) {
+        return entry.second->status != ReceiveSessionStatus::kIdle;
+    });
 }
 
-void ReceiveController::NotifySenderLost() {
-    spdlog::info("Being notified that sender is lost before the session is completed");
-    resetToIdle();
-
-    // feedback session failed
-    feedback(Feedback{
-        .type = FeedbackType::kReceiveSessionEnded,
-        .data = feedback::ReceiveSessionEnd{
-            .session_id = session_id_,
-            .success = false,
-            .error_message = "Sender is lost",
-        },
-    });
+void ReceiveController::NotifySenderLost(std::string_view ip, unsigned short port) {
+    for (const auto& [session_id, session] : sessions_) {
+        if (session->status != ReceiveSessionStatus::kWorking || session->sender_ip != ip
+            || session->sender_port != port) {
+            continue;
+        }
+        spdlog::error("Lost connection to sender {}:{} while receiving session {}",
+                      ip,
+                      port,
+                      session_id);
+        failSession(*session, "Sender is lost");
+    }
 }
 
 void ReceiveController::SetFeedbackCallback(FeedbackCallback callback) {
@@ -85,40 +145,176 @@ void ReceiveController::SetCancelConditionFunc(CancelConditionFunc func) {
 net::awaitable<http::response<http::string_body>> ReceiveController::onRequestSend(
     const http::request<http::string_body>& req) {
     spdlog::debug("ReceiveController::OnRequestSend");
+    RequestSendDto request_send_dto;
+    // NEW
     try {
-        RequestSendDto request_send_dto;
-        // NEW
-        try {
-            json data = json::parse(req.body());
-            nlohmann::from_json(data, request_send_dto);
-        } catch (const std::exception& e) {
-            spdlog::error("Error parsing request: {}", e.what());
-            co_return HttpServer::BadRequest(req.version(), req.keep_alive(), "invalid data");
-        }
+        json data = json::parse(req.body());
+        nlohmann::from_json(data, request_send_dto);
+    } catch (const std::exception& e) {
+        spdlog::error("Error parsing request: {}", e.what());
+        co_return HttpServer::BadRequest(req.version(), req.keep_alive(), "invalid data");
+    }
 
-        DeviceInfo device_info = std::move(request_send_dto.device_info);
-        std::vector<FileDto> files = std::move(request_send_dto.files);
-        std::string all_file_names{};
-        for (const auto& file : files) {
-            all_file_names += std::format("{} ({})\n",
-                                          file.file_name,
-                                          FileTypeToString(file.file_type));
-        }
-        spdlog::info("{} {} ({}:{}) wants to send {} files:\n{}",
-                     device_info.hostname,
-                     device_info.operating_system,
-                     device_info.ip_address,
-                     device_info.port,
-                     files.size(),
-                     all_file_names);
-
-        if (session_status_ != ReceiveSessionStatus::kIdle) {
-            spdlog::info("The receiver is busy, automatically reject the request");
+    const auto& device_info = request_send_dto.device_info;
+    std::string all_file_names{};
+    for (const auto& file : request_send_dto.files) {
+        all_file_names += std::format("{} ({})\n",
+                                      file.file_name,
+                                      FileTypeToString(file.file_type));
+    }
+    spdlog::info("{} {} ({}:{}) wants to send {} files:\n{}",
+                 device_info.hostname,
+                 device_info.operating_system,
+                 device_info.ip_address,
+                 device_info.port,
+                 request_send_dto.files.size(),
+                 all_file_names);
+
+    // Forget sessions that ended a while ago
+    auto now = std::chrono::steady_clock::now();
+    std::erase_if(sessions_, [now](const auto& entry) {
+        return entry.second->status == ReceiveSessionStatus::kIdle
+               && now - entry.second->ended_at > kEndedSessionLinger;
+    });
+    pruneQueue();
+
+    // Generate a unique session ID with timestamp, it is only told to the sender once the
+    // request is accepted
+    boost::uuids::random_generator uuid_gen;
+    std::string timestamp = std::to_string(
+        std::chrono::system_clock::now().time_since_epoch().count());
+    std::string session_id = timestamp + boost::uuids::to_string(uuid_gen());
+
+    bool full = active_sessions() >= settings.max_receive_sessions;
+    if (!request_send_dto.queue_supported) {
+        if (full) {
+            spdlog::info("The receiver is busy with {} sessions, automatically reject the request",
+                         active_sessions());
             co_return HttpServer::Forbidden(req.version(), req.keep_alive(), "receiver busy");
-        } else {
-            spdlog::info("The receiver is idle, start handling the request");
-            session_status_ = ReceiveSessionStatus::kWorking;
         }
+    } else if (full || !queue_.empty()) {
+        // Senders that can wait line up behind the ones already waiting
+        auto queued = std::make_shared<QueuedRequest>(QueuedRequest{
+            .ticket = std::move(session_id),
+            .request = std::move(request_send_dto),
+            .last_seen = now,
+        });
+        queue_.push_back(queued);
+        spdlog::info("The receiver is busy with {} sessions, queued the request at position {}",
+                     active_sessions(),
+                     queue_.size());
+        co_return co_await waitForTurn(std::move(queued), req.version(), req.keep_alive());
+    }
+
+    co_return co_await startSession(std::move(request_send_dto),
+                                    std::move(session_id),
+                                    req.version(),
+                                    req.keep_alive());
+}
+
+net::awaitable<HttpResponse> ReceiveController::onWaitTurn(const HttpRequest& req) {
+    spdlog::debug("ReceiveController::OnWaitTurn");
+    pruneQueue();
+
+    std::string ticket(req[kQueueTicketHeader]);
+    auto iter = std::ranges::find_if(queue_, [&](const QueuedPtr& queued) {
+        return queued->ticket == ticket;
+    });
+    if (iter == queue_.end()) {
+        // Expired or never queued, the sender has to send its request again
+        co_return HttpServer::Forbidden(req.version(), req.keep_alive(), "invalid ticket");
+    }
+    if ((*iter)->wakeup) {
+        co_return HttpServer::BadRequest(req.version(), req.keep_alive(), "already waiting");
+    }
+    co_return co_await waitForTurn(*iter, req.version(), req.keep_alive());
+}
+
+net::awaitable<HttpResponse> ReceiveController::waitForTurn(QueuedPtr queued,
+                                                            unsigned int version,
+                                                            bool keep_alive) {
+    net::steady_timer wakeup(server_.io_context(),
+                             std::chrono::steady_clock::now() + kQueueHoldTime);
+    queued->wakeup = &wakeup;
+
+    bool held_long_enough = false;
+    while (!queued->cancelled) {
+        pruneQueue();
+        if (!queue_.empty() && queue_.front() == queued
+            && active_sessions() < settings.max_receive_sessions) {
+            queue_.pop_front();
+            queued->wakeup = nullptr;
+            // A session might be free for the next one as well
+            notifyQueue();
+            spdlog::info("Queued request {} got its turn", queued->ticket);
+            co_return co_await startSession(std::move(queued->request),
+                                            std::move(queued->ticket),
+                                            version,
+                                            keep_alive);
+        }
+        if (held_long_enough) {
+            break;
+        }
+
+        // Cancelled when a session ends or the queue changes, expires after the hold time
+        boost::system::error_code ec;
+        co_await wakeup.async_wait(net::redirect_error(net::use_awaitable, ec));
+        held_long_enough = !ec;
+    }
+    queued->wakeup = nullptr;
+    queued->last_seen = std::chrono::steady_clock::now();
+
+    if (queued->cancelled) {
+        spdlog::info("Queued request {} is cancelled by the sender", queued->ticket);
+        co_return HttpServer::Forbidden(version, keep_alive, "sender cancelled");
+    }
+
+    RequestQueuedDto queued_dto{
+        .ticket = queued->ticket,
+        .position = static_cast<std::size_t>(std::ranges::find(queue_, queued) - queue_.begin())
+                    + 1,
+    };
+    json response_data = queued_dto;
+    co_return HttpServer::Accepted(version, keep_alive, response_data.dump());
+}
+
+void ReceiveController::pruneQueue() {
+    auto now = std::chrono::steady_clock::now();
+    auto pruned = std::erase_if(queue_, [now](const QueuedPtr& queued) {
+        return !queued->wakeup && now - queued->last_seen > kQueueTicketLifetime;
+    });
+    if (pruned > 0) {
+        spdlog::info("Dropped {} queued requests whose senders stopped waiting", pruned);
+        notifyQueue();
+    }
+}
+
+void ReceiveController::notifyQueue() {
+    for (const auto& queued : queue_) {
+        if (queued->wakeup) {
+            queued->wakeup->cancel();
+        }
+    }
+}
+
+net::awaitable<HttpResponse> ReceiveController::startSession(RequestSendDto request,
+                                                             std::string session_id,
+                                                             unsigned int version,
+                                                             bool keep_alive) {
+    SessionPtr session;
+    try {
+        DeviceInfo device_info = std::move(request.device_info);
+        std::vector<FileDto> files = std::move(request.files);
+
+        boost::uuids::random_generator uuid_gen;
+        session = std::make_shared<ReceiveSessionContext>();
+        session->session_id = std::move(session_id);
+        // Record sender's network information
+        session->sender_device_id = device_info.device_id;
+        session->sender_ip = device_info.ip_address;
+        session->sender_port = device_info.port;
+        sessions_.emplace(session->session_id, session);
+        spdlog::info("Start handling the request as session {}", session->session_id);
 
         std::vector<std::string> file_names;
         for (const auto& file : files) {
@@ -134,37 +330,36 @@ net::awaitable<http::response<http::string_body>> ReceiveController::onRequestSe
             },
         });
 
-        // Record sender's network information
-        sender_ip_ = device_info.ip_address;
-        sender_port_ = device_info.port;
-
         spdlog::debug("Wait for user confirmation");
 
         // Wait for user confirmation
         std::optional<std::vector<FileDto>> accepted_files
-            = co_await waitForUserConfirmation(device_info.device_id, files, 30);
+            = co_await waitForUserConfirmation(*session, device_info.device_id, files, 30);
 
         // Sender might cancel waiting for user confirmation
-        // resetToIdle() was called cocurrently when handling sender's request
-        if (session_status_ != ReceiveSessionStatus::kWorking) {
+        // endSession() was called cocurrently when handling sender's request
+        if (session->status != ReceiveSessionStatus::kWaiting) {
             spdlog::info("Sender cancelled waiting for user confirmation");
-            co_return HttpServer::Forbidden(req.version(), req.keep_alive(), "sender cancelled");
+            co_return HttpServer::Forbidden(version, keep_alive, "sender cancelled");
         }
 
         spdlog::debug("Wait for user confirmation finished");
 
         if (accepted_files == std::nullopt) {
             spdlog::info("Send request is rejected by the receiver");
-            resetToIdle();
-            co_return HttpServer::Forbidden(req.version(), req.keep_alive(), "declined");
+            endSession(*session);
+            co_return HttpServer::Forbidden(version, keep_alive, "declined");
         }
-
-        // Generate a unique session ID with timestamp
-        boost::uuids::random_generator uuid_gen;
-        std::string timestamp = std::to_string(
-            std::chrono::system_clock::now().time_since_epoch().count());
-        session_id_ = timestamp + boost::uuids::to_string(uuid_gen());
-        spdlog::info("Send request accepted, generate session_id: {}", session_id_);
+        session->status = ReceiveSessionStatus::kWorking;
+        spdlog::info("Send request accepted, session_id: {}", session->session_id);
+        auto priority = BandwidthScheduler::ParsePriority(settings.transfer_priority);
+        bandwidth_flows_.emplace(
+            session->session_id,
+            std::make_shared<BandwidthFlow>(
+                server_.bandwidth().Register(session->sender_device_id.empty()
+                                                 ? session->sender_ip
+                                                 : session->sender_device_id,
+                                             priority.value_or(TransferPriority::kNormal))));
 
         // Create a session context and generate file tokens with file-specific information
         std::unordered_map<std::string, std::string> file_tokens;
@@ -182,14 +377,18 @@ net::awaitable<http::response<http::string_body>> ReceiveController::onRequestSe
             fs::path temp_file_path = save_dir_ / (file.file_id + ".part");
 
             // Add file to session context
-            received_files_[file.file_id] = ReceiveFileContext{.file_name = file.file_name,
-                                                               .temp_file_path = temp_file_path,
-                                                               .file_token = file_token,
-                                                               .file_size = file.file_size,
-                                                               .chunk_size = file.chunk_size,
-                                                               .total_chunks = file.total_chunks,
-                                                               .received_chunks = {},
-                                                               .file_checksum = file.file_checksum};
+            session->received_files[file.file_id] = ReceiveFileContext{
+                .file_name = file.file_name,
+                .relative_path = SanitizeRelativePath(file.relative_path),
+                .temp_file_path = temp_file_path,
+                .file_token = file_token,
+                .file_size = file.file_size,
+                .chunk_size = file.chunk_size,
+                .total_chunks = file.total_chunks,
+                .received_chunks = {},
+                .file_checksum = file.file_checksum,
+                .chunk_checksums = file.chunk_checksums,
+            };
 
             // Build message about the file
             receive_file_message += std::format("{} ({} bytes), {} chunks expected\n",
@@ -202,306 +401,933 @@ net::awaitable<http::response<http::string_body>> ReceiveController::onRequestSe
                      receive_file_message);
 
         RequestSendResponseDto response_dto;
-        response_dto.session_id = session_id_;
+        response_dto.session_id = session->session_id;
         response_dto.file_tokens = file_tokens;
+
+        // Tiny files carried in the request are saved right away, the others are streamed
+        std::vector<FileDto> streamed_files;
+        for (const auto& file : accepted_files.value()) {
+            if (!file.inline_content.empty() && co_await storeInlineFile(*session, file)) {
+                response_dto.inline_received.push_back(file.file_id);
+            } else {
+                streamed_files.push_back(file);
+            }
+        }
+        if (!response_dto.inline_received.empty()) {
+            spdlog::info("Saved {} files from the request payload",
+                         response_dto.inline_received.size());
+        }
+
+        response_dto.satisfied_chunks = co_await planLocalChunks(*session, streamed_files);
+        response_dto.accepted_compressions = {CompressionAlgorithm::kLz4,
+                                              CompressionAlgorithm::kZstd};
+        response_dto.batch_supported = true;
+        response_dto.stream_supported = true;
+        response_dto.datagram_supported = true;
+        response_dto.upload_supported = true;
+        response_dto.continue_supported = true;
+        if (!streamed_files.empty()) {
+            std::vector<FileId> file_ids;
+            for (const auto& file : files) {
+                file_ids.push_back(file.file_id);
+            }
+            response_dto.multicast_joined = joinMulticast(*session, request, std::move(file_ids));
+        }
         json response_data = response_dto;
 
-        spdlog::info("Send request accepted, session_id: {}", session_id_);
-        co_return HttpServer::Ok(req.version(), req.keep_alive(), response_data.dump());
+        // Every file might have been carried inline
+        checkSessionCompletion(*session);
+
+        co_return HttpServer::Ok(version, keep_alive, response_data.dump());
     } catch (const std::exception& e) {
         spdlog::error("Error processing request: {}", e.what());
-        resetToIdle();
-        co_return HttpServer::InternalServerError(req.version(), req.keep_alive(), e.what());
+        if (session) {
+            endSession(*session);
+        }
+        co_return HttpServer::InternalServerError(version, keep_alive, e.what());
+    }
+}
+
+bool ReceiveController::joinMulticast(const ReceiveSessionContext& session,
+                                     const RequestSendDto& request,
+                                     std::vector<FileId> file_ids) {
+    if (request.multicast_group.empty()) {
+        return false;
+    }
+    boost::system::error_code ec;
+    auto group_address = net::ip::make_address_v4(request.multicast_group, ec);
+    if (ec || !group_address.is_multicast() || request.multicast_port == 0) {
+        spdlog::warn("Ignoring invalid multicast group {}:{}",
+                     request.multicast_group,
+                     request.multicast_port);
+        return false;
+    }
+    // Without the key, the round's datagrams can't be told from anyone else's
+    auto key = base64::Decode(request.multicast_key);
+    if (!key || key->size() != FileEncryptor::KEY_SIZE) {
+        spdlog::warn("Ignoring multicast group {}:{} without a valid key",
+                     request.multicast_group,
+                     request.multicast_port);
+        return false;
+    }
+
+    // Restored chunks go through the same checks and writes as the chunks sent over the
+    // connection, a chunk that doesn't pass is left for the sender to send again
+    auto handler = [this, session_id = session.session_id, file_ids = std::move(file_ids)](
+                       MulticastChunk chunk) -> net::awaitable<void> {
+        auto session = findSession(session_id);
+        if (!session || session->status != ReceiveSessionStatus::kWorking
+            || chunk.file_index >= file_ids.size()) {
+            co_return;
+        }
+        const auto& file_id = file_ids[chunk.file_index];
+        auto iter = session->received_files.find(file_id);
+        if (iter == session->received_files.end()
+            || chunk.chunk_index >= iter->second.chunk_checksums.size()) {
+            co_return;
+        }
+        SendChunkDto send_chunk_dto{
+            .session_id = session_id,
+            .file_id = file_id,
+            .file_token = iter->second.file_token,
+            .current_chunk_index = chunk.chunk_index,
+            .chunk_checksum = iter->second.chunk_checksums[chunk.chunk_index],
+            .compression = CompressionAlgorithm::kNone,
+            .uncompressed_size = chunk.data.size(),
+            .is_final = false,
+        };
+        try {
+            co_await acceptChunk(*session, send_chunk_dto, chunk.data);
+        } catch (const std::exception& e) {
+            spdlog::warn("Dropped multicast chunk {} of file_id {}: {}",
+                         chunk.chunk_index,
+                         file_id,
+                         e.what());
+        }
+    };
+    try {
+        multicast_receivers_[session.session_id]
+            = MulticastReceiver::Create(server_.io_context(),
+                                        net::ip::udp::endpoint(group_address,
+                                                               request.multicast_port),
+                                        // The interface the sender is reached on
+                                        DiscoveryManager::LocalAddressTowards(server_.io_context(),
+                                                                              session.sender_ip),
+                                        request.multicast_transfer_id,
+                                        std::move(*key),
+                                        std::move(handler));
+        return true;
+    } catch (const std::exception& e) {
+        spdlog::warn("Failed to join multicast group {}:{}, receiving over the connection only: {}",
+                     request.multicast_group,
+                     request.multicast_port,
+                     e.what());
+        return false;
+    }
+}
+
+std::optional<HttpResponse> ReceiveController::precheckUpload(const HttpRequest& req) {
+    if (pollReceiverCancel()) {
+        spdlog::info("receiver cancelled the session");
+        return HttpServer::Forbidden(req.version(), req.keep_alive(), "receiver cancelled");
+    }
+
+    // Older senders only identify the upload in the body, it's validated by the handler then
+    auto session_id = req[kStreamSessionHeader];
+    if (session_id.empty()) {
+        return std::nullopt;
     }
+    auto session = findSession(session_id);
+    if (auto rejection = checkSession(session, req.version(), req.keep_alive())) {
+        spdlog::info("Upload for session_id {} rejected by its header",
+                     std::string_view(session_id));
+        return rejection;
+    }
+    auto file_id = req[kUploadFileIdHeader];
+    if (!file_id.empty()) {
+        auto iter = session->received_files.find(FileId(file_id));
+        if (iter == session->received_files.end()
+            || req[kUploadFileTokenHeader] != iter->second.file_token) {
+            spdlog::error("Invalid upload of file_id {} in session_id {}",
+                          std::string_view(file_id),
+                          session->session_id);
+            return HttpServer::Forbidden(req.version(), req.keep_alive(), "invalid file");
+        }
+    }
+    return std::nullopt;
 }
 
 net::awaitable<http::response<http::string_body>> ReceiveController::onSendChunk(
     const http::request<http::vector_body<std::uint8_t>>& req) {
     spdlog::debug("ReceiveController::OnSendChunk");
-    // Sender might still send several data when receiver received the cancellation request
-    // and resetToIdle() was called cocurrently
-    // Notify sender to stop the sending coroutine
-    if (session_status_ != ReceiveSessionStatus::kWorking) {
-        spdlog::info("Chunk data sent when receive session is already cancelled by sender");
-        co_return HttpServer::Forbidden(req.version(), req.keep_alive(), "sender cancelled");
-    }
-
     // This should be polling the event stream to check the ui operation
-    if (cancel_condition_()) {
+    if (pollReceiverCancel()) {
         spdlog::info("receiver cancelled the session");
-        resetToIdle();
         co_return HttpServer::Forbidden(req.version(), req.keep_alive(), "receiver cancelled");
     }
 
+    const BinaryMessage& binary_message = req.body();
+
+    SendChunkDto send_chunk_dto;
+    BinaryData chunk_data;
     try {
-        const BinaryMessage& binary_message = req.body();
+        json metadata;
+        if (!ParseBinaryMessage(binary_message, metadata, chunk_data)) {
+            throw std::runtime_error("Failed to parse binary message");
+        }
+        nlohmann::from_json(metadata, send_chunk_dto);
+    } catch (const std::exception& e) {
+        spdlog::error("Error parsing request: {}", e.what());
+        co_return HttpServer::BadRequest(req.version(), req.keep_alive(), "invalid data");
+    }
 
-        SendChunkDto send_chunk_dto;
-        BinaryData chunk_data;
-        try {
-            json metadata;
-            if (!ParseBinaryMessage(binary_message, metadata, chunk_data)) {
-                throw std::runtime_error("Failed to parse binary message");
-            }
-            nlohmann::from_json(metadata, send_chunk_dto);
-        } catch (const std::exception& e) {
-            spdlog::error("Error parsing request: {}", e.what());
-            co_return HttpServer::BadRequest(req.version(), req.keep_alive(), "invalid data");
+    // Sender might still send several data when receiver received the cancellation request
+    // and the session was ended cocurrently
+    // Notify sender to stop the sending coroutine
+    auto session = findSession(send_chunk_dto.session_id);
+    if (auto rejection = checkSession(session, req.version(), req.keep_alive())) {
+        // The session ended with the file this chunk finalized
+        if (auto retry = session ? finalizedRetry(*session,
+                                                  send_chunk_dto,
+                                                  req.version(),
+                                                  req.keep_alive())
+                                 : std::nullopt) {
+            co_return std::move(*retry);
         }
+        spdlog::info("Chunk data sent when receive session {} is not receiving",
+                     send_chunk_dto.session_id);
+        co_return std::move(*rejection);
+    }
 
-        // Check if the session ID matches
-        if (send_chunk_dto.session_id != session_id_) {
-            spdlog::error("Session ID mismatch: expected {}, got {}",
-                          session_id_,
-                          send_chunk_dto.session_id);
-            throw std::runtime_error("Session ID mismatch");
+    try {
+        auto outcome = co_await acceptChunk(*session, send_chunk_dto, chunk_data);
+        co_return chunkResponse(*session, send_chunk_dto, outcome, req.version(), req.keep_alive());
+    } catch (const std::exception& e) {
+        // Another request might have ended the session while the chunk was written
+        if (auto rejection = checkSession(session, req.version(), req.keep_alive())) {
+            co_return std::move(*rejection);
         }
+        spdlog::error("Error processing chunk: {}", e.what());
+        failSession(*session, e.what());
+        co_return HttpServer::InternalServerError(req.version(), req.keep_alive(), e.what());
+    }
+}
 
-        // Check if file_id is valid
-        if (auto iter = received_files_.find(send_chunk_dto.file_id);
-            iter != received_files_.end()) {
-            auto& file_context = iter->second;
-            // Check if the file token matches
-            if (file_context.file_token == send_chunk_dto.file_token) {
-                // Check if the chunk has already been received
-                if (file_context.received_chunks.contains(send_chunk_dto.current_chunk_index)) {
-                    spdlog::warn("Chunk {} for file_id {} in session_id {} already received",
-                                 send_chunk_dto.current_chunk_index,
-                                 send_chunk_dto.file_id,
-                                 send_chunk_dto.session_id);
-                    co_return HttpServer::Ok(req.version(), req.keep_alive());
-                }
+net::awaitable<HttpResponse> ReceiveController::onSendChunkStream(BodyStreamParser& parser,
+                                                                  SslStream& stream,
+                                                                  beast::flat_buffer& buffer,
+                                                                  MemoryReservation& reservation) {
+    spdlog::debug("ReceiveController::OnSendChunkStream");
+    auto version = parser.get().version();
+    bool keep_alive = parser.get().keep_alive();
+
+    // The header passed the precheck, but the session may have ended while the body waited
+    // for memory
+    if (pollReceiverCancel()) {
+        spdlog::info("receiver cancelled the session");
+        co_return HttpServer::Forbidden(version, false, "receiver cancelled");
+    }
 
-                // All valid, process the chunk
-                auto actual_checksum = FileHasher::CalculateDataChecksum(chunk_data);
-                if (actual_checksum != send_chunk_dto.chunk_checksum) {
-                    throw std::runtime_error(
-                        std::format("Chunk checksum mismatch for file_id {} in session_id {}",
-                                    send_chunk_dto.file_id,
-                                    send_chunk_dto.session_id));
-                }
+    // The body is a binary message: the metadata size, the metadata and then the chunk
+    SendChunkDto send_chunk_dto;
+    try {
+        std::array<std::uint8_t, sizeof(details::BinaryHeader)> size_field;
+        if (co_await ReadBody(parser, stream, buffer, size_field) != size_field.size()) {
+            throw std::runtime_error("Truncated chunk metadata");
+        }
+        details::BinaryHeader header;
+        std::memcpy(&header, size_field.data(), sizeof(header));
+        std::uint32_t metadata_size = ntohl(header.metadata_size);
+        if (metadata_size > transfer::kMaxChunkBodySize - transfer::kMaxChunkSize) {
+            throw std::runtime_error("Chunk metadata too large");
+        }
 
-                // Create or open the temporary file
-                std::fstream temp_file(file_context.temp_file_path,
-                                       std::ios::binary | std::ios::in | std::ios::out);
-                if (!temp_file) {
-                    temp_file.open(file_context.temp_file_path, std::ios::binary | std::ios::out);
-                    if (!temp_file) {
-                        throw std::runtime_error(
-                            std::format("Failed to create temporary file {} for file {}",
-                                        file_context.temp_file_path.string(),
-                                        file_context.file_name));
-                    }
-                }
+        BinaryData metadata(metadata_size);
+        if (co_await ReadBody(parser, stream, buffer, metadata) != metadata.size()) {
+            throw std::runtime_error("Truncated chunk metadata");
+        }
+        nlohmann::from_json(json::parse(metadata.begin(), metadata.end()), send_chunk_dto);
+    } catch (const boost::system::system_error&) {
+        throw;
+    } catch (const std::exception& e) {
+        spdlog::error("Error parsing request: {}", e.what());
+        co_return HttpServer::BadRequest(version, false, "invalid data");
+    }
 
-                std::size_t offset = send_chunk_dto.current_chunk_index * file_context.chunk_size;
-                temp_file.seekp(offset);
-                temp_file.write(reinterpret_cast<const char*>(chunk_data.data()), chunk_data.size());
+    auto session = findSession(send_chunk_dto.session_id);
+    if (auto rejection = checkSession(session, version, false)) {
+        // The session ended with the file this chunk finalized, the body is left unread
+        if (auto retry = session ? finalizedRetry(*session, send_chunk_dto, version, false)
+                                 : std::nullopt) {
+            co_return std::move(*retry);
+        }
+        spdlog::info("Chunk data sent when receive session {} is not receiving",
+                     send_chunk_dto.session_id);
+        co_return std::move(*rejection);
+    }
 
-                if (!temp_file) {
-                    throw std::runtime_error(
-                        std::format("Failed to write chunk to temporary file {} for file {}",
-                                    file_context.temp_file_path.string(),
-                                    file_context.file_name));
-                }
+    auto outcome = ChunkOutcome::kDuplicate;
+    try {
+        std::size_t remaining = parser.content_length_remaining().value_or(0);
+        auto* file_context = validateChunk(*session, send_chunk_dto);
 
-                temp_file.close();
-
-                // Update the received chunks count
-                file_context.received_chunks.insert(send_chunk_dto.current_chunk_index);
-
-                // feedback file receiving progress
-                feedback(Feedback{
-                    .type = FeedbackType::kFileReceivingProgress,
-                    .data = feedback::FileReceivingProgress{
-                        .session_id = session_id_,
-                        .filename = file_context.file_name,
-                        .progress = 
-                            static_cast<double>(file_context.received_chunks.size())
-                            / file_context.total_chunks * 100.0,
-                    },
-                });
-                co_return HttpServer::Ok(req.version(), req.keep_alive(), "ok");
-            } else {
-                throw std::runtime_error(
-                    std::format("Invalid file token for file_id {} in session_id {}",
-                                send_chunk_dto.file_id,
-                                send_chunk_dto.session_id));
+        if (file_context == nullptr) {
+            // Already received, only read to keep the connection
+            BinaryData piece(transfer::kUploadReadSize);
+            while (co_await ReadBody(parser, stream, buffer, piece) > 0) {
             }
         } else {
-            throw std::runtime_error(std::format("Invalid file_id {} in session_id {}",
-                                                 send_chunk_dto.file_id,
-                                                 send_chunk_dto.session_id));
-        }
+            if (send_chunk_dto.compression == CompressionAlgorithm::kNone
+                && remaining > file_context->chunk_size) {
+                throw std::runtime_error(
+                    std::format("Chunk of {} bytes for file_id {} exceeds its chunk size",
+                                remaining,
+                                send_chunk_dto.file_id));
+            }
 
+            // The chunk is verified as a whole before it is written, so that a corrupt chunk
+            // never overwrites one that was received meanwhile. The body's reservation grows to
+            // hold it.
+            co_await server_.memory_budget().Grow(reservation, remaining);
+            BinaryData chunk_data(remaining);
+            if (co_await ReadBody(parser, stream, buffer, chunk_data) != remaining) {
+                throw std::runtime_error("Truncated chunk data");
+            }
+            outcome = co_await acceptChunk(*session, send_chunk_dto, chunk_data);
+        }
+    } catch (const boost::system::system_error&) {
+        // Lost connections are reported by the server
+        throw;
     } catch (const std::exception& e) {
+        // Another request might have ended the session while the chunk was written
+        if (auto rejection = checkSession(session, version, false)) {
+            co_return std::move(*rejection);
+        }
         spdlog::error("Error processing chunk: {}", e.what());
-        resetToIdle();
-
-        // feedback session failed
-        feedback(Feedback{
-            .type = FeedbackType::kReceiveSessionEnded,
-            .data = feedback::ReceiveSessionEnd{
-                .session_id = session_id_,
-                .success = false,
-                .error_message = e.what(),
-            },
-        });
-        co_return HttpServer::InternalServerError(req.version(), req.keep_alive(), e.what());
+        failSession(*session, e.what());
+        co_return HttpServer::InternalServerError(version, false, e.what());
     }
+    co_return chunkResponse(*session, send_chunk_dto, outcome, version, keep_alive);
 }
 
-net::awaitable<http::response<http::string_body>> ReceiveController::onVerifyIntegrity(
-    const http::request<http::string_body>& req) {
-    spdlog::debug("ReceiveController::OnVerifyIntegrity");
-
-    if (session_status_ != ReceiveSessionStatus::kWorking) {
-        spdlog::info("Chunk data sent when receive session is already cancelled by sender");
-        co_return HttpServer::Forbidden(req.version(), req.keep_alive(), "sender cancelled");
+HttpResponse ReceiveController::chunkResponse(ReceiveSessionContext& session,
+                                              const SendChunkDto& send_chunk_dto,
+                                              ChunkOutcome outcome,
+                                              unsigned int version,
+                                              bool keep_alive) {
+    HttpResponse res;
+    switch (outcome) {
+    case ChunkOutcome::kAccepted:
+        res = HttpServer::Ok(version, keep_alive, "ok");
+        if (!send_chunk_dto.is_final) {
+            // The response acks the chunk, the ranges are only worth it when something is off
+            return res;
+        }
+        break;
+    case ChunkOutcome::kFinalized:
+        res = HttpServer::Ok(version, keep_alive, "finalized");
+        break;
+    case ChunkOutcome::kDuplicate:
+        if (auto retry = finalizedRetry(session, send_chunk_dto, version, keep_alive)) {
+            return std::move(*retry);
+        }
+        res = HttpServer::Ok(version, keep_alive, "duplicate");
+        break;
+    case ChunkOutcome::kRejected:
+        res = HttpServer::UnprocessableEntity(version, keep_alive, "chunk rejected");
+        break;
+    }
+    setReceivedChunks(res, session, send_chunk_dto.file_id);
+    if (outcome == ChunkOutcome::kFinalized) {
+        // Check if all files in the session are completed
+        checkSessionCompletion(session);
     }
+    return res;
+}
 
+net::awaitable<http::response<http::string_body>> ReceiveController::onSendBatch(
+    const http::request<http::vector_body<std::uint8_t>>& req) {
+    spdlog::debug("ReceiveController::OnSendBatch");
     // This should be polling the event stream to check the ui operation
-    if (cancel_condition_()) {
+    if (pollReceiverCancel()) {
         spdlog::info("receiver cancelled the session");
-        resetToIdle();
         co_return HttpServer::Forbidden(req.version(), req.keep_alive(), "receiver cancelled");
     }
 
+    const BinaryMessage& binary_message = req.body();
+
+    SendBatchDto send_batch_dto;
+    BinaryData batch_data;
     try {
-        VerifyIntegrityDto verify_integrity_dto;
-        try {
-            json data = json::parse(req.body());
-            nlohmann::from_json(data, verify_integrity_dto);
-        } catch (const std::exception& e) {
-            spdlog::error("Error parsing request: {}", e.what());
-            co_return HttpServer::BadRequest(req.version(), req.keep_alive(), "invalid data");
+        json metadata;
+        if (!ParseBinaryMessage(binary_message, metadata, batch_data)) {
+            throw std::runtime_error("Failed to parse binary message");
         }
+        nlohmann::from_json(metadata, send_batch_dto);
+    } catch (const std::exception& e) {
+        spdlog::error("Error parsing request: {}", e.what());
+        co_return HttpServer::BadRequest(req.version(), req.keep_alive(), "invalid data");
+    }
 
-        // Check if the session ID matches
-        if (verify_integrity_dto.session_id != session_id_) {
-            throw std::runtime_error(std::format("Session ID mismatch: expected {}, got {}",
-                                                 session_id_,
-                                                 verify_integrity_dto.session_id));
-        }
+    auto session = findSession(send_batch_dto.session_id);
+    if (auto rejection = checkSession(session, req.version(), req.keep_alive())) {
+        spdlog::info("Batch data sent when receive session {} is not receiving",
+                     send_batch_dto.session_id);
+        co_return std::move(*rejection);
+    }
 
-        // Check if file_id is valid
-        if (auto iter = received_files_.find(verify_integrity_dto.file_id);
-            iter != received_files_.end()) {
+    try {
+        co_await throttle(*session, batch_data.size());
+        for (const auto& entry : send_batch_dto.entries) {
+            auto iter = session->received_files.find(entry.file_id);
+            if (iter == session->received_files.end()) {
+                throw std::runtime_error(std::format("Invalid file_id {} in session_id {}",
+                                                     entry.file_id,
+                                                     send_batch_dto.session_id));
+            }
             auto& file_context = iter->second;
-            // Check if the file token matches
-            if (file_context.file_token == verify_integrity_dto.file_token) {
-                // Check if the file is complete
-                if (file_context.received_chunks.size() != file_context.total_chunks) {
-                    spdlog::error("File {} is not completely received ({} of {} chunks)",
-                                  file_context.file_name,
-                                  file_context.received_chunks.size(),
-                                  file_context.total_chunks);
-                    throw std::runtime_error(
-                        std::format("File {} is not completely received ({} of {} chunks)",
-                                    file_context.file_name,
-                                    file_context.received_chunks.size(),
-                                    file_context.total_chunks));
-                }
-                // Verify the file checksum
-                auto actual_checksum = FileHasher::CalculateFileChecksum(
-                    file_context.temp_file_path);
-                if (actual_checksum != file_context.file_checksum) {
-                    spdlog::debug("File checksum: {}, actual checksum: {}",
-                                  file_context.file_checksum,
-                                  actual_checksum);
-                    throw std::runtime_error(
-                        std::format("File checksum mismatch for file {} (id = {}) in session_id {}",
-                                    file_context.file_name,
-                                    verify_integrity_dto.file_id,
-                                    verify_integrity_dto.session_id));
-                }
+            if (file_context.file_token != entry.file_token) {
+                throw std::runtime_error(
+                    std::format("Invalid file token for file_id {} in session_id {}",
+                                entry.file_id,
+                                send_batch_dto.session_id));
+            }
+            if (!file_context.final_file_path.empty()) {
+                spdlog::warn("File {} in session_id {} already received",
+                             entry.file_id,
+                             send_batch_dto.session_id);
+                continue;
+            }
+            if (entry.size != file_context.file_size || entry.offset > batch_data.size()
+                || entry.size > batch_data.size() - entry.offset) {
+                throw std::runtime_error(std::format("Invalid batch entry for file {}",
+                                                     file_context.file_name));
+            }
 
-                fs::path final_file_path = save_dir_ / file_context.file_name;
-                // Add suffix if the file already exists
-                if (fs::exists(final_file_path)) {
-                    std::string stem = final_file_path.stem().string();
-                    std::string ext = final_file_path.extension().string();
-                    int counter = 1;
-
-                    // Check if the filename already has the format "name (n)"
-                    std::regex pattern(R"((.*) \((\d+)\)$)");
-                    std::smatch matches;
-
-                    if (std::regex_match(stem, matches, pattern)) {
-                        // If it matches "name (n)" format, extract the base name and number
-                        stem = matches[1].str();
-                        counter = std::stoi(matches[2].str()) + 1;
-                    }
+            // Each packed file is complete, so it is verified and written to its final path
+            // without going through a temp file
+            std::span<const std::uint8_t> content(batch_data.data() + entry.offset, entry.size);
+            if (FileHasher::CalculateDataChecksum(content) != file_context.file_checksum) {
+                throw std::runtime_error(
+                    std::format("File checksum mismatch for file {} (id = {}) in session_id {}",
+                                file_context.file_name,
+                                entry.file_id,
+                                send_batch_dto.session_id));
+            }
 
-                    // Try new filenames with increasing counter
-                    do {
-                        std::string new_stem = stem + " (" + std::to_string(counter) + ")";
-                        final_file_path = save_dir_ / (new_stem + ext);
-                        ++counter;
-                    } while (fs::exists(final_file_path));
+            // The file is created right away so that no other session picks the same path while
+            // the content is being written
+            fs::path final_file_path = resolveFinalPath(file_context);
+            std::ofstream file(final_file_path, std::ios::binary);
+            co_await writeToDisk(*session, [&]() {
+                file.write(reinterpret_cast<const char*>(content.data()), content.size());
+                if (!file) {
+                    throw std::runtime_error(std::format("Failed to write file \"{}\"",
+                                                         final_file_path.string()));
                 }
+            });
+            file.close();
 
-                fs::rename(file_context.temp_file_path, final_file_path);
-
-                spdlog::info("File {} received successfully, saved as \"{}\"",
-                             file_context.file_name,
-                             final_file_path.string());
-
-                completed_file_count_++;
+            for (std::size_t chunk_idx = 0; chunk_idx < file_context.total_chunks; ++chunk_idx) {
+                file_context.received_chunks.insert(chunk_idx);
+            }
+            completeFile(*session, file_context, final_file_path);
+        }
 
-                // feedback file receiving completed
-                feedback(Feedback{
-                    .type = FeedbackType::kFileReceivingCompleted,
-                    .data = feedback::FileReceivingCompleted{
-                        .session_id = session_id_,
-                        .filename = file_context.file_name,
-                    },
-                });
+        spdlog::debug("Unpacked {} files ({} bytes) from batch",
+                      send_batch_dto.entries.size(),
+                      batch_data.size());
 
-                // Check if all files in the session are completed
-                checkSessionCompletion();
+        // Check if all files in the session are completed
+        checkSessionCompletion(*session);
 
-                co_return HttpServer::Ok(req.version(), req.keep_alive(), "ok");
-            } else {
-                throw std::runtime_error(
-                    std::format("Invalid file token for file_id {} in session_id {}",
-                                verify_integrity_dto.file_id,
-                                verify_integrity_dto.session_id));
-            }
-        } else {
-            throw std::runtime_error(std::format("Invalid file_id {} in session_id {}",
-                                                 verify_integrity_dto.file_id,
-                                                 verify_integrity_dto.session_id));
+        co_return HttpServer::Ok(req.version(), req.keep_alive(), "ok");
+    } catch (const std::exception& e) {
+        // Another request might have ended the session while the files were written
+        if (auto rejection = checkSession(session, req.version(), req.keep_alive())) {
+            co_return std::move(*rejection);
         }
+        spdlog::error("Error processing batch: {}", e.what());
+        failSession(*session, e.what());
+        co_return HttpServer::InternalServerError(req.version(), req.keep_alive(), e.what());
+    }
+}
 
-    } catch (const std::exception& e) {
-        spdlog::error("Error processing file integrity verification: {}", e.what());
-        resetToIdle();
+net::awaitable<bool> ReceiveController::onStream(HttpRequest&& req,
+                                                 SslStream& stream,
+                                                 beast::flat_buffer& buffer) {
+    spdlog::debug("ReceiveController::OnStream");
+    bool datagram = beast::iequals(req[http::field::upgrade], kDatagramProtocol);
+    if (!datagram && !beast::iequals(req[http::field::upgrade], kStreamProtocol)) {
+        co_await http::async_write(stream,
+                                   HttpServer::BadRequest(req.version(), false, "unknown protocol"),
+                                   net::use_awaitable);
+        co_return false;
+    }
+    auto session = findSession(req[kStreamSessionHeader]);
+    if (!session || session->status != ReceiveSessionStatus::kWorking) {
+        co_await http::async_write(stream,
+                                   HttpServer::Forbidden(req.version(), false, "invalid session"),
+                                   net::use_awaitable);
+        co_return false;
+    }
 
-        // feedback session failed
-        feedback(Feedback{
-            .type = FeedbackType::kReceiveSessionEnded,
-            .data = feedback::ReceiveSessionEnd{
-                .session_id = session_id_,
-                .success = false,
-                .error_message = e.what(),
-            },
+    if (!datagram) {
+        co_await http::async_write(stream,
+                                   HttpServer::SwitchingProtocols(req.version(), kStreamProtocol),
+                                   net::use_awaitable);
+        spdlog::info("Session {} switched to {}", session->session_id, kStreamProtocol);
+        co_return co_await serveFrames(session, stream, [&]() -> net::awaitable<Frame> {
+            beast::get_lowest_layer(stream).expires_after(std::chrono::seconds(30));
+            Frame frame = co_await ReadFrame(stream, buffer);
+            beast::get_lowest_layer(stream).expires_never();
+            co_return frame;
         });
-        co_return HttpServer::InternalServerError(req.version(), req.keep_alive(), e.what());
     }
-}
 
-net::awaitable<boost::beast::http::response<boost::beast::http::string_body>>
-ReceiveController::onCancelSend(const http::request<boost::beast::http::string_body>& req) {
-    spdlog::debug("ReceiveController::OnCancelSend");
-    if (session_status_ != ReceiveSessionStatus::kWorking) {
-        spdlog::info(
-            "cancel send request sent when receive session is already cancelled by sender");
-        co_return HttpServer::Ok(req.version(), req.keep_alive(), "Not receiving");
+    // The frames come over UDP to the address the sender reached us at, acks go back here
+    std::shared_ptr<DatagramReceiver> receiver;
+    std::optional<DatagramKeys> keys;
+    auto random = FileEncryptor::GenerateKey(kDatagramContextSize);
+    if (random) {
+        keys = ExportDatagramKeys(stream.native_handle(), session->session_id, *random);
+    }
+    if (keys) {
+        try {
+            auto address = beast::get_lowest_layer(stream).socket().local_endpoint().address();
+            receiver = DatagramReceiver::Create(server_.io_context(), address, std::move(*keys));
+        } catch (const boost::system::system_error& e) {
+            spdlog::error("Failed to open a datagram socket: {}", e.what());
+        }
     }
+    if (!receiver) {
+        co_await http::async_write(stream,
+                                   HttpServer::InternalServerError(req.version(),
+                                                                   true,
+                                                                   "datagram unavailable"),
+                                   net::use_awaitable);
+        co_return true;
+    }
+    auto res = HttpServer::SwitchingProtocols(req.version(), kDatagramProtocol);
+    res.set(kDatagramPortHeader, std::to_string(receiver->port()));
+    res.set(kDatagramContextHeader, base64::Encode(*random));
+    co_await http::async_write(stream, res, net::use_awaitable);
+    spdlog::info("Session {} switched to {} on port {}",
+                 session->session_id,
+                 kDatagramProtocol,
+                 receiver->port());
+
+    bool ended = co_await serveFrames(session, stream, [&]() -> net::awaitable<Frame> {
+        co_return co_await receiver->ReadFrame(
+            std::chrono::seconds(transfer::kDatagramIdleSeconds));
+    });
+    receiver->Close();
+    co_return ended;
+}
 
+net::awaitable<bool> ReceiveController::serveFrames(
+    SessionPtr session, SslStream& stream, std::function<net::awaitable<Frame>()> read_frame) {
+    // Frames are handled one at a time, the sender keeps several data frames in flight so the
+    // connection stays busy while a chunk is written and acked
+    std::unordered_map<std::uint32_t, FileId> stream_files;
+    std::string error_message;
+    std::string cancel_reason;
+    bool ended = false;
     try {
-        std::string session_id;
+        while (true) {
+            Frame frame = co_await read_frame();
+
+            if (frame.header.type == FrameType::kEnd) {
+                spdlog::debug("Sender ended the stream");
+                ended = true;
+                break;
+            }
+            if (frame.header.type == FrameType::kCancel) {
+                if (endSession(*session)) {
+                    spdlog::info("Session {} is cancelled by the sender", session->session_id);
+
+                    // feedback session cancelled
+                    feedback(Feedback{
+                        .type = FeedbackType::kReceiveSessionEnded,
+                        .data = feedback::ReceiveSessionEnd{
+                            .session_id = session->session_id,
+                            .success = false,
+                            .cancelled_by_sender = true,
+                        },
+                    });
+                }
+                break;
+            }
+            // This should be polling the event stream to check the ui operation
+            if (pollReceiverCancel()) {
+                spdlog::info("receiver cancelled the session");
+                cancel_reason = "receiver cancelled";
+                break;
+            }
+            if (session->status != ReceiveSessionStatus::kWorking) {
+                cancel_reason = session->cancelled_by_receiver ? "receiver cancelled"
+                                                               : "sender cancelled";
+                break;
+            }
+
+            switch (frame.header.type) {
+            case FrameType::kOpen: {
+                json data = json::parse(frame.payload.begin(), frame.payload.end());
+                auto file_id = data.at("file_id").get<std::string>();
+                auto iter = session->received_files.find(file_id);
+                if (iter == session->received_files.end()
+                    || iter->second.file_token != data.at("file_token").get<std::string>()) {
+                    throw std::runtime_error(std::format("Invalid file {} for stream {}",
+                                                         file_id,
+                                                         frame.header.stream_id));
+                }
+                stream_files[frame.header.stream_id] = std::move(file_id);
+                break;
+            }
+            case FrameType::kData:
+            case FrameType::kVerify: {
+                auto stream_file = stream_files.find(frame.header.stream_id);
+                if (stream_file == stream_files.end()) {
+                    throw std::runtime_error(
+                        std::format("Unknown stream {}", frame.header.stream_id));
+                }
+                auto& file_context = session->received_files.at(stream_file->second);
+
+                auto outcome = ChunkOutcome::kFinalized;
+                std::uint64_t chunk_index = 0;
+                if (frame.header.type == FrameType::kData) {
+                    auto info = DecodeDataFrameInfo(frame.payload);
+                    if (!info) {
+                        throw std::runtime_error("Invalid data frame");
+                    }
+                    chunk_index = info->chunk_index;
+                    frame.payload.erase(frame.payload.begin(),
+                                        frame.payload.begin() + kDataFrameInfoSize);
+                    SendChunkDto send_chunk_dto{
+                        .session_id = session->session_id,
+                        .file_id = stream_file->second,
+                        .file_token = file_context.file_token,
+                        .current_chunk_index = info->chunk_index,
+                        .chunk_checksum = std::move(info->chunk_checksum),
+                        .compression = info->compression,
+                        .uncompressed_size = info->uncompressed_size,
+                        .is_final = (frame.header.flags & frame_flag::kFinal) != 0,
+                    };
+                    outcome = co_await acceptChunk(*session, send_chunk_dto, frame.payload);
+                } else {
+                    co_await finalizeFile(*session, stream_file->second, file_context);
+                }
+                bool finalized = outcome == ChunkOutcome::kFinalized;
+                if (finalized) {
+                    stream_files.erase(stream_file);
+                }
+
+                // Rejected chunks are NAKed, the sender sends them again on the same stream
+                co_await WriteFrame(stream,
+                                    outcome == ChunkOutcome::kRejected ? FrameType::kNak
+                                                                       : FrameType::kAck,
+                                    finalized ? frame_flag::kFinalized : 0,
+                                    frame.header.stream_id,
+                                    EncodeAckPayload(chunk_index));
+                if (finalized) {
+                    // Check if all files in the session are completed
+                    checkSessionCompletion(*session);
+                }
+                break;
+            }
+            default:
+                throw std::runtime_error(std::format("Unexpected frame type {}",
+                                                     static_cast<int>(frame.header.type)));
+            }
+        }
+    } catch (const boost::system::system_error& e) {
+        spdlog::error("Stream of session {} broke: {}", session->session_id, e.what());
+        failSession(*session, "Sender is lost");
+        co_return false;
+    } catch (const std::exception& e) {
+        if (session->status != ReceiveSessionStatus::kWorking) {
+            // Another request ended the session while a chunk was written
+            cancel_reason = session->cancelled_by_receiver ? "receiver cancelled"
+                                                           : "sender cancelled";
+        } else {
+            spdlog::error("Error processing stream: {}", e.what());
+            error_message = e.what();
+            failSession(*session, e.what());
+        }
+    }
+
+    // Tell the sender why the stream ends, it might be blocked waiting for an ack
+    try {
+        if (!error_message.empty()) {
+            co_await WriteFrame(stream,
+                                FrameType::kError,
+                                0,
+                                0,
+                                BinaryData(error_message.begin(), error_message.end()));
+        } else if (!cancel_reason.empty()) {
+            co_await WriteFrame(stream,
+                                FrameType::kCancel,
+                                0,
+                                0,
+                                BinaryData(cancel_reason.begin(), cancel_reason.end()));
+        }
+    } catch (const std::exception& e) {
+        spdlog::debug("Failed to notify the sender: {}", e.what());
+    }
+    co_return ended;
+}
+
+net::awaitable<HttpResponse> ReceiveController::onUploadFile(BodyStreamParser& parser,
+                                                             SslStream& stream,
+                                                             beast::flat_buffer& buffer,
+                                                             MemoryReservation& reservation) {
+    spdlog::debug("ReceiveController::OnUploadFile");
+    auto version = parser.get().version();
+    bool keep_alive = parser.get().keep_alive();
+
+    // This should be polling the event stream to check the ui operation
+    if (pollReceiverCancel()) {
+        spdlog::info("receiver cancelled the session");
+        co_return HttpServer::Forbidden(version, false, "receiver cancelled");
+    }
+
+    // Rejected uploads leave the body unread, the connection is closed after the response
+    auto session = findSession(parser.get()[kStreamSessionHeader]);
+    if (auto rejection = checkSession(session, version, false)) {
+        spdlog::info("File uploaded when receive session is not receiving");
+        co_return std::move(*rejection);
+    }
+
+    FileId file_id(parser.get()[kUploadFileIdHeader]);
+    auto iter = session->received_files.find(file_id);
+    if (iter == session->received_files.end()
+        || parser.get()[kUploadFileTokenHeader] != iter->second.file_token) {
+        spdlog::error("Invalid upload of file_id {} in session_id {}",
+                      file_id,
+                      session->session_id);
+        co_return HttpServer::Forbidden(version, false, "invalid file");
+    }
+    auto& file_context = iter->second;
+
+    // Every record is written as soon as it is complete, so the chunks received so far stay
+    // committed like separately sent ones
+    std::size_t accepted_chunks = 0;
+    bool finalized = false;
+    try {
+        BinaryData pending;
+        std::size_t pending_size = 0;
+        while (!parser.is_done()) {
+            // A record is only processed once it is complete, the reservation grows with the
+            // largest one buffered
+            co_await server_.memory_budget().Grow(reservation,
+                                                  pending_size + transfer::kUploadReadSize);
+            pending.resize(pending_size + transfer::kUploadReadSize);
+            parser.get().body().data = pending.data() + pending_size;
+            parser.get().body().size = transfer::kUploadReadSize;
+
+            beast::error_code ec;
+            beast::get_lowest_layer(stream).expires_after(std::chrono::seconds(30));
+            co_await http::async_read(stream,
+                                      buffer,
+                                      parser,
+                                      net::redirect_error(net::use_awaitable, ec));
+            beast::get_lowest_layer(stream).expires_never();
+            if (ec && ec != http::error::need_buffer) {
+                throw boost::system::system_error(ec);
+            }
+            pending_size += transfer::kUploadReadSize - parser.get().body().size;
+
+            std::size_t offset = 0;
+            while (pending_size - offset >= kFrameHeaderSize) {
+                auto frame_header = DecodeFrameHeader(
+                    std::span<const std::uint8_t, kFrameHeaderSize>(pending.data() + offset,
+                                                                    kFrameHeaderSize));
+                if (frame_header.type != FrameType::kData
+                    || frame_header.length > kMaxFramePayloadSize) {
+                    throw std::runtime_error("Invalid upload record");
+                }
+                if (pending_size - offset < kFrameHeaderSize + frame_header.length) {
+                    break;
+                }
+
+                std::span<const std::uint8_t> payload(pending.data() + offset + kFrameHeaderSize,
+                                                      frame_header.length);
+                auto info = DecodeDataFrameInfo(payload);
+                if (!info) {
+                    throw std::runtime_error("Invalid upload record");
+                }
+                BinaryData chunk_data(payload.begin() + kDataFrameInfoSize, payload.end());
+                SendChunkDto send_chunk_dto{
+                    .session_id = session->session_id,
+                    .file_id = file_id,
+                    .file_token = file_context.file_token,
+                    .current_chunk_index = info->chunk_index,
+                    .chunk_checksum = std::move(info->chunk_checksum),
+                    .compression = info->compression,
+                    .uncompressed_size = info->uncompressed_size,
+                    .is_final = (frame_header.flags & frame_flag::kFinal) != 0,
+                };
+                // Rejected chunks don't stop the upload, the response lists what arrived
+                auto outcome = co_await acceptChunk(*session, send_chunk_dto, chunk_data);
+                finalized = outcome == ChunkOutcome::kFinalized;
+                if (outcome != ChunkOutcome::kRejected) {
+                    ++accepted_chunks;
+                }
+                offset += kFrameHeaderSize + frame_header.length;
+
+                if (auto rejection = checkSession(session, version, false)) {
+                    co_return std::move(*rejection);
+                }
+            }
+
+            // Keep the incomplete record at the front for the next read
+            if (offset > 0) {
+                std::copy(pending.begin() + offset,
+                          pending.begin() + pending_size,
+                          pending.begin());
+                pending_size -= offset;
+            }
+
+            if (!parser.is_done() && pollReceiverCancel()) {
+                spdlog::info("receiver cancelled the session");
+                co_return HttpServer::Forbidden(version, false, "receiver cancelled");
+            }
+        }
+        if (pending_size > 0) {
+            throw std::runtime_error("Upload ended with an incomplete record");
+        }
+    } catch (const boost::system::system_error&) {
+        // Lost connections are reported by the server
+        throw;
+    } catch (const std::exception& e) {
+        // Another request might have ended the session while a chunk was written
+        if (auto rejection = checkSession(session, version, false)) {
+            co_return std::move(*rejection);
+        }
+        spdlog::error("Error processing upload of file_id {}: {}", file_id, e.what());
+        failSession(*session, e.what());
+        co_return HttpServer::InternalServerError(version, false, e.what());
+    }
+
+    spdlog::debug("Upload of file_id {} done with {} chunks", file_id, accepted_chunks);
+    if (finalized) {
+        // Check if all files in the session are completed
+        checkSessionCompletion(*session);
+
+        co_return HttpServer::Ok(version, keep_alive, "finalized");
+    }
+    auto res = HttpServer::Ok(version, keep_alive, "ok");
+    setReceivedChunks(res, *session, file_id);
+    co_return res;
+}
+
+net::awaitable<http::response<http::string_body>> ReceiveController::onVerifyIntegrity(
+    const http::request<http::string_body>& req) {
+    spdlog::debug("ReceiveController::OnVerifyIntegrity");
+
+    // This should be polling the event stream to check the ui operation
+    if (pollReceiverCancel()) {
+        spdlog::info("receiver cancelled the session");
+        co_return HttpServer::Forbidden(req.version(), req.keep_alive(), "receiver cancelled");
+    }
+
+    VerifyIntegrityDto verify_integrity_dto;
+    try {
+        json data = json::parse(req.body());
+        nlohmann::from_json(data, verify_integrity_dto);
+    } catch (const std::exception& e) {
+        spdlog::error("Error parsing request: {}", e.what());
+        co_return HttpServer::BadRequest(req.version(), req.keep_alive(), "invalid data");
+    }
+
+    auto session = findSession(verify_integrity_dto.session_id);
+    if (auto rejection = checkSession(session, req.version(), req.keep_alive())) {
+        spdlog::info("Integrity verification sent when receive session {} is not receiving",
+                     verify_integrity_dto.session_id);
+        co_return std::move(*rejection);
+    }
+
+    try {
+        // Check if file_id is valid
+        if (auto iter = session->received_files.find(verify_integrity_dto.file_id);
+            iter != session->received_files.end()) {
+            auto& file_context = iter->second;
+            // Check if the file token matches
+            if (file_context.file_token == verify_integrity_dto.file_token) {
+                co_await finalizeFile(*session, verify_integrity_dto.file_id, file_context);
+
+                // Check if all files in the session are completed
+                checkSessionCompletion(*session);
+
+                co_return HttpServer::Ok(req.version(), req.keep_alive(), "ok");
+            } else {
+                throw std::runtime_error(
+                    std::format("Invalid file token for file_id {} in session_id {}",
+                                verify_integrity_dto.file_id,
+                                verify_integrity_dto.session_id));
+            }
+        } else {
+            throw std::runtime_error(std::format("Invalid file_id {} in session_id {}",
+                                                 verify_integrity_dto.file_id,
+                                                 verify_integrity_dto.session_id));
+        }
+
+    } catch (const std::exception& e) {
+        spdlog::error("Error processing file integrity verification: {}", e.what());
+        failSession(*session, e.what());
+        co_return HttpServer::InternalServerError(req.version(), req.keep_alive(), e.what());
+    }
+}
+
+net::awaitable<HttpResponse> ReceiveController::onMulticastDone(const HttpRequest& req) {
+    std::string session_id;
+    try {
+        json data = json::parse(req.body());
+        session_id = data.at("session_id").get<std::string>();
+    } catch (const std::exception& e) {
+        spdlog::error("Error parsing request: {}", e.what());
+        co_return HttpServer::BadRequest(req.version(), req.keep_alive(), "invalid data");
+    }
+
+    auto session = findSession(session_id);
+    if (auto rejection = checkSession(session, req.version(), req.keep_alive())) {
+        co_return std::move(*rejection);
+    }
+    if (auto iter = multicast_receivers_.find(session_id); iter != multicast_receivers_.end()) {
+        // Chunks restored by now are written before the missing ones are counted
+        auto receiver = std::move(iter->second);
+        multicast_receivers_.erase(iter);
+        co_await receiver->Stop();
+    }
+
+    MulticastReportDto report_dto;
+    std::size_t missing = 0;
+    for (const auto& [file_id, file_context] : session->received_files) {
+        if (!file_context.final_file_path.empty()) {
+            continue;
+        }
+        std::vector<std::size_t> missing_chunks;
+        for (std::size_t chunk_idx = 0; chunk_idx < file_context.total_chunks; ++chunk_idx) {
+            if (!file_context.received_chunks.contains(chunk_idx)
+                && !file_context.local_chunks.contains(chunk_idx)) {
+                missing_chunks.push_back(chunk_idx);
+            }
+        }
+        missing += missing_chunks.size();
+        if (!missing_chunks.empty()) {
+            report_dto.missing_chunks.emplace(file_id, std::move(missing_chunks));
+        }
+    }
+    spdlog::info("Multicast round of session {} done, {} chunks left to send", session_id, missing);
+    json response_data = report_dto;
+    co_return HttpServer::Ok(req.version(), req.keep_alive(), response_data.dump());
+}
+
+net::awaitable<boost::beast::http::response<boost::beast::http::string_body>>
+ReceiveController::onCancelSend(const http::request<boost::beast::http::string_body>& req) {
+    spdlog::debug("ReceiveController::OnCancelSend");
+    try {
+        std::string session_id;
         try {
             json data = json::parse(req.body());
             session_id = data["session_id"].get<std::string>();
@@ -511,26 +1337,32 @@ ReceiveController::onCancelSend(const http::request<boost::beast::http::string_b
             co_return HttpServer::BadRequest(req.version(), req.keep_alive(), "invalid data");
         }
 
-        if (session_id == session_id_) {
-            // Cancel the session
-            resetToIdle();
+        auto session = findSession(session_id);
+        if (!session) {
+            throw std::runtime_error("Invalid session ID: " + session_id);
+        }
+        if (session->status != ReceiveSessionStatus::kWorking) {
+            spdlog::info(
+                "cancel send request sent when receive session is already cancelled by sender");
+            co_return HttpServer::Ok(req.version(), req.keep_alive(), "Not receiving");
+        }
 
-            spdlog::info("Session {} is cancelled by the sender", session_id);
+        // Cancel the session
+        endSession(*session);
 
-            // feedback session cancelled
-            feedback(Feedback{
-                .type = FeedbackType::kReceiveSessionEnded,
-                .data = feedback::ReceiveSessionEnd{
-                    .session_id = session_id_,
-                    .success = false,
-                    .cancelled_by_sender = true,
-                },
-            });
+        spdlog::info("Session {} is cancelled by the sender", session_id);
 
-            co_return HttpServer::Ok(req.version(), req.keep_alive());
-        } else {
-            throw std::runtime_error("Invalid session ID: " + session_id);
-        }
+        // feedback session cancelled
+        feedback(Feedback{
+            .type = FeedbackType::kReceiveSessionEnded,
+            .data = feedback::ReceiveSessionEnd{
+                .session_id = session_id,
+                .success = false,
+                .cancelled_by_sender = true,
+            },
+        });
+
+        co_return HttpServer::Ok(req.version(), req.keep_alive());
     } catch (const std::exception& e) {
         spdlog::error("Error processing cancel request: {}", e.what());
         co_return HttpServer::InternalServerError(req.version(), req.keep_alive(), e.what());
@@ -540,53 +1372,82 @@ ReceiveController::onCancelSend(const http::request<boost::beast::http::string_b
 net::awaitable<boost::beast::http::response<boost::beast::http::string_body>>
 ReceiveController::onCancelWait(const http::request<boost::beast::http::string_body>& req) {
     spdlog::debug("ReceiveController::OnCancelWait");
-    if (session_status_ != ReceiveSessionStatus::kWorking) {
-        spdlog::info(
-            "cancel wait request sent when receive session is already cancelled by sender");
-        co_return HttpServer::Ok(req.version(), req.keep_alive(), "Not waiting");
-    }
-
-    try {
-        std::string ip;
-        unsigned short port;
+    // The sender names its queue ticket, or its device id or ip and port in the body
+    std::string ticket(req[kQueueTicketHeader]);
+    std::string device_id;
+    std::string ip;
+    unsigned short port = 0;
+    if (!req.body().empty()) {
         try {
             json data = json::parse(req.body());
-            ip = data["ip"].get<std::string>();
-            port = data["port"].get<unsigned short>();
+            device_id = data.value("device_id", std::string{});
+            ip = data.value("ip", std::string{});
+            port = data.value("port", static_cast<unsigned short>(0));
         } catch (const std::exception& e) {
             spdlog::error("Error parsing request: {}", e.what());
             co_return HttpServer::BadRequest(req.version(), req.keep_alive(), "invalid data");
         }
+    }
+    if (ticket.empty() && device_id.empty() && ip.empty()) {
+        co_return HttpServer::BadRequest(req.version(), req.keep_alive(), "invalid data");
+    }
+
+    std::size_t cancelled = std::erase_if(queue_, [&](const QueuedPtr& queued) {
+        if (queued->ticket != ticket
+            && (device_id.empty() || queued->request.device_info.device_id != device_id)) {
+            return false;
+        }
+        queued->cancelled = true;
+        if (queued->wakeup) {
+            queued->wakeup->cancel();
+        }
+        return true;
+    });
+    if (cancelled > 0) {
+        spdlog::info("{} queued requests are cancelled by the sender", cancelled);
+        notifyQueue();
+    }
 
-        if (ip == sender_ip_ && port == sender_port_) {
-            resetToIdle();
+    try {
+        for (const auto& [session_id, session] : sessions_) {
+            if (session->status != ReceiveSessionStatus::kWaiting
+                || (session_id != ticket
+                    && (device_id.empty() || session->sender_device_id != device_id)
+                    && (ip.empty() || session->sender_ip != ip || session->sender_port != port))) {
+                continue;
+            }
+            endSession(*session);
+            ++cancelled;
             spdlog::info("Wait for user confirmation is cancelled by the sender");
 
             // feedback session cancelled
             feedback(Feedback{
                 .type = FeedbackType::kReceiveSessionEnded,
                 .data = feedback::ReceiveSessionEnd{
-                    .session_id = session_id_,
+                    .session_id = session_id,
                     .success = false,
                     .cancelled_by_sender = true,
                 },
             });
-            co_return HttpServer::Ok(req.version(), req.keep_alive());
-        } else {
-            co_return HttpServer::Forbidden(req.version(),
-                                            req.keep_alive(),
-                                            "invalid sender ip or port");
         }
-
-        co_return HttpServer::Ok(req.version(), req.keep_alive());
     } catch (const std::exception& e) {
         spdlog::error("Error processing cancel wait request: {}", e.what());
         co_return HttpServer::InternalServerError(req.version(), req.keep_alive(), e.what());
     }
+
+    if (cancelled == 0) {
+        spdlog::info(
+            "cancel wait request sent when receive session is already cancelled by sender");
+        co_return HttpServer::Ok(req.version(), req.keep_alive(), "Not waiting");
+    }
+    co_return HttpServer::Ok(req.version(), req.keep_alive());
 }
 
 boost::asio::awaitable<std::optional<std::vector<FileDto>>> ReceiveController::waitForUserConfirmation(
-    std::string device_id, const std::vector<FileDto>& files, int timeout_seconds) {
+    ReceiveSessionContext& session,
+    std::string device_id,
+    const std::vector<FileDto>& files,
+    int timeout_seconds) {
     if (wait_condition_ == nullptr) {
         spdlog::warn("No wait condition function set, automatically accepting all files");
         co_return files;
@@ -595,10 +1456,19 @@ boost::asio::awaitable<std::optional<std::vector<FileDto>>> ReceiveController::w
     auto executor = co_await net::this_coro::executor;
     std::optional<std::vector<FileDto>> result = std::nullopt;
 
+    // The UI answers one send request at a time, the others wait for their turn
+    while (confirming_ && session.status == ReceiveSessionStatus::kWaiting) {
+        co_await net::post(executor);
+    }
+    if (session.status != ReceiveSessionStatus::kWaiting) {
+        co_return result;
+    }
+    confirming_ = true;
+
     bool timeout = false;
     auto confirmation_task = [&]() -> net::awaitable<void> {
         auto start_time = std::chrono::steady_clock::now();
-        while (session_status_ == ReceiveSessionStatus::kWorking) {
+        while (session.status == ReceiveSessionStatus::kWaiting) {
             if (auto filenames = wait_condition_(); filenames) {
                 std::vector<FileDto> accepted_files;
                 for (auto file : files) {
@@ -607,6 +1477,7 @@ boost::asio::awaitable<std::optional<std::vector<FileDto>>> ReceiveController::w
                         accepted_files.emplace_back(file);
                     }
                 }
+                result = std::move(accepted_files);
                 co_return;
             } else {
                 auto duration = std::chrono::steady_clock::now() - start_time;
@@ -626,69 +1497,746 @@ boost::asio::awaitable<std::optional<std::vector<FileDto>>> ReceiveController::w
     } catch (const std::exception& e) {
         spdlog::error("Error waiting for user confirmation: {}", e.what());
     }
+    confirming_ = false;
 
     co_return result;
 }
 
+net::awaitable<std::unordered_map<FileId, std::vector<std::size_t>>>
+ReceiveController::planLocalChunks(ReceiveSessionContext& session,
+                                   const std::vector<FileDto>& files) {
+    std::unordered_map<FileId, std::vector<std::size_t>> satisfied_chunks;
+
+    // The sender sends files in ascending (file_size, file_id) order, so every chunk registered
+    // here is on disk before any later file referencing it gets verified
+    std::vector<const FileDto*> ordered_files;
+    for (const auto& file : files) {
+        ordered_files.push_back(&file);
+    }
+    std::ranges::sort(ordered_files, [](const FileDto* a, const FileDto* b) {
+        return std::tie(a->file_size, a->file_id) < std::tie(b->file_size, b->file_id);
+    });
+
+    // A chunk of an earlier received file, copied on the disk thread if it still matches
+    struct IndexedCopy {
+        FileId file_id;
+        std::size_t chunk_idx;
+        ChunkLocation location;
+        std::string checksum;
+        std::filesystem::path target;
+        std::size_t offset;
+        bool copied = false;
+    };
+    std::vector<IndexedCopy> indexed_copies;
+    std::unordered_map<std::string, LocalChunkSource> session_chunks;
+    std::size_t session_chunk_count = 0;
+
+    for (const FileDto* file : ordered_files) {
+        if (file->chunk_checksums.size() != file->total_chunks || file->chunk_size == 0) {
+            continue;
+        }
+        auto& file_context = session.received_files.at(file->file_id);
+
+        for (std::size_t chunk_idx = 0; chunk_idx < file->total_chunks; ++chunk_idx) {
+            const auto& checksum = file->chunk_checksums[chunk_idx];
+            if (auto iter = session_chunks.find(checksum); iter != session_chunks.end()) {
+                file_context.local_chunks.emplace(chunk_idx, iter->second);
+                satisfied_chunks[file->file_id].push_back(chunk_idx);
+                ++session_chunk_count;
+                continue;
+            }
+
+            std::size_t offset = chunk_idx * file->chunk_size;
+            std::size_t size = std::min(file->chunk_size, file->file_size - offset);
+            if (auto location = chunk_index_.Find(checksum, save_dir_);
+                location && location->size == size) {
+                indexed_copies.push_back(IndexedCopy{
+                    .file_id = file->file_id,
+                    .chunk_idx = chunk_idx,
+                    .location = std::move(*location),
+                    .checksum = checksum,
+                    .target = file_context.temp_file_path,
+                    .offset = offset,
+                });
+            }
+            session_chunks.emplace(checksum, LocalChunkSource{file->file_id, chunk_idx});
+        }
+    }
+
+    // Reading and copying large matches would hold up every connection
+    if (!indexed_copies.empty()) {
+        co_await writeToDisk(session, [&]() {
+            for (auto& copy : indexed_copies) {
+                try {
+                    // The indexed file might have been rewritten in place, so check it again
+                    copy.copied = FileHasher::CalculateRangeChecksum(copy.location.file_path,
+                                                                     copy.location.offset,
+                                                                     copy.location.size)
+                                      == copy.checksum
+                                  && fileio::CopyRange(copy.location.file_path,
+                                                       copy.location.offset,
+                                                       copy.target,
+                                                       copy.offset,
+                                                       copy.location.size);
+                } catch (const std::exception& e) {
+                    spdlog::warn("Failed to reuse indexed chunk of \"{}\": {}",
+                                 copy.location.file_path.string(),
+                                 e.what());
+                }
+            }
+        });
+    }
+    std::size_t indexed_chunk_count = 0;
+    for (const auto& copy : indexed_copies) {
+        if (copy.copied) {
+            session.received_files.at(copy.file_id).received_chunks.insert(copy.chunk_idx);
+            satisfied_chunks[copy.file_id].push_back(copy.chunk_idx);
+            ++indexed_chunk_count;
+        }
+    }
+    for (auto& [file_id, satisfied] : satisfied_chunks) {
+        std::ranges::sort(satisfied);
+    }
+
+    if (indexed_chunk_count > 0 || session_chunk_count > 0) {
+        spdlog::info("Deduplicated {} chunks from disk and {} chunks within the session",
+                     indexed_chunk_count,
+                     session_chunk_count);
+    }
+    co_return satisfied_chunks;
+}
+
+net::awaitable<void> ReceiveController::materializeLocalChunks(ReceiveSessionContext& session,
+                                                               ReceiveFileContext& file_context) {
+    if (file_context.local_chunks.empty()) {
+        co_return;
+    }
+
+    auto source_path = [](const ReceiveFileContext& source) -> const fs::path& {
+        return source.final_file_path.empty() ? source.temp_file_path : source.final_file_path;
+    };
+
+    // A whole-file duplicate of a file received earlier is cloned instead of copied by chunks
+    const auto& first_source = file_context.local_chunks.begin()->second;
+    bool whole_file = file_context.local_chunks.size() == file_context.total_chunks
+                      && std::ranges::all_of(file_context.local_chunks, [&](const auto& entry) {
+                             return entry.second.file_id == first_source.file_id
+                                    && entry.second.chunk_index == entry.first;
+                         });
+    if (whole_file) {
+        const auto& source_context = session.received_files.at(first_source.file_id);
+        bool cloned = false;
+        if (source_context.file_size == file_context.file_size
+            && source_context.received_chunks.size() == source_context.total_chunks) {
+            fs::path source = source_path(source_context);
+            co_await writeToDisk(session, [&]() {
+                cloned = fileio::CloneFile(source, file_context.temp_file_path);
+            });
+        }
+        if (cloned) {
+            spdlog::info("File {} is a duplicate of {}, cloned locally",
+                         file_context.file_name,
+                         source_context.file_name);
+            for (std::size_t chunk_idx = 0; chunk_idx < file_context.total_chunks; ++chunk_idx) {
+                file_context.received_chunks.insert(chunk_idx);
+            }
+            file_context.local_chunks.clear();
+            co_return;
+        }
+    }
+
+    // Decided here, copied on the disk thread
+    struct LocalCopy {
+        std::size_t chunk_idx;
+        fs::path source;
+        std::size_t source_offset;
+        std::size_t offset;
+        std::size_t size;
+    };
+    std::vector<LocalCopy> copies;
+    for (const auto& [chunk_idx, source] : file_context.local_chunks) {
+        if (file_context.received_chunks.contains(chunk_idx)) {
+            continue;
+        }
+        const auto& source_context = session.received_files.at(source.file_id);
+        if (!source_context.received_chunks.contains(source.chunk_index)) {
+            throw std::runtime_error(
+                std::format("Source chunk {} of file {} for file {} is not received yet",
+                            source.chunk_index,
+                            source_context.file_name,
+                            file_context.file_name));
+        }
+
+        std::size_t offset = chunk_idx * file_context.chunk_size;
+        copies.push_back(LocalCopy{
+            .chunk_idx = chunk_idx,
+            .source = source_path(source_context),
+            .source_offset = source.chunk_index * source_context.chunk_size,
+            .offset = offset,
+            .size = std::min(file_context.chunk_size, file_context.file_size - offset),
+        });
+    }
+    if (!copies.empty()) {
+        co_await writeToDisk(session, [&]() {
+            for (const auto& copy : copies) {
+                if (!fileio::CopyRange(copy.source,
+                                       copy.source_offset,
+                                       file_context.temp_file_path,
+                                       copy.offset,
+                                       copy.size)) {
+                    throw std::runtime_error(
+                        std::format("Failed to copy local chunk {} into file {}",
+                                    copy.chunk_idx,
+                                    file_context.file_name));
+                }
+            }
+        });
+    }
+    for (const auto& copy : copies) {
+        file_context.received_chunks.insert(copy.chunk_idx);
+    }
+    file_context.local_chunks.clear();
+}
+
+ReceiveFileContext* ReceiveController::validateChunk(ReceiveSessionContext& session,
+                                                     const SendChunkDto& send_chunk_dto) {
+    // Check if the session ID matches
+    if (send_chunk_dto.session_id != session.session_id) {
+        spdlog::error("Session ID mismatch: expected {}, got {}",
+                      session.session_id,
+                      send_chunk_dto.session_id);
+        throw std::runtime_error("Session ID mismatch");
+    }
+
+    // Check if file_id is valid
+    auto iter = session.received_files.find(send_chunk_dto.file_id);
+    if (iter == session.received_files.end()) {
+        throw std::runtime_error(std::format("Invalid file_id {} in session_id {}",
+                                             send_chunk_dto.file_id,
+                                             send_chunk_dto.session_id));
+    }
+    auto& file_context = iter->second;
+
+    // Check if the file token matches
+    if (file_context.file_token != send_chunk_dto.file_token) {
+        throw std::runtime_error(std::format("Invalid file token for file_id {} in session_id {}",
+                                             send_chunk_dto.file_id,
+                                             send_chunk_dto.session_id));
+    }
+
+    // Check if the chunk has already been received
+    if (file_context.received_chunks.contains(send_chunk_dto.current_chunk_index)) {
+        spdlog::warn("Chunk {} for file_id {} in session_id {} already received",
+                     send_chunk_dto.current_chunk_index,
+                     send_chunk_dto.file_id,
+                     send_chunk_dto.session_id);
+        return nullptr;
+    }
+
+    // The final chunk carries the file digest, it has to match the announced one
+    if (send_chunk_dto.is_final && !send_chunk_dto.file_checksum.empty()
+        && send_chunk_dto.file_checksum != file_context.file_checksum) {
+        throw std::runtime_error(std::format("File checksum mismatch for file_id {} in session_id {}",
+                                             send_chunk_dto.file_id,
+                                             send_chunk_dto.session_id));
+    }
+    return &file_context;
+}
+
+net::awaitable<ReceiveController::ChunkOutcome> ReceiveController::acceptChunk(
+    ReceiveSessionContext& session, const SendChunkDto& send_chunk_dto, BinaryData& chunk_data) {
+    auto* file_context_ptr = validateChunk(session, send_chunk_dto);
+    if (file_context_ptr == nullptr) {
+        co_return ChunkOutcome::kDuplicate;
+    }
+    auto& file_context = *file_context_ptr;
+    co_await throttle(session, chunk_data.size());
+
+    // Restore the raw chunk, the declared size must fit in a single chunk
+    if (send_chunk_dto.compression != CompressionAlgorithm::kNone) {
+        if (send_chunk_dto.uncompressed_size > file_context.chunk_size
+            || send_chunk_dto.uncompressed_size > transfer::kMaxChunkSize) {
+            throw std::runtime_error(
+                std::format("Invalid uncompressed size {} for file_id {} in session_id {}",
+                            send_chunk_dto.uncompressed_size,
+                            send_chunk_dto.file_id,
+                            send_chunk_dto.session_id));
+        }
+        // Corrupt data tends to fail here before its checksum is compared
+        try {
+            chunk_data = compression::Decompress(send_chunk_dto.compression,
+                                                 chunk_data,
+                                                 send_chunk_dto.uncompressed_size);
+        } catch (const std::exception& e) {
+            rejectChunk(session, send_chunk_dto, file_context, e.what());
+            co_return ChunkOutcome::kRejected;
+        }
+    }
+
+    // All valid, process the chunk
+    auto actual_checksum = FileHasher::CalculateDataChecksum(chunk_data);
+    if (actual_checksum != send_chunk_dto.chunk_checksum) {
+        rejectChunk(session, send_chunk_dto, file_context, "checksum mismatch");
+        co_return ChunkOutcome::kRejected;
+    }
+
+    std::size_t offset = send_chunk_dto.current_chunk_index * file_context.chunk_size;
+    co_await writeToDisk(session, [&]() {
+        auto temp_file = openTempFile(file_context);
+        temp_file.seekp(offset);
+        temp_file.write(reinterpret_cast<const char*>(chunk_data.data()), chunk_data.size());
+
+        if (!temp_file) {
+            throw std::runtime_error(
+                std::format("Failed to write chunk to temporary file {} for file {}",
+                            file_context.temp_file_path.string(),
+                            file_context.file_name));
+        }
+
+        temp_file.close();
+    });
+
+    co_return co_await commitChunk(session, send_chunk_dto, file_context)
+        ? ChunkOutcome::kFinalized
+        : ChunkOutcome::kAccepted;
+}
+
+net::awaitable<void> ReceiveController::writeToDisk(ReceiveSessionContext& session,
+                                                    std::function<void()> write) {
+    co_await disk_writer_->Write(session.session_id, std::move(write));
+    if (session.status != ReceiveSessionStatus::kWorking) {
+        // The session was cleaned up while the write ran, which may have left a temp file behind
+        doCleanup(session);
+        throw std::runtime_error(std::format("Session {} ended while writing", session.session_id));
+    }
+}
+
+net::awaitable<void> ReceiveController::throttle(const ReceiveSessionContext& session,
+                                                std::size_t bytes) {
+    if (auto it = bandwidth_flows_.find(session.session_id); it != bandwidth_flows_.end()) {
+        // The flow outlives the wait if the session ends meanwhile
+        auto flow = it->second;
+        co_await flow->Acquire(bytes);
+    }
+}
+
+std::fstream ReceiveController::openTempFile(const ReceiveFileContext& file_context) {
+    // Create or open the temporary file
+    std::fstream temp_file(file_context.temp_file_path,
+                           std::ios::binary | std::ios::in | std::ios::out);
+    if (!temp_file) {
+        temp_file.open(file_context.temp_file_path, std::ios::binary | std::ios::out);
+        if (!temp_file) {
+            throw std::runtime_error(std::format("Failed to create temporary file {} for file {}",
+                                                 file_context.temp_file_path.string(),
+                                                 file_context.file_name));
+        }
+    }
+    return temp_file;
+}
+
+net::awaitable<bool> ReceiveController::commitChunk(ReceiveSessionContext& session,
+                                                    const SendChunkDto& send_chunk_dto,
+                                                    ReceiveFileContext& file_context) {
+    // Update the received chunks count
+    file_context.received_chunks.insert(send_chunk_dto.current_chunk_index);
+    file_context.rejected_chunks.erase(send_chunk_dto.current_chunk_index);
+
+    // feedback file receiving progress
+    feedback(Feedback{
+        .type = FeedbackType::kFileReceivingProgress,
+        .data = feedback::FileReceivingProgress{
+            .session_id = session.session_id,
+            .filename = file_context.file_name,
+            .progress = static_cast<double>(file_context.received_chunks.size())
+                        / file_context.total_chunks * 100.0,
+        },
+    });
+
+    // Verify and save the file right away instead of waiting for /verify-integrity, unless the
+    // sender still has to resend rejected chunks
+    if (send_chunk_dto.is_final && file_context.rejected_chunks.empty()) {
+        co_await finalizeFile(session, send_chunk_dto.file_id, file_context);
+        co_return true;
+    }
+    co_return false;
+}
+
+void ReceiveController::rejectChunk(ReceiveSessionContext& session,
+                                    const SendChunkDto& send_chunk_dto,
+                                    ReceiveFileContext& file_context,
+                                    std::string_view reason) {
+    // A sender whose chunks keep arriving corrupt won't get the file through
+    if (++session.rejected_chunk_count > transfer::kMaxRejectedChunks) {
+        throw std::runtime_error(
+            std::format("Chunk {} for file_id {} in session_id {} rejected: {}, giving up after {} "
+                        "rejected chunks",
+                        send_chunk_dto.current_chunk_index,
+                        send_chunk_dto.file_id,
+                        send_chunk_dto.session_id,
+                        reason,
+                        transfer::kMaxRejectedChunks));
+    }
+    spdlog::warn("Chunk {} for file_id {} in session_id {} rejected: {}",
+                 send_chunk_dto.current_chunk_index,
+                 send_chunk_dto.file_id,
+                 send_chunk_dto.session_id,
+                 reason);
+    file_context.rejected_chunks.insert(send_chunk_dto.current_chunk_index);
+}
+
+std::optional<HttpResponse> ReceiveController::finalizedRetry(const ReceiveSessionContext& session,
+                                                              const SendChunkDto& send_chunk_dto,
+                                                              unsigned int version,
+                                                              bool keep_alive) {
+    if (!send_chunk_dto.is_final || send_chunk_dto.session_id != session.session_id) {
+        return std::nullopt;
+    }
+    auto iter = session.received_files.find(send_chunk_dto.file_id);
+    if (iter == session.received_files.end()
+        || iter->second.file_token != send_chunk_dto.file_token
+        || iter->second.final_file_path.empty()) {
+        return std::nullopt;
+    }
+    auto res = HttpServer::Ok(version, keep_alive, "finalized");
+    setReceivedChunks(res, session, send_chunk_dto.file_id);
+    return res;
+}
+
+void ReceiveController::setReceivedChunks(HttpResponse& res,
+                                          const ReceiveSessionContext& session,
+                                          const FileId& file_id) {
+    if (auto iter = session.received_files.find(file_id); iter != session.received_files.end()) {
+        res.set(kReceivedChunksHeader, chunk_ranges::Format(iter->second.received_chunks));
+    }
+}
+
+net::awaitable<void> ReceiveController::finalizeFile(ReceiveSessionContext& session,
+                                                     const FileId& file_id,
+                                                     ReceiveFileContext& file_context) {
+    if (!file_context.final_file_path.empty() || file_context.finalizing) {
+        co_return;
+    }
+
+    // Fill in chunks that were not sent because another file already carried them
+    co_await materializeLocalChunks(session, file_context);
+
+    // Check if the file is complete
+    if (file_context.received_chunks.size() != file_context.total_chunks) {
+        spdlog::error("File {} is not completely received ({} of {} chunks)",
+                      file_context.file_name,
+                      file_context.received_chunks.size(),
+                      file_context.total_chunks);
+        throw std::runtime_error(std::format("File {} is not completely received ({} of {} chunks)",
+                                             file_context.file_name,
+                                             file_context.received_chunks.size(),
+                                             file_context.total_chunks));
+    }
+    // Verify the file checksum, reading the whole file would hold up every connection
+    std::string actual_checksum;
+    file_context.finalizing = true;
+    try {
+        co_await writeToDisk(session, [&]() {
+            actual_checksum = FileHasher::CalculateFileChecksum(file_context.temp_file_path);
+        });
+    } catch (...) {
+        file_context.finalizing = false;
+        throw;
+    }
+    file_context.finalizing = false;
+    if (actual_checksum != file_context.file_checksum) {
+        spdlog::debug("File checksum: {}, actual checksum: {}",
+                      file_context.file_checksum,
+                      actual_checksum);
+        throw std::runtime_error(
+            std::format("File checksum mismatch for file {} (id = {}) in session_id {}",
+                        file_context.file_name,
+                        file_id,
+                        session.session_id));
+    }
+
+    fs::path final_file_path = resolveFinalPath(file_context);
+    fs::rename(file_context.temp_file_path, final_file_path);
+    completeFile(session, file_context, final_file_path);
+}
+
+net::awaitable<bool> ReceiveController::storeInlineFile(ReceiveSessionContext& session,
+                                                       const FileDto& file) {
+    auto& file_context = session.received_files.at(file.file_id);
+    auto content = base64::Decode(file.inline_content);
+    if (!content || content->size() != file_context.file_size
+        || FileHasher::CalculateDataChecksum(*content) != file_context.file_checksum) {
+        spdlog::warn("Inline content of file {} is invalid, waiting for it to be sent",
+                     file_context.file_name);
+        co_return false;
+    }
+
+    try {
+        // The file is created right away so that no other session picks the same path while the
+        // content is being written
+        fs::path final_file_path = resolveFinalPath(file_context);
+        std::ofstream output(final_file_path, std::ios::binary);
+        bool written = false;
+        co_await writeToDisk(session, [&]() {
+            output.write(reinterpret_cast<const char*>(content->data()), content->size());
+            written = static_cast<bool>(output);
+            output.close();
+            if (!written) {
+                fs::remove(final_file_path);
+            }
+        });
+        if (!written) {
+            spdlog::warn("Failed to write file \"{}\"", final_file_path.string());
+            co_return false;
+        }
+
+        for (std::size_t chunk_idx = 0; chunk_idx < file_context.total_chunks; ++chunk_idx) {
+            file_context.received_chunks.insert(chunk_idx);
+        }
+        completeFile(session, file_context, final_file_path);
+        co_return true;
+    } catch (const std::exception& e) {
+        spdlog::warn("Failed to save inline file {}: {}", file_context.file_name, e.what());
+        co_return false;
+    }
+}
+
+fs::path ReceiveController::resolveFinalPath(const ReceiveFileContext& file_context) {
+    // Files sent as part of a folder are placed under the same relative path
+    fs::path final_file_path = save_dir_
+                               / (file_context.relative_path.empty() ? file_context.file_name
+                                                                     : file_context.relative_path);
+    fs::path parent_dir = final_file_path.parent_path();
+    fs::create_directories(parent_dir);
+
+    // Add suffix if the file already exists
+    if (fs::exists(final_file_path)) {
+        std::string stem = final_file_path.stem().string();
+        std::string ext = final_file_path.extension().string();
+        int counter = 1;
+
+        // Check if the filename already has the format "name (n)"
+        std::regex pattern(R"((.*) \((\d+)\)$)");
+        std::smatch matches;
+
+        if (std::regex_match(stem, matches, pattern)) {
+            // If it matches "name (n)" format, extract the base name and number
+            stem = matches[1].str();
+            counter = std::stoi(matches[2].str()) + 1;
+        }
+
+        // Try new filenames with increasing counter
+        do {
+            std::string new_stem = stem + " (" + std::to_string(counter) + ")";
+            final_file_path = parent_dir / (new_stem + ext);
+            ++counter;
+        } while (fs::exists(final_file_path));
+    }
+    return final_file_path;
+}
+
+void ReceiveController::completeFile(ReceiveSessionContext& session,
+                                     ReceiveFileContext& file_context,
+                                     const fs::path& final_file_path) {
+    file_context.final_file_path = final_file_path;
+    chunk_index_.AddFile(final_file_path, file_context.chunk_size, file_context.chunk_checksums);
+
+    spdlog::info("File {} received successfully, saved as \"{}\"",
+                 file_context.file_name,
+                 final_file_path.string());
+
+    session.completed_file_count++;
+
+    // feedback file receiving completed
+    feedback(Feedback{
+        .type = FeedbackType::kFileReceivingCompleted,
+        .data = feedback::FileReceivingCompleted{
+            .session_id = session.session_id,
+            .filename = file_context.file_name,
+        },
+    });
+}
+
 void ReceiveController::installRoutes() {
     server_.AddRoute(ApiRoute::kRequestSend.data(),
                      http::verb::post,
                      std::bind(&ReceiveController::onRequestSend, this, std::placeholders::_1));
+    server_.AddRoute(ApiRoute::kWaitTurn.data(),
+                     http::verb::post,
+                     std::bind(&ReceiveController::onWaitTurn, this, std::placeholders::_1));
+    server_.AddRoute(ApiRoute::kCancelWait.data(),
+                     http::verb::post,
+                     std::bind(&ReceiveController::onCancelWait, this, std::placeholders::_1));
     server_.AddRoute(ApiRoute::kSendChunk.data(),
                      http::verb::post,
                      std::bind(&ReceiveController::onSendChunk, this, std::placeholders::_1));
+    server_.AddRoute(ApiRoute::kSendBatch.data(),
+                     http::verb::post,
+                     std::bind(&ReceiveController::onSendBatch, this, std::placeholders::_1));
+    server_.SetRouteBodyLimit(ApiRoute::kRequestSend.data(), transfer::kMaxRequestSendBodySize);
+    server_.SetRouteBodyLimit(ApiRoute::kSendChunk.data(), transfer::kMaxChunkBodySize);
+    server_.SetRouteBodyLimit(ApiRoute::kSendBatch.data(), transfer::kMaxBatchBodySize);
+    server_.SetRouteStreamedBody(ApiRoute::kSendChunk.data(),
+                                 transfer::kStreamedBodyThreshold,
+                                 std::bind(&ReceiveController::onSendChunkStream,
+                                           this,
+                                           std::placeholders::_1,
+                                           std::placeholders::_2,
+                                           std::placeholders::_3,
+                                           std::placeholders::_4));
+    for (auto route : {ApiRoute::kSendChunk, ApiRoute::kSendBatch}) {
+        server_.SetRoutePrecheck(route.data(),
+                                 std::bind(&ReceiveController::precheckUpload,
+                                           this,
+                                           std::placeholders::_1));
+    }
+    server_.AddUpgradeRoute(ApiRoute::kStream.data(),
+                            std::bind(&ReceiveController::onStream,
+                                      this,
+                                      std::placeholders::_1,
+                                      std::placeholders::_2,
+                                      std::placeholders::_3));
+    server_.AddRoute(ApiRoute::kUploadFile.data(),
+                     http::verb::post,
+                     StreamingRequestHandler(std::bind(&ReceiveController::onUploadFile,
+                                                       this,
+                                                       std::placeholders::_1,
+                                                       std::placeholders::_2,
+                                                       std::placeholders::_3,
+                                                       std::placeholders::_4)));
     server_.AddRoute(ApiRoute::kVerifyIntegrity.data(),
                      http::verb::post,
                      std::bind(&ReceiveController::onVerifyIntegrity, this, std::placeholders::_1));
+    server_.AddRoute(ApiRoute::kMulticastDone.data(),
+                     http::verb::post,
+                     std::bind(&ReceiveController::onMulticastDone, this, std::placeholders::_1));
     server_.AddRoute(ApiRoute::kCancelSend.data(),
                      http::verb::post,
                      std::bind(&ReceiveController::onCancelSend, this, std::placeholders::_1));
 }
 
-void ReceiveController::doCleanup() {
-    if (session_id_.empty() || received_files_.empty()) {
+void ReceiveController::doCleanup(const ReceiveSessionContext& session) {
+    // Files arrive over several connections, streams and multicast at once, any of them may be
+    // unfinished
+    for (const auto& [file_id, file_context] : session.received_files) {
+        std::error_code ec;
+        if (file_context.final_file_path.empty() && fs::remove(file_context.temp_file_path, ec)) {
+            spdlog::info("Cleaned up unfinished temp file of \"{}\"", file_context.file_name);
+        } else if (ec) {
+            spdlog::warn("Failed to remove temp file {}: {}",
+                         file_context.temp_file_path.string(),
+                         ec.message());
+        }
+    }
+}
+
+void ReceiveController::checkSessionCompletion(ReceiveSessionContext& session) {
+    if (session.status != ReceiveSessionStatus::kWorking) {
         return;
     }
-    for (const auto& [file_id, file_context] : received_files_) {
-        if (fs::exists(file_context.temp_file_path)) {
-            spdlog::info("Cleaning up unfinished temp file of \"{}\"", file_context.file_name);
-            fs::remove(file_context.temp_file_path);
+    if (!session.received_files.empty()
+        && session.completed_file_count == session.received_files.size()) {
+        spdlog::info("All files in session {} have been received successfully.",
+                     session.session_id);
+        endSession(session);
 
-            // Since the files are sent in order, we can assume that the last file is the one
-            // that was being sent when the session was cancelled
-            break;
+        // feedback session completeds
+        feedback(Feedback{
+            .type = FeedbackType::kReceiveSessionEnded,
+            .data = feedback::ReceiveSessionEnd{
+                .session_id = session.session_id,
+                .success = true,
+            },
+        });
+    } else {
+        spdlog::info("Session {} is still in progress.", session.session_id);
+    }
+}
+
+ReceiveController::SessionPtr ReceiveController::findSession(std::string_view session_id) const {
+    if (auto iter = sessions_.find(std::string(session_id)); iter != sessions_.end()) {
+        return iter->second;
+    }
+    return nullptr;
+}
+
+bool ReceiveController::pollReceiverCancel() {
+    if (!cancel_condition_ || !cancel_condition_()) {
+        return false;
+    }
+    for (auto& [session_id, session] : sessions_) {
+        if (endSession(*session)) {
+            session->cancelled_by_receiver = true;
         }
     }
+    return true;
 }
 
-void ReceiveController::checkSessionCompletion() {
-    if (!session_id_.empty()) {
-        if (!received_files_.empty() && completed_file_count_ == received_files_.size()) {
-            spdlog::info("All files in session {} have been received successfully.", session_id_);
-            resetToIdle();
+std::optional<HttpResponse> ReceiveController::checkSession(const SessionPtr& session,
+                                                            unsigned int version,
+                                                            bool keep_alive) {
+    if (!session) {
+        return HttpServer::Forbidden(version, keep_alive, "invalid session");
+    }
+    if (session->status != ReceiveSessionStatus::kWorking) {
+        return HttpServer::Forbidden(version,
+                                     keep_alive,
+                                     session->cancelled_by_receiver ? "receiver cancelled"
+                                                                    : "sender cancelled");
+    }
+    return std::nullopt;
+}
 
-            // feedback session completeds
-            feedback(Feedback{
-                .type = FeedbackType::kReceiveSessionEnded,
-                .data = feedback::ReceiveSessionEnd{
-                    .session_id = session_id_,
-                    .success = true,
-                },
-            });
-        } else {
-            spdlog::info("Session {} is still in progress.", session_id_);
+bool ReceiveController::endSession(ReceiveSessionContext& session) {
+    if (session.status == ReceiveSessionStatus::kIdle) {
+        return false;
+    }
+    doCleanup(session);
+    chunk_index_.Save();
+    session.status = ReceiveSessionStatus::kIdle;
+    session.ended_at = std::chrono::steady_clock::now();
+    if (auto it = bandwidth_flows_.find(session.session_id); it != bandwidth_flows_.end()) {
+        const auto& flow = *it->second;
+        if (flow.target_rate() > 0.0) {
+            spdlog::info("Session {}: {:.2f} MB/s received for a target of {:.2f} MB/s, {:.2f}s "
+                         "throttled",
+                         session.session_id,
+                         flow.actual_rate() / (1024.0 * 1024.0),
+                         flow.target_rate() / (1024.0 * 1024.0),
+                         flow.throttled_seconds());
         }
+        bandwidth_flows_.erase(it);
+    }
+    if (auto it = multicast_receivers_.find(session.session_id); it != multicast_receivers_.end()) {
+        it->second->Close();
+        multicast_receivers_.erase(it);
+    }
+    // The first queued request can take the session's place
+    notifyQueue();
+    return true;
+}
+
+void ReceiveController::failSession(ReceiveSessionContext& session,
+                                    std::string_view error_message) {
+    if (!endSession(session)) {
+        return;
     }
+
+    // feedback session failed
+    feedback(Feedback{
+        .type = FeedbackType::kReceiveSessionEnded,
+        .data = feedback::ReceiveSessionEnd{
+            .session_id = session.session_id,
+            .success = false,
+            .error_message = std::string(error_message),
+        },
+    });
 }
 
 void ReceiveController::resetToIdle() {
-    doCleanup();
-    session_id_.clear();
-    session_status_ = ReceiveSessionStatus::kIdle;
-    received_files_.clear();
-    completed_file_count_ = 0;
-    sender_ip_.clear();
-    sender_port_ = 0;
+    for (auto& [session_id, session] : sessions_) {
+        endSession(*session);
+    }
 }
 
-} // namespace lansend::core
\ No newline at end of file
+} // namespace lansend::core
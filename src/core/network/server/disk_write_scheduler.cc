@@ -0,0 +1,87 @@
+#include <boost/asio/post.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <core/network/server/disk_write_scheduler.h>
+
+namespace net = boost::asio;
+
+namespace lansend::core {
+
+DiskWriteScheduler::DiskWriteScheduler(net::io_context& ioc)
+    : ioc_(ioc) {}
+
+std::shared_ptr<DiskWriteScheduler> DiskWriteScheduler::Create(net::io_context& ioc) {
+    return std::shared_ptr<DiskWriteScheduler>(new DiskWriteScheduler(ioc));
+}
+
+DiskWriteScheduler::~DiskWriteScheduler() {
+    pool_.join();
+}
+
+net::awaitable<void> DiskWriteScheduler::Write(const std::string& session_id,
+                                               std::function<void()> write) {
+    auto self = shared_from_this();
+    auto job = std::make_shared<Job>(Job{
+        .write = std::move(write),
+        .finished = net::steady_timer(ioc_, net::steady_timer::time_point::max()),
+    });
+
+    auto& queue = queued_[session_id];
+    if (queue.empty()) {
+        turns_.push_back(session_id);
+    }
+    queue.push_back(job);
+    if (busy_) {
+        ++waits_;
+    }
+    schedule();
+
+    while (!job->done) {
+        boost::system::error_code ec;
+        co_await job->finished.async_wait(net::redirect_error(net::use_awaitable, ec));
+    }
+    ++writes_;
+    if (job->error) {
+        std::rethrow_exception(job->error);
+    }
+}
+
+void DiskWriteScheduler::schedule() {
+    if (busy_ || turns_.empty()) {
+        return;
+    }
+
+    // The session goes to the back of the line if it has more writes queued
+    auto session_id = std::move(turns_.front());
+    turns_.pop_front();
+    auto& queue = queued_.at(session_id);
+    auto job = std::move(queue.front());
+    queue.pop_front();
+    if (queue.empty()) {
+        queued_.erase(session_id);
+    } else {
+        turns_.push_back(std::move(session_id));
+    }
+
+    busy_ = true;
+    // The disk thread never holds the scheduler, whose destructor joins it
+    net::post(pool_, [weak = weak_from_this(), &ioc = ioc_, job]() {
+        try {
+            job->write();
+        } catch (...) {
+            job->error = std::current_exception();
+        }
+        // Queue state is only touched on the io_context's thread, the scheduler may be gone by
+        // the time the completion runs there
+        net::post(ioc, [weak, job]() {
+            job->done = true;
+            job->finished.cancel();
+            if (auto self = weak.lock()) {
+                self->busy_ = false;
+                self->schedule();
+            }
+        });
+    });
+}
+
+} // namespace lansend::core
@@ -1,6 +1,8 @@
 
 #include "core/security/open_ssl_provider.h"
 #include "spdlog/spdlog.h"
+#include <algorithm>
+#include <array>
 #include <boost/asio/co_spawn.hpp>
 #include <boost/asio/detached.hpp>
 #include <boost/asio/error.hpp>
@@ -16,6 +18,9 @@
 #include <core/network/server/controller/common_controller.h>
 #include <core/network/server/controller/receive_controller.h>
 #include <core/network/server/http_server.h>
+#include <deque>
+#include <limits>
+#include <tuple>
 
 namespace lansend::core {
 
@@ -28,14 +33,151 @@ namespace net = boost::asio;
 namespace ssl = net::ssl;
 using tcp = net::ip::tcp;
 
-HttpServer::HttpServer(boost::asio::io_context& io_context, CertificateManager& cert_manager)
+namespace {
+
+// Responses owed on one connection, in request order. Handlers of requests read ahead fill in
+// their slot whenever they finish, the writer sends the responses as soon as all before them
+// are out.
+class ResponsePipeline {
+public:
+    explicit ResponsePipeline(const net::any_io_executor& executor)
+        : ready_(executor, net::steady_timer::time_point::max())
+        , space_(executor, net::steady_timer::time_point::max()) {}
+
+    std::size_t size() const { return slots_.size(); }
+
+    bool writer_done() const { return writer_done_; }
+
+    // Set while the next request is read without a timeout because responses are owed
+    void SetUntimedRead(bool untimed) { untimed_read_ = untimed; }
+
+    // Reserve the slot of the next response
+    std::uint64_t Reserve() {
+        slots_.emplace_back();
+        return first_slot_ + slots_.size() - 1;
+    }
+
+    void Fulfill(std::uint64_t slot, HttpResponse res) {
+        // The slots are dropped when the connection failed
+        if (slot >= first_slot_ && slot - first_slot_ < slots_.size()) {
+            slots_[slot - first_slot_] = std::move(res);
+            ready_.cancel();
+        }
+    }
+
+    // Wait until fewer than `limit` responses are owed or the writer stopped
+    net::awaitable<void> WaitForSpace(std::size_t limit) {
+        while (slots_.size() >= limit && !writer_done_) {
+            co_await wait(space_);
+        }
+    }
+
+    // No more requests follow, the writer stops once the owed responses are sent
+    void Close() {
+        closed_ = true;
+        ready_.cancel();
+    }
+
+    net::awaitable<void> WaitForWriter() {
+        while (!writer_done_) {
+            co_await wait(space_);
+        }
+    }
+
+    // Shares the stream, the reader may be gone before the owed responses are sent
+    net::awaitable<void> RunWriter(std::shared_ptr<SslStream> owned_stream) {
+        SslStream& stream = *owned_stream;
+        try {
+            while (true) {
+                if (!slots_.empty() && slots_.front()) {
+                    HttpResponse res = std::move(*slots_.front());
+                    slots_.pop_front();
+                    ++first_slot_;
+                    space_.cancel();
+
+                    // Only the write timeout is set while the reader waits for the next request
+                    beast::get_lowest_layer(stream).expires_after(HttpServer::kIdleTimeout);
+                    co_await http::async_write(stream, res, net::use_awaitable);
+                    if (!res.keep_alive()) {
+                        // Stop the reader as well
+                        beast::get_lowest_layer(stream).cancel();
+                        break;
+                    }
+                    continue;
+                }
+                if (closed_ && slots_.empty()) {
+                    break;
+                }
+
+                if (slots_.empty() && untimed_read_) {
+                    // Nothing owed anymore, give the client the idle timeout to send more
+                    ready_.expires_after(HttpServer::kIdleTimeout);
+                    bool notified = co_await wait(ready_);
+                    ready_.expires_at(net::steady_timer::time_point::max());
+                    if (!notified && slots_.empty() && untimed_read_) {
+                        spdlog::debug("Closing idle connection");
+                        beast::get_lowest_layer(stream).cancel();
+                        break;
+                    }
+                    continue;
+                }
+                co_await wait(ready_);
+            }
+        } catch (const boost::system::system_error& e) {
+            spdlog::debug("Failed to write response: {}", e.code().message());
+            beast::get_lowest_layer(stream).cancel();
+        }
+
+        writer_done_ = true;
+        slots_.clear();
+        space_.cancel();
+    }
+
+private:
+    // Returns true if woken up by cancel(), false if the timer expired
+    static net::awaitable<bool> wait(net::steady_timer& timer) {
+        beast::error_code ec;
+        co_await timer.async_wait(net::redirect_error(net::use_awaitable, ec));
+        co_return ec == net::error::operation_aborted;
+    }
+
+    net::steady_timer ready_; // Cancelled when a response is ready or the reader is done
+    net::steady_timer space_; // Cancelled when a response was sent or the writer is done
+    std::deque<std::optional<HttpResponse>> slots_;
+    std::uint64_t first_slot_ = 0;
+    bool untimed_read_ = false;
+    bool closed_ = false;
+    bool writer_done_ = false;
+};
+
+// Closes the pipeline however the reader ends, the writer would wait for more requests otherwise
+class PipelineCloser {
+public:
+    explicit PipelineCloser(std::shared_ptr<ResponsePipeline> pipeline)
+        : pipeline_(std::move(pipeline)) {}
+    ~PipelineCloser() { pipeline_->Close(); }
+
+    PipelineCloser(const PipelineCloser&) = delete;
+    PipelineCloser& operator=(const PipelineCloser&) = delete;
+
+private:
+    std::shared_ptr<ResponsePipeline> pipeline_;
+};
+
+} // namespace
+
+HttpServer::HttpServer(boost::asio::io_context& io_context,
+                       CertificateManager& cert_manager,
+                       std::shared_ptr<BandwidthScheduler> bandwidth)
     : io_context_(io_context)
     , cert_manager_(cert_manager)
     , ssl_context_(
           OpenSSLProvider::BuildServerContext(cert_manager_.security_context().certificate_pem,
                                               cert_manager_.security_context().private_key_pem))
     , acceptor_(io_context)
-    , running_(false) {
+    , running_(false)
+    , memory_budget_(io_context, transfer::kServerMemoryBudget)
+    , bandwidth_(bandwidth ? std::move(bandwidth) : BandwidthScheduler::Create(io_context)) {
     common_controller_ = std::make_unique<CommonController>(*this);
     receive_controller_ = std::make_unique<ReceiveController>(*this);
     spdlog::info("HttpServer created.");
@@ -62,6 +204,49 @@ void HttpServer::AddRoute(const std::string& path,
     spdlog::info(std::format("Added route: {} {}", std::string(http::to_string(method)), path));
 }
 
+void HttpServer::AddRoute(const std::string& path,
+                          boost::beast::http::verb method,
+                          StreamingRequestHandler&& handler) {
+    routes_[path] = {method, RequestType::kStreaming, std::move(handler)};
+    // Streaming handlers read as much as they accept themselves
+    routes_[path].body_limit = std::numeric_limits<std::size_t>::max();
+    spdlog::info(std::format("Added streaming route: {} {}",
+                             std::string(http::to_string(method)),
+                             path));
+}
+
+void HttpServer::SetRoutePrecheck(const std::string& path, RequestPrecheck&& precheck) {
+    if (auto it = routes_.find(path); it != routes_.end()) {
+        it->second.precheck = std::move(precheck);
+    } else {
+        spdlog::warn("Can't set precheck for unknown route {}", path);
+    }
+}
+
+void HttpServer::SetRouteBodyLimit(const std::string& path, std::size_t body_limit) {
+    if (auto it = routes_.find(path); it != routes_.end()) {
+        it->second.body_limit = body_limit;
+    } else {
+        spdlog::warn("Can't set body limit for unknown route {}", path);
+    }
+}
+
+void HttpServer::SetRouteStreamedBody(const std::string& path,
+                                      std::size_t threshold,
+                                      StreamingRequestHandler&& handler) {
+    if (auto it = routes_.find(path); it != routes_.end()) {
+        it->second.streamed_body_threshold = threshold;
+        it->second.streamed_body_handler = std::move(handler);
+    } else {
+        spdlog::warn("Can't set streamed body handler for unknown route {}", path);
+    }
+}
+
+void HttpServer::AddUpgradeRoute(const std::string& path, UpgradeHandler&& handler) {
+    upgrade_routes_[path] = std::move(handler);
+    spdlog::info(std::format("Added upgrade route: {}", path));
+}
+
 void HttpServer::Start(uint16_t port) {
     if (running_) {
         spdlog::warn("Server is already running.");
@@ -122,6 +307,15 @@ HttpResponse HttpServer::Ok(unsigned int version, bool keep_alive, std::string_v
     return res;
 }
 
+HttpResponse HttpServer::Accepted(unsigned int version, bool keep_alive, std::string_view body) {
+    HttpResponse res{http::status::accepted, version};
+    res.keep_alive(keep_alive);
+    res.set(http::field::content_type, "application/json");
+    res.body() = body;
+    res.prepare_payload();
+    return res;
+}
+
 HttpResponse HttpServer::NotFound(unsigned int version,
                                   bool keep_alive,
                                   std::string_view error_message) {
@@ -177,6 +371,35 @@ HttpResponse HttpServer::MethodNotAllowed(unsigned int version,
     return res;
 }
 
+HttpResponse HttpServer::UnprocessableEntity(unsigned int version,
+                                             bool keep_alive,
+                                             std::string_view error_message) {
+    HttpResponse res{http::status::unprocessable_entity, version};
+    res.keep_alive(keep_alive);
+    res.set(http::field::content_type, "text/plain");
+    res.body() = error_message;
+    res.prepare_payload();
+    return res;
+}
+
+HttpResponse HttpServer::PayloadTooLarge(unsigned int version,
+                                         bool keep_alive,
+                                         std::string_view error_message) {
+    HttpResponse res{http::status::payload_too_large, version};
+    res.keep_alive(keep_alive);
+    res.set(http::field::content_type, "text/plain");
+    res.body() = error_message;
+    res.prepare_payload();
+    return res;
+}
+
+HttpResponse HttpServer::SwitchingProtocols(unsigned int version, std::string_view protocol) {
+    HttpResponse res{http::status::switching_protocols, version};
+    res.set(http::field::connection, "Upgrade");
+    res.set(http::field::upgrade, protocol);
+    return res;
+}
+
 boost::asio::awaitable<void> HttpServer::acceptConnections() {
     while (running_) {
         try {
@@ -202,7 +425,11 @@ boost::asio::awaitable<void> HttpServer::acceptConnections() {
     spdlog::info("Stopped accepting connections.");
 }
 
-boost::asio::awaitable<void> HttpServer::handleConnection(ssl::stream<beast::tcp_stream> stream) {
+boost::asio::awaitable<void> HttpServer::handleConnection(
+    ssl::stream<beast::tcp_stream> connection) {
+    // The response writer holds the stream too, it may still be writing when an error ends this
+    auto shared_stream = std::make_shared<SslStream>(std::move(connection));
+    auto& stream = *shared_stream;
     try {
         auto& socket = stream.next_layer().socket();
         auto endpoint = socket.remote_endpoint();
@@ -212,27 +439,192 @@ boost::asio::awaitable<void> HttpServer::handleConnection(ssl::stream<beast::tcp
         co_await stream.async_handshake(ssl::stream_base::server, net::use_awaitable);
         spdlog::debug("SSL handshake completed successfully");
 
+        auto executor = co_await net::this_coro::executor;
+        auto pipeline = std::make_shared<ResponsePipeline>(executor);
+        PipelineCloser closer(pipeline);
+        net::co_spawn(executor, pipeline->RunWriter(shared_stream), net::detached);
+
+        // Kept across the requests of the connection, bytes read ahead stay in the buffer
         beast::flat_buffer buffer;
-        bool keep_alive = true;
+        std::optional<http::request_parser<http::vector_body<uint8_t>>> parser;
 
-        while (keep_alive) {
+        while (!pipeline->writer_done()) {
             try {
-                beast::get_lowest_layer(stream).expires_after(std::chrono::seconds(30));
+                // Read ahead while earlier requests are handled, up to kMaxPipelinedRequests
+                co_await pipeline->WaitForSpace(kMaxPipelinedRequests);
+                if (pipeline->writer_done()) {
+                    break;
+                }
+
+                // Connections owing a response aren't idle, the writer times them out once
+                // they are
+                if (pipeline->size() == 0) {
+                    beast::get_lowest_layer(stream).expires_after(kIdleTimeout);
+                } else {
+                    beast::get_lowest_layer(stream).expires_never();
+                    pipeline->SetUntimedRead(true);
+                }
 
-                http::request_parser<http::vector_body<uint8_t>> parser;
-                parser.body_limit(transfer::kMaxChunkSize + 8);
+                // Beast parsers handle a single message, a fresh one is emplaced in place
+                parser.emplace();
 
                 spdlog::debug("Waiting for client request...");
-                co_await http::async_read(stream, buffer, parser);
-                auto req = parser.release();
+                co_await http::async_read_header(stream, buffer, *parser);
+                pipeline->SetUntimedRead(false);
+                beast::get_lowest_layer(stream).expires_after(kIdleTimeout);
+
+                std::string_view target = parser->get().target();
+                auto route = routes_.find(target);
+                bool matched = route != routes_.end()
+                               && route->second.method == parser->get().method();
+                bool expects_continue = beast::iequals(parser->get()[http::field::expect],
+                                                       "100-continue");
+                bool upgrade = http::token_list{parser->get()[http::field::connection]}.exists(
+                                   "upgrade")
+                               && upgrade_routes_.contains(target);
+
+                std::size_t body_limit = matched ? route->second.body_limit
+                                                 : transfer::kDefaultBodyLimit;
+                parser->body_limit(body_limit);
+                std::size_t body_size = parser->chunked() ? body_limit
+                                                          : parser->content_length().value_or(0);
+                // Large bodies of routes that can take them piece by piece aren't buffered,
+                // chunked ones have no size to decide by and keep the buffered path
+                bool stream_body = matched && route->second.streamed_body_handler
+                                   && !parser->chunked()
+                                   && body_size > route->second.streamed_body_threshold;
+
+                // Requests that write to the connection themselves wait for the responses
+                // before them. Prechecked ones only do so for 100 Continue, their rejection
+                // otherwise takes its place in the pipeline.
+                bool exclusive = expects_continue || upgrade || stream_body
+                                 || (matched && route->second.type == RequestType::kStreaming);
+                if (exclusive) {
+                    co_await pipeline->WaitForSpace(1);
+                    if (pipeline->writer_done()) {
+                        break;
+                    }
+                }
 
-                spdlog::info("Received {} request for {}", req.method_string(), req.target());
+                // Reject requests the handler would refuse anyway before their body arrives
+                if (matched && route->second.precheck) {
+                    if (auto rejection = route->second.precheck(parser->get())) {
+                        spdlog::info("Rejected {} request for {} before reading its body",
+                                     parser->get().method_string(),
+                                     parser->get().target());
+                        if (expects_continue) {
+                            // The client holds the body back until told to send it
+                            rejection->keep_alive(false);
+                            co_await http::async_write(stream, *rejection);
+                            break;
+                        }
+                        bool keep_alive = rejection->keep_alive();
+                        auto discarded = co_await discardBody(std::move(*parser), stream, buffer);
+                        discarded_body_bytes_ += discarded;
+                        spdlog::info("Discarded {} body bytes of the rejected request", discarded);
+                        pipeline->Fulfill(pipeline->Reserve(), std::move(*rejection));
+                        if (!keep_alive) {
+                            break;
+                        }
+                        continue;
+                    }
+                }
+                if (!parser->chunked() && body_size > body_limit) {
+                    spdlog::warn("Refused {} byte body of {} request for {}",
+                                 body_size,
+                                 parser->get().method_string(),
+                                 parser->get().target());
+                    // After the responses still owed, the connection closes with it
+                    pipeline->Fulfill(pipeline->Reserve(),
+                                      PayloadTooLarge(parser->get().version(), false));
+                    break;
+                }
+
+                // Hold the body's memory before reading it. While the server is short on memory
+                // the body stays unread in the socket.
+                bool streamed = stream_body
+                                || (matched && route->second.type == RequestType::kStreaming);
+                MemoryReservation reservation;
+                if (body_size > 0) {
+                    reservation = co_await memory_budget_.Reserve(
+                        streamed ? transfer::kStreamedBodyReservation : body_size);
+                    beast::get_lowest_layer(stream).expires_after(kIdleTimeout);
+                }
+
+                if (expects_continue) {
+                    http::response<http::empty_body> proceed{http::status::continue_,
+                                                             parser->get().version()};
+                    co_await http::async_write(stream, proceed);
+                }
 
-                keep_alive = req.keep_alive();
+                // Streaming routes, and large bodies of routes that take them in pieces, are
+                // consumed by the handler itself
+                if (streamed) {
+                    spdlog::info("Received {} request for {}",
+                                 parser->get().method_string(),
+                                 parser->get().target());
+                    BodyStreamParser body_parser(std::move(*parser));
+                    if (!stream_body) {
+                        body_parser.body_limit(boost::none);
+                    }
+                    beast::get_lowest_layer(stream).expires_never();
+
+                    auto& handler = stream_body
+                                        ? route->second.streamed_body_handler
+                                        : std::get<StreamingRequestHandler>(route->second.handler);
+                    auto start = std::chrono::steady_clock::now();
+                    HttpResponse res = co_await handler(body_parser, stream, buffer, reservation);
+                    recordLatency(route->second, std::chrono::steady_clock::now() - start);
+                    bool keep_alive = res.keep_alive() && body_parser.is_done();
+                    res.keep_alive(keep_alive);
+                    co_await http::async_write(stream, res);
+                    if (!keep_alive) {
+                        break;
+                    }
+                    continue;
+                }
 
-                HttpResponse res = co_await handleRequest(std::move(req));
+                spdlog::info("Received {} request for {}",
+                             parser->get().method_string(),
+                             parser->get().target());
+                bool keep_alive = parser->get().keep_alive();
+
+                // String routes get their body read straight into a string
+                IncomingRequest request;
+                if (matched && route->second.type == RequestType::kString) {
+                    http::request_parser<http::string_body> string_parser(std::move(*parser));
+                    co_await http::async_read(stream, buffer, string_parser);
+                    request = string_parser.release();
+                } else {
+                    co_await http::async_read(stream, buffer, *parser);
+                    request = parser->release();
+                }
+
+                // The upgrade handler owns the connection from here on
+                if (upgrade) {
+                    auto it = upgrade_routes_.find(target);
+                    beast::get_lowest_layer(stream).expires_never();
+                    if (!co_await it->second(std::get<BinaryRequest>(std::move(request)),
+                                             stream,
+                                             buffer)) {
+                        break;
+                    }
+                    continue;
+                }
 
-                co_await http::async_write(stream, res);
+                // The response is written by the pipeline's writer once the ones before it are,
+                // the body's memory is handed back along with the request
+                auto slot = pipeline->Reserve();
+                net::co_spawn(
+                    executor,
+                    [this,
+                     pipeline,
+                     slot,
+                     request = std::move(request),
+                     reservation = std::move(reservation)]() mutable -> net::awaitable<void> {
+                        pipeline->Fulfill(slot, co_await handleRequest(std::move(request)));
+                    },
+                    net::detached);
 
                 if (!keep_alive) {
                     spdlog::debug("Connection: close requested, ending session");
@@ -240,26 +632,23 @@ boost::asio::awaitable<void> HttpServer::handleConnection(ssl::stream<beast::tcp
                 }
             } catch (const boost::system::system_error& e) {
                 // Notify the receiver if the sender is lost
-                if (receive_controller_->session_status() == ReceiveSessionStatus::kWorking) {
-                    if (receive_controller_->sender_ip() == endpoint_ip_str
-                        && receive_controller_->sender_port() == endpoint.port()) {
-                        spdlog::error("Lost connection to sender {}:{} while receiving file",
-                                      endpoint_ip_str,
-                                      endpoint.port());
-                        receive_controller_->NotifySenderLost();
-                    }
-                }
+                receive_controller_->NotifySenderLost(endpoint_ip_str, endpoint.port());
 
                 if (e.code() == boost::beast::error::timeout || e.code() == boost::asio::error::eof
                     || e.code() == boost::asio::error::operation_aborted
                     || e.code() == boost::beast::http::error::end_of_stream) {
                     spdlog::debug("Connection closed by peer: {}", e.code().message());
-                    break;
+                } else {
+                    spdlog::error("Session error: {}", e.what());
                 }
-                throw e;
+                break;
             }
         }
 
+        // Let the writer send what is still owed before the connection goes
+        pipeline->Close();
+        co_await pipeline->WaitForWriter();
+
         spdlog::debug("Closing connection gracefully");
         beast::error_code ec;
         stream.shutdown(ec);
@@ -279,57 +668,91 @@ boost::asio::awaitable<void> HttpServer::handleConnection(ssl::stream<beast::tcp
     spdlog::info("Connection handling finished.");
 }
 
-boost::asio::awaitable<HttpResponse> HttpServer::handleRequest(HttpRequest&& req) {
-    std::string path(req.target());
+boost::asio::awaitable<HttpResponse> HttpServer::handleRequest(IncomingRequest request) {
+    auto [method, path, version, keep_alive] = std::visit(
+        [](const auto& req) {
+            return std::tuple{req.method(),
+                              std::string_view(req.target()),
+                              req.version(),
+                              req.keep_alive()};
+        },
+        request);
     auto it = routes_.find(path);
 
     if (it == routes_.end()) {
-        spdlog::warn(std::format("Route not found: {}", path));
-        co_return NotFound(req.version(), req.keep_alive());
+        spdlog::warn("Route not found: {}", path);
+        co_return NotFound(version, keep_alive);
     }
 
-    const auto& route_info = it->second;
-    if (route_info.method != req.method()) {
-        spdlog::warn(std::format("Method not allowed for route {}: requested {}, expected {}",
-                                 path,
-                                 std::string(http::to_string(req.method())),
-                                 std::string(http::to_string(route_info.method))));
-        co_return MethodNotAllowed(req.version(), req.keep_alive());
+    auto& route_info = it->second;
+    if (route_info.method != method) {
+        spdlog::warn("Method not allowed for route {}: requested {}, expected {}",
+                     path,
+                     std::string_view(http::to_string(method)),
+                     std::string_view(http::to_string(route_info.method)));
+        co_return MethodNotAllowed(version, keep_alive);
     }
 
-    auto request_version = req.version();
-    bool request_keep_alive = req.keep_alive();
-
+    auto start = std::chrono::steady_clock::now();
     try {
         HttpResponse res;
         if (route_info.type == RequestType::kString) {
-            auto handler = std::get<StringRequestHandler>(route_info.handler);
-            res = co_await handler(binaryToStringRequest(req));
+            auto& handler = std::get<StringRequestHandler>(route_info.handler);
+            res = co_await handler(std::get<StringRequest>(request));
         } else {
-            auto handler = std::get<BinaryRequestHandler>(route_info.handler);
-            res = co_await handler(std::move(req));
+            auto& handler = std::get<BinaryRequestHandler>(route_info.handler);
+            res = co_await handler(std::get<BinaryRequest>(request));
         }
+        recordLatency(route_info, std::chrono::steady_clock::now() - start);
         co_return res;
     } catch (const std::exception& e) {
-        spdlog::error(std::format("Error executing handler for {}: {}", path, e.what()));
-        co_return InternalServerError(request_version, request_keep_alive, e.what());
+        spdlog::error("Error executing handler for {}: {}", path, e.what());
+        recordLatency(route_info, std::chrono::steady_clock::now() - start);
+        co_return InternalServerError(version, keep_alive, e.what());
     }
 }
 
-StringRequest HttpServer::binaryToStringRequest(const BinaryRequest& req) {
-    http::request<http::string_body> string_req;
-    string_req.method(req.method());
-    string_req.target(req.target());
-    string_req.version(req.version());
+void HttpServer::recordLatency(RouteInfo& route, std::chrono::steady_clock::duration latency) {
+    auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(latency);
+    route.stats.requests++;
+    route.stats.total_latency += nanoseconds;
+    route.stats.max_latency = std::max(route.stats.max_latency, nanoseconds);
+}
 
-    for (auto const& field : req)
-        string_req.set(field.name(), field.value());
+std::vector<std::pair<std::string, RouteStats>> HttpServer::GetRouteStats() const {
+    std::vector<std::pair<std::string, RouteStats>> stats;
+    stats.reserve(routes_.size());
+    for (const auto& [path, route] : routes_) {
+        stats.emplace_back(path, route.stats);
+    }
+    std::ranges::sort(stats, {}, &std::pair<std::string, RouteStats>::first);
+    return stats;
+}
+
+net::awaitable<std::size_t> HttpServer::discardBody(
+    http::request_parser<http::vector_body<uint8_t>>&& parser,
+    SslStream& stream,
+    beast::flat_buffer& buffer) {
+    // Keeps the route's body limit
+    BodyStreamParser body_parser(std::move(parser));
 
-    std::string body_str(reinterpret_cast<const char*>(req.body().data()), req.body().size());
-    string_req.body() = std::move(body_str);
-    string_req.prepare_payload();
+    std::array<std::uint8_t, 64 * 1024> scratch;
+    std::size_t discarded = 0;
+    while (!body_parser.is_done()) {
+        body_parser.get().body().data = scratch.data();
+        body_parser.get().body().size = scratch.size();
 
-    return string_req;
+        beast::error_code ec;
+        co_await http::async_read(stream,
+                                  buffer,
+                                  body_parser,
+                                  net::redirect_error(net::use_awaitable, ec));
+        if (ec && ec != http::error::need_buffer) {
+            throw boost::system::system_error(ec);
+        }
+        discarded += scratch.size() - body_parser.get().body().size;
+    }
+    co_return discarded;
 }
 
 } // namespace lansend::core
\ No newline at end of file
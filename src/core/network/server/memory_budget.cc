@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <core/network/server/memory_budget.h>
+#include <spdlog/spdlog.h>
+#include <utility>
+
+namespace net = boost::asio;
+
+namespace lansend::core {
+
+MemoryReservation::MemoryReservation(MemoryBudget* budget, std::size_t size)
+    : budget_(budget)
+    , size_(size) {}
+
+MemoryReservation::~MemoryReservation() {
+    Release();
+}
+
+MemoryReservation::MemoryReservation(MemoryReservation&& other) noexcept
+    : budget_(std::exchange(other.budget_, nullptr))
+    , size_(std::exchange(other.size_, 0)) {}
+
+MemoryReservation& MemoryReservation::operator=(MemoryReservation&& other) noexcept {
+    if (this != &other) {
+        Release();
+        budget_ = std::exchange(other.budget_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+}
+
+void MemoryReservation::Release() {
+    if (budget_ != nullptr) {
+        budget_->release(size_);
+        budget_ = nullptr;
+        size_ = 0;
+    }
+}
+
+MemoryBudget::MemoryBudget(net::io_context& ioc, std::size_t capacity)
+    : capacity_(capacity)
+    , released_(ioc, net::steady_timer::time_point::max()) {}
+
+net::awaitable<MemoryReservation> MemoryBudget::Reserve(std::size_t size) {
+    if (used_ > 0 && used_ + size > capacity_) {
+        ++waits_;
+        spdlog::debug("Waiting for {} bytes of request memory, {} of {} in use",
+                      size,
+                      used_,
+                      capacity_);
+        while (used_ > 0 && used_ + size > capacity_) {
+            boost::system::error_code ec;
+            co_await released_.async_wait(net::redirect_error(net::use_awaitable, ec));
+        }
+    }
+
+    used_ += size;
+    peak_ = std::max(peak_, used_);
+    co_return MemoryReservation(this, size);
+}
+
+net::awaitable<void> MemoryBudget::Grow(MemoryReservation& reservation, std::size_t size) {
+    if (size <= reservation.size_) {
+        co_return;
+    }
+    std::size_t extra = size - reservation.size_;
+    if (reservation.budget_ == this && (used_ == reservation.size_ || used_ + extra <= capacity_)) {
+        used_ += extra;
+        peak_ = std::max(peak_, used_);
+        reservation.size_ = size;
+        co_return;
+    }
+
+    reservation.Release();
+    reservation = co_await Reserve(size);
+}
+
+void MemoryBudget::release(std::size_t size) {
+    used_ -= size;
+    released_.cancel();
+}
+
+} // namespace lansend::core
@@ -0,0 +1,90 @@
+#include <core/network/stream/stream_frame.h>
+#include <cstring>
+
+namespace lansend::core {
+
+namespace {
+
+void PutUint32(std::uint8_t* out, std::uint32_t value) {
+    out[0] = static_cast<std::uint8_t>(value >> 24);
+    out[1] = static_cast<std::uint8_t>(value >> 16);
+    out[2] = static_cast<std::uint8_t>(value >> 8);
+    out[3] = static_cast<std::uint8_t>(value);
+}
+
+void PutUint64(std::uint8_t* out, std::uint64_t value) {
+    PutUint32(out, static_cast<std::uint32_t>(value >> 32));
+    PutUint32(out + 4, static_cast<std::uint32_t>(value));
+}
+
+std::uint32_t GetUint32(const std::uint8_t* in) {
+    return (static_cast<std::uint32_t>(in[0]) << 24) | (static_cast<std::uint32_t>(in[1]) << 16)
+           | (static_cast<std::uint32_t>(in[2]) << 8) | static_cast<std::uint32_t>(in[3]);
+}
+
+std::uint64_t GetUint64(const std::uint8_t* in) {
+    return (static_cast<std::uint64_t>(GetUint32(in)) << 32) | GetUint32(in + 4);
+}
+
+constexpr std::size_t kChecksumSize = 64;
+
+} // namespace
+
+std::array<std::uint8_t, kFrameHeaderSize> EncodeFrameHeader(const FrameHeader& header) {
+    std::array<std::uint8_t, kFrameHeaderSize> data{};
+    data[0] = static_cast<std::uint8_t>(header.type);
+    data[1] = header.flags;
+    PutUint32(data.data() + 4, header.stream_id);
+    PutUint32(data.data() + 8, header.length);
+    return data;
+}
+
+FrameHeader DecodeFrameHeader(std::span<const std::uint8_t, kFrameHeaderSize> data) {
+    return FrameHeader{
+        .type = static_cast<FrameType>(data[0]),
+        .flags = data[1],
+        .stream_id = GetUint32(data.data() + 4),
+        .length = GetUint32(data.data() + 8),
+    };
+}
+
+std::array<std::uint8_t, kDataFrameInfoSize> EncodeDataFrameInfo(const DataFrameInfo& info) {
+    std::array<std::uint8_t, kDataFrameInfoSize> data{};
+    PutUint64(data.data(), info.chunk_index);
+    data[8] = static_cast<std::uint8_t>(info.compression);
+    PutUint32(data.data() + 12, info.uncompressed_size);
+    std::memcpy(data.data() + 16,
+                info.chunk_checksum.data(),
+                std::min(info.chunk_checksum.size(), kChecksumSize));
+    return data;
+}
+
+std::optional<DataFrameInfo> DecodeDataFrameInfo(std::span<const std::uint8_t> payload) {
+    if (payload.size() < kDataFrameInfoSize) {
+        return std::nullopt;
+    }
+    auto compression = static_cast<CompressionAlgorithm>(payload[8]);
+    if (compression != CompressionAlgorithm::kNone && compression != CompressionAlgorithm::kLz4
+        && compression != CompressionAlgorithm::kZstd) {
+        return std::nullopt;
+    }
+    return DataFrameInfo{
+        .chunk_index = GetUint64(payload.data()),
+        .compression = compression,
+        .uncompressed_size = GetUint32(payload.data() + 12),
+        .chunk_checksum = std::string(reinterpret_cast<const char*>(payload.data() + 16),
+                                      kChecksumSize),
+    };
+}
+
+BinaryData EncodeAckPayload(std::uint64_t chunk_index) {
+    BinaryData data(8);
+    PutUint64(data.data(), chunk_index);
+    return data;
+}
+
+std::uint64_t DecodeAckPayload(std::span<const std::uint8_t> payload) {
+    return payload.size() >= 8 ? GetUint64(payload.data()) : 0;
+}
+
+} // namespace lansend::core
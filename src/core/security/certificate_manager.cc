@@ -1,9 +1,13 @@
+#include <chrono>
 #include <core/security/certificate_manager.h>
 #include <core/security/open_ssl_provider.h>
+#include <core/util/config.h>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <nlohmann/json.hpp>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
 #include <spdlog/spdlog.h>
 #include <sstream>
 
@@ -13,6 +17,44 @@ using json = nlohmann::json;
 
 namespace lansend::core {
 
+namespace {
+
+EVP_PKEY* GenerateKey(CertificateKeyType key_type) {
+    switch (key_type) {
+    case CertificateKeyType::kEcdsaP256:
+        return EVP_EC_gen("P-256");
+    case CertificateKeyType::kEd25519:
+        return EVP_PKEY_Q_keygen(nullptr, nullptr, "ED25519");
+    case CertificateKeyType::kRsa2048:
+        return EVP_RSA_gen(2048);
+    }
+    return nullptr;
+}
+
+std::optional<CertificateKeyType> DetectKeyType(const std::string& private_key_pem) {
+    BIO* bio = BIO_new_mem_buf(private_key_pem.data(), static_cast<int>(private_key_pem.size()));
+    EVP_PKEY* pkey = PEM_read_bio_PrivateKey(bio, nullptr, nullptr, nullptr);
+    BIO_free(bio);
+    if (!pkey) {
+        return std::nullopt;
+    }
+
+    int id = EVP_PKEY_get_base_id(pkey);
+    EVP_PKEY_free(pkey);
+    switch (id) {
+    case EVP_PKEY_EC:
+        return CertificateKeyType::kEcdsaP256;
+    case EVP_PKEY_ED25519:
+        return CertificateKeyType::kEd25519;
+    case EVP_PKEY_RSA:
+        return CertificateKeyType::kRsa2048;
+    default:
+        return std::nullopt;
+    }
+}
+
+} // namespace
+
 CertificateManager::CertificateManager(const fs::path& certDir)
     : certificate_dir_(certDir) {
     if (!fs::exists(certDir)) {
@@ -20,21 +62,49 @@ CertificateManager::CertificateManager(const fs::path& certDir)
     }
 
     OpenSSLProvider::InitOpenSSL();
-    initSecurityContext();
 
+    // Loaded first so that our own fingerprint is saved along with the trusted ones
     trusted_fingerprints_path_ = certificate_dir_ / "trusted_fingerprints.json";
     loadTrustedFingerprints();
+    fingerprint_writer_ = std::jthread([this](std::stop_token stop) {
+        runFingerprintWriter(stop);
+    });
+
+    initSecurityContext();
+}
+
+CertificateManager::~CertificateManager() {
+    // Flushes a pending save before the thread ends
+    fingerprint_writer_.request_stop();
+    if (fingerprint_writer_.joinable()) {
+        fingerprint_writer_.join();
+    }
 }
 
 bool CertificateManager::initSecurityContext() {
+    auto key_type = ParseKeyType(settings.certificate_key_type)
+                        .value_or(CertificateKeyType::kEcdsaP256);
+
     if (loadSecurityContext()) {
-        spdlog::info("Loaded existing certificate with fingerprint: {}",
+        spdlog::info("Loaded existing {} certificate with fingerprint: {}",
+                     KeyTypeName(security_context_.key_type),
                      security_context_.certificate_hash);
+        // Older versions generated RSA identities, move them to the faster key unless RSA is
+        // asked for explicitly
+        if (security_context_.key_type == CertificateKeyType::kRsa2048
+            && key_type != CertificateKeyType::kRsa2048) {
+            migrateSecurityContext(key_type);
+        }
         return true;
     }
 
-    if (generateSelfSignedCertificate()) {
-        spdlog::info("Generated new self-signed certificate with fingerprint: {}",
+    auto start = std::chrono::steady_clock::now();
+    if (generateSelfSignedCertificate(key_type)) {
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now()
+                                                            - start;
+        spdlog::info("Generated new self-signed {} certificate in {:.1f}ms with fingerprint: {}",
+                     KeyTypeName(key_type),
+                     elapsed.count(),
                      security_context_.certificate_hash);
         return saveSecurityContext();
     }
@@ -42,6 +112,45 @@ bool CertificateManager::initSecurityContext() {
     return false;
 }
 
+bool CertificateManager::migrateSecurityContext(CertificateKeyType key_type) {
+    SecurityContext legacy = security_context_;
+    if (!generateSelfSignedCertificate(key_type)) {
+        spdlog::warn("Failed to migrate the {} certificate, keeping it",
+                     KeyTypeName(legacy.key_type));
+        security_context_ = std::move(legacy);
+        return false;
+    }
+
+    try {
+        auto legacy_dir = certificate_dir_ / "legacy" / legacy.certificate_hash.substr(0, 16);
+        fs::create_directories(legacy_dir);
+        for (const char* name :
+             {"private_key.pem", "public_key.pem", "certificate.pem", "fingerprint.txt"}) {
+            fs::copy_file(certificate_dir_ / name,
+                          legacy_dir / name,
+                          fs::copy_options::overwrite_existing);
+        }
+    } catch (const std::exception& e) {
+        spdlog::error("Failed to keep the legacy certificate: {}", e.what());
+        security_context_ = std::move(legacy);
+        return false;
+    }
+
+    if (!saveSecurityContext()) {
+        security_context_ = std::move(legacy);
+        return false;
+    }
+
+    // Peers trust the new fingerprint on first contact like any other, the old one stays in our
+    // trusted list
+    spdlog::info("Migrated certificate from {} to {}, fingerprint {} -> {}",
+                 KeyTypeName(legacy.key_type),
+                 KeyTypeName(key_type),
+                 legacy.certificate_hash,
+                 security_context_.certificate_hash);
+    return true;
+}
+
 const SecurityContext& CertificateManager::security_context() const {
     return security_context_;
 }
@@ -67,6 +176,29 @@ std::string CertificateManager::CalculateCertificateHash(const std::string& cert
     return ss.str();
 }
 
+std::optional<CertificateKeyType> CertificateManager::ParseKeyType(std::string_view name) {
+    if (name == "ecdsa-p256") {
+        return CertificateKeyType::kEcdsaP256;
+    } else if (name == "ed25519") {
+        return CertificateKeyType::kEd25519;
+    } else if (name == "rsa-2048") {
+        return CertificateKeyType::kRsa2048;
+    }
+    return std::nullopt;
+}
+
+std::string_view CertificateManager::KeyTypeName(CertificateKeyType key_type) {
+    switch (key_type) {
+    case CertificateKeyType::kEcdsaP256:
+        return "ecdsa-p256";
+    case CertificateKeyType::kEd25519:
+        return "ed25519";
+    case CertificateKeyType::kRsa2048:
+        return "rsa-2048";
+    }
+    return "unknown";
+}
+
 bool CertificateManager::VerifyCertificate(bool preverified, ssl::verify_context& ctx) {
     // Get the certificate being verified
     X509* cert = X509_STORE_CTX_get_current_cert(ctx.native_handle());
@@ -75,45 +207,63 @@ bool CertificateManager::VerifyCertificate(bool preverified, ssl::verify_context
         return false;
     }
 
-    // Convert certificate to PEM format
-    BIO* certBio = BIO_new(BIO_s_mem());
-    PEM_write_bio_X509(certBio, cert);
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_len = 0;
+    if (X509_digest(cert, EVP_sha256(), digest, &digest_len) != 1) {
+        spdlog::error("Failed to digest certificate");
+        return false;
+    }
+    std::string der_digest(reinterpret_cast<const char*>(digest), digest_len);
+
+    std::string actualFingerprint;
+    {
+        std::lock_guard lock(fingerprints_mutex_);
+        if (auto it = verified_certificates_.find(der_digest); it != verified_certificates_.end()) {
+            actualFingerprint = it->second;
+        }
+    }
+
+    if (actualFingerprint.empty()) {
+        // Fingerprints are taken over the PEM text, as shown to users and stored in the list
+        BIO* certBio = BIO_new(BIO_s_mem());
+        PEM_write_bio_X509(certBio, cert);
 
-    char* certBuf = nullptr;
-    long certLen = BIO_get_mem_data(certBio, &certBuf);
-    std::string certPem(certBuf, certLen);
+        char* certBuf = nullptr;
+        long certLen = BIO_get_mem_data(certBio, &certBuf);
+        std::string certPem(certBuf, certLen);
 
-    // Calculate fingerprint
-    std::string actualFingerprint = CalculateCertificateHash(certPem);
+        actualFingerprint = CalculateCertificateHash(certPem);
 
-    BIO_free(certBio);
+        BIO_free(certBio);
+
+        std::lock_guard lock(fingerprints_mutex_);
+        if (verified_certificates_.size() >= kMaxVerifiedCertificates) {
+            verified_certificates_.clear();
+        }
+        verified_certificates_.emplace(std::move(der_digest), actualFingerprint);
+    }
 
     // Check if the fingerprint is in our trusted set
-    if (trusted_fingerprints_.find(actualFingerprint) != trusted_fingerprints_.end()) {
+    if (!addTrustedFingerprint(actualFingerprint)) {
         // Known fingerprint, connection is trusted
-        spdlog::info("Certificate fingerprint verified successfully: {}", actualFingerprint);
+        spdlog::debug("Certificate fingerprint verified successfully: {}", actualFingerprint);
         return true;
     } else {
-        // First connection with this fingerprint, prompt user to trust it
+        // First connection with this fingerprint. In a more official application, this might
+        // show a prompt to the user. For now, we auto-trust on first encounter.
         spdlog::warn("New certificate fingerprint detected: {}", actualFingerprint);
-
-        // In a more official application, this might show a prompt to the user
-        // For now, we'll auto-trust on first encounter
-        trusted_fingerprints_.insert(actualFingerprint);
-        saveTrustedFingerprints();
-
         spdlog::info("Automatically trusted new fingerprint: {}", actualFingerprint);
         return true;
     }
 }
 
 void CertificateManager::TrustFingerprint(const std::string& fingerprint) {
-    trusted_fingerprints_.insert(fingerprint);
-    saveTrustedFingerprints();
+    addTrustedFingerprint(fingerprint);
     spdlog::info("Added fingerprint to trusted list: {}", fingerprint);
 }
 
 bool CertificateManager::IsFingerprintTrusted(const std::string& fingerprint) {
+    std::lock_guard lock(fingerprints_mutex_);
     return trusted_fingerprints_.find(fingerprint) != trusted_fingerprints_.end();
 }
 
@@ -128,33 +278,19 @@ bool CertificateManager::TrustCertificate(const std::string& certificatePem) {
     }
 }
 
-bool CertificateManager::generateSelfSignedCertificate() {
+bool CertificateManager::generateSelfSignedCertificate(CertificateKeyType key_type) {
     EVP_PKEY* pkey = nullptr;
     X509* x509 = nullptr;
 
     try {
-        // 1. Generate RSA key pair
-        spdlog::info("Generating 2048-bit RSA key pair...");
-        EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, nullptr);
-        if (!ctx || EVP_PKEY_keygen_init(ctx) <= 0) {
-            EVP_PKEY_CTX_free(ctx);
-            throw std::runtime_error("Failed to initialize RSA key generation");
+        // 1. Generate the key pair, an EC key takes well under a millisecond where RSA takes up
+        // to a second
+        spdlog::info("Generating {} key pair...", KeyTypeName(key_type));
+        pkey = GenerateKey(key_type);
+        if (!pkey) {
+            throw std::runtime_error("Failed to generate key pair");
         }
 
-        // Set RSA key parameters (key size and public exponent)
-        if (EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, 2048) <= 0) {
-            EVP_PKEY_CTX_free(ctx);
-            throw std::runtime_error("Failed to set RSA key size");
-        }
-
-        // Generate the key
-        if (EVP_PKEY_keygen(ctx, &pkey) <= 0) {
-            EVP_PKEY_CTX_free(ctx);
-            throw std::runtime_error("Failed to generate RSA key pair");
-        }
-
-        EVP_PKEY_CTX_free(ctx);
-
         // 2. Create X509 certificate
         x509 = X509_new();
 
@@ -190,8 +326,9 @@ bool CertificateManager::generateSelfSignedCertificate() {
 
         X509_set_issuer_name(x509, name); // Self is the issuer
 
-        // Sign the certificate
-        if (X509_sign(x509, pkey, EVP_sha256()) == 0) {
+        // Sign the certificate, Ed25519 hashes internally and takes no digest
+        const EVP_MD* md = key_type == CertificateKeyType::kEd25519 ? nullptr : EVP_sha256();
+        if (X509_sign(x509, pkey, md) == 0) {
             throw std::runtime_error("Failed to sign certificate");
         }
 
@@ -218,13 +355,14 @@ bool CertificateManager::generateSelfSignedCertificate() {
         long certLen = BIO_get_mem_data(certBio, &certBuf);
         security_context_.certificate_pem = std::string(certBuf, certLen);
 
+        security_context_.key_type = key_type;
+
         // 4. Calculate certificate fingerprint
         security_context_.certificate_hash = CalculateCertificateHash(
             security_context_.certificate_pem);
 
         // Add our own fingerprint to trusted list
-        trusted_fingerprints_.insert(security_context_.certificate_hash);
-        saveTrustedFingerprints();
+        addTrustedFingerprint(security_context_.certificate_hash);
 
         // Release all resources
         BIO_free(privateBio);
@@ -301,9 +439,15 @@ bool CertificateManager::loadSecurityContext() {
         fingerprintStream << fingerprintFile.rdbuf();
         security_context_.certificate_hash = fingerprintStream.str();
 
+        auto key_type = DetectKeyType(security_context_.private_key_pem);
+        if (!key_type) {
+            spdlog::error("Unsupported private key in {}", certificate_dir_.string());
+            return false;
+        }
+        security_context_.key_type = *key_type;
+
         // Make sure our own fingerprint is trusted
-        trusted_fingerprints_.insert(security_context_.certificate_hash);
-        saveTrustedFingerprints();
+        addTrustedFingerprint(security_context_.certificate_hash);
 
         return !security_context_.private_key_pem.empty()
                && !security_context_.public_key_pem.empty()
@@ -337,18 +481,62 @@ void CertificateManager::loadTrustedFingerprints() {
     }
 }
 
-void CertificateManager::saveTrustedFingerprints() {
+bool CertificateManager::addTrustedFingerprint(const std::string& fingerprint) {
+    {
+        std::lock_guard lock(fingerprints_mutex_);
+        if (!trusted_fingerprints_.insert(fingerprint).second) {
+            return false;
+        }
+    }
+    scheduleFingerprintSave();
+    return true;
+}
+
+void CertificateManager::scheduleFingerprintSave() {
+    {
+        std::lock_guard lock(fingerprints_mutex_);
+        save_pending_ = true;
+    }
+    save_cv_.notify_one();
+}
+
+void CertificateManager::runFingerprintWriter(std::stop_token stop) {
+    std::unique_lock lock(fingerprints_mutex_);
+    while (save_cv_.wait(lock, stop, [this] { return save_pending_; })) {
+        // Let a burst of new peers settle into one write, a stop cuts the wait short
+        save_pending_ = false;
+        while (save_cv_.wait_for(lock, stop, kSaveDelay, [this] { return save_pending_; })) {
+            save_pending_ = false;
+        }
+
+        auto fingerprints = trusted_fingerprints_;
+        lock.unlock();
+        writeTrustedFingerprints(fingerprints);
+        lock.lock();
+
+        if (stop.stop_requested() && !save_pending_) {
+            break;
+        }
+    }
+}
+
+void CertificateManager::writeTrustedFingerprints(
+    const std::unordered_set<std::string>& fingerprints) {
     try {
         json j = json::array();
-        for (const auto& fingerprint : trusted_fingerprints_) {
+        for (const auto& fingerprint : fingerprints) {
             j.push_back(fingerprint);
         }
 
-        std::ofstream file(trusted_fingerprints_path_);
+        // Replace the list in one step, a crash mid-write must not lose it
+        auto temp_path = trusted_fingerprints_path_;
+        temp_path += ".tmp";
+        std::ofstream file(temp_path);
         file << j.dump(2);
         file.close();
+        fs::rename(temp_path, trusted_fingerprints_path_);
 
-        spdlog::debug("Saved {} trusted fingerprints", trusted_fingerprints_.size());
+        spdlog::debug("Saved {} trusted fingerprints", fingerprints.size());
     } catch (const std::exception& e) {
         spdlog::error("Failed to save trusted fingerprints: {}", e.what());
     }
@@ -1,9 +1,26 @@
 #include <core/security/file_hasher.h>
 #include <core/security/open_ssl_provider.h>
 #include <fstream>
+#include <iomanip>
+#include <sstream>
 
 namespace lansend::core {
 
+static std::string ToHexString(const unsigned char* hash, unsigned int hash_len) {
+    std::stringstream ss;
+    for (unsigned int i = 0; i < hash_len; i++) {
+        ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(hash[i]);
+    }
+    return ss.str();
+}
+
+static std::string FinalizeDigest(EVP_MD_CTX* mdctx) {
+    unsigned char hash[EVP_MAX_MD_SIZE];
+    unsigned int hash_len;
+    EVP_DigestFinal_ex(mdctx, hash, &hash_len);
+    return ToHexString(hash, hash_len);
+}
+
 std::string FileHasher::CalculateFileChecksum(const std::filesystem::path& file_path) {
     std::ifstream file(file_path, std::ios::binary);
     if (!file) {
@@ -24,40 +41,111 @@ std::string FileHasher::CalculateFileChecksum(const std::filesystem::path& file_
         }
     }
 
-    unsigned char hash[EVP_MAX_MD_SIZE];
-    unsigned int hash_len;
-    EVP_DigestFinal_ex(mdctx, hash, &hash_len);
+    std::string checksum = FinalizeDigest(mdctx);
     EVP_MD_CTX_free(mdctx);
 
-    // Convert hash to hex string
-    std::stringstream ss;
-    for (unsigned int i = 0; i < hash_len; i++) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(hash[i]);
-    }
-
-    return ss.str();
+    return checksum;
 }
 
-std::string FileHasher::CalculateDataChecksum(const BinaryData& data) {
+std::string FileHasher::CalculateDataChecksum(std::span<const std::uint8_t> data) {
     EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
     EVP_DigestInit_ex(mdctx, EVP_sha256(), nullptr);
     EVP_DigestUpdate(mdctx, data.data(), data.size());
 
-    unsigned char hash[EVP_MAX_MD_SIZE];
-    unsigned int hash_len;
-    EVP_DigestFinal_ex(mdctx, hash, &hash_len);
+    std::string checksum = FinalizeDigest(mdctx);
     EVP_MD_CTX_free(mdctx);
 
-    std::stringstream ss;
-    for (unsigned int i = 0; i < hash_len; i++) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(hash[i]);
+    return checksum;
+}
+
+FileChecksums FileHasher::CalculateFileAndChunkChecksums(const std::filesystem::path& file_path,
+                                                         std::size_t chunk_size) {
+    std::ifstream file(file_path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Failed to open file for checksum calculation");
+    }
+    if (chunk_size == 0) {
+        throw std::invalid_argument("Chunk size must be positive");
     }
 
-    return ss.str();
+    EVP_MD_CTX* file_ctx = EVP_MD_CTX_new();
+    EVP_MD_CTX* chunk_ctx = EVP_MD_CTX_new();
+    EVP_DigestInit_ex(file_ctx, EVP_sha256(), nullptr);
+    EVP_DigestInit_ex(chunk_ctx, EVP_sha256(), nullptr);
+
+    FileChecksums checksums;
+
+    constexpr size_t buffer_size = 64 * 1024;
+    std::vector<char> buffer(buffer_size);
+    std::size_t chunk_remaining = chunk_size;
+
+    while (file) {
+        // Never read across a chunk boundary so every chunk digest can be finalized in place
+        file.read(buffer.data(), std::min(buffer_size, chunk_remaining));
+        size_t bytes_read = file.gcount();
+        if (bytes_read == 0) {
+            break;
+        }
+        EVP_DigestUpdate(file_ctx, buffer.data(), bytes_read);
+        EVP_DigestUpdate(chunk_ctx, buffer.data(), bytes_read);
+        chunk_remaining -= bytes_read;
+
+        if (chunk_remaining == 0) {
+            checksums.chunk_checksums.emplace_back(FinalizeDigest(chunk_ctx));
+            EVP_DigestInit_ex(chunk_ctx, EVP_sha256(), nullptr);
+            chunk_remaining = chunk_size;
+        }
+    }
+
+    // Trailing partial chunk
+    if (chunk_remaining != chunk_size) {
+        checksums.chunk_checksums.emplace_back(FinalizeDigest(chunk_ctx));
+    }
+    checksums.file_checksum = FinalizeDigest(file_ctx);
+
+    EVP_MD_CTX_free(chunk_ctx);
+    EVP_MD_CTX_free(file_ctx);
+
+    return checksums;
+}
+
+std::string FileHasher::CalculateRangeChecksum(const std::filesystem::path& file_path,
+                                               std::size_t offset,
+                                               std::size_t size) {
+    std::ifstream file(file_path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Failed to open file for checksum calculation");
+    }
+    file.seekg(offset);
+
+    EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
+    EVP_DigestInit_ex(mdctx, EVP_sha256(), nullptr);
+
+    constexpr size_t buffer_size = 64 * 1024;
+    std::vector<char> buffer(buffer_size);
+    std::size_t remaining = size;
+
+    while (file && remaining > 0) {
+        file.read(buffer.data(), std::min(buffer_size, remaining));
+        size_t bytes_read = file.gcount();
+        if (bytes_read == 0) {
+            break;
+        }
+        EVP_DigestUpdate(mdctx, buffer.data(), bytes_read);
+        remaining -= bytes_read;
+    }
+
+    std::string checksum = FinalizeDigest(mdctx);
+    EVP_MD_CTX_free(mdctx);
+
+    if (remaining != 0) {
+        throw std::runtime_error("Unexpected end of file during checksum calculation");
+    }
+    return checksum;
 }
 
 FileHasher::FileHasher() {
     OpenSSLProvider::InitOpenSSL();
 }
 
-} // namespace lansend::core
\ No newline at end of file
+} // namespace lansend::core
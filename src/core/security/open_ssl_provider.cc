@@ -1,9 +1,19 @@
 #include <boost/uuid/random_generator.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include <core/security/open_ssl_provider.h>
+#include <core/util/config.h>
 #include <exception>
 #include <spdlog/spdlog.h>
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(_WIN32) && defined(_M_ARM64)
+#include <windows.h>
+#elif defined(__linux__) && defined(__aarch64__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
 namespace ssl = boost::asio::ssl;
 namespace uuids = boost::uuids;
 
@@ -54,12 +64,68 @@ void OpenSSLProvider::InitOpenSSL() {
     }
 }
 
+namespace {
+
+void EnableKtls(SSL_CTX* ctx) {
+#ifdef SSL_OP_ENABLE_KTLS
+    SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#else
+    spdlog::warn("Kernel TLS is not supported by this OpenSSL build");
+#endif
+}
+
+// AEAD suites only, both orders keep the other algorithm as a fallback. The TLS 1.2 list only
+// has ECDHE suites, ECDSA ones also cover Ed25519 certificates.
+constexpr const char* kAesFirstCiphersuites
+    = "TLS_AES_128_GCM_SHA256:TLS_CHACHA20_POLY1305_SHA256:TLS_AES_256_GCM_SHA384";
+constexpr const char* kChaChaFirstCiphersuites
+    = "TLS_CHACHA20_POLY1305_SHA256:TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384";
+constexpr const char* kAesFirstCipherList
+    = "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:"
+      "ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305:"
+      "ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384";
+constexpr const char* kChaChaFirstCipherList
+    = "ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305:"
+      "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:"
+      "ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384";
+
+void ApplyCipherPreference(SSL_CTX* ctx, bool server) {
+    auto preference = OpenSSLProvider::ResolveCipherPreference();
+    bool chacha_first = preference == CipherPreference::kChaCha20;
+    if (!SSL_CTX_set_ciphersuites(ctx,
+                                  chacha_first ? kChaChaFirstCiphersuites
+                                               : kAesFirstCiphersuites)
+        || !SSL_CTX_set_cipher_list(ctx,
+                                    chacha_first ? kChaChaFirstCipherList : kAesFirstCipherList)) {
+        spdlog::warn("Failed to set the cipher order, using OpenSSL defaults");
+        return;
+    }
+    if (server) {
+        // Follow our own order, but switch to ChaCha20 when a client without AES instructions
+        // asks for it first
+        SSL_CTX_set_options(ctx, SSL_OP_CIPHER_SERVER_PREFERENCE | SSL_OP_PRIORITIZE_CHACHA);
+    }
+    spdlog::info("TLS {} context prefers {} (tls-cipher-preference: {})",
+                 server ? "server" : "client",
+                 OpenSSLProvider::CipherPreferenceName(preference),
+                 settings.tls_cipher_preference);
+}
+
+} // namespace
+
 ssl::context OpenSSLProvider::BuildClientContext(
-    std::function<bool(bool, ssl::verify_context&)> verify_callback) {
-    ssl::context ctx(ssl::context::tlsv12_client);
+    std::function<bool(bool, ssl::verify_context&)> verify_callback, bool enable_ktls) {
+    // TLS 1.3 when the peer has it, older peers still get TLS 1.2
+    ssl::context ctx(ssl::context::tls_client);
+    SSL_CTX_set_min_proto_version(ctx.native_handle(), TLS1_2_VERSION);
+    SSL_CTX_set_max_proto_version(ctx.native_handle(), TLS1_3_VERSION);
 
     ctx.set_options(ssl::context::default_workarounds | ssl::context::no_sslv2
                     | ssl::context::no_sslv3);
+    if (enable_ktls) {
+        EnableKtls(ctx.native_handle());
+    }
+    ApplyCipherPreference(ctx.native_handle(), false);
 
     SSL_CTX_set_session_cache_mode(ctx.native_handle(), SSL_SESS_CACHE_CLIENT);
     SSL_CTX_sess_set_cache_size(ctx.native_handle(), 128);
@@ -77,18 +143,46 @@ ssl::context OpenSSLProvider::BuildClientContext(
 }
 
 ssl::context OpenSSLProvider::BuildServerContext(std::string_view cert_pem,
-                                                 std::string_view key_pem) {
-    ssl::context ctx(ssl::context::tlsv12_server);
+                                                 std::string_view key_pem,
+                                                 bool enable_ktls) {
+    ssl::context ctx(ssl::context::tls_server);
+    SSL_CTX_set_min_proto_version(ctx.native_handle(), TLS1_2_VERSION);
+    SSL_CTX_set_max_proto_version(ctx.native_handle(), TLS1_3_VERSION);
 
     ctx.set_options(ssl::context::default_workarounds | ssl::context::no_sslv2
                     | ssl::context::no_sslv3 | ssl::context::single_dh_use);
+    if (enable_ktls) {
+        EnableKtls(ctx.native_handle());
+    }
+    ApplyCipherPreference(ctx.native_handle(), true);
 
     ctx.use_certificate(boost::asio::buffer(cert_pem), ssl::context::pem);
     ctx.use_private_key(boost::asio::buffer(key_pem), ssl::context::pem);
 
+    // Let returning clients resume: session ids for TLS 1.2, tickets for both versions. Ticket
+    // keys live as long as the context, i.e. until the server restarts
+    SSL_CTX_set_session_cache_mode(ctx.native_handle(), SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(ctx.native_handle(), 1024);
+    SSL_CTX_set_timeout(ctx.native_handle(), kSessionTimeoutSeconds);
+    SSL_CTX_clear_options(ctx.native_handle(), SSL_OP_NO_TICKET);
+    SSL_CTX_set_num_tickets(ctx.native_handle(), 2);
+    constexpr std::string_view session_id_context = "lansend_server";
+    SSL_CTX_set_session_id_context(ctx.native_handle(),
+                                   reinterpret_cast<const unsigned char*>(
+                                       session_id_context.data()),
+                                   session_id_context.length());
+
     return ctx;
 }
 
+bool OpenSSLProvider::IsKtlsSendActive(SSL* ssl) {
+#ifdef SSL_OP_ENABLE_KTLS
+    return ssl && BIO_get_ktls_send(SSL_get_wbio(ssl)) == 1;
+#else
+    return false;
+#endif
+}
+
 bool OpenSSLProvider::SetHostname(SSL* ssl, std::string_view hostname) {
     if (!ssl || !SSL_set_tlsext_host_name(ssl, hostname.data())) {
         return false;
@@ -96,4 +190,54 @@ bool OpenSSLProvider::SetHostname(SSL* ssl, std::string_view hostname) {
     return true;
 }
 
+bool OpenSSLProvider::HasAesInstructions() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_cpu_supports("aes");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4] = {};
+    __cpuid(info, 1);
+    return (info[2] & (1 << 25)) != 0;
+#elif defined(__APPLE__) && defined(__aarch64__)
+    return true; // Every Apple ARM chip has the crypto extensions
+#elif defined(__linux__) && defined(__aarch64__)
+    return (getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+#elif defined(_WIN32) && defined(_M_ARM64)
+    return IsProcessorFeaturePresent(PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE);
+#else
+    return false;
+#endif
+}
+
+CipherPreference OpenSSLProvider::ResolveCipherPreference() {
+    static const bool has_aes = [] {
+        bool has_aes = HasAesInstructions();
+        spdlog::info("AES instructions {}", has_aes ? "available" : "not available");
+        return has_aes;
+    }();
+
+    if (auto preference = ParseCipherPreference(settings.tls_cipher_preference)) {
+        return *preference;
+    }
+    return has_aes ? CipherPreference::kAesGcm : CipherPreference::kChaCha20;
+}
+
+std::optional<CipherPreference> OpenSSLProvider::ParseCipherPreference(std::string_view name) {
+    if (name == "aes-gcm") {
+        return CipherPreference::kAesGcm;
+    } else if (name == "chacha20") {
+        return CipherPreference::kChaCha20;
+    }
+    return std::nullopt;
+}
+
+std::string_view OpenSSLProvider::CipherPreferenceName(CipherPreference preference) {
+    switch (preference) {
+    case CipherPreference::kAesGcm:
+        return "aes-gcm";
+    case CipherPreference::kChaCha20:
+        return "chacha20";
+    }
+    return "unknown";
+}
+
 } // namespace lansend::core
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <core/security/tls_session_cache.h>
+#include <format>
+#include <spdlog/spdlog.h>
+
+namespace ssl = boost::asio::ssl;
+
+namespace lansend::core {
+
+namespace {
+
+// Index of the peer key stored on every SSL object created for the shared context
+int PeerKeyIndex() {
+    static const int index = SSL_get_ex_new_index(
+        0,
+        nullptr,
+        nullptr,
+        nullptr,
+        [](void*, void* ptr, CRYPTO_EX_DATA*, int, long, void*) {
+            delete static_cast<std::string*>(ptr);
+        });
+    return index;
+}
+
+// Index of the owning cache on the shared context, boost::asio already uses its app data
+int CacheIndex() {
+    static const int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+}
+
+} // namespace
+
+TlsSessionCache& TlsSessionCache::Instance(CertificateManager& cert_manager) {
+    static TlsSessionCache instance(cert_manager);
+    return instance;
+}
+
+TlsSessionCache::TlsSessionCache(CertificateManager& cert_manager)
+    : ssl_ctx_(OpenSSLProvider::BuildClientContext(
+          [&cert_manager](bool preverified, ssl::verify_context& ctx) -> bool {
+              return cert_manager.VerifyCertificate(preverified, ctx);
+          })) {
+    // Sessions are kept per peer here instead of in OpenSSL's internal client cache
+    SSL_CTX_set_session_cache_mode(ssl_ctx_.native_handle(),
+                                   SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_set_ex_data(ssl_ctx_.native_handle(), CacheIndex(), this);
+    SSL_CTX_sess_set_new_cb(ssl_ctx_.native_handle(), &TlsSessionCache::onNewSession);
+}
+
+TlsSessionCache::~TlsSessionCache() {
+    for (auto& [peer_key, session] : sessions_) {
+        SSL_SESSION_free(session);
+    }
+}
+
+std::string TlsSessionCache::PeerKey(std::string_view device_id,
+                                     std::string_view host,
+                                     unsigned short port) {
+    if (device_id.empty()) {
+        return std::format("{}:{}", host, port);
+    }
+    return std::format("{}@{}:{}", device_id, host, port);
+}
+
+void TlsSessionCache::PrepareConnection(SSL* ssl, const std::string& peer_key) {
+    SSL_set_ex_data(ssl, PeerKeyIndex(), new std::string(peer_key));
+
+    std::lock_guard lock(mutex_);
+    if (auto it = sessions_.find(peer_key); it != sessions_.end()) {
+        if (SSL_SESSION_is_resumable(it->second)) {
+            SSL_set_session(ssl, it->second);
+        } else {
+            SSL_SESSION_free(it->second);
+            sessions_.erase(it);
+        }
+    }
+}
+
+bool TlsSessionCache::RecordHandshake(SSL* ssl, std::chrono::steady_clock::duration duration) {
+    bool resumed = SSL_session_reused(ssl) == 1;
+    double seconds = std::chrono::duration<double>(duration).count();
+    {
+        std::lock_guard lock(mutex_);
+        stats_.handshakes++;
+        if (resumed) {
+            stats_.resumed++;
+            stats_.total_resumed_seconds += seconds;
+        } else {
+            stats_.total_full_seconds += seconds;
+        }
+    }
+    spdlog::debug("{} {} handshake took {:.2f} ms",
+                  SSL_get_version(ssl),
+                  resumed ? "resumed" : "full",
+                  seconds * 1000.0);
+    return resumed;
+}
+
+void TlsSessionCache::Forget(const std::string& peer_key) {
+    std::lock_guard lock(mutex_);
+    if (auto it = sessions_.find(peer_key); it != sessions_.end()) {
+        SSL_SESSION_free(it->second);
+        sessions_.erase(it);
+    }
+}
+
+HandshakeStats TlsSessionCache::stats() const {
+    std::lock_guard lock(mutex_);
+    return stats_;
+}
+
+int TlsSessionCache::onNewSession(SSL* ssl, SSL_SESSION* session) {
+    auto* cache = static_cast<TlsSessionCache*>(
+        SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), CacheIndex()));
+    auto* peer_key = static_cast<std::string*>(SSL_get_ex_data(ssl, PeerKeyIndex()));
+    if (!cache || !peer_key) {
+        return 0;
+    }
+
+    std::lock_guard lock(cache->mutex_);
+    auto& cached = cache->sessions_[*peer_key];
+    if (cached) {
+        SSL_SESSION_free(cached);
+    } else if (cache->sessions_.size() > kMaxCachedPeers) {
+        // Peers rarely change, dropping an arbitrary one only costs a full handshake
+        auto victim = std::ranges::find_if(cache->sessions_,
+                                           [&](const auto& entry) {
+                                               return entry.first != *peer_key;
+                                           });
+        SSL_SESSION_free(victim->second);
+        cache->sessions_.erase(victim);
+    }
+    cached = session;
+    // Keeping the reference OpenSSL passed in
+    return 1;
+}
+
+} // namespace lansend::core
@@ -0,0 +1,45 @@
+#include <core/util/base64.h>
+#include <openssl/evp.h>
+
+namespace lansend::core {
+
+namespace base64 {
+
+std::string Encode(std::span<const std::uint8_t> data) {
+    if (data.empty()) {
+        return {};
+    }
+    // EVP_EncodeBlock writes a trailing NUL after the 4 * ceil(n / 3) output characters
+    std::string text(4 * ((data.size() + 2) / 3) + 1, '\0');
+    int length = EVP_EncodeBlock(reinterpret_cast<unsigned char*>(text.data()),
+                                 data.data(),
+                                 static_cast<int>(data.size()));
+    text.resize(length);
+    return text;
+}
+
+std::optional<BinaryData> Decode(std::string_view text) {
+    if (text.empty()) {
+        return BinaryData{};
+    }
+    if (text.size() % 4 != 0) {
+        return std::nullopt;
+    }
+
+    BinaryData data(text.size() / 4 * 3);
+    int length = EVP_DecodeBlock(data.data(),
+                                 reinterpret_cast<const unsigned char*>(text.data()),
+                                 static_cast<int>(text.size()));
+    if (length < 0) {
+        return std::nullopt;
+    }
+
+    // EVP_DecodeBlock keeps the zero bytes produced by the padding
+    std::size_t padding = text.ends_with("==") ? 2 : text.ends_with('=') ? 1 : 0;
+    data.resize(static_cast<std::size_t>(length) - padding);
+    return data;
+}
+
+} // namespace base64
+
+} // namespace lansend::core
@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <core/util/chunk_index.h>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace lansend::core {
+
+static std::int64_t LastWriteTime(const fs::path& path, std::error_code& ec) {
+    return static_cast<std::int64_t>(fs::last_write_time(path, ec).time_since_epoch().count());
+}
+
+static bool IsUnder(const fs::path& root, const fs::path& path) {
+    auto normalized_root = root.lexically_normal();
+    auto normalized_path = path.lexically_normal();
+    auto [root_end, _] = std::mismatch(normalized_root.begin(),
+                                       normalized_root.end(),
+                                       normalized_path.begin(),
+                                       normalized_path.end());
+    return root_end == normalized_root.end();
+}
+
+ChunkIndex::ChunkIndex(const fs::path& index_path)
+    : index_path_(index_path) {}
+
+void ChunkIndex::Load() {
+    files_.clear();
+    chunks_.clear();
+    if (!fs::exists(index_path_)) {
+        return;
+    }
+
+    try {
+        std::ifstream file(index_path_);
+        json j = json::parse(file);
+        for (const auto& entry : j) {
+            IndexedFile indexed{
+                .file_size = entry["file_size"].get<std::size_t>(),
+                .last_write_time = entry["last_write_time"].get<std::int64_t>(),
+                .chunk_size = entry["chunk_size"].get<std::size_t>(),
+                .chunk_checksums = entry["chunk_checksums"].get<std::vector<std::string>>(),
+                .indexed_at = entry["indexed_at"].get<std::int64_t>(),
+            };
+            auto file_path = entry["file_path"].get<std::string>();
+            for (std::size_t i = 0; i < indexed.chunk_checksums.size(); ++i) {
+                chunks_.emplace(indexed.chunk_checksums[i], ChunkRef{file_path, i});
+            }
+            files_.emplace(std::move(file_path), std::move(indexed));
+        }
+        spdlog::info("Loaded chunk index with {} files", files_.size());
+    } catch (const std::exception& e) {
+        spdlog::error("Failed to load chunk index: {}", e.what());
+        files_.clear();
+        chunks_.clear();
+    }
+    dirty_ = false;
+}
+
+void ChunkIndex::Save() {
+    if (!dirty_) {
+        return;
+    }
+
+    try {
+        json j = json::array();
+        for (const auto& [file_path, indexed] : files_) {
+            j.push_back({
+                {"file_path", file_path},
+                {"file_size", indexed.file_size},
+                {"last_write_time", indexed.last_write_time},
+                {"chunk_size", indexed.chunk_size},
+                {"chunk_checksums", indexed.chunk_checksums},
+                {"indexed_at", indexed.indexed_at},
+            });
+        }
+
+        fs::create_directories(index_path_.parent_path());
+        std::ofstream file(index_path_);
+        file << j.dump();
+        file.close();
+        dirty_ = false;
+
+        spdlog::debug("Saved chunk index with {} files", files_.size());
+    } catch (const std::exception& e) {
+        spdlog::error("Failed to save chunk index: {}", e.what());
+    }
+}
+
+void ChunkIndex::AddFile(const fs::path& file_path,
+                         std::size_t chunk_size,
+                         const std::vector<std::string>& chunk_checksums) {
+    if (chunk_checksums.empty()) {
+        return;
+    }
+
+    std::error_code ec;
+    auto file_size = fs::file_size(file_path, ec);
+    auto last_write_time = LastWriteTime(file_path, ec);
+    if (ec) {
+        spdlog::warn("Failed to index \"{}\": {}", file_path.string(), ec.message());
+        return;
+    }
+
+    auto key = file_path.lexically_normal().string();
+    removeFile(key);
+    if (files_.size() >= kMaxIndexedFiles) {
+        evictOldest();
+    }
+
+    for (std::size_t i = 0; i < chunk_checksums.size(); ++i) {
+        chunks_.emplace(chunk_checksums[i], ChunkRef{key, i});
+    }
+    files_.emplace(key,
+                   IndexedFile{
+                       .file_size = file_size,
+                       .last_write_time = last_write_time,
+                       .chunk_size = chunk_size,
+                       .chunk_checksums = chunk_checksums,
+                       .indexed_at = std::chrono::system_clock::now().time_since_epoch().count(),
+                   });
+    dirty_ = true;
+}
+
+std::optional<ChunkLocation> ChunkIndex::Find(std::string_view chunk_checksum,
+                                              const fs::path& root) {
+    auto [begin, end] = chunks_.equal_range(std::string(chunk_checksum));
+    std::vector<std::string> stale_files;
+    std::optional<ChunkLocation> location;
+
+    for (auto it = begin; it != end; ++it) {
+        const auto& ref = it->second;
+        auto file_it = files_.find(ref.file_path);
+        if (file_it == files_.end()) {
+            continue;
+        }
+        if (isStale(ref.file_path, file_it->second)) {
+            stale_files.push_back(ref.file_path);
+            continue;
+        }
+        if (!IsUnder(root, ref.file_path)) {
+            continue;
+        }
+
+        const auto& indexed = file_it->second;
+        std::size_t offset = ref.chunk_index * indexed.chunk_size;
+        location = ChunkLocation{
+            .file_path = ref.file_path,
+            .offset = offset,
+            .size = std::min(indexed.chunk_size, indexed.file_size - offset),
+        };
+        break;
+    }
+
+    for (const auto& file_path : stale_files) {
+        spdlog::debug("Dropping stale chunk index entry \"{}\"", file_path);
+        removeFile(file_path);
+    }
+    return location;
+}
+
+bool ChunkIndex::isStale(const std::string& file_path, const IndexedFile& file) const {
+    std::error_code ec;
+    auto file_size = fs::file_size(file_path, ec);
+    if (ec || file_size != file.file_size) {
+        return true;
+    }
+    auto last_write_time = LastWriteTime(file_path, ec);
+    return ec || last_write_time != file.last_write_time;
+}
+
+void ChunkIndex::removeFile(const std::string& file_path) {
+    auto file_it = files_.find(file_path);
+    if (file_it == files_.end()) {
+        return;
+    }
+    for (const auto& checksum : file_it->second.chunk_checksums) {
+        auto [begin, end] = chunks_.equal_range(checksum);
+        for (auto it = begin; it != end;) {
+            if (it->second.file_path == file_path) {
+                it = chunks_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    files_.erase(file_it);
+    dirty_ = true;
+}
+
+void ChunkIndex::evictOldest() {
+    auto oldest = std::ranges::min_element(files_, {}, [](const auto& entry) {
+        return entry.second.indexed_at;
+    });
+    if (oldest != files_.end()) {
+        removeFile(std::string(oldest->first));
+    }
+}
+
+} // namespace lansend::core
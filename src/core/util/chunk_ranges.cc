@@ -0,0 +1,64 @@
+#include <algorithm>
+#include <charconv>
+#include <core/util/chunk_ranges.h>
+#include <format>
+#include <vector>
+
+namespace lansend::core {
+
+namespace chunk_ranges {
+
+std::string Format(const std::unordered_set<std::size_t>& chunks) {
+    std::vector<std::size_t> sorted(chunks.begin(), chunks.end());
+    std::ranges::sort(sorted);
+
+    std::string text;
+    for (std::size_t i = 0; i < sorted.size();) {
+        std::size_t first = sorted[i];
+        std::size_t last = first;
+        while (++i < sorted.size() && sorted[i] == last + 1) {
+            ++last;
+        }
+        if (!text.empty()) {
+            text += ',';
+        }
+        text += first == last ? std::format("{}", first) : std::format("{}-{}", first, last);
+    }
+    return text;
+}
+
+std::optional<std::set<std::size_t>> Parse(std::string_view text, std::size_t total_chunks) {
+    auto parse_index = [](std::string_view number) -> std::optional<std::size_t> {
+        std::size_t value = 0;
+        auto [ptr, ec] = std::from_chars(number.data(), number.data() + number.size(), value);
+        if (ec != std::errc() || ptr != number.data() + number.size()) {
+            return std::nullopt;
+        }
+        return value;
+    };
+
+    std::set<std::size_t> chunks;
+    if (text.empty()) {
+        return chunks;
+    }
+    for (std::size_t start = 0; start <= text.size();) {
+        auto comma = std::min(text.find(',', start), text.size());
+        auto range = text.substr(start, comma - start);
+        start = comma + 1;
+
+        auto dash = range.find('-');
+        auto first = parse_index(range.substr(0, dash));
+        auto last = dash == std::string_view::npos ? first : parse_index(range.substr(dash + 1));
+        if (!first || !last || *first > *last || *last >= total_chunks) {
+            return std::nullopt;
+        }
+        for (std::size_t chunk = *first; chunk <= *last; ++chunk) {
+            chunks.insert(chunk);
+        }
+    }
+    return chunks;
+}
+
+} // namespace chunk_ranges
+
+} // namespace lansend::core
@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <core/util/compression.h>
+#include <format>
+#include <limits>
+#include <lz4.h>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <zstd.h>
+
+namespace lansend::core {
+
+namespace compression {
+
+BinaryData Compress(CompressionAlgorithm algorithm, const BinaryData& data, int level) {
+    switch (algorithm) {
+    case CompressionAlgorithm::kNone:
+        return data;
+    case CompressionAlgorithm::kLz4: {
+        BinaryData output(LZ4_compressBound(static_cast<int>(data.size())));
+        int size = LZ4_compress_default(reinterpret_cast<const char*>(data.data()),
+                                        reinterpret_cast<char*>(output.data()),
+                                        static_cast<int>(data.size()),
+                                        static_cast<int>(output.size()));
+        if (size <= 0) {
+            throw std::runtime_error("LZ4 compression failed");
+        }
+        output.resize(size);
+        return output;
+    }
+    case CompressionAlgorithm::kZstd: {
+        // Contexts are expensive to create, keep one per thread
+        thread_local std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> cctx(ZSTD_createCCtx(),
+                                                                               &ZSTD_freeCCtx);
+        BinaryData output(ZSTD_compressBound(data.size()));
+        std::size_t size = ZSTD_compressCCtx(cctx.get(),
+                                             output.data(),
+                                             output.size(),
+                                             data.data(),
+                                             data.size(),
+                                             level);
+        if (ZSTD_isError(size)) {
+            throw std::runtime_error(
+                std::format("Zstd compression failed: {}", ZSTD_getErrorName(size)));
+        }
+        output.resize(size);
+        return output;
+    }
+    }
+    throw std::runtime_error("Unknown compression algorithm");
+}
+
+BinaryData Decompress(CompressionAlgorithm algorithm,
+                      const BinaryData& data,
+                      std::size_t original_size) {
+    switch (algorithm) {
+    case CompressionAlgorithm::kNone:
+        return data;
+    case CompressionAlgorithm::kLz4: {
+        BinaryData output(original_size);
+        int size = LZ4_decompress_safe(reinterpret_cast<const char*>(data.data()),
+                                       reinterpret_cast<char*>(output.data()),
+                                       static_cast<int>(data.size()),
+                                       static_cast<int>(output.size()));
+        if (size < 0 || static_cast<std::size_t>(size) != original_size) {
+            throw std::runtime_error("LZ4 decompression failed");
+        }
+        return output;
+    }
+    case CompressionAlgorithm::kZstd: {
+        thread_local std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> dctx(ZSTD_createDCtx(),
+                                                                               &ZSTD_freeDCtx);
+        BinaryData output(original_size);
+        std::size_t size = ZSTD_decompressDCtx(dctx.get(),
+                                               output.data(),
+                                               output.size(),
+                                               data.data(),
+                                               data.size());
+        if (ZSTD_isError(size) || size != original_size) {
+            throw std::runtime_error("Zstd decompression failed");
+        }
+        return output;
+    }
+    }
+    throw std::runtime_error("Unknown compression algorithm");
+}
+
+} // namespace compression
+
+AdaptiveCompressor::AdaptiveCompressor(FileType file_type,
+                                       const std::vector<CompressionAlgorithm>& accepted) {
+    candidates_.push_back({CompressionAlgorithm::kNone, 0, 0.0, 1.0});
+
+    // Already-compressed media never gets smaller
+    if (file_type == FileType::kImage || file_type == FileType::kVideo
+        || file_type == FileType::kAudio) {
+        return;
+    }
+
+    if (std::ranges::find(accepted, CompressionAlgorithm::kLz4) != accepted.end()) {
+        candidates_.push_back({CompressionAlgorithm::kLz4, 0, 0.0, 1.0});
+    }
+    if (std::ranges::find(accepted, CompressionAlgorithm::kZstd) != accepted.end()) {
+        candidates_.push_back({CompressionAlgorithm::kZstd, 1, 0.0, 1.0});
+        // Text compresses well enough for a stronger level to pay off on slow links
+        if (file_type == FileType::kText) {
+            candidates_.push_back({CompressionAlgorithm::kZstd, 3, 0.0, 1.0});
+        }
+    }
+    enabled_ = candidates_.size() > 1;
+}
+
+std::optional<AdaptiveCompressor::Compressed> AdaptiveCompressor::Compress(
+    const BinaryData& chunk) {
+    if (!enabled_ || chunk.empty()) {
+        return std::nullopt;
+    }
+    if (!probed_ || chunks_since_probe_ >= kReprobeInterval) {
+        probe(chunk);
+    }
+    ++chunks_since_probe_;
+
+    if (current_ == 0) {
+        return std::nullopt;
+    }
+
+    auto& candidate = candidates_[current_];
+    try {
+        auto start = std::chrono::steady_clock::now();
+        BinaryData compressed = compression::Compress(candidate.algorithm, chunk, candidate.level);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        double ratio = static_cast<double>(compressed.size()) / chunk.size();
+        candidate.ratio = (1 - kSmoothing) * candidate.ratio + kSmoothing * ratio;
+        if (elapsed.count() > 0) {
+            candidate.bytes_per_second = (1 - kSmoothing) * candidate.bytes_per_second
+                                         + kSmoothing * (chunk.size() / elapsed.count());
+        }
+        // May pick another candidate for the next chunk, this one keeps its algorithm
+        CompressionAlgorithm algorithm = candidate.algorithm;
+        choose();
+
+        if (ratio >= kMinUsefulRatio) {
+            return std::nullopt;
+        }
+        return Compressed{algorithm, std::move(compressed)};
+    } catch (const std::exception& e) {
+        spdlog::warn("Chunk compression failed, sending raw: {}", e.what());
+        enabled_ = false;
+        return std::nullopt;
+    }
+}
+
+void AdaptiveCompressor::RecordSend(std::size_t wire_bytes,
+                                    std::chrono::steady_clock::duration elapsed) {
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    if (wire_bytes == 0 || seconds <= 0) {
+        return;
+    }
+    link_bytes_per_second_ = (1 - kSmoothing) * link_bytes_per_second_
+                             + kSmoothing * (wire_bytes / seconds);
+    choose();
+}
+
+void AdaptiveCompressor::probe(const BinaryData& chunk) {
+    BinaryData sample(chunk.begin(), chunk.begin() + std::min(kProbeSize, chunk.size()));
+    for (std::size_t i = 1; i < candidates_.size(); ++i) {
+        auto& candidate = candidates_[i];
+        try {
+            auto start = std::chrono::steady_clock::now();
+            auto compressed = compression::Compress(candidate.algorithm, sample, candidate.level);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            candidate.ratio = static_cast<double>(compressed.size()) / sample.size();
+            candidate.bytes_per_second = sample.size() / std::max(elapsed.count(), 1e-9);
+        } catch (const std::exception& e) {
+            candidate.ratio = 1.0;
+            candidate.bytes_per_second = 0.0;
+        }
+    }
+    probed_ = true;
+    chunks_since_probe_ = 0;
+    choose();
+}
+
+void AdaptiveCompressor::choose() {
+    // Estimated seconds needed per raw byte, compressing and sending sequentially
+    auto cost = [this](const Candidate& candidate) {
+        if (candidate.algorithm == CompressionAlgorithm::kNone) {
+            return 1.0 / link_bytes_per_second_;
+        }
+        if (candidate.bytes_per_second <= 0 || candidate.ratio >= kMinUsefulRatio) {
+            return std::numeric_limits<double>::infinity();
+        }
+        return 1.0 / candidate.bytes_per_second + candidate.ratio / link_bytes_per_second_;
+    };
+
+    std::size_t best = 0;
+    for (std::size_t i = 1; i < candidates_.size(); ++i) {
+        if (cost(candidates_[i]) < cost(candidates_[best])) {
+            best = i;
+        }
+    }
+    if (best != current_) {
+        spdlog::debug("Chunk compression switched to {} (level {}), link {:.1f} MB/s",
+                      nlohmann::json(candidates_[best].algorithm).get<std::string>(),
+                      candidates_[best].level,
+                      link_bytes_per_second_ / (1024 * 1024));
+        current_ = best;
+    }
+}
+
+} // namespace lansend::core
@@ -38,6 +38,81 @@ static void LoadSetting() {
     } else {
         settings.save_dir = path::kSystemDownloadDir;
     }
+    if (setting.contains("compression")) {
+        settings.compression = setting["compression"].value_or(true);
+    } else {
+        settings.compression = true;
+    }
+    if (setting.contains("stream-transport")) {
+        settings.stream_transport = setting["stream-transport"].value_or(true);
+    } else {
+        settings.stream_transport = true;
+    }
+    if (setting.contains("chunked-upload")) {
+        settings.chunked_upload = setting["chunked-upload"].value_or(true);
+    } else {
+        settings.chunked_upload = true;
+    }
+    if (setting.contains("kernel-tls")) {
+        settings.kernel_tls = setting["kernel-tls"].value_or(false);
+    } else {
+        settings.kernel_tls = false;
+    }
+    if (setting.contains("certificate-key-type")) {
+        settings.certificate_key_type = setting["certificate-key-type"].value_or(
+            std::string{"ecdsa-p256"});
+    } else {
+        settings.certificate_key_type = "ecdsa-p256";
+    }
+    if (setting.contains("tls-cipher-preference")) {
+        settings.tls_cipher_preference = setting["tls-cipher-preference"].value_or(
+            std::string{"auto"});
+    } else {
+        settings.tls_cipher_preference = "auto";
+    }
+    if (setting.contains("max-receive-sessions")) {
+        settings.max_receive_sessions = setting["max-receive-sessions"].value_or(4u);
+    } else {
+        settings.max_receive_sessions = 4;
+    }
+    if (setting.contains("rate-limit")) {
+        settings.rate_limit = setting["rate-limit"].value_or(0u);
+    } else {
+        settings.rate_limit = 0;
+    }
+    if (setting.contains("device-rate-limit")) {
+        settings.device_rate_limit = setting["device-rate-limit"].value_or(0u);
+    } else {
+        settings.device_rate_limit = 0;
+    }
+    if (setting.contains("transfer-priority")) {
+        settings.transfer_priority = setting["transfer-priority"].value_or(std::string{"normal"});
+    } else {
+        settings.transfer_priority = "normal";
+    }
+    if (setting.contains("multicast-transport")) {
+        settings.multicast_transport = setting["multicast-transport"].value_or(false);
+    } else {
+        settings.multicast_transport = false;
+    }
+    if (setting.contains("multicast-rate")) {
+        settings.multicast_rate = setting["multicast-rate"].value_or(40960u);
+    } else {
+        settings.multicast_rate = 40960;
+    }
+    if (setting.contains("udp-transport")) {
+        settings.udp_transport = setting["udp-transport"].value_or(false);
+    } else {
+        settings.udp_transport = false;
+    }
+    settings.device_rate_limits.clear();
+    if (auto* limits = setting["device-rate-limits"].as_table()) {
+        for (const auto& [device_id, limit] : *limits) {
+            if (auto value = limit.value<std::uint32_t>()) {
+                settings.device_rate_limits.emplace(device_id.str(), *value);
+            }
+        }
+    }
 }
 
 void InitConfig() {
@@ -67,12 +142,30 @@ void SaveConfig() {
         spdlog::error("Failed to open \"{}\" for saving config.", path.string());
         return;
     }
+    toml::table device_rate_limits;
+    for (const auto& [device_id, limit] : settings.device_rate_limits) {
+        device_rate_limits.insert(device_id, limit);
+    }
     config.insert_or_assign("setting",
                             toml::table{
                                 {"port", settings.port},
                                 {"pin-code", settings.pin_code},
                                 {"auto-receive", settings.auto_receive},
                                 {"save-dir", settings.save_dir.string()},
+                                {"compression", settings.compression},
+                                {"stream-transport", settings.stream_transport},
+                                {"chunked-upload", settings.chunked_upload},
+                                {"kernel-tls", settings.kernel_tls},
+                                {"certificate-key-type", settings.certificate_key_type},
+                                {"tls-cipher-preference", settings.tls_cipher_preference},
+                                {"max-receive-sessions", settings.max_receive_sessions},
+                                {"rate-limit", settings.rate_limit},
+                                {"device-rate-limit", settings.device_rate_limit},
+                                {"transfer-priority", settings.transfer_priority},
+                                {"multicast-transport", settings.multicast_transport},
+                                {"multicast-rate", settings.multicast_rate},
+                                {"udp-transport", settings.udp_transport},
+                                {"device-rate-limits", std::move(device_rate_limits)},
                             });
     ofs << config;
 }
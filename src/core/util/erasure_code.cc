@@ -0,0 +1,171 @@
+#include <array>
+#include <core/util/erasure_code.h>
+#include <stdexcept>
+
+namespace lansend::core {
+
+namespace {
+
+// Log and exponent tables of GF(2^8) with the polynomial x^8 + x^4 + x^3 + x^2 + 1
+struct GaloisField {
+    std::array<std::uint8_t, 512> exp{};
+    std::array<std::uint8_t, 256> log{};
+
+    GaloisField() {
+        unsigned value = 1;
+        for (std::size_t i = 0; i < 255; ++i) {
+            exp[i] = static_cast<std::uint8_t>(value);
+            log[value] = static_cast<std::uint8_t>(i);
+            value <<= 1;
+            if (value & 0x100) {
+                value ^= 0x11d;
+            }
+        }
+        // Products index up to 254 + 254, no need to reduce them
+        for (std::size_t i = 255; i < exp.size(); ++i) {
+            exp[i] = exp[i - 255];
+        }
+    }
+
+    std::uint8_t Multiply(std::uint8_t a, std::uint8_t b) const {
+        return a == 0 || b == 0 ? 0 : exp[log[a] + log[b]];
+    }
+
+    std::uint8_t Inverse(std::uint8_t a) const { return exp[255 - log[a]]; }
+};
+
+const GaloisField& Field() {
+    static const GaloisField field;
+    return field;
+}
+
+// out ^= coefficient * in, symbol by symbol
+void MultiplyAdd(BinaryData& out, const BinaryData& in, std::uint8_t coefficient) {
+    if (coefficient == 0) {
+        return;
+    }
+    const auto& field = Field();
+    std::array<std::uint8_t, 256> products;
+    for (std::size_t i = 0; i < products.size(); ++i) {
+        products[i] = field.Multiply(coefficient, static_cast<std::uint8_t>(i));
+    }
+    for (std::size_t i = 0; i < out.size(); ++i) {
+        out[i] ^= products[in[i]];
+    }
+}
+
+} // namespace
+
+ErasureCode::ErasureCode(std::size_t data_symbols, std::size_t repair_symbols)
+    : data_symbols_(data_symbols)
+    , repair_symbols_(repair_symbols) {
+    if (data_symbols == 0 || data_symbols + repair_symbols > 256) {
+        throw std::invalid_argument("Unsupported erasure code block size");
+    }
+    // Cauchy matrix 1 / (x_i + y_j) with x_i = i and y_j = repair_symbols + j, every square
+    // submatrix of it is invertible
+    const auto& field = Field();
+    matrix_.assign(repair_symbols, std::vector<std::uint8_t>(data_symbols));
+    for (std::size_t i = 0; i < repair_symbols; ++i) {
+        for (std::size_t j = 0; j < data_symbols; ++j) {
+            matrix_[i][j] = field.Inverse(static_cast<std::uint8_t>(i ^ (repair_symbols + j)));
+        }
+    }
+}
+
+std::vector<BinaryData> ErasureCode::Encode(const std::vector<BinaryData>& data) const {
+    if (data.size() != data_symbols_) {
+        throw std::invalid_argument("Wrong number of data symbols");
+    }
+    std::vector<BinaryData> repair(repair_symbols_, BinaryData(data.front().size()));
+    for (std::size_t i = 0; i < repair_symbols_; ++i) {
+        for (std::size_t j = 0; j < data_symbols_; ++j) {
+            MultiplyAdd(repair[i], data[j], matrix_[i][j]);
+        }
+    }
+    return repair;
+}
+
+bool ErasureCode::Decode(std::vector<std::optional<BinaryData>>& symbols) const {
+    if (symbols.size() != data_symbols_ + repair_symbols_) {
+        throw std::invalid_argument("Wrong number of symbols");
+    }
+
+    std::vector<std::size_t> lost;
+    for (std::size_t j = 0; j < data_symbols_; ++j) {
+        if (!symbols[j]) {
+            lost.push_back(j);
+        }
+    }
+    if (lost.empty()) {
+        return true;
+    }
+    std::vector<std::size_t> repairs;
+    for (std::size_t i = 0; i < repair_symbols_ && repairs.size() < lost.size(); ++i) {
+        if (symbols[data_symbols_ + i]) {
+            repairs.push_back(i);
+        }
+    }
+    if (repairs.size() < lost.size()) {
+        return false;
+    }
+
+    // Take the received data symbols out of the repair symbols, what is left is a square system
+    // in the lost ones: rhs[r] = sum over lost j of matrix_[repairs[r]][j] * data[j]
+    const auto& field = Field();
+    const std::size_t n = lost.size();
+    std::vector<BinaryData> rhs;
+    std::vector<std::vector<std::uint8_t>> system(n, std::vector<std::uint8_t>(n));
+    for (std::size_t r = 0; r < n; ++r) {
+        const auto& row = matrix_[repairs[r]];
+        BinaryData value = *symbols[data_symbols_ + repairs[r]];
+        for (std::size_t j = 0; j < data_symbols_; ++j) {
+            if (symbols[j]) {
+                MultiplyAdd(value, *symbols[j], row[j]);
+            }
+        }
+        rhs.push_back(std::move(value));
+        for (std::size_t c = 0; c < n; ++c) {
+            system[r][c] = row[lost[c]];
+        }
+    }
+
+    // Gauss-Jordan elimination, the Cauchy submatrix always has a pivot
+    for (std::size_t c = 0; c < n; ++c) {
+        std::size_t pivot = c;
+        while (pivot < n && system[pivot][c] == 0) {
+            ++pivot;
+        }
+        if (pivot == n) {
+            return false;
+        }
+        std::swap(system[c], system[pivot]);
+        std::swap(rhs[c], rhs[pivot]);
+
+        std::uint8_t inverse = field.Inverse(system[c][c]);
+        for (auto& coefficient : system[c]) {
+            coefficient = field.Multiply(coefficient, inverse);
+        }
+        BinaryData scaled(rhs[c].size());
+        MultiplyAdd(scaled, rhs[c], inverse);
+        rhs[c] = std::move(scaled);
+
+        for (std::size_t r = 0; r < n; ++r) {
+            std::uint8_t factor = system[r][c];
+            if (r == c || factor == 0) {
+                continue;
+            }
+            for (std::size_t k = 0; k < n; ++k) {
+                system[r][k] ^= field.Multiply(factor, system[c][k]);
+            }
+            MultiplyAdd(rhs[r], rhs[c], factor);
+        }
+    }
+
+    for (std::size_t c = 0; c < n; ++c) {
+        symbols[lost[c]] = std::move(rhs[c]);
+    }
+    return true;
+}
+
+} // namespace lansend::core
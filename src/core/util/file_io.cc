@@ -0,0 +1,138 @@
+#include <core/util/file_io.h>
+#include <fstream>
+#include <spdlog/spdlog.h>
+#include <vector>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <sys/clonefile.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace lansend::core {
+
+namespace fileio {
+
+static bool StreamCopyRange(const fs::path& src,
+                            std::uint64_t src_offset,
+                            const fs::path& dst,
+                            std::uint64_t dst_offset,
+                            std::uint64_t length) {
+    std::ifstream in(src, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    std::fstream out(dst, std::ios::binary | std::ios::in | std::ios::out);
+    if (!out) {
+        out.open(dst, std::ios::binary | std::ios::out);
+        if (!out) {
+            return false;
+        }
+    }
+    in.seekg(src_offset);
+    out.seekp(dst_offset);
+
+    constexpr std::size_t buffer_size = 256 * 1024;
+    std::vector<char> buffer(buffer_size);
+    while (length > 0) {
+        in.read(buffer.data(), std::min<std::uint64_t>(buffer_size, length));
+        auto bytes_read = static_cast<std::size_t>(in.gcount());
+        if (bytes_read == 0) {
+            return false;
+        }
+        out.write(buffer.data(), bytes_read);
+        if (!out) {
+            return false;
+        }
+        length -= bytes_read;
+    }
+    return true;
+}
+
+bool CopyRange(const fs::path& src,
+               std::uint64_t src_offset,
+               const fs::path& dst,
+               std::uint64_t dst_offset,
+               std::uint64_t length) {
+#if defined(__linux__)
+    int src_fd = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (src_fd < 0) {
+        return false;
+    }
+    int dst_fd = ::open(dst.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (dst_fd < 0) {
+        ::close(src_fd);
+        return false;
+    }
+
+    auto off_in = static_cast<loff_t>(src_offset);
+    auto off_out = static_cast<loff_t>(dst_offset);
+    std::uint64_t remaining = length;
+    bool fallback = false;
+    while (remaining > 0) {
+        ssize_t copied = ::copy_file_range(src_fd, &off_in, dst_fd, &off_out, remaining, 0);
+        if (copied < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // Cross-filesystem copies or old kernels, let the portable path handle it
+            if (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP) {
+                fallback = true;
+            }
+            break;
+        }
+        if (copied == 0) {
+            break; // Source is shorter than expected
+        }
+        remaining -= static_cast<std::uint64_t>(copied);
+    }
+    ::close(dst_fd);
+    ::close(src_fd);
+
+    if (fallback) {
+        std::uint64_t done = length - remaining;
+        return StreamCopyRange(src, src_offset + done, dst, dst_offset + done, remaining);
+    }
+    return remaining == 0;
+#else
+    return StreamCopyRange(src, src_offset, dst, dst_offset, length);
+#endif
+}
+
+bool CloneFile(const fs::path& src, const fs::path& dst) {
+    std::error_code ec;
+#if defined(__linux__)
+    int src_fd = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (src_fd >= 0) {
+        int dst_fd = ::open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (dst_fd >= 0) {
+            bool cloned = ::ioctl(dst_fd, FICLONE, src_fd) == 0;
+            ::close(dst_fd);
+            ::close(src_fd);
+            if (cloned) {
+                spdlog::debug("Reflinked \"{}\" to \"{}\"", src.string(), dst.string());
+                return true;
+            }
+            return CopyRange(src, 0, dst, 0, fs::file_size(src, ec)) && !ec;
+        }
+        ::close(src_fd);
+    }
+#elif defined(__APPLE__)
+    fs::remove(dst, ec);
+    if (::clonefile(src.c_str(), dst.c_str(), 0) == 0) {
+        spdlog::debug("Cloned \"{}\" to \"{}\"", src.string(), dst.string());
+        return true;
+    }
+#endif
+    return fs::copy_file(src, dst, fs::copy_options::overwrite_existing, ec) && !ec;
+}
+
+} // namespace fileio
+
+} // namespace lansend::core
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace lansend::benchmark {
+
+// Wall time and process CPU time of a measured section, CPU time covers every thread so
+// loopback runs account for both the sending and the receiving side
+class Stopwatch {
+public:
+    Stopwatch()
+        : wall_start_(std::chrono::steady_clock::now())
+        , cpu_start_(std::clock()) {}
+
+    double wall_seconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start_)
+            .count();
+    }
+
+    double cpu_seconds() const {
+        return static_cast<double>(std::clock() - cpu_start_) / CLOCKS_PER_SEC;
+    }
+
+private:
+    std::chrono::steady_clock::time_point wall_start_;
+    std::clock_t cpu_start_;
+};
+
+// Returns the process exit code
+using BenchmarkFunc = int (*)(const std::vector<std::string_view>& args);
+
+int RunTransferBenchmark(const std::vector<std::string_view>& args);
+int RunHandshakeBenchmark(const std::vector<std::string_view>& args);
+int RunCryptoBenchmark(const std::vector<std::string_view>& args);
+int RunMulticastBenchmark(const std::vector<std::string_view>& args);
+
+} // namespace lansend::benchmark
@@ -9,8 +9,13 @@ public:
     static constexpr std::string_view kPing = "/ping";
     static constexpr std::string_view kConnect = "/connect";
     static constexpr std::string_view kRequestSend = "/request-send";
+    static constexpr std::string_view kWaitTurn = "/wait-turn";
     static constexpr std::string_view kSendChunk = "/send-chunk";
+    static constexpr std::string_view kSendBatch = "/send-batch";
     static constexpr std::string_view kVerifyIntegrity = "/verify-integrity";
+    static constexpr std::string_view kMulticastDone = "/multicast-done";
+    static constexpr std::string_view kStream = "/stream";
+    static constexpr std::string_view kUploadFile = "/upload-file";
     static constexpr std::string_view kCancelSend = "/cancel-send";
     static constexpr std::string_view kCancelWait = "/cancel-wait";
 };
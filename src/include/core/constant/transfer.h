@@ -9,6 +9,63 @@ namespace transfer {
 constexpr size_t kDefaultChunkSize = 1 * 1024 * 1024; // 1 MB
 constexpr size_t kMaxChunkSize = 32 * 1024 * 1024;    // 32 MB
 
+// Files up to this size are packed together and sent through /send-batch
+constexpr size_t kPackedFileThreshold = 256 * 1024; // 256 KB
+constexpr size_t kMaxBatchSize = 4 * 1024 * 1024;   // 4 MB
+constexpr size_t kMaxBatchFiles = 1024;
+
+// Data frames sent ahead of their acks on a lansend-stream connection
+constexpr size_t kStreamWindow = 8;
+
+// A chunk request that failed with its connection, or got no response within
+// kChunkTimeoutSeconds, is sent again on a new connection up to kMaxChunkRetries times. Chunks
+// the receiver rejected are resent in up to as many rounds. Each retry waits twice as long as
+// the one before, starting at kChunkRetryBackoffMs.
+constexpr size_t kMaxChunkRetries = 3;
+constexpr size_t kChunkTimeoutSeconds = 60;
+constexpr size_t kChunkRetryBackoffMs = 250;
+// Chunks a receiver rejects in a session before it fails the session
+constexpr size_t kMaxRejectedChunks = 64;
+
+// Waiting for 100 Continue costs a round trip per request. Senders only wait on a session's first
+// chunk or batch request, which tells whether the receiver still takes the session, and on
+// bodies above this size.
+constexpr size_t kContinueBodyThreshold = 4 * 1024 * 1024; // 4 MB
+
+// Size of the reads a /upload-file body is consumed with
+constexpr size_t kUploadReadSize = 256 * 1024; // 256 KB
+
+// Request body limits: a chunk or a batch with its metadata, a send request with its inline
+// files, and any other request. A send request lists every file with its chunk checksums, about
+// 0.5 KB per file and 70 bytes per chunk, so a few hundred thousand files have to fit.
+constexpr size_t kMaxChunkBodySize = kMaxChunkSize + 64 * 1024;
+constexpr size_t kMaxBatchBodySize = kMaxBatchSize + 1024 * 1024;
+constexpr size_t kMaxRequestSendBodySize = 256 * 1024 * 1024; // 256 MB
+constexpr size_t kDefaultBodyLimit = 1 * 1024 * 1024;          // 1 MB
+
+// Chunk bodies above this size are handed to the route's handler before they are read
+constexpr size_t kStreamedBodyThreshold = 4 * 1024 * 1024; // 4 MB
+// Memory a streamed body holds at first: one default-size chunk and a read ahead of it. Handlers
+// grow the reservation to what they buffer beyond that.
+constexpr size_t kStreamedBodyReservation = kDefaultChunkSize + kUploadReadSize;
+// Request body memory across all connections before the server stops reading
+constexpr size_t kServerMemoryBudget = 256 * 1024 * 1024; // 256 MB
+
+// Files up to this size are embedded in the request-send payload, up to a total budget
+constexpr size_t kInlineFileThreshold = 64 * 1024;     // 64 KB
+constexpr size_t kMaxInlineTotalSize = 4 * 1024 * 1024; // 4 MB
+
+// Multicast rounds: payload bytes per datagram, which stays under an Ethernet MTU with the IP,
+// UDP and packet headers, and the data and repair symbols of an FEC block
+constexpr size_t kMulticastSymbolSize = 1280;
+constexpr size_t kMulticastDataSymbols = 32;
+constexpr size_t kMulticastRepairSymbols = 4;
+
+// lansend-datagram: the largest datagram sent, which stays under an Ethernet MTU with the IP and
+// UDP headers, and the time a datagram connection may go without any packet from the other side
+constexpr size_t kDatagramSize = 1400;
+constexpr size_t kDatagramIdleSeconds = 30;
+
 } // namespace transfer
 
 } // namespace lansend::core
\ No newline at end of file
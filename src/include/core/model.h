@@ -4,6 +4,8 @@
 #include "model/feedback.h"
 #include "model/file_receive_context.h"
 #include "model/file_type.h"
+#include "model/receive_session_context.h"
 #include "model/security_context.h"
+#include "model/session_stats.h"
 #include "model/session_status.h"
 #include "model/transfer_file_info.h"
\ No newline at end of file
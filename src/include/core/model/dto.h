@@ -1,7 +1,10 @@
 #pragma once
 
 #include "dto/file_dto.h"
+#include "dto/multicast_report_dto.h"
+#include "dto/request_queued_dto.h"
 #include "dto/request_send_dto.h"
 #include "dto/request_send_response_dto.h"
+#include "dto/send_batch_dto.h"
 #include "dto/send_chunk_dto.h"
 #include "dto/verify_integrity_dto.h"
\ No newline at end of file
@@ -3,20 +3,33 @@
 #include "../file_type.h"
 #include <nlohmann/json.hpp>
 #include <string>
+#include <vector>
 
 namespace lansend::core {
 
 struct FileDto {
-    std::string file_id;       // 文件唯一标识符
-    std::string file_name;     // 文件名
-    size_t file_size;          // 文件总大小
-    size_t chunk_size;         // 块大小
-    size_t total_chunks;       // 总块数
-    std::string file_checksum; // 整个文件的校验和
-    FileType file_type;        // 文件类型
+    std::string file_id;                      // 文件唯一标识符
+    std::string file_name;                    // 文件名
+    size_t file_size;                         // 文件总大小
+    size_t chunk_size;                        // 块大小
+    size_t total_chunks;                      // 总块数
+    std::string file_checksum;                // 整个文件的校验和
+    FileType file_type;                       // 文件类型
+    std::vector<std::string> chunk_checksums; // 每个块的校验和，接收方据此在本地去重
+    std::string relative_path;                // 文件夹传输时相对于文件夹上级目录的路径，单个文件为空
+    std::string inline_content;               // 随请求内联发送的小文件内容（base64），可为空
 
-    NLOHMANN_DEFINE_TYPE_INTRUSIVE(
-        FileDto, file_id, file_name, file_size, chunk_size, total_chunks, file_checksum, file_type);
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(FileDto,
+                                                file_id,
+                                                file_name,
+                                                file_size,
+                                                chunk_size,
+                                                total_chunks,
+                                                file_checksum,
+                                                file_type,
+                                                chunk_checksums,
+                                                relative_path,
+                                                inline_content);
 };
 
 } // namespace lansend::core
\ No newline at end of file
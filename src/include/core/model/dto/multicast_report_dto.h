@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <nlohmann/detail/macro_scope.hpp>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lansend::core {
+
+// 组播结束后接收方对 /multicast-done 的响应，发送方通过会话连接补发缺失的块
+struct MulticastReportDto {
+    // 文件ID到仍缺失的块编号的映射，已完成的文件不出现
+    std::unordered_map<std::string, std::vector<std::size_t>> missing_chunks;
+
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(MulticastReportDto, missing_chunks);
+};
+
+} // namespace lansend::core
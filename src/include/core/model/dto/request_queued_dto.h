@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <nlohmann/detail/macro_scope.hpp>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+
+namespace lansend::core {
+
+// Header carrying the queue ticket of a /wait-turn or /cancel-wait request
+constexpr std::string_view kQueueTicketHeader = "X-Lansend-Queue-Ticket";
+
+// 接收方正忙时，对发送请求的 202 Accepted 响应
+struct RequestQueuedDto {
+    std::string ticket;       // 排队凭证，发送方凭它在 /wait-turn 继续等待，轮到时即为会话ID
+    std::size_t position = 0; // 在等待队列中的位置，从1开始
+
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE(RequestQueuedDto, ticket, position);
+};
+
+} // namespace lansend::core
@@ -3,7 +3,9 @@
 #include "../device_info.h"
 #include "file_dto.h"
 #include <nlohmann/detail/macro_scope.hpp>
+#include <cstdint>
 #include <nlohmann/json.hpp>
+#include <string>
 #include <vector>
 
 namespace lansend::core {
@@ -11,8 +13,22 @@ namespace lansend::core {
 struct RequestSendDto {
     DeviceInfo device_info;     // 发送方的设备信息
     std::vector<FileDto> files; // 文件信息列表
+    // 接收方正忙时，发送方能否在等待队列中等待（202 Accepted 后通过 /wait-turn 保留位置）
+    bool queue_supported = false;
+    // 发送方提供的组播轮次（实验性），组地址为空表示不使用组播
+    std::string multicast_group;             // 组播组地址
+    std::uint16_t multicast_port = 0;        // 组播端口
+    std::uint64_t multicast_transfer_id = 0; // 区分同一组播组上的不同传输
+    std::string multicast_key;               // 组播数据报的 AES-256-GCM 密钥（base64）
 
-    NLOHMANN_DEFINE_TYPE_INTRUSIVE(RequestSendDto, device_info, files);
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(RequestSendDto,
+                                                device_info,
+                                                files,
+                                                queue_supported,
+                                                multicast_group,
+                                                multicast_port,
+                                                multicast_transfer_id,
+                                                multicast_key);
 };
 
 } // namespace lansend::core
@@ -1,16 +1,47 @@
 #pragma once
 
+#include <core/util/compression.h>
 #include <nlohmann/detail/macro_scope.hpp>
 #include <nlohmann/json.hpp>
 #include <unordered_map>
+#include <vector>
 
 namespace lansend::core {
 
 struct RequestSendResponseDto {
     std::string session_id;                                   // 服务器生成的会话ID
     std::unordered_map<std::string, std::string> file_tokens; // 文件ID到令牌的映射
+    // 文件ID到接收方已在本地满足（无需发送）的块编号的映射
+    std::unordered_map<std::string, std::vector<std::size_t>> satisfied_chunks;
+    // 接收方能够解压的块压缩算法
+    std::vector<CompressionAlgorithm> accepted_compressions;
+    // 接收方是否支持通过 /send-batch 接收打包的小文件
+    bool batch_supported = false;
+    // 接收方是否支持将连接升级为 lansend-stream 帧协议
+    bool stream_supported = false;
+    // 接收方是否支持通过 /upload-file 在一个分块传输编码的请求中上传整个文件
+    bool upload_supported = false;
+    // 接收方是否支持 Expect: 100-continue，在读取块数据前根据请求头拒绝上传
+    bool continue_supported = false;
+    // 已通过请求内联内容保存完成、无需再发送的文件ID
+    std::vector<std::string> inline_received;
+    // 接收方是否已加入组播组，组播结束后发送方经 /multicast-done 询问缺失的块
+    bool multicast_joined = false;
+    // 接收方是否支持将 lansend-stream 连接的数据帧改经 lansend-datagram（UDP）发送
+    bool datagram_supported = false;
 
-    NLOHMANN_DEFINE_TYPE_INTRUSIVE(RequestSendResponseDto, session_id, file_tokens);
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(RequestSendResponseDto,
+                                                session_id,
+                                                file_tokens,
+                                                satisfied_chunks,
+                                                accepted_compressions,
+                                                batch_supported,
+                                                stream_supported,
+                                                upload_supported,
+                                                continue_supported,
+                                                inline_received,
+                                                multicast_joined,
+                                                datagram_supported);
 };
 
 } // namespace lansend::core
\ No newline at end of file
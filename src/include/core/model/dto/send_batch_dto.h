@@ -0,0 +1,25 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+namespace lansend::core {
+
+struct BatchEntryDto {
+    std::string file_id;    // 文件唯一标识符
+    std::string file_token; // 文件令牌
+    size_t offset;          // 文件内容在批数据中的偏移
+    size_t size;            // 文件内容的字节数
+
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE(BatchEntryDto, file_id, file_token, offset, size);
+};
+
+struct SendBatchDto {
+    std::string session_id;             // 会话唯一标识符
+    std::vector<BatchEntryDto> entries; // 打包在本批数据中的文件
+
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE(SendBatchDto, session_id, entries);
+};
+
+} // namespace lansend::core
@@ -1,19 +1,33 @@
 #pragma once
 
+#include <core/util/compression.h>
 #include <nlohmann/json.hpp>
 #include <string>
 
 namespace lansend::core {
 
 struct SendChunkDto {
-    std::string session_id;     // 会话唯一标识符
-    std::string file_id;        // 文件唯一标识符
-    std::string file_token;     // 文件令牌
-    size_t current_chunk_index; // 当前块编号
-    std::string chunk_checksum; // 当前块的校验和
+    std::string session_id;           // 会话唯一标识符
+    std::string file_id;              // 文件唯一标识符
+    std::string file_token;           // 文件令牌
+    size_t current_chunk_index;       // 当前块编号
+    std::string chunk_checksum;       // 当前块（未压缩数据）的校验和
+    // 块数据的压缩算法
+    CompressionAlgorithm compression = CompressionAlgorithm::kNone;
+    size_t uncompressed_size = 0;     // 块数据压缩前的大小
+    bool is_final = false;            // 是否为该文件最后发送的块，接收方收到后直接完成校验
+    std::string file_checksum;        // 整个文件的校验和（仅最后一块携带）
 
-    NLOHMANN_DEFINE_TYPE_INTRUSIVE(
-        SendChunkDto, session_id, file_id, file_token, current_chunk_index, chunk_checksum);
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(SendChunkDto,
+                                                session_id,
+                                                file_id,
+                                                file_token,
+                                                current_chunk_index,
+                                                chunk_checksum,
+                                                compression,
+                                                uncompressed_size,
+                                                is_final,
+                                                file_checksum);
 };
 
-} // namespace lansend::core
\ No newline at end of file
+} // namespace lansend::core
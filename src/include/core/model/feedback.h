@@ -10,6 +10,7 @@
 #include "feedback/lost_device.h"
 #include "feedback/receive_session_end.h"
 #include "feedback/recipient_accepted.h"
+#include "feedback/recipient_busy.h"
 #include "feedback/recipient_declined.h"
 #include "feedback/request_receive_files.h"
 #include "feedback/send_session_end.h"
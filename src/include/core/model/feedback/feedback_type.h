@@ -13,6 +13,7 @@ enum class FeedbackType {
 
     kRecipientAccepted, // 对方同意接收文件（包含对方的device_id，文件名列表表示要接收的文件，以及session_id）
     kRecipientDeclined,    // 对方拒绝接收文件（只包含对方的device_id）
+    kRecipientBusy,        // 对方正忙，发送请求在对方的等待队列中（包含对方的device_id和排队位置）
     kFileSendingProgress,  // 正在发送文件时的发送进度（session_id，文件名，文件进度（百分比））
     kFileSendingCompleted, // 文件通过了整体的Hash校验，发送完成（只包含session_id和文件名）
     kSendSessionEnded,     // 发送会话结束的（包含session_id，是否成功，是否被对方取消，失败原因）
@@ -32,6 +33,7 @@ NLOHMANN_JSON_SERIALIZE_ENUM(FeedbackType,
                                  {FeedbackType::kNetworkError, "NetworkError"},
                                  {FeedbackType::kRecipientAccepted, "RecipientAccepted"},
                                  {FeedbackType::kRecipientDeclined, "RecipientDeclined"},
+                                 {FeedbackType::kRecipientBusy, "RecipientBusy"},
                                  {FeedbackType::kFileSendingProgress, "FileSendingProgress"},
                                  {FeedbackType::kFileSendingCompleted, "FileSendingCompleted"},
                                  {FeedbackType::kSendSessionEnded, "SendSessionEnded"},
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <nlohmann/json.hpp>
+#include <string>
+
+namespace lansend::core::feedback {
+
+struct RecipientBusy {
+    std::string device_id;
+    std::size_t position; // 在对方等待队列中的位置，从1开始
+
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE(RecipientBusy, device_id, position);
+};
+
+} // namespace lansend::core::feedback
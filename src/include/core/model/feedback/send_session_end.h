@@ -1,5 +1,6 @@
 #pragma once
 
+#include <core/model/session_stats.h>
 #include <nlohmann/json.hpp>
 #include <string>
 
@@ -11,9 +12,10 @@ struct SendSessionEnd {
     bool success = true;
     bool cancelled_by_receiver = false;
     std::string error_message;
+    SessionStats stats;
 
     NLOHMANN_DEFINE_TYPE_INTRUSIVE(
-        SendSessionEnd, session_id, success, cancelled_by_receiver, error_message);
+        SendSessionEnd, session_id, success, cancelled_by_receiver, error_message, stats);
 };
 
-} // namespace lansend::core::feedback
\ No newline at end of file
+} // namespace lansend::core::feedback
@@ -11,8 +11,40 @@ struct Settings {
     std::string pin_code;
     bool auto_receive;
     std::string save_dir;
+    bool compression;
+    bool stream_transport;
+    bool chunked_upload;
+    bool kernel_tls;
+    std::string certificate_key_type;
+    std::string tls_cipher_preference;
+    std::uint32_t max_receive_sessions;
+    std::uint32_t rate_limit;
+    std::uint32_t device_rate_limit;
+    std::string transfer_priority;
+    bool multicast_transport;
+    std::uint32_t multicast_rate;
+    bool udp_transport;
+    std::map<std::string, std::uint32_t> device_rate_limits;
 
-    NLOHMANN_DEFINE_TYPE_INTRUSIVE(Settings, port, pin_code, auto_receive, save_dir);
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE(Settings,
+                                   port,
+                                   pin_code,
+                                   auto_receive,
+                                   save_dir,
+                                   compression,
+                                   stream_transport,
+                                   chunked_upload,
+                                   kernel_tls,
+                                   certificate_key_type,
+                                   tls_cipher_preference,
+                                   max_receive_sessions,
+                                   rate_limit,
+                                   device_rate_limit,
+                                   transfer_priority,
+                                   multicast_transport,
+                                   multicast_rate,
+                                   udp_transport,
+                                   device_rate_limits);
 
     static Settings FromConfigSettings() {
         return Settings{
@@ -20,6 +52,20 @@ struct Settings {
             .pin_code = core::settings.pin_code,
             .auto_receive = core::settings.auto_receive,
             .save_dir = core::settings.save_dir.string(),
+            .compression = core::settings.compression,
+            .stream_transport = core::settings.stream_transport,
+            .chunked_upload = core::settings.chunked_upload,
+            .kernel_tls = core::settings.kernel_tls,
+            .certificate_key_type = core::settings.certificate_key_type,
+            .tls_cipher_preference = core::settings.tls_cipher_preference,
+            .max_receive_sessions = core::settings.max_receive_sessions,
+            .rate_limit = core::settings.rate_limit,
+            .device_rate_limit = core::settings.device_rate_limit,
+            .transfer_priority = core::settings.transfer_priority,
+            .multicast_transport = core::settings.multicast_transport,
+            .multicast_rate = core::settings.multicast_rate,
+            .udp_transport = core::settings.udp_transport,
+            .device_rate_limits = core::settings.device_rate_limits,
         };
     }
 };
@@ -2,19 +2,33 @@
 
 #include <filesystem>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 namespace lansend::core {
 
+// 可由本会话中先收到的文件提供的块
+struct LocalChunkSource {
+    std::string file_id;     // 源文件ID
+    std::size_t chunk_index; // 源文件中的块编号
+};
+
 struct ReceiveFileContext {
-    std::string file_name;                           // 文件名
-    std::filesystem::path temp_file_path;            // 临时文件路径
-    std::string file_token;                          // 文件令牌
-    size_t file_size;                                // 文件总大小
-    size_t chunk_size;                               // 块大小
-    size_t total_chunks;                             // 总块数
-    std::unordered_set<std::size_t> received_chunks; // 已接收块集合
-    std::string file_checksum;                       // 整个文件的校验和
+    std::string file_name;                                          // 文件名
+    std::string relative_path;                                      // 文件夹内的相对路径（可为空）
+    std::filesystem::path temp_file_path;                           // 临时文件路径
+    std::string file_token;                                         // 文件令牌
+    size_t file_size;                                               // 文件总大小
+    size_t chunk_size;                                              // 块大小
+    size_t total_chunks;                                            // 总块数
+    std::unordered_set<std::size_t> received_chunks;                // 已接收块集合
+    std::unordered_set<std::size_t> rejected_chunks;                // 校验失败、等待重发的块
+    std::string file_checksum;                                      // 整个文件的校验和
+    std::vector<std::string> chunk_checksums;                       // 每个块的校验和（发送方提供）
+    std::unordered_map<std::size_t, LocalChunkSource> local_chunks; // 由本会话其他文件提供的块
+    std::filesystem::path final_file_path;                          // 校验通过后的最终路径
+    bool finalizing = false;                                        // 正在校验整个文件
 };
 
 } // namespace lansend::core
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "file_receive_context.h"
+#include <chrono>
+#include <string>
+#include <unordered_map>
+
+namespace lansend::core {
+
+enum class ReceiveSessionStatus {
+    kIdle,    // 空闲状态，或会话已结束
+    kWaiting, // 等待用户确认
+    kWorking, // 接收中
+};
+
+// 一个发送方的接收会话，各会话互不影响
+struct ReceiveSessionContext {
+    std::string session_id;                                             // 会话ID
+    ReceiveSessionStatus status = ReceiveSessionStatus::kWaiting;       // 会话状态
+    std::string sender_device_id;                                       // 发送方设备ID
+    std::string sender_ip;                                              // 发送方IP
+    unsigned short sender_port = 0;                                     // 发送方端口
+    std::unordered_map<std::string, ReceiveFileContext> received_files; // 会话中的文件
+    std::size_t completed_file_count = 0;                               // 已完成的文件数
+    std::size_t rejected_chunk_count = 0;                               // 校验失败被拒绝的块数
+    bool cancelled_by_receiver = false;                                 // 是否由接收方取消
+    std::chrono::steady_clock::time_point ended_at;                     // 会话结束时间
+};
+
+} // namespace lansend::core
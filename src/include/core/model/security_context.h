@@ -4,11 +4,18 @@
 
 namespace lansend::core {
 
+enum class CertificateKeyType {
+    kEcdsaP256, // ECDSA P-256，默认
+    kEd25519,   // Ed25519
+    kRsa2048,   // RSA 2048，旧版本生成的证书
+};
+
 struct SecurityContext {
     std::string private_key_pem;
     std::string public_key_pem;
     std::string certificate_pem;
     std::string certificate_hash; // SHA-256 fingerprint
+    CertificateKeyType key_type = CertificateKeyType::kEcdsaP256;
 };
 
 } // namespace lansend::core
\ No newline at end of file
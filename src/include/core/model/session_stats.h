@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+namespace lansend::core {
+
+struct SessionStats {
+    std::size_t file_count = 0;                 // 会话中的文件数
+    std::uint64_t raw_bytes = 0;                // 文件内容总字节数
+    std::uint64_t wire_bytes = 0;               // 实际发送的块数据字节数
+    std::uint64_t deduplicated_bytes = 0;       // 接收方本地已有、无需发送的字节数
+    std::uint64_t multicast_bytes = 0;          // 接收方已从组播收到、无需再发送的字节数
+    std::uint64_t compressed_chunks = 0;        // 压缩后发送的块数
+    std::uint64_t compression_input_bytes = 0;  // 被压缩块的原始字节数
+    std::uint64_t compression_output_bytes = 0; // 被压缩块压缩后的字节数
+    std::uint64_t wasted_bytes = 0;             // 已发送但被接收方拒绝的请求体字节数
+    std::uint64_t retransmitted_bytes = 0;      // 丢包或被接收方拒绝后重发的字节数
+    double compression_ratio = 1.0;             // 原始大小 / 压缩后大小
+    double elapsed_seconds = 0.0;               // 会话耗时（秒）
+    double effective_throughput = 0.0;          // 有效吞吐量（MB/s，按原始字节计算）
+    double files_per_second = 0.0;              // 文件吞吐量（个/s）
+    double wire_rate = 0.0;                     // 实际线上速率（MB/s，按线上字节计算）
+    double target_rate = 0.0;                   // 带宽调度的目标速率上限（MB/s），0表示不限速
+    double throttled_seconds = 0.0;             // 等待带宽调度的时间（秒）
+
+    void Finish(double seconds) {
+        elapsed_seconds = seconds;
+        if (compression_output_bytes > 0) {
+            compression_ratio = static_cast<double>(compression_input_bytes)
+                                / compression_output_bytes;
+        }
+        if (seconds > 0) {
+            effective_throughput = raw_bytes / seconds / (1024.0 * 1024.0);
+            wire_rate = wire_bytes / seconds / (1024.0 * 1024.0);
+            files_per_second = file_count / seconds;
+        }
+    }
+
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE(SessionStats,
+                                   file_count,
+                                   raw_bytes,
+                                   wire_bytes,
+                                   deduplicated_bytes,
+                                   multicast_bytes,
+                                   compressed_chunks,
+                                   compression_input_bytes,
+                                   compression_output_bytes,
+                                   wasted_bytes,
+                                   retransmitted_bytes,
+                                   compression_ratio,
+                                   elapsed_seconds,
+                                   effective_throughput,
+                                   files_per_second,
+                                   wire_rate,
+                                   target_rate,
+                                   throttled_seconds);
+};
+
+} // namespace lansend::core
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <core/model/file_type.h>
 #include <filesystem>
 #include <string>
+#include <unordered_set>
+#include <vector>
 
 namespace lansend::core {
 
@@ -10,6 +13,14 @@ struct TransferFileInfo {
     size_t file_size;
     size_t total_chunks;
     std::string file_token;
+    std::string file_checksum;
+    std::vector<std::string> chunk_checksums;
+    std::unordered_set<std::size_t> satisfied_chunks; // Chunks the receiver already has locally
+    std::unordered_set<std::size_t> multicast_chunks; // Those of them it got from a multicast round
+    std::unordered_set<std::size_t> acked_chunks;     // Chunks the receiver confirmed
+    std::unordered_set<std::size_t> rejected_chunks;  // Chunks the receiver asked for again
+    FileType file_type;
+    bool delivered_inline = false; // Saved by the receiver from the request-send payload
 };
 
-} // namespace lansend::core
\ No newline at end of file
+} // namespace lansend::core
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <array>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace lansend::core {
+
+// Classes of transfers sharing the bandwidth, a class gets its weight's share of a contended
+// link. Lower classes still make progress, they are never starved.
+enum class TransferPriority {
+    kInteractive,
+    kNormal,
+    kBackground,
+};
+
+class BandwidthScheduler;
+
+// Tokens of a rate limit, in bytes. Negative while paying off a request larger than the burst.
+struct TokenBucket {
+    double tokens = 0.0;
+    std::chrono::steady_clock::time_point refilled_at;
+};
+
+// A session's share of the bandwidth, sending or receiving. Leaves the scheduler when destroyed.
+class BandwidthFlow {
+public:
+    BandwidthFlow() = default;
+    ~BandwidthFlow();
+
+    BandwidthFlow(BandwidthFlow&& other) noexcept;
+    BandwidthFlow& operator=(BandwidthFlow&& other) noexcept;
+
+    BandwidthFlow(const BandwidthFlow&) = delete;
+    BandwidthFlow& operator=(const BandwidthFlow&) = delete;
+
+    explicit operator bool() const { return scheduler_ != nullptr; }
+
+    // Wait until `bytes` more may cross the network, returns right away without a scheduler
+    boost::asio::awaitable<void> Acquire(std::size_t bytes);
+
+    // Cap the flow on top of the global and device limits, 0 removes the cap. Used by senders
+    // that adapt their own rate.
+    void SetRateLimit(double rate);
+
+    // Bytes per second the flow is capped at by all its limits, 0 if none
+    double target_rate() const;
+    // Bytes per second the flow actually got since it was registered
+    double actual_rate() const;
+    std::uint64_t bytes() const { return bytes_; }
+    // Time spent waiting for the scheduler
+    double throttled_seconds() const { return throttled_seconds_; }
+
+private:
+    friend class BandwidthScheduler;
+
+    BandwidthFlow(std::shared_ptr<BandwidthScheduler> scheduler,
+                  std::string peer,
+                  TransferPriority priority,
+                  double weight);
+
+    void leave();
+
+    std::shared_ptr<BandwidthScheduler> scheduler_;
+    std::string peer_; // Device id, or the address when the device is unknown
+    TransferPriority priority_ = TransferPriority::kNormal;
+    double weight_ = 1.0;
+    double rate_limit_ = 0.0;
+    TokenBucket bucket_;
+    double last_finish_ = 0.0; // Virtual time its last grant finished at
+    std::uint64_t bytes_ = 0;
+    double throttled_seconds_ = 0.0;
+    std::chrono::steady_clock::time_point registered_at_;
+};
+
+// Token buckets shared by every send and receive session: one for all transfers together and
+// one per device, both refilled at the rates in settings. Sessions waiting for tokens are
+// served in start-time fair queueing order by their weight, so that a bulk send can't starve
+// the others. Without limits the flows only count their bytes.
+class BandwidthScheduler : public std::enable_shared_from_this<BandwidthScheduler> {
+public:
+    struct ClassStats {
+        std::uint64_t bytes = 0;
+        std::uint64_t waits = 0; // Grants that had to wait for tokens
+    };
+
+    struct Stats {
+        double target_rate = 0.0; // Bytes per second, 0 if unlimited
+        double actual_rate = 0.0; // Bytes per second over the last measuring window
+        std::size_t flows = 0;
+        std::array<ClassStats, 3> classes{}; // Indexed by TransferPriority
+    };
+
+    static std::shared_ptr<BandwidthScheduler> Create(boost::asio::io_context& ioc);
+
+    BandwidthScheduler(const BandwidthScheduler&) = delete;
+    BandwidthScheduler& operator=(const BandwidthScheduler&) = delete;
+
+    // `peer` names the device at the other end, `weight` scales the priority class's weight
+    BandwidthFlow Register(std::string peer,
+                           TransferPriority priority = TransferPriority::kNormal,
+                           double weight = 1.0);
+
+    // Apply changed limits in settings to the transfers waiting right now
+    void Reconfigure();
+
+    Stats stats() const;
+
+    // Bytes per second allowed for all transfers, and for the transfers of one device
+    static double GlobalLimit();
+    static double DeviceLimit(std::string_view peer);
+
+    static std::optional<TransferPriority> ParsePriority(std::string_view name);
+    static std::string_view PriorityName(TransferPriority priority);
+    static double PriorityWeight(TransferPriority priority);
+
+    // Tokens a bucket may save up, as time at its rate
+    static constexpr std::chrono::milliseconds kBurstTime{50};
+    // Window the actual rate is measured over
+    static constexpr std::chrono::seconds kRateWindow{1};
+
+private:
+    friend class BandwidthFlow;
+
+    using Bucket = TokenBucket;
+
+    struct Peer {
+        Bucket bucket;
+        std::size_t flows = 0;
+    };
+
+    struct Waiter {
+        BandwidthFlow* flow;
+        std::size_t bytes;
+        double start; // Virtual start time, the smallest one is served first
+        bool granted = false;
+        boost::asio::steady_timer* wakeup;
+    };
+
+    // Lists a waiter while its acquire() waits. A coroutine destroyed before its grant takes the
+    // waiter off the list, so that no dangling waiter is left behind.
+    class WaiterRegistration {
+    public:
+        WaiterRegistration(std::shared_ptr<BandwidthScheduler> scheduler, Waiter& waiter);
+        ~WaiterRegistration();
+
+        WaiterRegistration(const WaiterRegistration&) = delete;
+        WaiterRegistration& operator=(const WaiterRegistration&) = delete;
+
+    private:
+        std::shared_ptr<BandwidthScheduler> scheduler_;
+        Waiter& waiter_;
+    };
+
+    explicit BandwidthScheduler(boost::asio::io_context& ioc);
+
+    boost::asio::awaitable<void> acquire(BandwidthFlow& flow, std::size_t bytes);
+    void join(const std::string& peer);
+    void leave(const std::string& peer);
+    // Hand out tokens to waiters in order and arm the refill timer for the rest
+    void dispatch();
+    void grant(Waiter& waiter);
+    // Seconds until the device and flow buckets let the waiter go
+    double waitSeconds(const Waiter& waiter) const;
+    static double debtSeconds(const Bucket& bucket, double rate);
+    void account(BandwidthFlow& flow, std::size_t bytes);
+    static void refill(Bucket& bucket, double rate, std::chrono::steady_clock::time_point now);
+
+    boost::asio::io_context& ioc_;
+    Bucket global_;
+    std::unordered_map<std::string, Peer> peers_;
+    std::vector<Waiter*> waiters_;
+    double virtual_time_ = 0.0;
+    boost::asio::steady_timer refill_timer_;
+    std::size_t flows_ = 0;
+    std::array<ClassStats, 3> classes_{};
+    std::chrono::steady_clock::time_point window_start_;
+    std::uint64_t window_bytes_ = 0;
+    double actual_rate_ = 0.0;
+};
+
+} // namespace lansend::core
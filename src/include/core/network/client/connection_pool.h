@@ -0,0 +1,118 @@
+#pragma once
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/io_context.hpp>
+#include <chrono>
+#include <core/network/client/http_client.h>
+#include <core/security/certificate_manager.h>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace lansend::core {
+
+class ConnectionPool;
+
+struct ConnectionPoolStats {
+    std::uint64_t leases = 0;    // Connections handed out
+    std::uint64_t reused = 0;    // Of which were warm connections from the pool
+    std::uint64_t expired = 0;   // Idle connections closed after kIdleTimeout
+    std::uint64_t unhealthy = 0; // Idle connections found closed by the peer
+};
+
+// Exclusive use of one connection to a device. Unless discarded, the connection goes back to the
+// pool when the lease ends, connections closed or upgraded in the meantime are dropped then.
+class ConnectionLease {
+public:
+    ConnectionLease() = default;
+    ~ConnectionLease();
+
+    ConnectionLease(ConnectionLease&& other) noexcept = default;
+    ConnectionLease& operator=(ConnectionLease&& other) noexcept;
+
+    ConnectionLease(const ConnectionLease&) = delete;
+    ConnectionLease& operator=(const ConnectionLease&) = delete;
+
+    explicit operator bool() const { return client_ != nullptr; }
+
+    HttpsClient& operator*() const { return *client_; }
+    HttpsClient* operator->() const { return client_.get(); }
+
+    // Whether the connection was taken warm from the pool instead of newly established
+    bool reused() const { return reused_; }
+
+    // Close the connection instead of returning it, e.g. after a request failed halfway
+    void Discard();
+
+    // Return the connection to the pool now
+    void Release();
+
+private:
+    friend class ConnectionPool;
+
+    ConnectionLease(std::weak_ptr<ConnectionPool> pool,
+                    std::string key,
+                    std::unique_ptr<HttpsClient> client,
+                    bool reused);
+
+    std::weak_ptr<ConnectionPool> pool_; // The pool may go first at shutdown
+    std::string key_;
+    std::unique_ptr<HttpsClient> client_;
+    bool reused_ = false;
+};
+
+// Keep-alive connections to other devices, kept warm between operations so that back-to-back
+// requests and sessions to the same device skip the TCP and TLS setup. Idle connections are
+// closed after kIdleTimeout, well before the server gives up on them, and checked for a close
+// by the peer before they are leased again.
+class ConnectionPool : public std::enable_shared_from_this<ConnectionPool> {
+public:
+    static std::shared_ptr<ConnectionPool> Create(boost::asio::io_context& ioc,
+                                                  CertificateManager& cert_manager);
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    // Lease a connection to the device at host:port, an empty lease if it can't be reached.
+    // `device_id` only narrows which cached TLS session may be resumed.
+    boost::asio::awaitable<ConnectionLease> Acquire(std::string host,
+                                                    unsigned short port,
+                                                    std::string device_id = {});
+
+    // Close all idle connections
+    void Clear();
+
+    const ConnectionPoolStats& stats() const { return stats_; }
+
+    static constexpr std::chrono::seconds kIdleTimeout{20}; // The server waits for 30s
+    static constexpr std::size_t kMaxIdlePerDevice = 2;
+
+private:
+    friend class ConnectionLease;
+
+    ConnectionPool(boost::asio::io_context& ioc, CertificateManager& cert_manager);
+
+    struct IdleConnection {
+        std::unique_ptr<HttpsClient> client;
+        std::chrono::steady_clock::time_point idle_since;
+    };
+
+    static std::string endpointKey(std::string_view host, unsigned short port);
+
+    void release(const std::string& key, std::unique_ptr<HttpsClient> client);
+    // Close expired idle connections until there are none left
+    boost::asio::awaitable<void> reapIdle();
+
+    boost::asio::io_context& ioc_;
+    CertificateManager& cert_manager_;
+    // By device endpoint, most recently used last
+    std::unordered_map<std::string, std::vector<IdleConnection>> idle_;
+    bool reaping_ = false;
+    ConnectionPoolStats stats_;
+};
+
+} // namespace lansend::core
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <core/util/binary_message.h>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace lansend::core {
+
+// Chunks read from disk once for all the sessions of a fan-out send. The first session to reach
+// a chunk reads it, the buffer is then kept for the other receivers until each of them took it.
+// Every receiver may hold back at most kReceiverBudget bytes this way: once a slow receiver is
+// further behind, its oldest chunks are let go and it reads them from disk itself when it gets
+// there, so it never holds up or bloats the others.
+class FanoutChunkCache {
+public:
+    explicit FanoutChunkCache(std::size_t receivers,
+                              std::size_t receiver_budget = kReceiverBudget);
+    ~FanoutChunkCache();
+
+    FanoutChunkCache(const FanoutChunkCache&) = delete;
+    FanoutChunkCache& operator=(const FanoutChunkCache&) = delete;
+
+    // The chunk `key` as `receiver` needs it next, from the cache or from `read`. Receivers take
+    // chunks in the same order, chunks a receiver skips are let go when it moves past them.
+    std::shared_ptr<const BinaryData> Read(std::size_t receiver,
+                                           const std::string& key,
+                                           const std::function<BinaryData()>& read);
+
+    // The receiver's session ended, nothing is kept for it anymore
+    void Leave(std::size_t receiver);
+
+    std::uint64_t disk_reads() const { return disk_reads_; }
+    std::uint64_t hits() const { return hits_; }
+    // Chunks read again by receivers that fell behind their budget
+    std::uint64_t rereads() const { return rereads_; }
+
+    static constexpr std::size_t kReceiverBudget = 64 * 1024 * 1024;
+
+private:
+    struct Entry {
+        std::shared_ptr<const BinaryData> data;
+        std::vector<bool> waiting; // Indexed by receiver
+        std::size_t waiting_count = 0;
+    };
+
+    struct Receiver {
+        std::deque<std::string> pinned; // Chunks kept for the receiver, in reading order
+        std::size_t pinned_bytes = 0;
+        bool active = true;
+    };
+
+    // Stop keeping the chunk for the receiver, the chunk goes once nobody waits for it
+    void release(std::size_t receiver, const std::string& key);
+
+    std::size_t receiver_budget_;
+    std::vector<Receiver> receivers_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::unordered_set<std::string> published_; // Chunks that were handed to the receivers
+    std::uint64_t disk_reads_ = 0;
+    std::uint64_t hits_ = 0;
+    std::uint64_t rereads_ = 0;
+};
+
+} // namespace lansend::core
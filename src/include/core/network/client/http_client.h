@@ -2,14 +2,20 @@
 
 #include <boost/asio/awaitable.hpp>
 #include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
 #include <boost/beast/core/flat_buffer.hpp>
 #include <boost/beast/core/tcp_stream.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/http/string_body_fwd.hpp>
 #include <boost/beast/ssl.hpp>
 #include <boost/beast/version.hpp>
+#include <chrono>
 #include <core/constant/route.h>
+#include <core/network/datagram/datagram_packet.h>
+#include <core/network/stream/stream_frame.h>
 #include <core/security/certificate_manager.h>
+#include <core/security/tls_session_cache.h>
+#include <optional>
 #include <string>
 
 namespace beast = boost::beast;
@@ -28,14 +34,29 @@ public:
     HttpsClient(const HttpsClient&) = delete;
     HttpsClient& operator=(const HttpsClient&) = delete;
 
-    net::awaitable<bool> Connect(std::string_view host, unsigned short port);
+    // `device_id` only narrows which cached TLS session may be resumed
+    net::awaitable<bool> Connect(std::string_view host,
+                                 unsigned short port,
+                                 std::string_view device_id = {});
 
     net::awaitable<bool> Disconnect();
 
     bool IsConnected() const;
 
+    // Whether a connection between requests can take the next one, i.e. the peer hasn't closed it
+    // and nothing unexpected is waiting to be read
+    bool IsIdleHealthy();
+
     std::optional<boost::asio::ip::tcp::endpoint> local_endpoint() const;
 
+    // The connection's TCP socket for socket options, nullptr while not connected
+    tcp::socket* socket();
+
+    // Operations on the connection fail with beast::error::timeout once `timeout` passed, until
+    // ExpiresNever() is called. The connection can't be used after a timeout.
+    void ExpiresAfter(std::chrono::steady_clock::duration timeout);
+    void ExpiresNever();
+
     std::string current_host() const;
 
     unsigned short current_port() const;
@@ -43,19 +64,66 @@ public:
     template<typename RequestBody>
     net::awaitable<http::response<http::string_body>> SendRequest(http::request<RequestBody>& req);
 
+    // Send a request with Expect: 100-continue, the body is only written once the server asked
+    // for it. A final response in place of 100 Continue is returned as the response, the server
+    // closes the connection then. `body_sent` tells whether the body went out.
+    template<typename RequestBody>
+    net::awaitable<http::response<http::string_body>> SendRequestWithContinue(
+        http::request<RequestBody>& req, bool* body_sent = nullptr);
+
     template<typename Body>
     http::request<Body> CreateRequest(http::verb method,
                                       const std::string& target,
                                       bool keepAlive = true);
 
+    // Switch the connection from HTTP to lansend-stream frames for the given session.
+    // Returns false if the server refused, the connection then still speaks HTTP.
+    net::awaitable<bool> UpgradeToStream(std::string_view session_id);
+
+    // Where the data frames of a connection upgraded to lansend-datagram go, and their keys
+    struct DatagramUpgrade {
+        boost::asio::ip::udp::endpoint receiver;
+        DatagramKeys keys;
+    };
+
+    // Switch the connection to lansend-datagram: the sender's frames go over UDP to the port the
+    // server opened, the server's acks and errors still come as frames on this connection.
+    // Returns std::nullopt if the server refused, the connection then still speaks HTTP.
+    net::awaitable<std::optional<DatagramUpgrade>> UpgradeToDatagram(std::string_view session_id);
+
+    net::awaitable<void> WriteFrame(FrameType type,
+                                    std::uint8_t flags,
+                                    std::uint32_t stream_id,
+                                    std::span<const std::uint8_t> payload = {});
+
+    net::awaitable<void> WriteDataFrame(std::uint8_t flags,
+                                        std::uint32_t stream_id,
+                                        const DataFrameInfo& info,
+                                        std::span<const std::uint8_t> data);
+
+    net::awaitable<Frame> ReadFrame();
+
+    // Upload a whole file in one request with chunked transfer encoding: BeginUpload writes the
+    // header, each WriteUploadRecord one data frame as a body chunk, and FinishUpload ends the
+    // body and reads the response
+    net::awaitable<void> BeginUpload(std::string_view session_id,
+                                     std::string_view file_id,
+                                     std::string_view file_token);
+
+    net::awaitable<void> WriteUploadRecord(std::uint8_t flags,
+                                           const DataFrameInfo& info,
+                                           std::span<const std::uint8_t> data);
+
+    net::awaitable<http::response<http::string_body>> FinishUpload();
+
 private:
     net::io_context& ioc_;
     CertificateManager& cert_manager_;
-    ssl::context ssl_ctx_;
+    TlsSessionCache& session_cache_; // Shared client context and resumable sessions
     std::unique_ptr<beast::ssl_stream<beast::tcp_stream>> connection_;
     std::string current_host_;
     unsigned short current_port_ = 0;
-    SSL_SESSION* ssl_session_ = nullptr;
+    beast::flat_buffer frame_buffer_; // Bytes read ahead on an upgraded connection
 };
 
 template<typename RequestBody>
@@ -74,6 +142,37 @@ net::awaitable<http::response<http::string_body>> HttpsClient::SendRequest(
     co_return res;
 }
 
+template<typename RequestBody>
+net::awaitable<http::response<http::string_body>> HttpsClient::SendRequestWithContinue(
+    http::request<RequestBody>& req, bool* body_sent) {
+    if (!connection_) {
+        throw std::runtime_error("No active connection");
+    }
+    if (body_sent != nullptr) {
+        *body_sent = false;
+    }
+
+    req.set(http::field::expect, "100-continue");
+    http::request_serializer<RequestBody> serializer(req);
+    co_await http::async_write_header(*connection_, serializer);
+
+    beast::flat_buffer buffer;
+    http::response<http::string_body> res;
+    co_await http::async_read(*connection_, buffer, res);
+    if (res.result() != http::status::continue_) {
+        co_return res;
+    }
+
+    co_await http::async_write(*connection_, serializer);
+    if (body_sent != nullptr) {
+        *body_sent = true;
+    }
+
+    res = {};
+    co_await http::async_read(*connection_, buffer, res);
+    co_return res;
+}
+
 template<typename Body>
 http::request<Body> HttpsClient::CreateRequest(http::verb method,
                                                const std::string& target,
@@ -85,7 +184,8 @@ http::request<Body> HttpsClient::CreateRequest(http::verb method,
     }
 
     req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-    if (target == ApiRoute::kSendChunk) {
+    if (target == ApiRoute::kSendChunk || target == ApiRoute::kSendBatch
+        || target == ApiRoute::kUploadFile) {
         req.set(http::field::content_type, "application/octet-stream");
     } else {
         req.set(http::field::content_type, "application/json");
@@ -3,7 +3,10 @@
 #include "send_session_manager.h"
 #include <boost/asio/io_context.hpp>
 #include <core/model.h>
+#include <core/network/bandwidth_scheduler.h>
+#include <core/network/client/connection_pool.h>
 #include <core/security/certificate_manager.h>
+#include <memory>
 #include <string>
 #include <string_view>
 
@@ -11,9 +14,12 @@ namespace lansend::core {
 
 class HttpClientService {
 public:
+    // Sends are scheduled by `bandwidth` when it is shared with the server, otherwise by a
+    // scheduler of their own
     HttpClientService(boost::asio::io_context& ioc,
                       CertificateManager& cert_manager,
-                      FeedbackCallback callback = nullptr);
+                      FeedbackCallback callback = nullptr,
+                      std::shared_ptr<BandwidthScheduler> bandwidth = nullptr);
     ~HttpClientService() = default;
 
     void SetFeedbackCallback(FeedbackCallback callback);
@@ -30,6 +36,9 @@ public:
                    const std::vector<std::filesystem::path>& file_paths,
                    std::string_view device_id = {});
 
+    void SendFanout(const std::vector<SendTarget>& targets,
+                    const std::vector<std::filesystem::path>& file_paths);
+
     void CancelSend(const std::string& session_id);
 
     void CancelWaitForConfirmation(std::string_view ip, unsigned short port);
@@ -37,6 +46,7 @@ public:
 private:
     boost::asio::io_context& ioc_;
     CertificateManager& cert_manager_;
+    std::shared_ptr<ConnectionPool> connection_pool_; // Shared by all requests and sessions
     SendSessionManager send_session_manager_;
     FeedbackCallback callback_;
 
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http.hpp>
+#include <core/network/stream/stream_frame.h>
+#include <core/security/certificate_manager.h>
+#include <core/security/open_ssl_provider.h>
+#include <filesystem>
+#include <span>
+#include <string_view>
+
+namespace lansend::core {
+
+// Sends /upload-file requests on a connection whose records are encrypted by the kernel, so
+// that chunk data goes from the file to the socket with SSL_sendfile without being copied
+// through user space. OpenSSL drives the socket directly here, kTLS can't be enabled behind
+// boost::asio's SSL stream which keeps its own record buffers.
+class KtlsUploader {
+public:
+    KtlsUploader(boost::asio::io_context& ioc, CertificateManager& cert_manager);
+    ~KtlsUploader();
+
+    KtlsUploader(const KtlsUploader&) = delete;
+    KtlsUploader& operator=(const KtlsUploader&) = delete;
+
+    // Connect and handshake, returns false if connecting failed or the kernel did not take over
+    // the encryption, e.g. without the tls module or with an unsupported cipher
+    boost::asio::awaitable<bool> Connect(std::string_view host, unsigned short port);
+
+    void Close();
+
+    boost::asio::ip::tcp::socket& socket() { return socket_; }
+
+    // Same request as HttpsClient::BeginUpload, chunks are then read from `file_path`
+    boost::asio::awaitable<void> BeginUpload(std::string_view session_id,
+                                             std::string_view file_id,
+                                             std::string_view file_token,
+                                             const std::filesystem::path& file_path);
+
+    // Send one data frame whose chunk is the uncompressed file range [offset, offset + size)
+    boost::asio::awaitable<void> WriteUploadRecord(std::uint8_t flags,
+                                                   const DataFrameInfo& info,
+                                                   std::uint64_t offset,
+                                                   std::size_t size);
+
+    boost::asio::awaitable<boost::beast::http::response<boost::beast::http::string_body>>
+    FinishUpload();
+
+private:
+    // Wait until the socket is ready for the operation OpenSSL asked for, throws on other errors
+    boost::asio::awaitable<void> waitFor(int result);
+    boost::asio::awaitable<void> write(std::span<const std::uint8_t> data);
+    boost::asio::awaitable<void> write(std::string_view data);
+    boost::asio::awaitable<void> sendFile(std::uint64_t offset, std::size_t size);
+    void closeFile();
+
+    boost::asio::io_context& ioc_;
+    boost::asio::ssl::context ssl_ctx_;
+    boost::asio::ip::tcp::socket socket_;
+    SSL* ssl_ = nullptr;
+    std::string host_;
+    unsigned short port_ = 0;
+    int file_fd_ = -1; // Source of the current upload
+    boost::beast::flat_buffer read_buffer_;
+};
+
+} // namespace lansend::core
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <boost/asio/ip/tcp.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+
+namespace lansend::core {
+
+// Sending rate of a background session that yields to other traffic, after LEDBAT (RFC 6817).
+//
+// The one way delay LEDBAT measures isn't available to a plain TLS connection, so the delay
+// samples are the connection's RTT from the kernel or else the time a chunk request took. The
+// lowest sample of the last minutes is the base delay, anything above it is queueing in front of
+// the bottleneck. The rate grows while the queueing delay is below kTargetDelay and shrinks in
+// proportion as soon as it is above, so the session backs off before other flows notice the
+// queue it builds up. The rate stands in for the congestion window, it is enforced by the
+// session's bandwidth flow.
+class LedbatController {
+public:
+    LedbatController();
+
+    // Feed back one delay sample
+    void OnDelay(std::chrono::microseconds delay);
+
+    // Feed back bytes handed to the connection, the rate doesn't grow past what is really sent
+    void OnSent(std::size_t bytes);
+
+    // Bytes per second the session may send
+    double rate() const { return rate_; }
+
+    std::chrono::microseconds base_delay() const;
+    std::chrono::microseconds queuing_delay() const;
+
+    // Make the socket yield to other connections where the platform allows: TCP-LP as the
+    // congestion control and the lower effort DSCP. Failures are ignored, the rate control above
+    // works on its own.
+    static void UseLowerEffort(boost::asio::ip::tcp::socket& socket);
+
+    // Smoothed RTT the kernel measured for the connection, std::nullopt if not available
+    static std::optional<std::chrono::microseconds> SocketRtt(boost::asio::ip::tcp::socket& socket);
+
+    // LEDBAT's 100 ms is meant for the internet, a LAN queue that long is already noticeable
+    static constexpr std::chrono::milliseconds kTargetDelay{25};
+    static constexpr double kMinRate = 64.0 * 1024;
+    static constexpr double kInitialRate = 4.0 * 1024 * 1024;
+
+private:
+    struct BaseDelay {
+        std::chrono::steady_clock::time_point minute; // Start of the minute the entry covers
+        std::chrono::microseconds delay;
+    };
+
+    void adjust();
+
+    std::deque<BaseDelay> base_delays_;              // Lowest delay of each of the last minutes
+    std::deque<std::chrono::microseconds> current_; // Last few samples, the lowest one counts
+    double rate_{kInitialRate};
+    double sent_rate_{0.0}; // Bytes per second measured over kRateWindow
+    std::chrono::steady_clock::time_point window_start_;
+    std::uint64_t window_bytes_{0};
+
+    static constexpr double kGain = 0.25;
+    static constexpr double kMaxDecrease = 0.5;
+    static constexpr std::size_t kBaseHistory = 10;
+    static constexpr std::size_t kCurrentFilter = 4;
+    static constexpr std::chrono::seconds kRateWindow{1};
+};
+
+} // namespace lansend::core
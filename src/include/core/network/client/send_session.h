@@ -2,65 +2,207 @@
 
 #include "core/model/feedback.h"
 #include <boost/asio.hpp>
+#include <filesystem>
+#include <fstream>
 #include <core/constant/transfer.h>
 #include <core/model.h>
+#include <core/network/bandwidth_scheduler.h>
+#include <core/network/client/connection_pool.h>
+#include <core/network/client/fanout_chunk_cache.h>
 #include <core/network/client/http_client.h>
+#include <core/network/client/ktls_uploader.h>
+#include <core/network/client/ledbat_controller.h>
+#include <core/network/datagram/datagram_sender.h>
+#include <core/network/stream/stream_frame.h>
 #include <core/security/certificate_manager.h>
 #include <core/security/file_hasher.h>
 #include <core/util/binary_message.h>
+#include <core/util/compression.h>
+#include <memory>
+#include <optional>
 #include <string>
 #include <unordered_map>
 
 namespace lansend::core {
 
+class MulticastRound;
+
 using SessionStartedCallback = std::function<void()>;
 using SessionCleanupCallback = std::function<void()>;
 
+// A file hashed for sending, the sessions of a fan-out share them
+struct PreparedFile {
+    FileDto dto;
+    std::filesystem::path path;
+};
+using PreparedFiles = std::vector<PreparedFile>;
+
 class SendSession {
     friend class SendSessionManager;
 
 public:
     SendSession(boost::asio::io_context& ioc,
                 CertificateManager& cert_manager,
+                std::shared_ptr<ConnectionPool> connection_pool,
+                std::shared_ptr<BandwidthScheduler> bandwidth,
                 FeedbackCallback callback = nullptr);
-    ~SendSession() = default;
+    ~SendSession();
 
     SendSession(const SendSession&) = delete;
     SendSession& operator=(const SendSession&) = delete;
 
     SessionStatus session_status() const { return session_status_; }
 
+    const SessionStats& stats() const { return stats_; }
+
     std::string session_id() const { return session_id_; }
 
     void RecordReceiverId(std::string_view receiver_id) { receiver_device_id_ = receiver_id; }
 
+    // Read chunks through a cache shared with the other receivers of a fan-out
+    void JoinFanout(std::shared_ptr<FanoutChunkCache> cache, std::size_t receiver) {
+        fanout_ = std::move(cache);
+        fanout_receiver_ = receiver;
+    }
+
+    // Offer the receiver a multicast round shared with the other sessions of a fan-out
+    void JoinMulticast(std::shared_ptr<MulticastRound> round) { multicast_ = std::move(round); }
+
     void Cancel();
 
     bool IsCancelled() const;
 
-    boost::asio::awaitable<void> Start(const std::vector<std::filesystem::path>& file_paths,
-                                       std::string_view host,
-                                       unsigned int port,
+    boost::asio::awaitable<void> Start(std::vector<std::filesystem::path> file_paths,
+                                       std::string host,
+                                       unsigned short port,
+                                       SessionStartedCallback callback = nullptr);
+
+    // Same with files prepared beforehand, e.g. once for all receivers of a fan-out
+    boost::asio::awaitable<void> Start(std::shared_ptr<const PreparedFiles> prepared_files,
+                                       std::string host,
+                                       unsigned short port,
                                        SessionStartedCallback callback = nullptr);
 
+    // Expand folders and hash all files
+    static PreparedFiles PrepareFiles(const std::vector<std::filesystem::path>& file_paths);
+
 private:
     boost::asio::awaitable<bool> requestSend(const RequestSendDto& dto);
     boost::asio::awaitable<void> sendFile(std::string_view file_id);
-    boost::asio::awaitable<bool> sendChunk(const SendChunkDto& dto, const BinaryData& chunk_data);
+    // Send small files packed together, in the given order
+    boost::asio::awaitable<void> sendBatches(const std::vector<std::string>& file_ids);
+    // `finalized` is set when the receiver verified the file along with its final chunk
+    boost::asio::awaitable<bool> sendChunk(const SendChunkDto& dto,
+                                           const BinaryData& chunk_data,
+                                           bool* finalized = nullptr);
+    boost::asio::awaitable<bool> sendBatch(const SendBatchDto& dto, const BinaryData& batch_data);
+    // Send a chunk or batch request, holding its body back until the receiver accepted the
+    // header when it supports that and the request is the first or a large one. Counts the body
+    // as wasted if the request was refused.
+    boost::asio::awaitable<boost::beast::http::response<boost::beast::http::string_body>>
+    sendUploadRequest(
+        boost::beast::http::request<boost::beast::http::vector_body<std::uint8_t>>& req);
     boost::asio::awaitable<bool> verifyIntegrity(const VerifyIntegrityDto& dto);
-    boost::asio::awaitable<bool> cancelSend();
 
-    std::vector<FileDto> prepareFiles(const std::vector<std::filesystem::path>& file_paths);
+    // Counterparts of sendChunk/verifyIntegrity once the connection carries frames
+    boost::asio::awaitable<bool> sendChunkFrame(std::uint32_t stream_id,
+                                                const SendChunkDto& dto,
+                                                const BinaryData& chunk_data,
+                                                bool* finalized);
+    boost::asio::awaitable<bool> verifyOverStream(std::uint32_t stream_id);
+    // Counterparts of sendChunk for a chunked /upload-file request
+    boost::asio::awaitable<bool> writeUploadRecord(const SendChunkDto& dto,
+                                                   const BinaryData& chunk_data);
+    // Same for a chunk sent with SSL_sendfile from the file range [offset, offset + size)
+    boost::asio::awaitable<bool> writeSendfileRecord(const SendChunkDto& dto,
+                                                     std::uint64_t offset,
+                                                     std::size_t size);
+    // `file_id` is the uploaded file, whose chunks missing from the receiver's answer count as
+    // rejected
+    boost::asio::awaitable<bool> finishUpload(bool* finalized, std::string_view file_id = {});
+    // Send the chunks the receiver rejected again, in up to transfer::kMaxChunkRetries rounds.
+    // Sets `finalized` to false, the file is verified afterwards.
+    boost::asio::awaitable<bool> resendRejectedChunks(std::string_view file_id,
+                                                      std::uint32_t stream_id,
+                                                      bool* finalized);
+    // Mark the chunks listed in the response's kReceivedChunksHeader as acked
+    static void recordReceivedChunks(
+        TransferFileInfo& file_info,
+        const boost::beast::http::response<boost::beast::http::string_body>& res);
+    // End an upload whose chunks stopped early, then forward a sender cancellation
+    boost::asio::awaitable<void> abortUpload();
+    // Write a frame to the receiver, over UDP once the session switched to lansend-datagram
+    boost::asio::awaitable<void> writeFrame(FrameType type,
+                                            std::uint8_t flags,
+                                            std::uint32_t stream_id,
+                                            std::span<const std::uint8_t> payload = {});
+    boost::asio::awaitable<void> writeDataFrame(std::uint8_t flags,
+                                                std::uint32_t stream_id,
+                                                const DataFrameInfo& info,
+                                                std::span<const std::uint8_t> data);
+    // Wait for the next ack, returns false if the receiver cancelled or failed the stream
+    boost::asio::awaitable<bool> readStreamAck(bool* finalized);
+    // Send the closing frame and drop the upgraded connection
+    boost::asio::awaitable<void> closeStream(FrameType type);
+    boost::asio::awaitable<bool> cancelSend();
+    // Take part in the multicast round with the files left to send, then ask the receiver which
+    // chunks it missed. The others count as satisfied and aren't sent again.
+    boost::asio::awaitable<void> receiveMulticast(const std::vector<std::string>& file_ids);
+    // Tell the round this session won't take part, unless it reported already
+    void leaveMulticast();
+    // Feed a background session's rate control after `bytes` went out. `latency` is the time
+    // the receiver took to answer a full chunk, the delay sample when the kernel has no RTT.
+    void trackDelay(std::size_t bytes,
+                    std::optional<std::chrono::steady_clock::duration> latency = std::nullopt);
+
+    // Register the files in transfer_files_, returns what goes into the send request
+    std::vector<FileDto> registerFiles(const PreparedFiles& prepared_files);
+    // Chunk `chunk_idx` of the file, empty if nothing could be read
+    std::shared_ptr<const BinaryData> readChunk(std::ifstream& file,
+                                                std::string_view file_id,
+                                                std::size_t chunk_idx,
+                                                std::size_t size);
+    static std::optional<FileDto> prepareFile(const std::filesystem::path& file_path,
+                                              std::string relative_path);
 
     boost::asio::io_context& ioc_;
     CertificateManager& cert_manager_;
-    HttpsClient client_;
+    std::shared_ptr<ConnectionPool> connection_pool_;
+    ConnectionLease client_; // Leased from connection_pool_ once the session starts
+    std::shared_ptr<BandwidthScheduler> bandwidth_;
+    BandwidthFlow bandwidth_flow_; // Registered once the receiver accepted
+    std::optional<LedbatController> ledbat_; // Set for background sessions
+    std::unique_ptr<KtlsUploader> ktls_uploader_; // Set while uploads go through kernel TLS
+    std::shared_ptr<FanoutChunkCache> fanout_;    // Set for a session of a fan-out
+    std::size_t fanout_receiver_ = 0;             // This session's receiver in fanout_
+    std::shared_ptr<MulticastRound> multicast_;   // Set for a fan-out with multicast
+    bool multicast_joined_ = false;               // The receiver joined the round's group
+    bool multicast_reported_ = false;             // The round knows whether we take part
 
     std::unordered_map<std::string, TransferFileInfo> transfer_files_;
     SessionStatus session_status_ = SessionStatus::kIdle;
+    std::vector<CompressionAlgorithm> accepted_compressions_; // Empty if not compressing
+    bool batch_supported_ = false;                            // Receiver accepts /send-batch
+    bool stream_supported_ = false;                           // Receiver accepts /stream upgrades
+    bool stream_active_ = false;                              // Connection carries frames
+    bool datagram_supported_ = false;                         // Receiver takes frames over UDP
+    std::shared_ptr<DatagramSender> datagram_; // Set while the frames go over lansend-datagram
+    bool upload_supported_ = false;                           // Receiver accepts /upload-file
+    bool upload_active_ = false;                              // An upload body is being written
+    bool upload_via_sendfile_ = false;                        // The upload uses ktls_uploader_
+    bool continue_supported_ = false;                         // Receiver answers 100-continue
+    bool continue_probed_ = false;                            // Waited for 100 Continue once
+    std::uint32_t next_stream_id_ = 1;
+    std::unordered_map<std::uint32_t, std::string> stream_files_; // File ID by stream ID
+    std::size_t frames_in_flight_ = 0; // Data and verify frames not acked yet
+    SessionStats stats_;
 
     std::string session_id_ = {};         // Generated by the server
+    std::string queue_ticket_ = {};       // Set once the receiver queued the send request
+    std::size_t queue_position_ = 0;      // Last reported position in the receiver's queue
     std::string receiver_device_id_ = {}; // The device ID of the receiver
+    std::string host_ = {};               // The receiver's server
+    unsigned short port_ = 0;
     FeedbackCallback callback_ = nullptr;
 
     void feedback(Feedback&& feedback) {
@@ -3,17 +3,29 @@
 #include "core/model/feedback.h"
 #include "send_session.h"
 #include <boost/asio/io_context.hpp>
+#include <core/network/bandwidth_scheduler.h>
+#include <core/network/client/connection_pool.h>
 #include <core/security/certificate_manager.h>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <unordered_map>
 
 namespace lansend::core {
 
+// One receiver of a fan-out send
+struct SendTarget {
+    std::string host;
+    unsigned short port = 0;
+    std::string device_id;
+};
+
 class SendSessionManager {
 public:
     SendSessionManager(boost::asio::io_context& ioc,
                        CertificateManager& cert_manager,
+                       std::shared_ptr<ConnectionPool> connection_pool,
+                       std::shared_ptr<BandwidthScheduler> bandwidth,
                        FeedbackCallback callback = nullptr);
     ~SendSessionManager() = default;
     SendSessionManager(const SendSessionManager&) = delete;
@@ -24,6 +36,16 @@ public:
                    const std::vector<std::filesystem::path>& file_paths,
                    std::string_view device_id = {});
 
+    // Send the same files to several devices at once. The files are hashed once and every chunk
+    // is read once for all of them, each receiver still gets a session and a connection of its
+    // own and goes at its own pace. With settings.multicast_transport the files are multicast to
+    // the receivers first and each session only sends what its receiver missed.
+    void SendFanout(const std::vector<SendTarget>& targets,
+                    const std::vector<std::filesystem::path>& file_paths);
+
+    // Also used by the sessions started afterwards
+    void SetFeedbackCallback(FeedbackCallback callback) { callback_ = std::move(callback); }
+
     void CancelSend(const std::string& session_id);
 
     void CancelWaitForConfirmation(std::string_view ip, unsigned short port);
@@ -33,8 +55,13 @@ private:
         send_sessions_[session->session_id()] = std::move(session);
     }
 
+    void startSession(std::shared_ptr<SendSession> session,
+                      boost::asio::awaitable<void> start);
+
     boost::asio::io_context& ioc_;
     CertificateManager& cert_manager_;
+    std::shared_ptr<ConnectionPool> connection_pool_;
+    std::shared_ptr<BandwidthScheduler> bandwidth_;
     FeedbackCallback callback_;
 
     std::unordered_map<std::string, std::shared_ptr<SendSession>> send_sessions_;
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <chrono>
+#include <core/constant/transfer.h>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+
+namespace lansend::core {
+
+// Congestion control of a lansend-datagram connection, after BBR (draft-cardwell-iccrg-bbr).
+//
+// Loss based congestion control takes every lost packet for congestion. On a busy 2.4 GHz
+// channel most losses come from interference, and TCP backs off far below what the link carries.
+// BBR models the path from the acks instead. The bottleneck bandwidth is the highest delivery
+// rate of the last rounds, and the propagation delay is the lowest RTT of the last seconds.
+// Packets are paced at that bandwidth. The gain cycles above it to probe for more and below it to
+// drain the queue again. Data in flight is capped at twice the bandwidth-delay product. Losses
+// below kLossThreshold of a round's bytes only make the sender resend. Above it, as in BBRv2, the
+// pipe counts as full: Startup ends and the data in flight is capped below the window that lost.
+// Every probing phase raises the cap again.
+//
+// ProbeRTT is left out: the min RTT filter just starts over when it expires. A LAN path hardly
+// changes, and the datagram connection is the session's only flow.
+class BbrController {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Delivery state when a packet was sent, kept with the packet until it is acked
+    struct PacketState {
+        std::uint64_t delivered = 0;
+        Clock::time_point delivered_time;
+        Clock::time_point first_sent_time;
+        Clock::time_point sent_time;
+        bool app_limited = false;
+    };
+
+    BbrController();
+
+    // A packet is sent, `bytes_in_flight` doesn't count it yet
+    PacketState OnSend(std::size_t bytes_in_flight, Clock::time_point now);
+    // A packet of `bytes` was acked, `rtt` is std::nullopt unless it is the newest one the ack
+    // covers
+    void OnAck(const PacketState& packet,
+               std::size_t bytes,
+               std::optional<std::chrono::microseconds> rtt,
+               std::size_t bytes_in_flight,
+               Clock::time_point now);
+    // A packet of `bytes` was declared lost
+    void OnLoss(std::size_t bytes);
+    // The sender has nothing more to send, the rate samples until then don't show the path
+    void OnAppLimited(std::size_t bytes_in_flight);
+
+    // Bytes per second the packets are paced at
+    double pacing_rate() const;
+    // Bytes that may be in flight
+    std::size_t congestion_window() const;
+
+    double bottleneck_bandwidth() const { return bottleneck_bandwidth_; }
+    std::optional<std::chrono::microseconds> min_rtt() const { return min_rtt_; }
+
+    static constexpr std::size_t kMinWindow = 64 * transfer::kDatagramSize;
+    // Until there is an RTT sample, a fast LAN
+    static constexpr std::chrono::microseconds kInitialRtt{1000};
+
+private:
+    enum class State {
+        kStartup,
+        kDrain,
+        kProbeBandwidth,
+    };
+
+    struct RoundMax {
+        std::uint64_t round;
+        double bandwidth;
+    };
+
+    void updateBandwidth(double rate);
+    // At the start of a round, whether the last one lost too much
+    void checkRoundLoss();
+    void updateState(bool round_start, std::size_t bytes_in_flight, Clock::time_point now);
+    double bandwidthDelayProduct() const;
+
+    State state_ = State::kStartup;
+    std::uint64_t delivered_ = 0;
+    Clock::time_point delivered_time_;
+    Clock::time_point first_sent_time_;
+    std::uint64_t app_limited_until_ = 0; // Delivered bytes until which samples are app limited
+
+    std::uint64_t round_ = 0;
+    std::uint64_t next_round_delivered_ = 0;
+    std::deque<RoundMax> bandwidth_filter_; // Highest rate of each of the last rounds
+    double bottleneck_bandwidth_ = 0.0;
+    std::optional<std::chrono::microseconds> min_rtt_;
+    Clock::time_point min_rtt_stamp_;
+
+    std::uint64_t round_start_delivered_ = 0;
+    std::uint64_t round_lost_ = 0;
+    std::optional<std::size_t> inflight_cap_; // Set once a round lost too much
+
+    double full_bandwidth_ = 0.0; // Startup ends once the bandwidth stops growing
+    std::size_t full_bandwidth_rounds_ = 0;
+    std::size_t cycle_index_ = 0;
+    Clock::time_point cycle_stamp_;
+
+    static constexpr double kStartupGain = 2.885; // 2 / ln 2
+    static constexpr double kCwndGain = 2.0;
+    static constexpr double kGainCycle[] = {1.25, 0.75, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0};
+    static constexpr std::size_t kBandwidthWindowRounds = 10;
+    static constexpr std::size_t kFullBandwidthRounds = 3;
+    static constexpr double kFullBandwidthGrowth = 1.25;
+    static constexpr std::chrono::seconds kMinRttWindow{10};
+    static constexpr double kLossThreshold = 0.02;
+    static constexpr double kLossBeta = 0.7; // Share of the window kept after a lossy round
+};
+
+} // namespace lansend::core
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <core/constant/transfer.h>
+#include <core/security/file_encryptor.h>
+#include <core/util/binary_message.h>
+#include <cstddef>
+#include <cstdint>
+#include <openssl/ssl.h>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace lansend::core {
+
+// Protocol name used in the `Upgrade` header when a session moves its data frames to UDP
+constexpr std::string_view kDatagramProtocol = "lansend-datagram";
+// Header of the 101 response carrying the UDP port the receiver listens on
+constexpr std::string_view kDatagramPortHeader = "X-Lansend-Datagram-Port";
+// Header of the 101 response carrying the base64 random the keys of this upgrade are bound to
+constexpr std::string_view kDatagramContextHeader = "X-Lansend-Datagram-Context";
+
+// lansend-datagram carries the open, data, verify, end and cancel frames a lansend-stream
+// connection would, from the sender to the receiver. Every frame is a message, encoded as on the
+// stream and split into fragments of kDatagramFragmentSize bytes, one per data packet. The
+// receiver acks packets with ranges of packet numbers. Packet numbers are never reused, a lost
+// fragment goes out again in a new packet, so every ack tells exactly which packet arrived.
+//
+// Every packet starts with a header sent in clear, integers are big-endian:
+// | magic (4) | version (1) | type (1) | reserved (2) | packet number (8) |
+// The rest is sealed with AES-256-GCM, with the header as additional data and the packet number
+// in the nonce, and followed by the tag:
+// data: | message id (8) | offset (4) | message length (4) | fragment |
+// ack:  | ack delay in us (4) | range count (2) | reserved (2) | ranges, first (8) and last (8) |
+enum class DatagramType : std::uint8_t {
+    kData = 1, // sender -> receiver
+    kAck = 2,  // receiver -> sender
+};
+
+struct DatagramHeader {
+    DatagramType type;
+    std::uint64_t packet_number = 0;
+};
+
+struct DataFragment {
+    std::uint64_t message_id = 0; // Messages are numbered from 0 in the order they are sent
+    std::uint32_t offset = 0;
+    std::uint32_t message_length = 0;
+    std::span<const std::uint8_t> data;
+};
+
+struct DatagramAck {
+    std::chrono::microseconds ack_delay{0}; // Time the receiver held the ack back
+    // Inclusive ranges of received packet numbers, highest first
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> ranges;
+};
+
+// Key and nonce salt of one direction
+struct DatagramKey {
+    BinaryData key;
+    std::array<std::uint8_t, 4> salt{};
+};
+
+struct DatagramKeys {
+    DatagramKey sender;   // Seals data packets
+    DatagramKey receiver; // Seals acks
+};
+
+constexpr std::uint32_t kDatagramMagic = 0x4c534447; // "LSDG"
+constexpr std::uint8_t kDatagramVersion = 1;
+constexpr std::size_t kDatagramHeaderSize = 16;
+constexpr std::size_t kDataFragmentHeaderSize = 16;
+constexpr std::size_t kDatagramFragmentSize = transfer::kDatagramSize - kDatagramHeaderSize
+                                              - kDataFragmentHeaderSize - FileEncryptor::TAG_SIZE;
+constexpr std::size_t kMaxAckRanges = 64;
+constexpr std::size_t kDatagramContextSize = 16;
+// The receiver acks every second data packet, or after this delay
+constexpr std::chrono::milliseconds kDatagramMaxAckDelay{1};
+
+// Both ends of an upgraded TLS connection get the same keys from it, RFC 5705 keying material
+// exporter. Packet numbers start at 0 on every upgrade, so the exporter context holds the session
+// id and a random the receiver picks for each upgrade: a pooled connection upgraded again gets new
+// keys instead of reusing nonces. Returns std::nullopt if the export fails.
+std::optional<DatagramKeys> ExportDatagramKeys(SSL* ssl,
+                                               std::string_view session_id,
+                                               std::span<const std::uint8_t> random);
+
+BinaryData SealDatagram(const DatagramHeader& header,
+                        std::span<const std::uint8_t> payload,
+                        const DatagramKey& key);
+// Returns std::nullopt for datagrams that aren't lansend-datagram packets or fail to authenticate
+std::optional<std::pair<DatagramHeader, BinaryData>> OpenDatagram(
+    std::span<const std::uint8_t> packet, const DatagramKey& key);
+
+BinaryData EncodeDataFragment(std::uint64_t message_id,
+                              std::uint32_t offset,
+                              std::uint32_t message_length,
+                              std::span<const std::uint8_t> fragment);
+// The fragment refers to `payload`
+std::optional<DataFragment> DecodeDataFragment(std::span<const std::uint8_t> payload);
+
+BinaryData EncodeDatagramAck(const DatagramAck& ack);
+std::optional<DatagramAck> DecodeDatagramAck(std::span<const std::uint8_t> payload);
+
+} // namespace lansend::core
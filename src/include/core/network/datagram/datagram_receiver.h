@@ -0,0 +1,96 @@
+#pragma once
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <core/network/datagram/datagram_packet.h>
+#include <core/network/stream/stream_frame.h>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace lansend::core {
+
+// Receiving end of a lansend-datagram connection. Every data packet is acked, and the frames are
+// put back together and handed on in the order they were sent. Fragments of frames too far ahead
+// of the next one are dropped unacked, so the sender resends them once there is room. Together
+// with the sender's window of unacked data frames, that bounds the memory a connection holds.
+class DatagramReceiver : public std::enable_shared_from_this<DatagramReceiver> {
+public:
+    // Opens a socket on an ephemeral port of `address`, throws boost::system::system_error if
+    // that fails. The first packet that authenticates fixes the sender's endpoint.
+    static std::shared_ptr<DatagramReceiver> Create(boost::asio::io_context& ioc,
+                                                    const boost::asio::ip::address& address,
+                                                    DatagramKeys keys);
+
+    DatagramReceiver(const DatagramReceiver&) = delete;
+    DatagramReceiver& operator=(const DatagramReceiver&) = delete;
+
+    std::uint16_t port() const { return port_; }
+
+    // The next frame. Throws boost::system::system_error if none arrived within `timeout`, if the
+    // receiver was closed, or if the sender broke the protocol.
+    boost::asio::awaitable<Frame> ReadFrame(std::chrono::steady_clock::duration timeout);
+    void Close();
+
+    std::uint64_t packets() const { return packets_; }
+    std::uint64_t duplicate_packets() const { return duplicate_packets_; }
+
+    // Frames received in full ahead of the next one to hand on, or still arriving
+    static constexpr std::size_t kMaxMessagesAhead = 2 * transfer::kStreamWindow + 4;
+
+private:
+    struct PartialMessage {
+        BinaryData data;
+        std::vector<bool> received;
+        std::size_t missing = 0;
+    };
+
+    DatagramReceiver(boost::asio::io_context& ioc, DatagramKeys keys);
+
+    boost::asio::awaitable<void> receiveLoop();
+    // Returns false if the packet is dropped and must not be acked
+    bool onData(const DataFragment& fragment);
+    // Returns false if the packet number was already received
+    bool recordPacket(std::uint64_t packet_number);
+    void sendAck();
+    void scheduleAck();
+    // Move the frames complete up to the first missing one to the queue
+    void deliver();
+    void fail(std::string error);
+
+    boost::asio::ip::udp::socket socket_;
+    std::uint16_t port_ = 0;
+    DatagramKeys keys_;
+    std::optional<boost::asio::ip::udp::endpoint> sender_;
+
+    std::map<std::uint64_t, std::uint64_t> received_ranges_; // First to last packet number
+    std::uint64_t next_ack_number_ = 0;
+    std::size_t unacked_packets_ = 0;
+    std::chrono::steady_clock::time_point largest_received_time_;
+    bool ack_scheduled_ = false;
+    boost::asio::steady_timer ack_timer_;
+
+    std::map<std::uint64_t, PartialMessage> messages_;
+    std::uint64_t next_message_id_ = 0; // Next frame to hand on
+    std::deque<Frame> frames_;
+    bool closed_ = false;
+    std::string error_;
+    boost::asio::steady_timer ready_; // Signals ReadFrame()
+
+    std::uint64_t packets_ = 0;
+    std::uint64_t duplicate_packets_ = 0;
+
+    // Ranges kept to build acks from, older packets belong to frames handed on long ago
+    static constexpr std::size_t kMaxReceivedRanges = 256;
+    static constexpr std::size_t kAckEvery = 2;
+};
+
+} // namespace lansend::core
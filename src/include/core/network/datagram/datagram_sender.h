@@ -0,0 +1,144 @@
+#pragma once
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <core/network/datagram/bbr_controller.h>
+#include <core/network/datagram/datagram_packet.h>
+#include <core/network/stream/stream_frame.h>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace lansend::core {
+
+// Sending end of a lansend-datagram connection. Frames are queued as messages and go out as data
+// packets paced by a BbrController. A packet counts as lost once three later ones were acked or
+// it is overdue by an eighth of the RTT, and its fragment is sent again. Losses are reported to
+// the BbrController too. Without any ack for a probe timeout, which backs off, the oldest packet
+// goes again as a probe outside the congestion window, and the acks it draws tell which of the
+// others were lost. The connection fails when the receiver stopped acking for
+// transfer::kDatagramIdleSeconds.
+class DatagramSender : public std::enable_shared_from_this<DatagramSender> {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Opens a socket connected to the receiver, throws boost::system::system_error if that fails
+    static std::shared_ptr<DatagramSender> Create(boost::asio::io_context& ioc,
+                                                  const boost::asio::ip::udp::endpoint& receiver,
+                                                  DatagramKeys keys);
+
+    DatagramSender(const DatagramSender&) = delete;
+    DatagramSender& operator=(const DatagramSender&) = delete;
+
+    // Queue a frame and wait while more than kMaxBufferedBytes aren't acked yet. Throws
+    // std::runtime_error once the connection failed or was closed.
+    boost::asio::awaitable<void> WriteFrame(FrameType type,
+                                            std::uint8_t flags,
+                                            std::uint32_t stream_id,
+                                            std::span<const std::uint8_t> payload = {});
+    boost::asio::awaitable<void> WriteDataFrame(std::uint8_t flags,
+                                                std::uint32_t stream_id,
+                                                const DataFrameInfo& info,
+                                                std::span<const std::uint8_t> data);
+    // Wait until the receiver acked every frame, returns false if it didn't within `timeout`
+    boost::asio::awaitable<bool> Flush(Clock::duration timeout);
+    // Stop sending, frames not acked yet are dropped
+    void Close();
+
+    // Data packets including the resent ones, and the resent ones alone
+    std::uint64_t sent_bytes() const { return sent_bytes_; }
+    std::uint64_t retransmitted_bytes() const { return retransmitted_bytes_; }
+    std::uint64_t lost_packets() const { return lost_packets_; }
+    std::optional<std::chrono::microseconds> smoothed_rtt() const { return smoothed_rtt_; }
+    const BbrController& congestion() const { return congestion_; }
+
+    // Frame bytes queued or in flight before writers wait, a few chunks' worth
+    static constexpr std::size_t kMaxBufferedBytes = 16 * 1024 * 1024;
+
+private:
+    struct Message {
+        BinaryData data; // The encoded frame
+        std::vector<bool> acked;
+        std::size_t acked_fragments = 0;
+    };
+
+    struct Fragment {
+        std::uint64_t message_id = 0;
+        std::uint32_t index = 0;
+        bool resent = false;
+    };
+
+    struct SentPacket {
+        Fragment fragment;
+        std::size_t bytes = 0;
+        BbrController::PacketState state;
+    };
+
+    DatagramSender(boost::asio::io_context& ioc, DatagramKeys keys);
+
+    boost::asio::awaitable<void> enqueue(BinaryData message);
+    boost::asio::awaitable<void> sendLoop();
+    boost::asio::awaitable<void> receiveLoop();
+    boost::asio::awaitable<void> sendPacket(Clock::time_point now);
+    void onAck(const DatagramAck& ack, Clock::time_point now);
+    void updateRtt(std::chrono::microseconds sample, std::chrono::microseconds ack_delay);
+    // Packets overtaken by acked ones
+    void detectLoss(Clock::time_point now);
+    // Probes when there was no ack for a probe timeout, fails the connection after the idle time
+    void checkTimeout(Clock::time_point now);
+    // Takes the packet out of flight and queues its fragment to be sent again
+    std::map<std::uint64_t, SentPacket>::iterator lose(
+        std::map<std::uint64_t, SentPacket>::iterator packet);
+    void fail(std::string error);
+    Clock::duration probeTimeout() const;
+    // Wake the send loop and the writers waiting for acks
+    void wake();
+
+    boost::asio::ip::udp::socket socket_;
+    DatagramKeys keys_;
+    BbrController congestion_;
+
+    std::map<std::uint64_t, Message> messages_; // Messages not completely acked yet
+    std::uint64_t next_message_id_ = 0;
+    std::size_t buffered_bytes_ = 0;
+    std::deque<Fragment> pending_; // Fragments to send, lost ones go first
+    std::map<std::uint64_t, SentPacket> in_flight_; // By packet number
+    std::size_t bytes_in_flight_ = 0;
+    std::uint64_t next_packet_number_ = 0;
+    std::optional<std::uint64_t> largest_acked_;
+
+    std::optional<std::chrono::microseconds> smoothed_rtt_;
+    std::chrono::microseconds rtt_variation_{0};
+    std::chrono::microseconds latest_rtt_{0};
+    std::size_t timeouts_ = 0;  // Probe timeouts in a row, each doubles the next one
+    std::size_t probes_ = 0;    // Packets to send regardless of the congestion window
+    Clock::time_point progress_; // Last ack, or when packets went out after a pause
+    Clock::time_point next_send_time_;
+
+    bool closed_ = false;
+    std::string error_;
+    boost::asio::steady_timer wake_;                  // The send loop waits on it
+    std::vector<boost::asio::steady_timer*> waiters_; // Writers and flushes waiting for acks
+
+    std::uint64_t sent_bytes_ = 0;
+    std::uint64_t retransmitted_bytes_ = 0;
+    std::uint64_t lost_packets_ = 0;
+    std::uint64_t send_errors_ = 0;
+
+    // Bursts a late send loop may catch up with
+    static constexpr std::chrono::milliseconds kPacingBurst{2};
+    static constexpr std::uint64_t kPacketThreshold = 3;
+    static constexpr std::chrono::milliseconds kTimerGranularity{1};
+    static constexpr std::chrono::milliseconds kInitialProbeTimeout{100};
+};
+
+} // namespace lansend::core
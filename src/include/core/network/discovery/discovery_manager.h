@@ -10,6 +10,7 @@
 #include <functional>
 #include <mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -39,6 +40,22 @@ public:
     void SetDeviceFoundCallback(std::function<void(const DeviceInfo&)> callback);
     void SetDeviceLostCallback(std::function<void(std::string_view)> callback);
 
+    // 组播传输复用发现用的 UDP 设置，组播数据发往 kMulticastPort
+    static constexpr std::uint16_t kMulticastPort = 37021;
+    // 为一次组播传输随机选取一个本地管理范围的组地址 (239.255.0.0/16)
+    static boost::asio::ip::address_v4 PickMulticastGroup();
+    // 通往 peer 的路由所用网卡的本机地址，用来选择组播收发的网卡；无法确定时返回 any()
+    static boost::asio::ip::address_v4 LocalAddressTowards(boost::asio::io_context& ioc,
+                                                           std::string_view peer);
+    // 打开发送组播的套接字：只在本网段内传播，并回送给本机的接收者。
+    // 组播从 interface 所在的网卡发出，为 any() 时由系统选择
+    static void OpenMulticastSender(boost::asio::ip::udp::socket& socket,
+                                    const boost::asio::ip::address_v4& interface);
+    // 打开套接字并在 interface 所在的网卡上加入组播组，失败时抛出 boost::system::system_error
+    static void JoinMulticastGroup(boost::asio::ip::udp::socket& socket,
+                                   const boost::asio::ip::udp::endpoint& group,
+                                   const boost::asio::ip::address_v4& interface);
+
 private:
     std::mutex devices_mutex_;
     boost::asio::io_context& io_context_;
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <core/constant/transfer.h>
+#include <core/security/file_encryptor.h>
+#include <core/util/binary_message.h>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <utility>
+
+namespace lansend::core {
+
+// A chunk goes to a multicast group as FEC blocks of symbols, one symbol of
+// transfer::kMulticastSymbolSize bytes per datagram. Block b of a chunk covers its bytes from
+// b * kMulticastDataSymbols * kMulticastSymbolSize on, the last block has as many data symbols
+// as the rest of the chunk needs and its last symbol is padded with zeros. Every block gets the
+// same number of repair symbols, which follow its data symbols.
+//
+// Every datagram starts with a fixed size header, integers are big-endian:
+// | magic (4) | version (1) | repair symbols (1) | reserved (2) | transfer id (8) |
+// | file index (4) | chunk index (4) | chunk size (4) | block (2) | symbol (1) | data symbols (1) |
+// The symbol follows sealed with AES-256-GCM and the round's key, which the receivers only get
+// over their TLS connection, with the header as additional data. The nonce is made of the file
+// index, chunk index, block and symbol, which a round sends once each under a key of its own.
+struct MulticastPacketHeader {
+    std::uint64_t transfer_id = 0; // Tells concurrent transfers to the same group apart
+    std::uint32_t file_index = 0;  // Position of the file in the send request
+    std::uint32_t chunk_index = 0;
+    std::uint32_t chunk_size = 0;
+    std::uint16_t block = 0;
+    std::uint8_t symbol = 0; // Data symbols first, then repair symbols
+    std::uint8_t data_symbols = 0;
+    std::uint8_t repair_symbols = 0;
+};
+
+constexpr std::uint32_t kMulticastMagic = 0x4c534d43; // "LSMC"
+constexpr std::uint8_t kMulticastVersion = 2;
+constexpr std::size_t kMulticastHeaderSize = 32;
+constexpr std::size_t kMulticastPacketSize = kMulticastHeaderSize + transfer::kMulticastSymbolSize
+                                             + FileEncryptor::TAG_SIZE;
+
+std::array<std::uint8_t, kMulticastHeaderSize> EncodeMulticastHeader(
+    const MulticastPacketHeader& header);
+// Returns std::nullopt for datagrams that aren't lansend multicast packets
+std::optional<MulticastPacketHeader> DecodeMulticastHeader(std::span<const std::uint8_t> data);
+
+// A new key for a round, throws std::runtime_error if no random bytes could be had
+BinaryData GenerateMulticastKey();
+// The header followed by the sealed symbol
+BinaryData SealMulticastPacket(const MulticastPacketHeader& header,
+                               std::span<const std::uint8_t> symbol,
+                               const BinaryData& key);
+// Returns std::nullopt for datagrams that aren't lansend multicast packets of a symbol's size or
+// fail to authenticate
+std::optional<std::pair<MulticastPacketHeader, BinaryData>> OpenMulticastPacket(
+    std::span<const std::uint8_t> packet, const BinaryData& key);
+
+} // namespace lansend::core
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <core/network/multicast/multicast_packet.h>
+#include <core/util/binary_message.h>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace lansend::core {
+
+// A chunk restored from a multicast round
+struct MulticastChunk {
+    std::uint32_t file_index = 0; // Position of the file in the send request
+    std::uint32_t chunk_index = 0;
+    BinaryData data;
+};
+
+// Receives one multicast round of a send session. Datagrams are collected into FEC blocks, a
+// block is restored once any data symbols' worth of its symbols arrived, and a chunk is handed
+// on once all its blocks are. Chunks that can't be restored are simply never handed on: the
+// sender asks which chunks are missing when the round is over and sends those over the
+// session's connection.
+class MulticastReceiver : public std::enable_shared_from_this<MulticastReceiver> {
+public:
+    // Called for one chunk at a time, in the order the chunks were restored
+    using ChunkHandler = std::function<boost::asio::awaitable<void>(MulticastChunk)>;
+
+    // Joins the group on the network interface with address `interface`, throws
+    // boost::system::system_error if that fails. Datagrams that don't authenticate with the
+    // round's `key` are dropped.
+    static std::shared_ptr<MulticastReceiver> Create(boost::asio::io_context& ioc,
+                                                     const boost::asio::ip::udp::endpoint& group,
+                                                     const boost::asio::ip::address_v4& interface,
+                                                     std::uint64_t transfer_id,
+                                                     BinaryData key,
+                                                     ChunkHandler handler);
+
+    MulticastReceiver(const MulticastReceiver&) = delete;
+    MulticastReceiver& operator=(const MulticastReceiver&) = delete;
+
+    // Leave the group, chunks restored so far are still handed on
+    void Close();
+    // Close and wait until the handler took every restored chunk
+    boost::asio::awaitable<void> Stop();
+
+    std::uint64_t datagrams() const { return datagrams_; }
+    // Datagrams of the transfer that failed to authenticate
+    std::uint64_t forged_datagrams() const { return forged_datagrams_; }
+    std::uint64_t chunks() const { return chunks_; }
+    // Data symbols restored from repair symbols
+    std::uint64_t recovered_symbols() const { return recovered_symbols_; }
+    // Chunks given up on, because too many were pending or queued for the handler
+    std::uint64_t dropped_chunks() const { return dropped_chunks_; }
+
+    // Chunks being collected at once, the oldest is given up on beyond that
+    static constexpr std::size_t kMaxPendingChunks = 16;
+    // Restored chunks waiting for the handler, which may be throttled or waiting for the disk
+    static constexpr std::size_t kMaxQueuedChunks = 32;
+
+private:
+    using ChunkKey = std::pair<std::uint32_t, std::uint32_t>; // File index, chunk index
+
+    struct Block {
+        std::vector<std::optional<BinaryData>> symbols; // Data symbols, then repair symbols
+        std::size_t received = 0;
+        std::size_t data_symbols = 0;
+        bool restored = false;
+    };
+
+    struct PendingChunk {
+        std::uint32_t chunk_size = 0;
+        std::vector<Block> blocks;
+        std::size_t restored_blocks = 0;
+        std::uint64_t last_datagram = 0; // Order of its last datagram, to find the oldest
+    };
+
+    MulticastReceiver(boost::asio::io_context& ioc,
+                      std::uint64_t transfer_id,
+                      BinaryData key,
+                      ChunkHandler handler);
+
+    boost::asio::awaitable<void> receive();
+    boost::asio::awaitable<void> deliver();
+    void onDatagram(const MulticastPacketHeader& header, std::span<const std::uint8_t> payload);
+    // Decode the block if enough symbols arrived, returns false if it can't be yet
+    bool restoreBlock(Block& block);
+    // Hand a completely restored chunk to the deliver loop
+    void completeChunk(const ChunkKey& key, PendingChunk& chunk);
+
+    boost::asio::ip::udp::socket socket_;
+    std::uint64_t transfer_id_;
+    BinaryData key_;
+    ChunkHandler handler_;
+    std::map<ChunkKey, PendingChunk> pending_;
+    std::set<ChunkKey> completed_; // Chunks restored or given up on, their datagrams are ignored
+    std::deque<MulticastChunk> queue_;
+    bool closed_ = false;
+    bool delivered_ = false;             // The deliver loop ended
+    boost::asio::steady_timer queued_;   // Signals the deliver loop
+    boost::asio::steady_timer finished_; // Signals Stop() once the deliver loop ended
+
+    std::uint64_t datagrams_ = 0;
+    std::uint64_t forged_datagrams_ = 0;
+    std::uint64_t chunks_ = 0;
+    std::uint64_t recovered_symbols_ = 0;
+    std::uint64_t dropped_chunks_ = 0;
+};
+
+} // namespace lansend::core
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <core/network/bandwidth_scheduler.h>
+#include <core/network/client/send_session.h>
+#include <core/network/multicast/multicast_packet.h>
+#include <core/util/erasure_code.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lansend::core {
+
+#ifdef LANSEND_MULTICAST_DROP_HOOK
+// Only in builds that emulate a lossy link, i.e. the benchmark, which defines it: returns true
+// for a datagram to be dropped instead of sent. Loopback multicast skips the qdisc of lo, so tc
+// can't drop it there.
+bool DropMulticastDatagram();
+#endif
+
+// The multicast part of a fan-out send (experimental). Every session offers the round to its
+// receiver in the send request, and the receivers that joined the group get the files in one
+// go at settings.multicast_rate, each datagram reaching all of them. The round starts once every
+// session reported in or kGatherTime after the first one did, and afterwards each session asks
+// its receiver which chunks it missed and sends those over its own connection.
+class MulticastRound : public std::enable_shared_from_this<MulticastRound> {
+public:
+    // Opens the sending socket on the network interface with address `interface` and picks the
+    // round's key, throws boost::system::system_error or std::runtime_error if that fails
+    static std::shared_ptr<MulticastRound> Create(boost::asio::io_context& ioc,
+                                                  std::shared_ptr<BandwidthScheduler> bandwidth,
+                                                  std::shared_ptr<const PreparedFiles> files,
+                                                  std::size_t sessions,
+                                                  const boost::asio::ip::address_v4& interface);
+
+    MulticastRound(const MulticastRound&) = delete;
+    MulticastRound& operator=(const MulticastRound&) = delete;
+
+    const boost::asio::ip::udp::endpoint& group() const { return group_; }
+    std::uint64_t transfer_id() const { return transfer_id_; }
+    // Seals the datagrams, only ever sent to receivers over TLS
+    const BinaryData& key() const { return key_; }
+
+    // A session's receiver joined and needs the files, packed files are left to the sessions.
+    // Files asked for after the round started are left to the sessions as well.
+    void Join(const std::vector<std::string>& file_ids);
+    // A session won't take part, e.g. because its receiver declined or couldn't join
+    void Leave();
+    // Wait at most `timeout` for the round to end, returns true if it did
+    boost::asio::awaitable<bool> WaitDone(std::chrono::steady_clock::duration timeout);
+
+    bool done() const { return state_ == State::kDone; }
+    std::uint64_t sent_bytes() const { return sent_bytes_; }
+
+    // Time the sessions that reported in wait for the others before the round starts anyway
+    static constexpr std::chrono::seconds kGatherTime{15};
+
+private:
+    enum class State {
+        kGathering,
+        kSending,
+        kDone,
+    };
+
+    MulticastRound(boost::asio::io_context& ioc,
+                   std::shared_ptr<BandwidthScheduler> bandwidth,
+                   std::shared_ptr<const PreparedFiles> files,
+                   std::size_t sessions);
+
+    // A session joined or left while gathering, starts the round once all of them did
+    void report();
+    void start();
+    void finish();
+    boost::asio::awaitable<void> send();
+    boost::asio::awaitable<void> sendChunk(std::uint32_t file_index,
+                                           std::uint32_t chunk_index,
+                                           const BinaryData& chunk);
+
+    boost::asio::io_context& ioc_;
+    std::shared_ptr<BandwidthScheduler> bandwidth_;
+    BandwidthFlow flow_; // Paces the datagrams, registered when the round starts
+    std::shared_ptr<const PreparedFiles> files_;
+    std::unordered_map<std::string, std::uint32_t> file_indexes_; // Position in files_ by file id
+    boost::asio::ip::udp::socket socket_;
+    boost::asio::ip::udp::endpoint group_;
+    std::uint64_t transfer_id_;
+    BinaryData key_;
+    ErasureCode code_; // For full blocks, the last block of a chunk may be shorter
+
+    State state_ = State::kGathering;
+    std::size_t sessions_;
+    std::size_t reported_ = 0;
+    std::size_t joined_ = 0;
+    std::set<std::uint32_t> wanted_; // Indexes of the files to send
+    boost::asio::steady_timer gather_timer_;
+    std::vector<boost::asio::steady_timer*> waiters_; // Sessions in WaitDone()
+
+    std::uint64_t sent_bytes_ = 0;
+    std::uint64_t datagrams_ = 0;
+    std::uint64_t send_errors_ = 0;
+};
+
+} // namespace lansend::core
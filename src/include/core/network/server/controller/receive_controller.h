@@ -6,20 +6,24 @@
 #include <boost/beast/http/string_body_fwd.hpp>
 #include <core/constant/path.h>
 #include <core/model.h>
+#include <core/network/bandwidth_scheduler.h>
+#include <core/network/multicast/multicast_receiver.h>
+#include <core/network/server/disk_write_scheduler.h>
 #include <core/network/server/http_server.h>
+#include <core/network/stream/stream_frame.h>
 #include <core/security/file_hasher.h>
+#include <core/util/chunk_index.h>
+#include <deque>
 #include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
 #include <nlohmann/detail/macro_scope.hpp>
 #include <nlohmann/json.hpp>
 #include <string>
 
 namespace lansend::core {
 
-enum class ReceiveSessionStatus {
-    kIdle,
-    kWorking,
-};
-
 using FileId = std::string;
 using SessionId = std::string;
 
@@ -36,41 +40,217 @@ public:
 
     void SetSaveDirectory(const std::filesystem::path& save_dir);
 
-    ReceiveSessionStatus session_status() const;
-    std::string_view sender_ip() const;
-    unsigned short sender_port() const;
+    // Sessions waiting for confirmation or receiving
+    std::size_t active_sessions() const;
+    const DiskWriteScheduler& disk_writer() const { return *disk_writer_; }
 
-    void NotifySenderLost(); // Called by Controller's HttpServer when sender is lost
+    // Called by Controller's HttpServer when a connection is lost, ends the sessions of the sender
+    // at ip:port
+    void NotifySenderLost(std::string_view ip, unsigned short port);
 
     void SetFeedbackCallback(FeedbackCallback callback);
     void SetWaitConditionFunc(WaitConditionFunc func);
     void SetCancelConditionFunc(CancelConditionFunc func);
 
-    // 重置接收控制器状态为空闲，取消当前的接收会话
+    // 重置接收控制器状态为空闲，取消所有接收会话
     void resetToIdle();
 
 private:
     boost::asio::awaitable<boost::beast::http::response<boost::beast::http::string_body>>
     onRequestSend(const boost::beast::http::request<boost::beast::http::string_body>& req);
 
+    // A queued sender coming back with its ticket to wait for its turn again
+    boost::asio::awaitable<HttpResponse> onWaitTurn(const HttpRequest& req);
+
     boost::asio::awaitable<boost::beast::http::response<boost::beast::http::string_body>> onSendChunk(
         const boost::beast::http::request<boost::beast::http::vector_body<std::uint8_t>>& req);
 
+    boost::asio::awaitable<boost::beast::http::response<boost::beast::http::string_body>> onSendBatch(
+        const boost::beast::http::request<boost::beast::http::vector_body<std::uint8_t>>& req);
+
+    // Takes chunk bodies above kStreamedBodyThreshold, which are read once the server's memory
+    // budget has room for them instead of all being buffered before the handler runs
+    boost::asio::awaitable<HttpResponse> onSendChunkStream(BodyStreamParser& parser,
+                                                           SslStream& stream,
+                                                           boost::beast::flat_buffer& buffer,
+                                                           MemoryReservation& reservation);
+
+    // Rejects chunks and batches of a cancelled session, or with a foreign session or file token,
+    // by their header so that their body isn't read
+    std::optional<HttpResponse> precheckUpload(const HttpRequest& req);
+
+    // Handles a session's connection once it switched from HTTP to frames, the connection takes
+    // HTTP requests again after the sender ended the stream
+    boost::asio::awaitable<bool> onStream(HttpRequest&& req,
+                                          SslStream& stream,
+                                          boost::beast::flat_buffer& buffer);
+
+    using SessionPtr = std::shared_ptr<ReceiveSessionContext>;
+
+    // Handles the frames of an upgraded connection as read by `read_frame`, acks and the reason
+    // the frames end are written to `stream`. Returns true if the sender ended the frames.
+    boost::asio::awaitable<bool> serveFrames(
+        SessionPtr session,
+        SslStream& stream,
+        std::function<boost::asio::awaitable<Frame>()> read_frame);
+
+    // Receives a whole file as a chunked body of data frames
+    boost::asio::awaitable<HttpResponse> onUploadFile(BodyStreamParser& parser,
+                                                      SslStream& stream,
+                                                      boost::beast::flat_buffer& buffer,
+                                                      MemoryReservation& reservation);
+
     boost::asio::awaitable<boost::beast::http::response<boost::beast::http::string_body>>
     onVerifyIntegrity(const boost::beast::http::request<boost::beast::http::string_body>& req);
 
+    // The sender's multicast round is over: stops receiving it and answers which chunks are
+    // still missing, the sender sends those as usual
+    boost::asio::awaitable<HttpResponse> onMulticastDone(const HttpRequest& req);
+
     boost::asio::awaitable<boost::beast::http::response<boost::beast::http::string_body>>
     onCancelSend(const boost::beast::http::request<boost::beast::http::string_body>& req);
 
+    // Cancels queued requests and sessions waiting for confirmation, the sender names them by
+    // queue ticket, by device id or by ip and port
     boost::asio::awaitable<boost::beast::http::response<boost::beast::http::string_body>>
     onCancelWait(const boost::beast::http::request<boost::beast::http::string_body>& req);
 
     boost::asio::awaitable<std::optional<std::vector<FileDto>>> waitForUserConfirmation(
-        std::string device_id, const std::vector<FileDto>& files, int timeout_seconds = 30);
+        ReceiveSessionContext& session,
+        std::string device_id,
+        const std::vector<FileDto>& files,
+        int timeout_seconds = 30);
+
+    // A send request that came while every session was taken. The sender keeps its place by
+    // coming back to /wait-turn with the ticket instead of sending the request again.
+    struct QueuedRequest {
+        std::string ticket; // Becomes the session id once the request gets its turn
+        RequestSendDto request;
+        std::chrono::steady_clock::time_point last_seen;
+        bool cancelled = false;
+        // Set while a request of the sender is held open for the turn, cancelled on changes
+        boost::asio::steady_timer* wakeup = nullptr;
+    };
+    using QueuedPtr = std::shared_ptr<QueuedRequest>;
+
+    // Hold the request open until its turn comes or kQueueHoldTime passed, then either start
+    // the session or tell the sender its position
+    boost::asio::awaitable<HttpResponse> waitForTurn(QueuedPtr queued,
+                                                     unsigned int version,
+                                                     bool keep_alive);
+    // Ask the UI about a send request and set up the session if it is accepted
+    boost::asio::awaitable<HttpResponse> startSession(RequestSendDto request,
+                                                      std::string session_id,
+                                                      unsigned int version,
+                                                      bool keep_alive);
+    // Drop queued requests whose sender stopped coming back
+    void pruneQueue();
+    // Wake the held requests to check whether their turn came
+    void notifyQueue();
+
+    // The session with the id, ended ones are kept for a while to tell late requests why they
+    // are refused
+    SessionPtr findSession(std::string_view session_id) const;
+    // Poll the UI for a cancel, which ends every session since it doesn't name one
+    bool pollReceiverCancel();
+    // Refusal for requests of a session that is missing or not receiving
+    static std::optional<HttpResponse> checkSession(const SessionPtr& session,
+                                                    unsigned int version,
+                                                    bool keep_alive);
+
+    // Decide which chunks of the accepted files can be satisfied locally, either from the
+    // chunk index or from files sent earlier in this session. The indexed chunks are checked and
+    // copied on the disk thread.
+    boost::asio::awaitable<std::unordered_map<FileId, std::vector<std::size_t>>> planLocalChunks(
+        ReceiveSessionContext& session, const std::vector<FileDto>& files);
+    // Join the multicast round the sender offered, returns false if there is none or the group
+    // can't be joined. `file_ids` are the files of the request in their order.
+    bool joinMulticast(const ReceiveSessionContext& session,
+                       const RequestSendDto& request,
+                       std::vector<FileId> file_ids);
+    // Copy chunks provided by other files of this session into the file's temp file, on the disk
+    // thread
+    boost::asio::awaitable<void> materializeLocalChunks(ReceiveSessionContext& session,
+                                                        ReceiveFileContext& file_context);
+
+    // What became of a chunk handed to acceptChunk
+    enum class ChunkOutcome {
+        kAccepted,
+        kFinalized, // Accepted, and the file was finalized with it
+        kDuplicate, // Received before, dropped
+        kRejected,  // Corrupt, the sender is asked to send it again
+    };
+
+    // Validate a chunk and write it into its temp file. Throws on invalid chunks, and on corrupt
+    // ones once the session rejected too many.
+    boost::asio::awaitable<ChunkOutcome> acceptChunk(ReceiveSessionContext& session,
+                                                     const SendChunkDto& send_chunk_dto,
+                                                     BinaryData& chunk_data);
+    // Check a chunk's metadata, returns the file it belongs to or nullptr if it was received
+    // before. Throws on invalid chunks.
+    static ReceiveFileContext* validateChunk(ReceiveSessionContext& session,
+                                             const SendChunkDto& send_chunk_dto);
+    // Wait for the session's share of the bandwidth before taking `bytes` more of its data, which
+    // holds the response back and with it the sender
+    boost::asio::awaitable<void> throttle(const ReceiveSessionContext& session, std::size_t bytes);
+    // Run a write to the session's temp files in the session's turn, throws if the session ended
+    // in the meantime
+    boost::asio::awaitable<void> writeToDisk(ReceiveSessionContext& session,
+                                             std::function<void()> write);
+    // Record a chunk written to the temp file, returns true if it was final and the file has been
+    // finalized with it
+    boost::asio::awaitable<bool> commitChunk(ReceiveSessionContext& session,
+                                             const SendChunkDto& send_chunk_dto,
+                                             ReceiveFileContext& file_context);
+    // Record a chunk that failed its checksum for the sender to send again, throws once the
+    // session rejected more than transfer::kMaxRejectedChunks
+    void rejectChunk(ReceiveSessionContext& session,
+                     const SendChunkDto& send_chunk_dto,
+                     ReceiveFileContext& file_context,
+                     std::string_view reason);
+    // Response to a chunk sent in its own request. Rejected chunks get 422 Unprocessable Entity,
+    // the responses to final, duplicate and rejected chunks list the file's received chunks.
+    HttpResponse chunkResponse(ReceiveSessionContext& session,
+                               const SendChunkDto& send_chunk_dto,
+                               ChunkOutcome outcome,
+                               unsigned int version,
+                               bool keep_alive);
+    // Response to a final chunk sent again because the response that finalized its file got lost,
+    // std::nullopt unless the file is complete. The session may have ended with the file.
+    static std::optional<HttpResponse> finalizedRetry(const ReceiveSessionContext& session,
+                                                      const SendChunkDto& send_chunk_dto,
+                                                      unsigned int version,
+                                                      bool keep_alive);
+    // Tell the sender which chunks of the file arrived, with kReceivedChunksHeader
+    static void setReceivedChunks(HttpResponse& res,
+                                  const ReceiveSessionContext& session,
+                                  const FileId& file_id);
+    static std::fstream openTempFile(const ReceiveFileContext& file_context);
+    // Verify a completely received file and move it to its final path, throws on failure. The file
+    // is hashed on the disk thread. Returns right away if another request finalizes the file,
+    // which fails the session if the file doesn't verify.
+    boost::asio::awaitable<void> finalizeFile(ReceiveSessionContext& session,
+                                              const FileId& file_id,
+                                              ReceiveFileContext& file_context);
+    // Save a file whose content was embedded in the request on the disk thread, returns false if
+    // it has to be sent
+    boost::asio::awaitable<bool> storeInlineFile(ReceiveSessionContext& session,
+                                                 const FileDto& file);
+    // Pick a free path under the save directory for a verified file
+    std::filesystem::path resolveFinalPath(const ReceiveFileContext& file_context);
+    // Record a verified file that has been written to its final path
+    void completeFile(ReceiveSessionContext& session,
+                      ReceiveFileContext& file_context,
+                      const std::filesystem::path& final_file_path);
 
     void installRoutes();
-    void doCleanup(); // Clean up any unfinished temp files when cancelled or failed
-    void checkSessionCompletion();
+    // Remove the temp files of every unfinished file when cancelled or failed
+    void doCleanup(const ReceiveSessionContext& session);
+    void checkSessionCompletion(ReceiveSessionContext& session);
+    // End a session without touching the others, returns false if it had already ended
+    bool endSession(ReceiveSessionContext& session);
+    // End a session after an error and tell the UI
+    void failSession(ReceiveSessionContext& session, std::string_view error_message);
 
     HttpServer& server_;
     std::filesystem::path save_dir_;
@@ -78,13 +258,15 @@ private:
     WaitConditionFunc wait_condition_;
     CancelConditionFunc cancel_condition_;
 
-    ReceiveSessionStatus session_status_{ReceiveSessionStatus::kIdle};
-    std::string session_id_{};
-    std::unordered_map<FileId, ReceiveFileContext> received_files_;
-    std::size_t completed_file_count_{0};
-
-    std::string sender_ip_{};
-    unsigned short sender_port_{};
+    std::unordered_map<SessionId, SessionPtr> sessions_;
+    std::deque<QueuedPtr> queue_; // Send requests waiting for a free session, oldest first
+    // Bandwidth shares of the receiving sessions
+    std::unordered_map<SessionId, std::shared_ptr<BandwidthFlow>> bandwidth_flows_;
+    // Multicast rounds the sessions receive until the sender reports them done
+    std::unordered_map<SessionId, std::shared_ptr<MulticastReceiver>> multicast_receivers_;
+    bool confirming_ = false; // The UI asks about one send request at a time
+    ChunkIndex chunk_index_;
+    std::shared_ptr<DiskWriteScheduler> disk_writer_;
 
     void feedback(Feedback&& feedback) {
         if (callback_) {
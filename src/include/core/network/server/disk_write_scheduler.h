@@ -0,0 +1,59 @@
+#pragma once
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace lansend::core {
+
+// Runs the file writes of receive sessions on a thread of its own, so that the connections keep
+// being read while the disk is busy. Every session queues its writes separately and the sessions
+// take turns one write at a time, so a sender with many connections can't starve the others.
+class DiskWriteScheduler : public std::enable_shared_from_this<DiskWriteScheduler> {
+public:
+    static std::shared_ptr<DiskWriteScheduler> Create(boost::asio::io_context& ioc);
+    ~DiskWriteScheduler();
+
+    DiskWriteScheduler(const DiskWriteScheduler&) = delete;
+    DiskWriteScheduler& operator=(const DiskWriteScheduler&) = delete;
+
+    // Run `write` on the disk thread in the session's turn and wait for it, rethrows what it
+    // threw. Whatever `write` refers to has to stay untouched until it returns.
+    boost::asio::awaitable<void> Write(const std::string& session_id, std::function<void()> write);
+
+    std::uint64_t writes() const { return writes_; }
+    // Writes that had to wait for another one
+    std::uint64_t waits() const { return waits_; }
+
+private:
+    struct Job {
+        std::function<void()> write;
+        std::exception_ptr error;
+        bool done = false;
+        boost::asio::steady_timer finished; // Cancelled once the write returned
+    };
+
+    explicit DiskWriteScheduler(boost::asio::io_context& ioc);
+
+    // Hand the next session's oldest write to the disk thread if it is free
+    void schedule();
+
+    boost::asio::io_context& ioc_;
+    boost::asio::thread_pool pool_{1};
+    // Sessions with queued writes, in the order of their next turn
+    std::deque<std::string> turns_;
+    std::unordered_map<std::string, std::deque<std::shared_ptr<Job>>> queued_;
+    bool busy_ = false;
+    std::uint64_t writes_ = 0;
+    std::uint64_t waits_ = 0;
+};
+
+} // namespace lansend::core
@@ -3,14 +3,24 @@
 #include "core/security/certificate_manager.h"
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
 #include <boost/beast/core/tcp_stream.hpp>
 #include <boost/beast/http.hpp>
+#include <chrono>
+#include <core/constant/transfer.h>
 #include <core/model/feedback.h>
+#include <core/network/bandwidth_scheduler.h>
+#include <core/network/server/memory_budget.h>
 #include <cstdint>
 #include <functional>
-#include <map>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
 
 namespace lansend::core {
 
@@ -22,32 +32,80 @@ using BinaryRequest = boost::beast::http::request<boost::beast::http::vector_bod
 
 using HttpResponse = boost::beast::http::response<boost::beast::http::string_body>;
 
-using StringRequestHandler = std::function<boost::asio::awaitable<HttpResponse>(StringRequest&&)>;
-using BinaryRequestHandler = std::function<boost::asio::awaitable<HttpResponse>(BinaryRequest&&)>;
+// Handlers see the request as it was read, it stays alive until the handler finished
+using StringRequestHandler =
+    std::function<boost::asio::awaitable<HttpResponse>(const StringRequest&)>;
+using BinaryRequestHandler =
+    std::function<boost::asio::awaitable<HttpResponse>(const BinaryRequest&)>;
 
 using HttpRequest = BinaryRequest;
 using RouteHandler = BinaryRequestHandler;
 
+using SslStream = boost::asio::ssl::stream<boost::beast::tcp_stream>;
+using BodyStreamParser = boost::beast::http::request_parser<boost::beast::http::buffer_body>;
+// Reads the request body itself, e.g. to process a large upload while it arrives. Called once
+// the header has been read, the connection is closed after the response unless the whole body
+// was consumed. The handler grows the body's memory reservation if it holds more than
+// kStreamedBodyReservation at once.
+using StreamingRequestHandler = std::function<boost::asio::awaitable<HttpResponse>(
+    BodyStreamParser&, SslStream&, boost::beast::flat_buffer&, MemoryReservation&)>;
+// Takes over a connection that asked to upgrade away from HTTP, including writing the response
+// to the upgrade request. Returns whether the connection went back to HTTP, it is closed
+// otherwise.
+using UpgradeHandler = std::function<boost::asio::awaitable<bool>(
+    HttpRequest&&, SslStream&, boost::beast::flat_buffer&)>;
+// Checks a request by its header before the body is read, the request's body is still empty.
+// Returns the response to reject the request with, its body is then never read into memory.
+using RequestPrecheck = std::function<std::optional<HttpResponse>(const HttpRequest&)>;
+
 enum class RequestType {
     kString,
     kBinary,
+    kStreaming,
+};
+
+// 路由统计
+struct RouteStats {
+    std::uint64_t requests = 0;               // 已处理的请求数
+    std::chrono::nanoseconds total_latency{}; // 处理器累计耗时
+    std::chrono::nanoseconds max_latency{};   // 单个请求的最大耗时
 };
 
 // 路由信息结构体
 struct RouteInfo {
     boost::beast::http::verb method;
     RequestType type;
-    std::variant<StringRequestHandler, BinaryRequestHandler> handler;
+    std::variant<StringRequestHandler, BinaryRequestHandler, StreamingRequestHandler> handler;
+    RequestPrecheck precheck; // Optional
+    std::size_t body_limit = transfer::kDefaultBodyLimit;
+    // Optional, takes over bodies above streamed_body_threshold instead of buffering them
+    StreamingRequestHandler streamed_body_handler;
+    std::size_t streamed_body_threshold = 0;
+    RouteStats stats;
+};
+
+// Hashes std::string and std::string_view alike, so that routes are found by a request's target
+// without copying it
+struct RouteHash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view path) const noexcept {
+        return std::hash<std::string_view>{}(path);
+    }
 };
 
+template<typename T>
+using RouteTable = std::unordered_map<std::string, T, RouteHash, std::equal_to<>>;
+
 //HTTPS 服务器类
 class HttpServer {
 public:
     using ReceiveWaitConditionFunc = std::function<std::optional<std::vector<std::string>>()>;
     using ReceiveCancelConditionFunc = std::function<bool()>;
 
-    // 构造函数
-    HttpServer(boost::asio::io_context& io_context, CertificateManager& cert_manager);
+    // 构造函数，不共享带宽调度器时由服务器自己创建
+    HttpServer(boost::asio::io_context& io_context,
+               CertificateManager& cert_manager,
+               std::shared_ptr<BandwidthScheduler> bandwidth = nullptr);
 
     // 析构函数
     ~HttpServer();
@@ -59,6 +117,19 @@ public:
     void AddRoute(const std::string& path,
                   boost::beast::http::verb method,
                   StringRequestHandler&& handler);
+    void AddRoute(const std::string& path,
+                  boost::beast::http::verb method,
+                  StreamingRequestHandler&& handler);
+    // 为已添加的路由设置请求头预检
+    void SetRoutePrecheck(const std::string& path, RequestPrecheck&& precheck);
+    // 设置已添加路由的请求体大小上限
+    void SetRouteBodyLimit(const std::string& path, std::size_t body_limit);
+    // 超过阈值的请求体交由流式处理器边接收边处理，而不是读入内存
+    void SetRouteStreamedBody(const std::string& path,
+                              std::size_t threshold,
+                              StreamingRequestHandler&& handler);
+    // 添加协议升级路由
+    void AddUpgradeRoute(const std::string& path, UpgradeHandler&& handler);
 
     // 启动服务器
     void Start(uint16_t port);
@@ -71,6 +142,7 @@ public:
     void SetReceiveCancelConditionFunc(ReceiveCancelConditionFunc func);
 
     static HttpResponse Ok(unsigned int version, bool keep_alive, std::string_view body = {});
+    static HttpResponse Accepted(unsigned int version, bool keep_alive, std::string_view body = {});
     static HttpResponse NotFound(unsigned int version,
                                  bool keep_alive,
                                  std::string_view error_message = "Not Found");
@@ -87,31 +159,73 @@ public:
     static HttpResponse MethodNotAllowed(unsigned int version,
                                          bool keep_alive,
                                          std::string_view error_message = "Method Not Allowed");
+    static HttpResponse PayloadTooLarge(unsigned int version,
+                                        bool keep_alive,
+                                        std::string_view error_message = "Payload Too Large");
+    static HttpResponse UnprocessableEntity(
+        unsigned int version,
+        bool keep_alive,
+        std::string_view error_message = "Unprocessable Entity");
+    static HttpResponse SwitchingProtocols(unsigned int version, std::string_view protocol);
+
+    // How long a connection may wait for the next request, or for a read or write to progress
+    static constexpr std::chrono::seconds kIdleTimeout{30};
+    // Requests read ahead on a connection while earlier ones are still being handled
+    static constexpr std::size_t kMaxPipelinedRequests = 4;
+
+    boost::asio::io_context& io_context() { return io_context_; }
+
+    // Request body memory in flight across all connections
+    MemoryBudget& memory_budget() { return memory_budget_; }
+
+    // Schedules the receive sessions' bandwidth, shared with the sends when given at construction
+    BandwidthScheduler& bandwidth() { return *bandwidth_; }
+
+    // 各路由的请求数与处理耗时
+    std::vector<std::pair<std::string, RouteStats>> GetRouteStats() const;
 
     // 获取接收控制器
     ReceiveController& GetReceiveController() { return *receive_controller_; }
 
+    // Body bytes read and dropped for requests rejected by a precheck, i.e. sent by clients that
+    // don't wait for 100 Continue
+    std::uint64_t discarded_body_bytes() const { return discarded_body_bytes_; }
+
 private:
     // 接受连接
     boost::asio::awaitable<void> acceptConnections();
 
     // 处理连接
     boost::asio::awaitable<void> handleConnection(
-        boost::asio::ssl::stream<boost::beast::tcp_stream> stream);
+        boost::asio::ssl::stream<boost::beast::tcp_stream> connection);
+
+    // A request whose body was read for its route's handler type
+    using IncomingRequest = std::variant<StringRequest, BinaryRequest>;
 
     // 处理请求
-    boost::asio::awaitable<HttpResponse> handleRequest(HttpRequest&& request);
+    boost::asio::awaitable<HttpResponse> handleRequest(IncomingRequest request);
+
+    // Read the rest of a rejected request's body into a small scratch buffer, so that the
+    // connection can take the next request. Returns the number of bytes dropped.
+    static boost::asio::awaitable<std::size_t> discardBody(
+        boost::beast::http::request_parser<boost::beast::http::vector_body<std::uint8_t>>&& parser,
+        SslStream& stream,
+        boost::beast::flat_buffer& buffer);
 
-    static StringRequest binaryToStringRequest(const BinaryRequest& req);
+    static void recordLatency(RouteInfo& route, std::chrono::steady_clock::duration latency);
 
     boost::asio::io_context& io_context_;
     CertificateManager& cert_manager_;
     boost::asio::ssl::context ssl_context_;
     boost::asio::ip::tcp::acceptor acceptor_;
     bool running_;
-    std::map<std::string, RouteInfo> routes_;
+    RouteTable<RouteInfo> routes_;
+    RouteTable<UpgradeHandler> upgrade_routes_;
     std::unique_ptr<CommonController> common_controller_;
     std::unique_ptr<ReceiveController> receive_controller_;
+    std::uint64_t discarded_body_bytes_ = 0;
+    MemoryBudget memory_budget_;
+    std::shared_ptr<BandwidthScheduler> bandwidth_;
 };
 
 } // namespace lansend::core
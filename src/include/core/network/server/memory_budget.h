@@ -0,0 +1,73 @@
+#pragma once
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <cstddef>
+#include <cstdint>
+
+namespace lansend::core {
+
+class MemoryBudget;
+
+// Memory held for a request body, handed back to the budget when the reservation ends
+class MemoryReservation {
+public:
+    MemoryReservation() = default;
+    ~MemoryReservation();
+
+    MemoryReservation(MemoryReservation&& other) noexcept;
+    MemoryReservation& operator=(MemoryReservation&& other) noexcept;
+
+    MemoryReservation(const MemoryReservation&) = delete;
+    MemoryReservation& operator=(const MemoryReservation&) = delete;
+
+    std::size_t size() const { return size_; }
+
+    void Release();
+
+private:
+    friend class MemoryBudget;
+
+    MemoryReservation(MemoryBudget* budget, std::size_t size);
+
+    MemoryBudget* budget_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+// Request body memory in flight across all connections of a server. Connections wait for their
+// reservation before reading a body, so that the data stays in the socket buffers and TCP slows
+// the senders down while the server is short on memory.
+class MemoryBudget {
+public:
+    MemoryBudget(boost::asio::io_context& ioc, std::size_t capacity);
+
+    MemoryBudget(const MemoryBudget&) = delete;
+    MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+    // Wait until `size` more bytes fit into the budget. Reservations larger than the whole
+    // budget are granted once nothing else is held, so that no request waits forever.
+    boost::asio::awaitable<MemoryReservation> Reserve(std::size_t size);
+    // Grow `reservation` to `size` bytes. If that has to wait, the reservation is handed back
+    // meanwhile, so that connections growing theirs at the same time don't wait for each other.
+    boost::asio::awaitable<void> Grow(MemoryReservation& reservation, std::size_t size);
+
+    std::size_t capacity() const { return capacity_; }
+    std::size_t used() const { return used_; }
+    std::size_t peak() const { return peak_; }
+    // Reservations that had to wait for memory to be released
+    std::uint64_t waits() const { return waits_; }
+
+private:
+    friend class MemoryReservation;
+
+    void release(std::size_t size);
+
+    std::size_t capacity_;
+    std::size_t used_ = 0;
+    std::size_t peak_ = 0;
+    std::uint64_t waits_ = 0;
+    boost::asio::steady_timer released_; // Cancelled whenever memory is handed back
+};
+
+} // namespace lansend::core
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <boost/asio.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <core/constant/transfer.h>
+#include <core/util/binary_message.h>
+#include <core/util/compression.h>
+#include <cstdint>
+#include <format>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace lansend::core {
+
+// Protocol name used in the `Upgrade` header when a session switches its connection from
+// HTTP requests to frames
+constexpr std::string_view kStreamProtocol = "lansend-stream";
+// Header carrying the session the upgraded connection or file upload belongs to
+constexpr std::string_view kStreamSessionHeader = "X-Lansend-Session-Id";
+// Headers identifying the file of a /upload-file request, whose chunked body is a sequence of
+// data frames with a zero stream id
+constexpr std::string_view kUploadFileIdHeader = "X-Lansend-File-Id";
+constexpr std::string_view kUploadFileTokenHeader = "X-Lansend-File-Token";
+// Header of the responses to chunk and upload requests listing the chunks of the file the
+// receiver has, see chunk_ranges::Format
+constexpr std::string_view kReceivedChunksHeader = "X-Lansend-Received-Chunks";
+
+enum class FrameType : std::uint8_t {
+    kOpen = 1,   // client -> server, binds the stream id to a file: {"file_id", "file_token"}
+    kData = 2,   // client -> server, DataFrameInfo followed by one chunk of the stream's file
+    kVerify = 3, // client -> server, finalize the stream's file without sending data
+    kAck = 4,    // server -> client, a data or verify frame was processed
+    kCancel = 5, // either way, the session was cancelled, payload is the reason
+    kError = 6,  // server -> client, processing failed, payload is the error message
+    kEnd = 7,    // client -> server, no more frames will follow
+    kNak = 8,    // server -> client, a data frame's chunk was rejected and has to be sent again
+};
+
+namespace frame_flag {
+
+constexpr std::uint8_t kFinal = 0x01;     // Data frame carrying the last chunk sent for a file
+constexpr std::uint8_t kFinalized = 0x02; // Ack of a frame after which the file was saved
+
+} // namespace frame_flag
+
+// Every frame starts with a fixed size header, integers are big-endian:
+// | type (1) | flags (1) | reserved (2) | stream id (4) | payload length (4) |
+struct FrameHeader {
+    FrameType type;
+    std::uint8_t flags = 0;
+    std::uint32_t stream_id = 0;
+    std::uint32_t length = 0;
+};
+
+constexpr std::size_t kFrameHeaderSize = 12;
+constexpr std::size_t kMaxFramePayloadSize = transfer::kMaxChunkSize + 4096;
+
+// Chunk metadata at the start of a data frame payload:
+// | chunk index (8) | compression (1) | reserved (3) | uncompressed size (4) | checksum (64) |
+struct DataFrameInfo {
+    std::uint64_t chunk_index = 0;
+    CompressionAlgorithm compression = CompressionAlgorithm::kNone;
+    std::uint32_t uncompressed_size = 0;
+    std::string chunk_checksum; // Hex SHA-256 of the uncompressed chunk
+};
+
+constexpr std::size_t kDataFrameInfoSize = 80;
+
+struct Frame {
+    FrameHeader header;
+    BinaryData payload;
+};
+
+std::array<std::uint8_t, kFrameHeaderSize> EncodeFrameHeader(const FrameHeader& header);
+FrameHeader DecodeFrameHeader(std::span<const std::uint8_t, kFrameHeaderSize> data);
+
+std::array<std::uint8_t, kDataFrameInfoSize> EncodeDataFrameInfo(const DataFrameInfo& info);
+std::optional<DataFrameInfo> DecodeDataFrameInfo(std::span<const std::uint8_t> payload);
+
+// Acks carry the chunk index they refer to, or nothing for verify frames
+BinaryData EncodeAckPayload(std::uint64_t chunk_index);
+std::uint64_t DecodeAckPayload(std::span<const std::uint8_t> payload);
+
+template<typename AsyncStream>
+boost::asio::awaitable<void> WriteFrame(AsyncStream& stream,
+                                        FrameType type,
+                                        std::uint8_t flags,
+                                        std::uint32_t stream_id,
+                                        std::span<const std::uint8_t> payload = {}) {
+    auto header = EncodeFrameHeader(
+        {type, flags, stream_id, static_cast<std::uint32_t>(payload.size())});
+    std::array<boost::asio::const_buffer, 2> buffers{
+        boost::asio::buffer(header),
+        boost::asio::buffer(payload.data(), payload.size()),
+    };
+    co_await boost::asio::async_write(stream, buffers, boost::asio::use_awaitable);
+}
+
+// Write a data frame without copying the chunk into an intermediate buffer
+template<typename AsyncStream>
+boost::asio::awaitable<void> WriteDataFrame(AsyncStream& stream,
+                                            std::uint8_t flags,
+                                            std::uint32_t stream_id,
+                                            const DataFrameInfo& info,
+                                            std::span<const std::uint8_t> data) {
+    auto header = EncodeFrameHeader(
+        {FrameType::kData,
+         flags,
+         stream_id,
+         static_cast<std::uint32_t>(kDataFrameInfoSize + data.size())});
+    auto encoded_info = EncodeDataFrameInfo(info);
+    std::array<boost::asio::const_buffer, 3> buffers{
+        boost::asio::buffer(header),
+        boost::asio::buffer(encoded_info),
+        boost::asio::buffer(data.data(), data.size()),
+    };
+    co_await boost::asio::async_write(stream, buffers, boost::asio::use_awaitable);
+}
+
+namespace details {
+
+template<typename AsyncStream>
+boost::asio::awaitable<void> FillBuffer(AsyncStream& stream,
+                                        boost::beast::flat_buffer& buffer,
+                                        std::size_t size) {
+    while (buffer.size() < size) {
+        std::size_t bytes_read = co_await stream.async_read_some(
+            buffer.prepare(std::max<std::size_t>(size - buffer.size(), 64 * 1024)),
+            boost::asio::use_awaitable);
+        buffer.commit(bytes_read);
+    }
+}
+
+} // namespace details
+
+// Read the next frame, `buffer` may already hold bytes read past a previous message
+template<typename AsyncStream>
+boost::asio::awaitable<Frame> ReadFrame(AsyncStream& stream, boost::beast::flat_buffer& buffer) {
+    co_await details::FillBuffer(stream, buffer, kFrameHeaderSize);
+    Frame frame;
+    frame.header = DecodeFrameHeader(
+        std::span<const std::uint8_t, kFrameHeaderSize>(
+            static_cast<const std::uint8_t*>(buffer.data().data()), kFrameHeaderSize));
+    if (frame.header.length > kMaxFramePayloadSize) {
+        throw std::runtime_error(std::format("Frame payload too large: {}", frame.header.length));
+    }
+    buffer.consume(kFrameHeaderSize);
+
+    co_await details::FillBuffer(stream, buffer, frame.header.length);
+    const auto* payload = static_cast<const std::uint8_t*>(buffer.data().data());
+    frame.payload.assign(payload, payload + frame.header.length);
+    buffer.consume(frame.header.length);
+    co_return frame;
+}
+
+} // namespace lansend::core
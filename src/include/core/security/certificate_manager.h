@@ -1,9 +1,17 @@
 #pragma once
 
 #include <boost/asio/ssl/context.hpp>
+#include <chrono>
+#include <condition_variable>
 #include <core/model/security_context.h>
 #include <filesystem>
+#include <mutex>
+#include <optional>
+#include <stop_token>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
 #include <unordered_set>
 
 namespace lansend::core {
@@ -11,11 +19,21 @@ namespace lansend::core {
 class CertificateManager {
 public:
     CertificateManager(const std::filesystem::path& certDir);
+    ~CertificateManager();
+
+    CertificateManager(const CertificateManager&) = delete;
+    CertificateManager& operator=(const CertificateManager&) = delete;
 
     const SecurityContext& security_context() const;
 
     static std::string CalculateCertificateHash(const std::string& certificatePem);
 
+    // Names used by the certificate-key-type setting: ecdsa-p256, ed25519 and rsa-2048
+    static std::optional<CertificateKeyType> ParseKeyType(std::string_view name);
+    static std::string_view KeyTypeName(CertificateKeyType key_type);
+
+    // Peer certificates seen before are recognized by the digest of their DER encoding, only new
+    // ones are fingerprinted
     bool VerifyCertificate(bool preverified, boost::asio::ssl::verify_context& ctx);
 
     void TrustFingerprint(const std::string& fingerprint);
@@ -27,7 +45,10 @@ public:
 private:
     bool initSecurityContext();
 
-    bool generateSelfSignedCertificate();
+    bool generateSelfSignedCertificate(CertificateKeyType key_type);
+
+    // Replace an RSA identity with one of `key_type`, the old files are kept under legacy/
+    bool migrateSecurityContext(CertificateKeyType key_type);
 
     bool saveSecurityContext();
 
@@ -35,15 +56,31 @@ private:
 
     void loadTrustedFingerprints();
 
-    void saveTrustedFingerprints();
+    // Returns whether the fingerprint was new, the list is then saved in the background
+    bool addTrustedFingerprint(const std::string& fingerprint);
+
+    // Wake the writer, which saves the list once it stayed unchanged for kSaveDelay
+    void scheduleFingerprintSave();
+
+    void runFingerprintWriter(std::stop_token stop);
+
+    void writeTrustedFingerprints(const std::unordered_set<std::string>& fingerprints);
 
     SecurityContext security_context_;
     std::filesystem::path certificate_dir_;
     std::filesystem::path trusted_fingerprints_path_;
 
+    std::mutex fingerprints_mutex_; // Guards the members below, used from io and writer threads
     std::unordered_set<std::string> trusted_fingerprints_;
+    // DER digest of a verified certificate -> its fingerprint
+    std::unordered_map<std::string, std::string> verified_certificates_;
+    bool save_pending_ = false;
+    std::condition_variable_any save_cv_;
+    std::jthread fingerprint_writer_; // Last, so it stops before the members it uses go away
 
     static constexpr int kCertValidityDays = 3650;
+    static constexpr std::size_t kMaxVerifiedCertificates = 1024;
+    static constexpr std::chrono::milliseconds kSaveDelay{500};
 };
 
 } // namespace lansend::core
\ No newline at end of file
@@ -2,17 +2,34 @@
 
 #include <core/util/binary_message.h>
 #include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
 
 namespace lansend::core {
 
+struct FileChecksums {
+    std::string file_checksum;                // SHA-256 of the whole file
+    std::vector<std::string> chunk_checksums; // SHA-256 of every chunk, in chunk order
+};
+
 class FileHasher {
 public:
     static std::string CalculateFileChecksum(const std::filesystem::path& file_path);
-    static std::string CalculateDataChecksum(const BinaryData& data);
+    static std::string CalculateDataChecksum(std::span<const std::uint8_t> data);
+
+    // Hash the whole file and each of its chunks in a single pass over the file
+    static FileChecksums CalculateFileAndChunkChecksums(const std::filesystem::path& file_path,
+                                                        std::size_t chunk_size);
+
+    // Hash `size` bytes of the file starting at `offset`
+    static std::string CalculateRangeChecksum(const std::filesystem::path& file_path,
+                                              std::size_t offset,
+                                              std::size_t size);
 
 private:
     FileHasher();
     static FileHasher instance;
 };
 
-} // namespace lansend::core
\ No newline at end of file
+} // namespace lansend::core
@@ -17,10 +17,17 @@
 #include <openssl/ssl.h>
 #include <openssl/x509.h>
 #include <openssl/x509_vfy.h>
+#include <optional>
 #include <string_view>
 
 namespace lansend::core {
 
+// Which AEAD the TLS contexts put first
+enum class CipherPreference {
+    kAesGcm,   // AES-GCM, fastest with AES instructions (AES-NI, ARMv8 crypto extensions)
+    kChaCha20, // ChaCha20-Poly1305, fastest in software
+};
+
 class OpenSSLProvider {
 private:
     OpenSSLProvider() = default;
@@ -33,6 +40,8 @@ private:
 
     bool initialized_ = false;
 
+    static constexpr long kSessionTimeoutSeconds = 24 * 60 * 60;
+
 public:
     /**
      * @brief Initialize OpenSSL library
@@ -46,20 +55,34 @@ public:
      * @brief Build a client SSL context with the given verification callback
      * 
      * @param verify_callback Callback function called during the certificate verification process
+     * @param enable_ktls Let OpenSSL hand the record layer to the kernel (Linux kTLS). Only takes
+     *        effect for connections attached to a socket with SSL_set_fd, boost::asio streams
+     *        keep encrypting in user space
      * @return boost::asio::ssl::context SSL context configured for client use
      */
     static boost::asio::ssl::context BuildClientContext(
-        std::function<bool(bool, boost::asio::ssl::verify_context&)> verify_callback);
+        std::function<bool(bool, boost::asio::ssl::verify_context&)> verify_callback,
+        bool enable_ktls = false);
 
     /**
      * @brief Build a server SSL context with the given certificate and key in PEM format
      * 
      * @param cert_pem Certificate in PEM format
      * @param key_pem Private key in PEM format
+     * @param enable_ktls Same as for BuildClientContext
      * @return boost::asio::ssl::context SSL context configured for server use
      */
     static boost::asio::ssl::context BuildServerContext(std::string_view cert_pem,
-                                                        std::string_view key_pem);
+                                                        std::string_view key_pem,
+                                                        bool enable_ktls = false);
+
+    /**
+     * @brief Check whether the kernel encrypts the records sent on the connection
+     * 
+     * @param ssl SSL connection object, after the handshake
+     * @return bool True if kTLS is active for sending, so that SSL_sendfile can be used
+     */
+    static bool IsKtlsSendActive(SSL* ssl);
 
     /**
      * @brief Set the hostname for the SSL connection
@@ -69,6 +92,26 @@ public:
      * @return bool True if hostname was set successfully, false otherwise
      */
     static bool SetHostname(SSL* ssl, std::string_view hostname);
+
+    /**
+     * @brief Check whether the CPU has AES instructions
+     * 
+     * @return bool True for AES-NI on x86 and the crypto extensions on ARMv8
+     */
+    static bool HasAesInstructions();
+
+    /**
+     * @brief Resolve the tls-cipher-preference setting, "auto" picks by HasAesInstructions
+     * 
+     * @return CipherPreference The preference all contexts are built with
+     */
+    static CipherPreference ResolveCipherPreference();
+
+    /**
+     * @brief Names used by the tls-cipher-preference setting: auto, aes-gcm and chacha20
+     */
+    static std::optional<CipherPreference> ParseCipherPreference(std::string_view name);
+    static std::string_view CipherPreferenceName(CipherPreference preference);
 };
 
 } // namespace lansend::core
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <boost/asio/ssl/context.hpp>
+#include <chrono>
+#include <core/security/certificate_manager.h>
+#include <core/security/open_ssl_provider.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace lansend::core {
+
+struct HandshakeStats {
+    std::uint64_t handshakes = 0;         // Completed client handshakes
+    std::uint64_t resumed = 0;            // Of which resumed a cached session
+    double total_full_seconds = 0.0;      // Time spent in full handshakes
+    double total_resumed_seconds = 0.0;   // Time spent in resumed handshakes
+
+    double average_full_ms() const {
+        auto full = handshakes - resumed;
+        return full > 0 ? total_full_seconds * 1000.0 / full : 0.0;
+    }
+    double average_resumed_ms() const {
+        return resumed > 0 ? total_resumed_seconds * 1000.0 / resumed : 0.0;
+    }
+};
+
+// The client TLS context shared by all outgoing connections of the process, together with the
+// sessions they can resume. Sessions are cached per peer, keyed by device id and endpoint, and
+// collected from OpenSSL's new session callback since TLS 1.3 tickets arrive after the
+// handshake.
+class TlsSessionCache {
+public:
+    // Created on first use, `cert_manager` verifies the peers of all later connections
+    static TlsSessionCache& Instance(CertificateManager& cert_manager);
+
+    ~TlsSessionCache();
+
+    TlsSessionCache(const TlsSessionCache&) = delete;
+    TlsSessionCache& operator=(const TlsSessionCache&) = delete;
+
+    boost::asio::ssl::context& context() { return ssl_ctx_; }
+
+    static std::string PeerKey(std::string_view device_id,
+                               std::string_view host,
+                               unsigned short port);
+
+    // Attach the peer's cached session, if any, to a connection before its handshake and tag the
+    // connection so that new sessions are stored under `peer_key`
+    void PrepareConnection(SSL* ssl, const std::string& peer_key);
+
+    // Record a finished handshake, returns whether it resumed a session
+    bool RecordHandshake(SSL* ssl, std::chrono::steady_clock::duration duration);
+
+    // Drop the peer's session, e.g. after the peer changed its certificate
+    void Forget(const std::string& peer_key);
+
+    HandshakeStats stats() const;
+
+private:
+    explicit TlsSessionCache(CertificateManager& cert_manager);
+
+    static int onNewSession(SSL* ssl, SSL_SESSION* session);
+
+    boost::asio::ssl::context ssl_ctx_;
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, SSL_SESSION*> sessions_; // Owns one reference each
+    HandshakeStats stats_;
+
+    static constexpr std::size_t kMaxCachedPeers = 256;
+};
+
+} // namespace lansend::core
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <core/util/binary_message.h>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace lansend::core {
+
+namespace base64 {
+
+std::string Encode(std::span<const std::uint8_t> data);
+
+// Returns std::nullopt if `text` is not valid base64
+std::optional<BinaryData> Decode(std::string_view text);
+
+} // namespace base64
+
+} // namespace lansend::core
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace lansend::core {
+
+struct ChunkLocation {
+    std::filesystem::path file_path;
+    std::size_t offset;
+    std::size_t size;
+};
+
+// Content-addressed index of chunks belonging to files that were already received.
+// Lets the receiver satisfy advertised chunks from local disk instead of the network.
+class ChunkIndex {
+public:
+    explicit ChunkIndex(const std::filesystem::path& index_path);
+    ~ChunkIndex() = default;
+
+    ChunkIndex(const ChunkIndex&) = delete;
+    ChunkIndex& operator=(const ChunkIndex&) = delete;
+
+    void Load();
+    void Save();
+
+    void AddFile(const std::filesystem::path& file_path,
+                 std::size_t chunk_size,
+                 const std::vector<std::string>& chunk_checksums);
+
+    // Find a still-valid chunk with the given checksum in a file located under `root`
+    std::optional<ChunkLocation> Find(std::string_view chunk_checksum,
+                                      const std::filesystem::path& root);
+
+    std::size_t size() const { return files_.size(); }
+
+private:
+    struct IndexedFile {
+        std::size_t file_size;
+        std::int64_t last_write_time; // Used to detect files modified after indexing
+        std::size_t chunk_size;
+        std::vector<std::string> chunk_checksums;
+        std::int64_t indexed_at;
+    };
+
+    struct ChunkRef {
+        std::string file_path;
+        std::size_t chunk_index;
+    };
+
+    bool isStale(const std::string& file_path, const IndexedFile& file) const;
+    void removeFile(const std::string& file_path);
+    void evictOldest();
+
+    std::filesystem::path index_path_;
+    std::unordered_map<std::string, IndexedFile> files_;
+    std::unordered_multimap<std::string, ChunkRef> chunks_;
+    bool dirty_{false};
+
+    static constexpr std::size_t kMaxIndexedFiles = 10000;
+};
+
+} // namespace lansend::core
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+namespace lansend::core {
+
+namespace chunk_ranges {
+
+// Chunk indices as comma separated inclusive ranges, e.g. "0-15,17,20-31"
+std::string Format(const std::unordered_set<std::size_t>& chunks);
+
+// Returns std::nullopt if `text` is not a list of ranges as Format writes them, or names a chunk
+// at or above `total_chunks`
+std::optional<std::set<std::size_t>> Parse(std::string_view text, std::size_t total_chunks);
+
+} // namespace chunk_ranges
+
+} // namespace lansend::core
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <chrono>
+#include <core/model/file_type.h>
+#include <core/util/binary_message.h>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <vector>
+
+namespace lansend::core {
+
+enum class CompressionAlgorithm {
+    kNone,
+    kLz4,
+    kZstd,
+};
+
+NLOHMANN_JSON_SERIALIZE_ENUM(CompressionAlgorithm,
+                             {
+                                 {CompressionAlgorithm::kNone, "none"},
+                                 {CompressionAlgorithm::kLz4, "lz4"},
+                                 {CompressionAlgorithm::kZstd, "zstd"},
+                             })
+
+namespace compression {
+
+// Throws std::runtime_error on failure
+BinaryData Compress(CompressionAlgorithm algorithm, const BinaryData& data, int level = 0);
+
+// Throws std::runtime_error on failure or when the output size differs from `original_size`
+BinaryData Decompress(CompressionAlgorithm algorithm,
+                      const BinaryData& data,
+                      std::size_t original_size);
+
+} // namespace compression
+
+// Chooses a per-chunk compression for one file.
+//
+// Media is never compressed. Other files are probed with a sample of the first chunk, then
+// every chunk goes through a cost model: the estimated time per raw byte of each candidate is
+// `1 / compress_speed + ratio / link_speed`, so compression is dropped as soon as the CPU
+// rather than the link becomes the bottleneck.
+class AdaptiveCompressor {
+public:
+    AdaptiveCompressor(FileType file_type, const std::vector<CompressionAlgorithm>& accepted);
+
+    struct Compressed {
+        CompressionAlgorithm algorithm; // The one the data was compressed with
+        BinaryData data;
+    };
+
+    // Returns the compressed chunk, or std::nullopt when the chunk should be sent raw. The next
+    // chunk may go out with another algorithm, label each chunk with the one returned here.
+    std::optional<Compressed> Compress(const BinaryData& chunk);
+
+    // Feed back the time the link needed to carry a chunk of `wire_bytes`
+    void RecordSend(std::size_t wire_bytes, std::chrono::steady_clock::duration elapsed);
+
+    // The algorithm the next chunk is compressed with
+    CompressionAlgorithm algorithm() const { return candidates_[current_].algorithm; }
+
+private:
+    struct Candidate {
+        CompressionAlgorithm algorithm;
+        int level;
+        double bytes_per_second; // Compression speed, raw bytes per second
+        double ratio;            // Compressed size / raw size
+    };
+
+    void probe(const BinaryData& chunk);
+    void choose();
+
+    std::vector<Candidate> candidates_; // candidates_[0] is always "send raw"
+    std::size_t current_{0};
+    bool enabled_{false};
+    bool probed_{false};
+    std::size_t chunks_since_probe_{0};
+    double link_bytes_per_second_{kInitialLinkBytesPerSecond};
+
+    static constexpr double kInitialLinkBytesPerSecond = 40.0 * 1024 * 1024; // Typical Wi-Fi
+    static constexpr double kMinUsefulRatio = 0.9;
+    static constexpr double kSmoothing = 0.25;
+    static constexpr std::size_t kProbeSize = 64 * 1024;
+    static constexpr std::size_t kReprobeInterval = 64;
+};
+
+} // namespace lansend::core
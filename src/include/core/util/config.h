@@ -23,6 +23,20 @@
         lansend::settings.pin_code = "new_pin_code";
         lansend::settings.auto_receive = true;
         lansend::settings.save_dir = "/path/to/save";
+        lansend::settings.compression = false;
+        lansend::settings.stream_transport = false;
+        lansend::settings.chunked_upload = false;
+        lansend::settings.kernel_tls = true;
+        lansend::settings.certificate_key_type = "ed25519";
+        lansend::settings.tls_cipher_preference = "chacha20";
+        lansend::settings.max_receive_sessions = 4;
+        lansend::settings.rate_limit = 10240;
+        lansend::settings.device_rate_limit = 0;
+        lansend::settings.transfer_priority = "background";
+        lansend::settings.multicast_transport = true;
+        lansend::settings.multicast_rate = 40960;
+        lansend::settings.udp_transport = true;
+        lansend::settings.device_rate_limits["<device id>"] = 2048;
 
     Initialization and saving:
     - Initialize the configuration (loads from file or creates default):
@@ -34,6 +48,7 @@
 #pragma once
 
 #include <filesystem>
+#include <map>
 #include <string>
 #include <toml++/toml.h>
 
@@ -42,10 +57,26 @@ namespace lansend::core {
 inline toml::table config;
 
 struct Settings {
-    std::uint16_t port;             // Server port
-    std::string pin_code;           // Pin Code for other devices to connect
-    bool auto_receive;              // Whether to automatically receive files from other devices
-    std::filesystem::path save_dir; // Directory to save files from other devices
+    std::uint16_t port;                 // Server port
+    std::string pin_code;               // Pin Code for other devices to connect
+    bool auto_receive;                  // Whether to automatically receive files from other devices
+    std::filesystem::path save_dir;     // Directory to save files from other devices
+    bool compression;                   // Whether to compress chunks when it speeds up the transfer
+    bool stream_transport;              // Whether to upgrade sessions to lansend-stream frames
+    bool chunked_upload;                // Whether to upload each file in one chunked HTTP request
+    bool kernel_tls;                    // Whether uploads may use kernel TLS and sendfile (Linux)
+    std::string certificate_key_type;   // Device certificate key: ecdsa-p256, ed25519 or rsa-2048
+    std::string tls_cipher_preference;  // AEAD put first in TLS: auto, aes-gcm or chacha20
+    std::uint32_t max_receive_sessions; // Senders that may send to this device at the same time
+    std::uint32_t rate_limit;           // KiB/s for all transfers together, 0 for no limit
+    std::uint32_t device_rate_limit;    // KiB/s for the transfers of any one device, 0 for no limit
+    std::string transfer_priority;      // Bandwidth class: interactive, normal or background
+    bool multicast_transport;           // Experimental: multicast fan-out sends on the LAN first
+    std::uint32_t multicast_rate;       // KiB/s the multicast round is sent at
+    bool udp_transport;                 // Experimental: stream data frames over lansend-datagram
+
+    // KiB/s for the transfers of specific devices by device id, instead of device_rate_limit
+    std::map<std::string, std::uint32_t> device_rate_limits;
 };
 
 inline Settings settings;
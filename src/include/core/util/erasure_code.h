@@ -0,0 +1,35 @@
+#pragma once
+
+#include <core/util/binary_message.h>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace lansend::core {
+
+// Systematic Reed-Solomon erasure code over GF(2^8) with a Cauchy generator matrix. A block of
+// `data_symbols` equally sized symbols gets `repair_symbols` more, and any `data_symbols` of them
+// together restore the block, whichever were lost.
+class ErasureCode {
+public:
+    // Throws std::invalid_argument if there are no data symbols or more than 256 symbols in all
+    ErasureCode(std::size_t data_symbols, std::size_t repair_symbols);
+
+    // The repair symbols of a block, `data` holds data_symbols() symbols of the same size
+    std::vector<BinaryData> Encode(const std::vector<BinaryData>& data) const;
+
+    // `symbols` holds the data symbols followed by the repair symbols, std::nullopt for the lost
+    // ones. Restores the lost data symbols in place, returns false if too few symbols arrived.
+    bool Decode(std::vector<std::optional<BinaryData>>& symbols) const;
+
+    std::size_t data_symbols() const { return data_symbols_; }
+    std::size_t repair_symbols() const { return repair_symbols_; }
+
+private:
+    std::size_t data_symbols_;
+    std::size_t repair_symbols_;
+    // Row i holds the coefficients of repair symbol i
+    std::vector<std::vector<std::uint8_t>> matrix_;
+};
+
+} // namespace lansend::core
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+namespace lansend::core {
+
+namespace fileio {
+
+// Copy `length` bytes from `src` at `src_offset` into `dst` at `dst_offset`.
+// `dst` is created if missing and never truncated. Uses copy_file_range on Linux so
+// filesystems with reflink support share extents instead of copying data.
+bool CopyRange(const std::filesystem::path& src,
+               std::uint64_t src_offset,
+               const std::filesystem::path& dst,
+               std::uint64_t dst_offset,
+               std::uint64_t length);
+
+// Clone `src` into `dst` (overwriting it), using reflink (FICLONE/clonefile) when the
+// filesystem supports it and falling back to a regular copy otherwise.
+bool CloneFile(const std::filesystem::path& src, const std::filesystem::path& dst);
+
+} // namespace fileio
+
+} // namespace lansend::core
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "core/network/bandwidth_scheduler.h"
 #include "core/network/client/http_client_service.h"
 #include "core/network/discovery/discovery_manager.h"
 #include "core/network/server/http_server.h"
@@ -7,6 +8,7 @@
 #include "ipc_event_stream.h"
 #include "model.h"
 #include <boost/asio/io_context.hpp>
+#include <memory>
 #include <nlohmann/json_fwd.hpp>
 #include <string>
 
@@ -44,6 +46,8 @@ private:
     IpcEventStream& event_stream_;
     core::CertificateManager cert_manager_;
     core::DiscoveryManager discovery_manager_;
+    // Shared by the send and the receive sessions
+    std::shared_ptr<core::BandwidthScheduler> bandwidth_;
     core::HttpClientService http_client_service_;
     core::HttpServer http_server_;
     std::function<void()> exit_app_callback_ = nullptr;
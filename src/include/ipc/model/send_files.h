@@ -10,8 +10,9 @@ namespace lansend::ipc::operation {
 struct SendFiles {
     std::string device_id;
     std::vector<std::string> file_paths;
+    std::vector<std::string> device_ids; // 同时发送给多个设备时使用，文件只读取一次
 
-    NLOHMANN_DEFINE_TYPE_INTRUSIVE(SendFiles, device_id, file_paths);
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(SendFiles, device_id, file_paths, device_ids);
 };
 
 } // namespace lansend::ipc::operation
\ No newline at end of file
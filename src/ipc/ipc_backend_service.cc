@@ -5,7 +5,9 @@
 #include "core/constant/path.h"
 #include "core/model/feedback.h"
 #include "core/model/feedback/feedback_type.h"
+#include "core/network/bandwidth_scheduler.h"
 #include "core/security/certificate_manager.h"
+#include "core/security/open_ssl_provider.h"
 #include "core/util/config.h"
 // clang-format on
 
@@ -17,8 +19,9 @@ IpcBackendService::IpcBackendService(boost::asio::io_context& ioc, IpcEventStrea
     : ioc_(ioc)
     , event_stream_(event_stream)
     , cert_manager_(core::path::kCertificateDir)
-    , http_client_service_(ioc, cert_manager_)
-    , http_server_(ioc, cert_manager_)
+    , bandwidth_(core::BandwidthScheduler::Create(ioc))
+    , http_client_service_(ioc, cert_manager_, nullptr, bandwidth_)
+    , http_server_(ioc, cert_manager_, bandwidth_)
     , discovery_manager_(ioc)
     , is_running_(true) {
     discovery_manager_.SetDeviceFoundCallback([this](const core::DeviceInfo& device) {
@@ -146,11 +149,6 @@ void IpcBackendService::dispatchOperation(const Operation& operation) {
 }
 
 void IpcBackendService::sendFiles(const operation::SendFiles& send_file) {
-    auto device = discovery_manager_.GetDevice(send_file.device_id);
-    if (!device) {
-        spdlog::error("IPC Error: Device not found");
-        return;
-    }
     if (send_file.file_paths.empty()) {
         spdlog::error("IPC Error: No files to send");
         return;
@@ -158,12 +156,35 @@ void IpcBackendService::sendFiles(const operation::SendFiles& send_file) {
     if (send_file.file_paths.size() > 10) {
         spdlog::error("IPC Error: Too many files to send");
         return;
-        std::vector<std::filesystem::path> file_paths;
-        for (const auto& file_path : send_file.file_paths) {
-            file_paths.emplace_back(file_path);
+    }
+    std::vector<std::filesystem::path> file_paths;
+    for (const auto& file_path : send_file.file_paths) {
+        file_paths.emplace_back(file_path);
+    }
+
+    if (!send_file.device_ids.empty()) {
+        std::vector<core::SendTarget> targets;
+        for (const auto& device_id : send_file.device_ids) {
+            if (auto device = discovery_manager_.GetDevice(device_id); device) {
+                targets.push_back(core::SendTarget{
+                    .host = device->ip_address,
+                    .port = device->port,
+                    .device_id = device_id,
+                });
+            } else {
+                spdlog::error("IPC Error: Device {} not found", device_id);
+            }
         }
-        http_client_service_.SendFiles(device->ip_address, device->port, file_paths);
+        http_client_service_.SendFanout(targets, file_paths);
+        return;
+    }
+
+    auto device = discovery_manager_.GetDevice(send_file.device_id);
+    if (!device) {
+        spdlog::error("IPC Error: Device not found");
+        return;
     }
+    http_client_service_.SendFiles(device->ip_address, device->port, file_paths, device->device_id);
 }
 
 void IpcBackendService::modifySettings(std::string_view key, nlohmann::json value) {
@@ -176,6 +197,66 @@ void IpcBackendService::modifySettings(std::string_view key, nlohmann::json valu
             core::settings.auto_receive = value.get<bool>();
         } else if (key == "save-dir") {
             core::settings.save_dir = value.get<std::string>();
+        } else if (key == "compression") {
+            core::settings.compression = value.get<bool>();
+        } else if (key == "stream-transport") {
+            core::settings.stream_transport = value.get<bool>();
+        } else if (key == "chunked-upload") {
+            core::settings.chunked_upload = value.get<bool>();
+        } else if (key == "kernel-tls") {
+            core::settings.kernel_tls = value.get<bool>();
+        } else if (key == "certificate-key-type") {
+            // Takes effect for new certificates and the migration at the next start
+            auto key_type = value.get<std::string>();
+            if (!core::CertificateManager::ParseKeyType(key_type)) {
+                spdlog::error("IPC Error: Invalid certificate key type {}", key_type);
+                return;
+            }
+            core::settings.certificate_key_type = key_type;
+        } else if (key == "tls-cipher-preference") {
+            // Applies to TLS contexts built after the change, i.e. at the next start
+            auto preference = value.get<std::string>();
+            if (preference != "auto" && !core::OpenSSLProvider::ParseCipherPreference(preference)) {
+                spdlog::error("IPC Error: Invalid TLS cipher preference {}", preference);
+                return;
+            }
+            core::settings.tls_cipher_preference = preference;
+        } else if (key == "max-receive-sessions") {
+            // Sessions already running are not ended when the limit is lowered
+            auto max_sessions = value.get<std::uint32_t>();
+            if (max_sessions == 0) {
+                spdlog::error("IPC Error: At least one receive session has to be allowed");
+                return;
+            }
+            core::settings.max_receive_sessions = max_sessions;
+        } else if (key == "rate-limit") {
+            core::settings.rate_limit = value.get<std::uint32_t>();
+        } else if (key == "device-rate-limit") {
+            core::settings.device_rate_limit = value.get<std::uint32_t>();
+        } else if (key == "device-rate-limits") {
+            core::settings.device_rate_limits
+                = value.get<std::map<std::string, std::uint32_t>>();
+        } else if (key == "transfer-priority") {
+            // Applies to the sessions started after the change
+            auto priority = value.get<std::string>();
+            if (!core::BandwidthScheduler::ParsePriority(priority)) {
+                spdlog::error("IPC Error: Invalid transfer priority {}", priority);
+                return;
+            }
+            core::settings.transfer_priority = priority;
+        } else if (key == "multicast-transport") {
+            // Applies to the fan-out sends started after the change
+            core::settings.multicast_transport = value.get<bool>();
+        } else if (key == "multicast-rate") {
+            auto rate = value.get<std::uint32_t>();
+            if (rate == 0) {
+                spdlog::error("IPC Error: The multicast rate has to be above zero");
+                return;
+            }
+            core::settings.multicast_rate = rate;
+        } else if (key == "udp-transport") {
+            // Applies to the sessions started after the change
+            core::settings.udp_transport = value.get<bool>();
         } else {
             spdlog::error("IPC Error: Invalid key for ModifySettings");
             return;
@@ -184,6 +265,8 @@ void IpcBackendService::modifySettings(std::string_view key, nlohmann::json valu
         spdlog::error("IPC Error: Failed to modify settings: {}", e.what());
         return;
     }
+    // Transfers waiting for bandwidth go on at the new rates right away
+    bandwidth_->Reconfigure();
 }
 
 void IpcBackendService::cancelWaitForConfirmation(const std::string& device_id) {
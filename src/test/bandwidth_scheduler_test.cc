@@ -0,0 +1,110 @@
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <chrono>
+#include <core/network/bandwidth_scheduler.h>
+#include <core/util/config.h>
+#include <cstddef>
+#include <gtest/gtest.h>
+
+namespace net = boost::asio;
+
+namespace lansend::core {
+
+namespace {
+
+// Clears the limits in settings, and restores them after the test
+class BandwidthSchedulerTest : public testing::Test {
+protected:
+    void SetUp() override {
+        saved_ = settings;
+        settings.rate_limit = 0;
+        settings.device_rate_limit = 0;
+        settings.device_rate_limits.clear();
+    }
+
+    void TearDown() override { settings = saved_; }
+
+private:
+    Settings saved_;
+};
+
+// Acquires `bytes` at a time until `stop` is set
+net::awaitable<void> Drain(BandwidthFlow& flow, std::size_t bytes, const bool& stop) {
+    while (!stop) {
+        co_await flow.Acquire(bytes);
+    }
+}
+
+} // namespace
+
+TEST_F(BandwidthSchedulerTest, UnlimitedFlowsOnlyCountTheirBytes) {
+    net::io_context ioc;
+    auto scheduler = BandwidthScheduler::Create(ioc);
+    auto flow = scheduler->Register("peer");
+
+    net::co_spawn(
+        ioc,
+        [&]() -> net::awaitable<void> {
+            co_await flow.Acquire(1000);
+            co_await flow.Acquire(500);
+        },
+        net::detached);
+    ioc.run();
+
+    EXPECT_EQ(flow.bytes(), 1500);
+    EXPECT_EQ(flow.throttled_seconds(), 0.0);
+    EXPECT_EQ(scheduler->stats().flows, 1);
+    EXPECT_EQ(scheduler->stats().classes[static_cast<std::size_t>(TransferPriority::kNormal)].waits,
+              0);
+}
+
+TEST_F(BandwidthSchedulerTest, BucketRefillsAtItsRate) {
+    net::io_context ioc;
+    auto scheduler = BandwidthScheduler::Create(ioc);
+    auto flow = scheduler->Register("peer");
+    // 10 MB/s, the bucket starts out empty
+    flow.SetRateLimit(10'000'000);
+
+    auto start = std::chrono::steady_clock::now();
+    net::co_spawn(
+        ioc,
+        [&]() -> net::awaitable<void> {
+            for (int i = 0; i < 6; ++i) {
+                co_await flow.Acquire(100'000);
+            }
+        },
+        net::detached);
+    ioc.run();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    // The first grant puts the bucket 100 KB into debt, each one after it waits it off
+    EXPECT_EQ(flow.bytes(), 600'000);
+    EXPECT_GE(elapsed.count(), 0.045);
+    EXPECT_LT(elapsed.count(), 0.5);
+    EXPECT_GT(flow.throttled_seconds(), 0.0);
+}
+
+TEST_F(BandwidthSchedulerTest, ContendedFlowsShareByWeight) {
+    settings.rate_limit = 10 * 1024; // 10 MiB/s
+    net::io_context ioc;
+    auto scheduler = BandwidthScheduler::Create(ioc);
+    auto interactive = scheduler->Register("a", TransferPriority::kInteractive);
+    auto background = scheduler->Register("b", TransferPriority::kBackground);
+
+    bool stop = false;
+    net::co_spawn(ioc, Drain(interactive, 16 * 1024, stop), net::detached);
+    net::co_spawn(ioc, Drain(background, 16 * 1024, stop), net::detached);
+    ioc.run_for(std::chrono::milliseconds(300));
+    stop = true;
+    ioc.restart();
+    ioc.run();
+
+    // Weights are 8 to 1. The background flow is slowed down but never starved.
+    EXPECT_GT(background.bytes(), 0);
+    double ratio = static_cast<double>(interactive.bytes()) / background.bytes();
+    EXPECT_GT(ratio, 5.0);
+    EXPECT_LT(ratio, 11.0);
+}
+
+} // namespace lansend::core
@@ -0,0 +1,70 @@
+#include <chrono>
+#include <core/network/datagram/bbr_controller.h>
+#include <cstddef>
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace lansend::core {
+
+namespace {
+
+constexpr std::size_t kPacketSize = transfer::kDatagramSize;
+
+// Drives a BbrController over a path with a fixed RTT, a round of packets at a time
+class Path {
+public:
+    // Sends `packets` and acks them one RTT later, except every `lose_every`th, which is lost
+    void Round(BbrController& bbr, std::size_t packets, std::size_t lose_every = 0) {
+        std::vector<BbrController::PacketState> sent;
+        std::size_t in_flight = 0;
+        for (std::size_t i = 0; i < packets; ++i) {
+            sent.push_back(bbr.OnSend(in_flight, now_));
+            in_flight += kPacketSize;
+            now_ += std::chrono::microseconds(10);
+        }
+        now_ += kRtt;
+        for (std::size_t i = 0; i < sent.size(); ++i) {
+            in_flight -= kPacketSize;
+            if (lose_every != 0 && i % lose_every == 0) {
+                bbr.OnLoss(kPacketSize);
+                continue;
+            }
+            bbr.OnAck(sent[i], kPacketSize, kRtt, in_flight, now_);
+        }
+    }
+
+private:
+    static constexpr std::chrono::microseconds kRtt{2000};
+    BbrController::Clock::time_point now_ = BbrController::Clock::now();
+};
+
+} // namespace
+
+TEST(BbrControllerTest, SmallLossesLeaveTheWindowAlone) {
+    BbrController lossless;
+    BbrController lossy;
+    Path lossless_path;
+    Path lossy_path;
+    for (int round = 0; round < 20; ++round) {
+        lossless_path.Round(lossless, 100);
+        lossy_path.Round(lossy, 100, 100); // 1%
+    }
+    // Only the delivery rate is a percent lower
+    EXPECT_GT(lossy.congestion_window(), 0.98 * lossless.congestion_window());
+}
+
+TEST(BbrControllerTest, LossyRoundCapsTheWindow) {
+    BbrController bbr;
+    Path path;
+    for (int round = 0; round < 20; ++round) {
+        path.Round(bbr, 100);
+    }
+    auto window = bbr.congestion_window();
+    path.Round(bbr, 100, 10); // 10%
+    // The next round start looks at the lossy one
+    path.Round(bbr, 1);
+    EXPECT_LT(bbr.congestion_window(), window);
+    EXPECT_GE(bbr.congestion_window(), BbrController::kMinWindow);
+}
+
+} // namespace lansend::core
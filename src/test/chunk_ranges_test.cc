@@ -0,0 +1,43 @@
+#include <core/util/chunk_ranges.h>
+#include <cstddef>
+#include <gtest/gtest.h>
+#include <set>
+#include <string_view>
+#include <unordered_set>
+
+namespace lansend::core {
+
+TEST(ChunkRangesTest, FormatsSortedInclusiveRanges) {
+    EXPECT_EQ(chunk_ranges::Format({}), "");
+    EXPECT_EQ(chunk_ranges::Format({7}), "7");
+    EXPECT_EQ(chunk_ranges::Format({3, 1, 2, 0}), "0-3");
+    EXPECT_EQ(chunk_ranges::Format({20, 0, 1, 17, 15, 16, 31, 21}), "0-1,15-17,20-21,31");
+}
+
+TEST(ChunkRangesTest, ParseReadsWhatFormatWrites) {
+    std::unordered_set<std::size_t> chunks{0, 1, 2, 5, 9, 10, 11, 12, 40, 63};
+    auto parsed = chunk_ranges::Parse(chunk_ranges::Format(chunks), 64);
+    ASSERT_TRUE(parsed);
+    EXPECT_EQ(*parsed, std::set<std::size_t>(chunks.begin(), chunks.end()));
+
+    auto empty = chunk_ranges::Parse("", 64);
+    ASSERT_TRUE(empty);
+    EXPECT_TRUE(empty->empty());
+}
+
+TEST(ChunkRangesTest, ParseRejectsChunksBeyondTheFile) {
+    EXPECT_TRUE(chunk_ranges::Parse("0-9", 10));
+    EXPECT_FALSE(chunk_ranges::Parse("0-10", 10));
+    EXPECT_FALSE(chunk_ranges::Parse("10", 10));
+    EXPECT_FALSE(chunk_ranges::Parse("0", 0));
+}
+
+TEST(ChunkRangesTest, ParseRejectsMalformedText) {
+    for (std::string_view text :
+         {",", "1,", ",1", "1,,2", "-", "-1", "1-", "3-1", "1-2-3", " 1", "1 ", "a", "1;2", "+1",
+          "99999999999999999999999"}) {
+        EXPECT_FALSE(chunk_ranges::Parse(text, 100)) << '"' << text << '"';
+    }
+}
+
+} // namespace lansend::core
@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <chrono>
+#include <core/util/compression.h>
+#include <cstddef>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+namespace lansend::core {
+
+namespace {
+
+const std::vector<CompressionAlgorithm> kAccepted{CompressionAlgorithm::kLz4,
+                                                  CompressionAlgorithm::kZstd};
+
+// Half random bytes, half zeros, compresses to about half with any algorithm
+BinaryData HalfRandom(std::size_t size, std::mt19937& engine) {
+    BinaryData data(size);
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (std::size_t i = 0; i < size / 2; ++i) {
+        data[i] = static_cast<std::uint8_t>(byte(engine));
+    }
+    return data;
+}
+
+} // namespace
+
+TEST(CompressionTest, RoundTripsEveryAlgorithm) {
+    std::mt19937 engine(3);
+    auto data = HalfRandom(256 * 1024, engine);
+    for (auto algorithm : kAccepted) {
+        auto compressed = compression::Compress(algorithm, data);
+        EXPECT_LT(compressed.size(), data.size());
+        EXPECT_EQ(compression::Decompress(algorithm, compressed, data.size()), data);
+        EXPECT_THROW(compression::Decompress(algorithm, compressed, data.size() - 1),
+                     std::runtime_error);
+    }
+}
+
+TEST(CompressionTest, MediaIsSentRaw) {
+    AdaptiveCompressor compressor(FileType::kVideo, kAccepted);
+    EXPECT_FALSE(compressor.Compress(BinaryData(1024 * 1024)));
+}
+
+TEST(CompressionTest, ChunksKeepTheAlgorithmTheyWereCompressedWith) {
+    AdaptiveCompressor compressor(FileType::kOther, kAccepted);
+    // A slow link, the smallest ratio wins whatever it costs in CPU
+    for (int i = 0; i < 100; ++i) {
+        compressor.RecordSend(1, std::chrono::seconds(1));
+    }
+
+    std::mt19937 engine(5);
+    std::vector<CompressionAlgorithm> used;
+    bool switched_while_compressing = false;
+    // Zeros make zstd the pick, the half random chunks worsen its ratio until lz4 wins over it
+    std::vector<BinaryData> chunks{BinaryData(1024 * 1024)};
+    for (int i = 0; i < 4; ++i) {
+        chunks.push_back(HalfRandom(1024 * 1024, engine));
+    }
+    for (const auto& chunk : chunks) {
+        // Before the first chunk the compressor hasn't probed yet
+        auto before = used.empty() ? CompressionAlgorithm::kZstd : compressor.algorithm();
+        auto compressed = compressor.Compress(chunk);
+        ASSERT_TRUE(compressed);
+        used.push_back(compressed->algorithm);
+        EXPECT_EQ(compression::Decompress(compressed->algorithm, compressed->data, chunk.size()),
+                  chunk);
+        if (before != compressor.algorithm()) {
+            // The switch happened while compressing, the chunk still has the old algorithm
+            EXPECT_EQ(compressed->algorithm, before);
+            switched_while_compressing = true;
+        }
+    }
+    EXPECT_TRUE(switched_while_compressing);
+    EXPECT_EQ(used.front(), CompressionAlgorithm::kZstd);
+    EXPECT_NE(std::ranges::find(used, CompressionAlgorithm::kLz4), used.end());
+}
+
+} // namespace lansend::core
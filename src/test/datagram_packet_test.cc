@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <core/network/datagram/datagram_packet.h>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <span>
+#include <vector>
+
+namespace lansend::core {
+
+namespace {
+
+DatagramKey RandomKey() {
+    DatagramKey key;
+    key.key = *FileEncryptor::GenerateKey();
+    auto salt = *FileEncryptor::GenerateKey(static_cast<int>(key.salt.size()));
+    std::copy(salt.begin(), salt.end(), key.salt.begin());
+    return key;
+}
+
+BinaryData Payload(std::size_t size) {
+    BinaryData payload(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        payload[i] = static_cast<std::uint8_t>(i * 31 + 7);
+    }
+    return payload;
+}
+
+} // namespace
+
+TEST(DatagramPacketTest, SealedPacketsOpenWithTheSameKey) {
+    auto key = RandomKey();
+    auto payload = Payload(1000);
+    auto packet = SealDatagram({DatagramType::kData, 0x0102030405060708}, payload, key);
+    ASSERT_EQ(packet.size(), kDatagramHeaderSize + payload.size() + FileEncryptor::TAG_SIZE);
+
+    auto opened = OpenDatagram(packet, key);
+    ASSERT_TRUE(opened);
+    EXPECT_EQ(opened->first.type, DatagramType::kData);
+    EXPECT_EQ(opened->first.packet_number, 0x0102030405060708u);
+    EXPECT_EQ(opened->second, payload);
+
+    auto empty = OpenDatagram(SealDatagram({DatagramType::kAck, 1}, {}, key), key);
+    ASSERT_TRUE(empty);
+    EXPECT_EQ(empty->first.type, DatagramType::kAck);
+    EXPECT_TRUE(empty->second.empty());
+}
+
+TEST(DatagramPacketTest, PacketNumbersChangeTheCiphertext) {
+    auto key = RandomKey();
+    auto payload = Payload(64);
+    auto first = SealDatagram({DatagramType::kData, 1}, payload, key);
+    auto second = SealDatagram({DatagramType::kData, 2}, payload, key);
+    EXPECT_FALSE(std::equal(first.begin() + kDatagramHeaderSize,
+                            first.end(),
+                            second.begin() + kDatagramHeaderSize));
+}
+
+TEST(DatagramPacketTest, OpenRejectsForgedPackets) {
+    auto key = RandomKey();
+    auto packet = SealDatagram({DatagramType::kData, 9}, Payload(100), key);
+
+    EXPECT_FALSE(OpenDatagram(packet, RandomKey()));
+    // The packet number is in the clear header, moving it breaks the tag
+    for (std::size_t i : {std::size_t{5}, std::size_t{8}, kDatagramHeaderSize, packet.size() - 1}) {
+        auto forged = packet;
+        forged[i] ^= 0x01;
+        EXPECT_FALSE(OpenDatagram(forged, key)) << "byte " << i;
+    }
+    auto other_salt = key;
+    other_salt.salt[0] ^= 0x01;
+    EXPECT_FALSE(OpenDatagram(packet, other_salt));
+
+    auto wrong_magic = packet;
+    wrong_magic[0] ^= 0x01;
+    EXPECT_FALSE(OpenDatagram(wrong_magic, key));
+    auto wrong_version = packet;
+    wrong_version[4] = kDatagramVersion + 1;
+    EXPECT_FALSE(OpenDatagram(wrong_version, key));
+    EXPECT_FALSE(OpenDatagram(std::span(packet).first(kDatagramHeaderSize), key));
+    EXPECT_FALSE(OpenDatagram(std::span(packet).first(packet.size() - 1), key));
+}
+
+TEST(DatagramPacketTest, DataFragmentsRoundTrip) {
+    auto fragment = Payload(kDatagramFragmentSize);
+    auto payload = EncodeDataFragment(5,
+                                      2 * kDatagramFragmentSize,
+                                      4 * kDatagramFragmentSize,
+                                      fragment);
+    auto decoded = DecodeDataFragment(payload);
+    ASSERT_TRUE(decoded);
+    EXPECT_EQ(decoded->message_id, 5u);
+    EXPECT_EQ(decoded->offset, 2 * kDatagramFragmentSize);
+    EXPECT_EQ(decoded->message_length, 4 * kDatagramFragmentSize);
+    EXPECT_EQ(BinaryData(decoded->data.begin(), decoded->data.end()), fragment);
+}
+
+TEST(DatagramPacketTest, DataFragmentsMustFitTheirMessage) {
+    auto fragment = Payload(100);
+    EXPECT_TRUE(DecodeDataFragment(EncodeDataFragment(0, 900, 1000, fragment)));
+    EXPECT_FALSE(DecodeDataFragment(EncodeDataFragment(0, 901, 1000, fragment)));
+    EXPECT_FALSE(DecodeDataFragment(EncodeDataFragment(0, UINT32_MAX, 1000, fragment)));
+    EXPECT_FALSE(DecodeDataFragment(BinaryData(kDataFragmentHeaderSize - 1)));
+}
+
+TEST(DatagramPacketTest, AckRangesRoundTrip) {
+    DatagramAck ack{
+        .ack_delay = std::chrono::microseconds(1500),
+        .ranges = {{100, 120}, {90, 90}, {0, UINT64_MAX / 2}},
+    };
+    auto decoded = DecodeDatagramAck(EncodeDatagramAck(ack));
+    ASSERT_TRUE(decoded);
+    EXPECT_EQ(decoded->ack_delay, ack.ack_delay);
+    EXPECT_EQ(decoded->ranges, ack.ranges);
+
+    auto empty = DecodeDatagramAck(EncodeDatagramAck({}));
+    ASSERT_TRUE(empty);
+    EXPECT_TRUE(empty->ranges.empty());
+}
+
+TEST(DatagramPacketTest, AckEncodingLimitsRangesAndDelay) {
+    DatagramAck ack{.ack_delay = std::chrono::hours(2)};
+    for (std::uint64_t i = 0; i < kMaxAckRanges + 10; ++i) {
+        ack.ranges.emplace_back(1000 - 2 * i, 1000 - 2 * i);
+    }
+    auto decoded = DecodeDatagramAck(EncodeDatagramAck(ack));
+    ASSERT_TRUE(decoded);
+    EXPECT_EQ(decoded->ack_delay, std::chrono::microseconds(UINT32_MAX));
+    ASSERT_EQ(decoded->ranges.size(), kMaxAckRanges);
+    // The highest ranges are kept
+    EXPECT_EQ(decoded->ranges.front(), ack.ranges.front());
+    EXPECT_EQ(decoded->ranges.back(), ack.ranges[kMaxAckRanges - 1]);
+
+    DatagramAck negative{.ack_delay = std::chrono::microseconds(-5), .ranges = {{1, 1}}};
+    EXPECT_EQ(DecodeDatagramAck(EncodeDatagramAck(negative))->ack_delay.count(), 0);
+}
+
+TEST(DatagramPacketTest, DecodeAckRejectsMalformedRanges) {
+    auto payload = EncodeDatagramAck({.ranges = {{5, 9}, {1, 2}}});
+    auto inverted = EncodeDatagramAck({.ranges = {{9, 5}}});
+    EXPECT_FALSE(DecodeDatagramAck(inverted));
+    EXPECT_FALSE(DecodeDatagramAck(std::span(payload).first(payload.size() - 1)));
+    payload.push_back(0);
+    EXPECT_FALSE(DecodeDatagramAck(payload));
+    EXPECT_FALSE(DecodeDatagramAck(BinaryData(7)));
+}
+
+TEST(DatagramPacketTest, KeyExportNeedsAConnectionAndAFullRandom) {
+    std::array<std::uint8_t, kDatagramContextSize> random{};
+    EXPECT_FALSE(ExportDatagramKeys(nullptr, "session", random));
+    EXPECT_FALSE(ExportDatagramKeys(nullptr, "session", std::span(random).first(8)));
+}
+
+} // namespace lansend::core
@@ -0,0 +1,94 @@
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <core/network/server/disk_write_scheduler.h>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace net = boost::asio;
+
+namespace lansend::core {
+
+namespace {
+
+// Writes nothing but `name` into `order`
+net::awaitable<void> RecordWrite(DiskWriteScheduler& scheduler,
+                                 std::string session_id,
+                                 std::string name,
+                                 std::vector<std::string>& order) {
+    co_await scheduler.Write(session_id, [&order, &name]() { order.push_back(name); });
+}
+
+} // namespace
+
+TEST(DiskWriteSchedulerTest, WritesRunOffTheIoThread) {
+    net::io_context ioc;
+    auto scheduler = DiskWriteScheduler::Create(ioc);
+
+    std::thread::id write_thread;
+    bool done = false;
+    net::co_spawn(
+        ioc,
+        [&]() -> net::awaitable<void> {
+            co_await scheduler->Write("session",
+                                      [&]() { write_thread = std::this_thread::get_id(); });
+            done = true;
+        },
+        net::detached);
+    ioc.run();
+
+    EXPECT_TRUE(done);
+    EXPECT_NE(write_thread, std::this_thread::get_id());
+    EXPECT_EQ(scheduler->writes(), 1);
+    EXPECT_EQ(scheduler->waits(), 0);
+}
+
+TEST(DiskWriteSchedulerTest, RethrowsWhatTheWriteThrew) {
+    net::io_context ioc;
+    auto scheduler = DiskWriteScheduler::Create(ioc);
+
+    std::string error;
+    net::co_spawn(
+        ioc,
+        [&]() -> net::awaitable<void> {
+            try {
+                co_await scheduler->Write("session",
+                                          []() { throw std::runtime_error("disk full"); });
+            } catch (const std::runtime_error& e) {
+                error = e.what();
+            }
+            // The scheduler goes on with the next write
+            co_await scheduler->Write("session", []() {});
+        },
+        net::detached);
+    ioc.run();
+
+    EXPECT_EQ(error, "disk full");
+    EXPECT_EQ(scheduler->writes(), 2);
+}
+
+TEST(DiskWriteSchedulerTest, SessionsTakeTurns) {
+    net::io_context ioc;
+    auto scheduler = DiskWriteScheduler::Create(ioc);
+
+    // Only touched by the disk thread until the io context ran out of work
+    std::vector<std::string> order;
+    for (const auto* name : {"a1", "a2", "a3"}) {
+        net::co_spawn(ioc, RecordWrite(*scheduler, "a", name, order), net::detached);
+    }
+    for (const auto* name : {"b1", "b2"}) {
+        net::co_spawn(ioc, RecordWrite(*scheduler, "b", name, order), net::detached);
+    }
+    ioc.run();
+
+    // a1 is written right away, the others are queued behind it
+    std::vector<std::string> expected{"a1", "a2", "b1", "a3", "b2"};
+    EXPECT_EQ(order, expected);
+    EXPECT_EQ(scheduler->writes(), 5);
+    EXPECT_EQ(scheduler->waits(), 4);
+}
+
+} // namespace lansend::core
@@ -0,0 +1,113 @@
+#include <bit>
+#include <core/util/erasure_code.h>
+#include <cstddef>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace lansend::core {
+
+namespace {
+
+std::vector<BinaryData> RandomSymbols(std::size_t count, std::size_t size, std::mt19937& engine) {
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::vector<BinaryData> symbols(count, BinaryData(size));
+    for (auto& symbol : symbols) {
+        for (auto& value : symbol) {
+            value = static_cast<std::uint8_t>(byte(engine));
+        }
+    }
+    return symbols;
+}
+
+// The data symbols followed by the repair symbols, as a receiver collects them
+std::vector<std::optional<BinaryData>> Block(const ErasureCode& code,
+                                             const std::vector<BinaryData>& data) {
+    std::vector<std::optional<BinaryData>> block(data.begin(), data.end());
+    for (auto& repair : code.Encode(data)) {
+        block.emplace_back(std::move(repair));
+    }
+    return block;
+}
+
+} // namespace
+
+TEST(ErasureCodeTest, RestoresAnyLostDataSymbolsUpToTheRepairCount) {
+    std::mt19937 engine(7);
+    ErasureCode code(32, 4);
+    auto data = RandomSymbols(32, 1280, engine);
+    auto block = Block(code, data);
+    ASSERT_EQ(block.size(), 36u);
+
+    for (std::size_t lost : {0, 5, 17, 31}) {
+        block[lost].reset();
+    }
+    ASSERT_TRUE(code.Decode(block));
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        ASSERT_TRUE(block[i].has_value()) << "symbol " << i;
+        EXPECT_EQ(*block[i], data[i]) << "symbol " << i;
+    }
+}
+
+TEST(ErasureCodeTest, RestoresWhenRepairSymbolsAreLostToo) {
+    std::mt19937 engine(11);
+    ErasureCode code(8, 4);
+    auto data = RandomSymbols(8, 64, engine);
+    auto block = Block(code, data);
+
+    block[0].reset();
+    block[3].reset();
+    block[8].reset();  // Repair symbol 0
+    block[11].reset(); // Repair symbol 3
+    ASSERT_TRUE(code.Decode(block));
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        EXPECT_EQ(*block[i], data[i]) << "symbol " << i;
+    }
+}
+
+TEST(ErasureCodeTest, EveryErasurePatternOfASmallCode) {
+    std::mt19937 engine(13);
+    ErasureCode code(4, 3);
+    auto data = RandomSymbols(4, 16, engine);
+    auto encoded = Block(code, data);
+
+    // Every subset of the 7 symbols with at most 3 lost restores the block
+    for (unsigned lost_mask = 0; lost_mask < (1u << 7); ++lost_mask) {
+        auto block = encoded;
+        for (std::size_t i = 0; i < block.size(); ++i) {
+            if (lost_mask & (1u << i)) {
+                block[i].reset();
+            }
+        }
+        bool restored = code.Decode(block);
+        if (std::popcount(lost_mask) > 3) {
+            EXPECT_FALSE(restored) << "mask " << lost_mask;
+            continue;
+        }
+        ASSERT_TRUE(restored) << "mask " << lost_mask;
+        for (std::size_t i = 0; i < data.size(); ++i) {
+            EXPECT_EQ(*block[i], data[i]) << "mask " << lost_mask << " symbol " << i;
+        }
+    }
+}
+
+TEST(ErasureCodeTest, FailsWithTooFewSymbols) {
+    std::mt19937 engine(17);
+    ErasureCode code(16, 2);
+    auto block = Block(code, RandomSymbols(16, 32, engine));
+    block[1].reset();
+    block[2].reset();
+    block[9].reset();
+    EXPECT_FALSE(code.Decode(block));
+}
+
+TEST(ErasureCodeTest, RejectsInvalidShapes) {
+    EXPECT_THROW(ErasureCode(0, 4), std::invalid_argument);
+    EXPECT_THROW(ErasureCode(250, 7), std::invalid_argument);
+    EXPECT_NO_THROW(ErasureCode(252, 4));
+}
+
+} // namespace lansend::core
@@ -0,0 +1,111 @@
+#include <core/network/client/fanout_chunk_cache.h>
+#include <cstddef>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+
+namespace lansend::core {
+
+namespace {
+
+constexpr std::size_t kChunkSize = 10;
+
+// Reads chunks of kChunkSize bytes filled with the first character of their key, and counts
+// the reads
+class Disk {
+public:
+    std::shared_ptr<const BinaryData> Read(FanoutChunkCache& cache,
+                                           std::size_t receiver,
+                                           const std::string& key) {
+        return cache.Read(receiver, key, [this, &key]() {
+            ++reads_;
+            return BinaryData(kChunkSize, static_cast<std::uint8_t>(key.front()));
+        });
+    }
+
+    int reads() const { return reads_; }
+
+private:
+    int reads_ = 0;
+};
+
+} // namespace
+
+TEST(FanoutChunkCacheTest, ChunksAreReadOnceForAllReceivers) {
+    FanoutChunkCache cache(3);
+    Disk disk;
+    for (std::size_t receiver = 0; receiver < 3; ++receiver) {
+        for (const auto* key : {"a", "b"}) {
+            auto data = disk.Read(cache, receiver, key);
+            ASSERT_EQ(data->size(), kChunkSize);
+            EXPECT_EQ(data->front(), key[0]);
+        }
+    }
+    EXPECT_EQ(disk.reads(), 2);
+    EXPECT_EQ(cache.disk_reads(), 2);
+    EXPECT_EQ(cache.hits(), 4);
+    EXPECT_EQ(cache.rereads(), 0);
+}
+
+TEST(FanoutChunkCacheTest, ChunkGoesOnceEveryReceiverTookIt) {
+    FanoutChunkCache cache(3);
+    Disk disk;
+    std::weak_ptr<const BinaryData> chunk = disk.Read(cache, 0, "a");
+    EXPECT_FALSE(chunk.expired());
+
+    disk.Read(cache, 1, "a");
+    EXPECT_FALSE(chunk.expired());
+
+    disk.Read(cache, 2, "a");
+    EXPECT_TRUE(chunk.expired());
+    EXPECT_EQ(disk.reads(), 1);
+}
+
+TEST(FanoutChunkCacheTest, SkippedChunksAreLetGo) {
+    FanoutChunkCache cache(2);
+    Disk disk;
+    std::weak_ptr<const BinaryData> skipped = disk.Read(cache, 0, "a");
+    disk.Read(cache, 0, "b");
+    EXPECT_FALSE(skipped.expired());
+
+    // Receiver 1 moves past "a" without taking it
+    disk.Read(cache, 1, "b");
+    EXPECT_TRUE(skipped.expired());
+    EXPECT_EQ(cache.hits(), 1);
+}
+
+TEST(FanoutChunkCacheTest, SlowReceiverReadsWhatFellOutOfItsBudget) {
+    // Room for two chunks per receiver
+    FanoutChunkCache cache(2, 2 * kChunkSize);
+    Disk disk;
+    std::weak_ptr<const BinaryData> oldest = disk.Read(cache, 0, "a");
+    for (const auto* key : {"b", "c", "d"}) {
+        disk.Read(cache, 0, key);
+    }
+    EXPECT_TRUE(oldest.expired());
+
+    for (const auto* key : {"a", "b", "c", "d"}) {
+        disk.Read(cache, 1, key);
+    }
+    EXPECT_EQ(cache.disk_reads(), 4);
+    EXPECT_EQ(cache.rereads(), 2);
+    EXPECT_EQ(cache.hits(), 2);
+    EXPECT_EQ(disk.reads(), 6);
+}
+
+TEST(FanoutChunkCacheTest, NothingIsKeptForReceiversThatLeft) {
+    FanoutChunkCache cache(2);
+    Disk disk;
+    std::weak_ptr<const BinaryData> pinned = disk.Read(cache, 0, "a");
+    EXPECT_FALSE(pinned.expired());
+
+    cache.Leave(1);
+    EXPECT_TRUE(pinned.expired());
+
+    // With no other receiver left the chunks aren't kept at all
+    std::weak_ptr<const BinaryData> alone = disk.Read(cache, 0, "b");
+    EXPECT_TRUE(alone.expired());
+}
+
+} // namespace lansend::core
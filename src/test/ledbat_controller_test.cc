@@ -0,0 +1,83 @@
+#include <chrono>
+#include <core/network/client/ledbat_controller.h>
+#include <gtest/gtest.h>
+
+namespace lansend::core {
+
+namespace {
+
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+// Feeds `count` samples of `delay`
+void Feed(LedbatController& ledbat, microseconds delay, int count) {
+    for (int i = 0; i < count; ++i) {
+        ledbat.OnDelay(delay);
+    }
+}
+
+} // namespace
+
+TEST(LedbatControllerTest, BaseDelayIsTheLowestSample) {
+    LedbatController ledbat;
+    EXPECT_EQ(ledbat.base_delay(), microseconds::zero());
+
+    ledbat.OnDelay(milliseconds(5));
+    ledbat.OnDelay(milliseconds(2));
+    ledbat.OnDelay(milliseconds(8));
+    EXPECT_EQ(ledbat.base_delay(), milliseconds(2));
+    // The lowest of the recent samples counts, which is the base delay itself
+    EXPECT_EQ(ledbat.queuing_delay(), microseconds::zero());
+
+    // Samples that were never measured are ignored
+    ledbat.OnDelay(microseconds::zero());
+    EXPECT_EQ(ledbat.base_delay(), milliseconds(2));
+}
+
+TEST(LedbatControllerTest, IdleSenderStaysAtTheInitialRate) {
+    LedbatController ledbat;
+    Feed(ledbat, milliseconds(1), 20);
+    EXPECT_EQ(ledbat.rate(), LedbatController::kInitialRate);
+}
+
+TEST(LedbatControllerTest, QueueAboveTargetShrinksTheRate) {
+    LedbatController ledbat;
+    ledbat.OnDelay(milliseconds(1));
+
+    // A single late sample is filtered out by the lower ones before it
+    auto queued = milliseconds(1) + 2 * LedbatController::kTargetDelay;
+    ledbat.OnDelay(queued);
+    EXPECT_EQ(ledbat.rate(), LedbatController::kInitialRate);
+
+    Feed(ledbat, queued, 4);
+    EXPECT_EQ(ledbat.queuing_delay(), 2 * LedbatController::kTargetDelay);
+    double shrunk = ledbat.rate();
+    EXPECT_LT(shrunk, LedbatController::kInitialRate);
+    // It backs off gradually, not all at once
+    EXPECT_GE(shrunk, LedbatController::kInitialRate * 0.5);
+
+    ledbat.OnDelay(queued);
+    EXPECT_LT(ledbat.rate(), shrunk);
+}
+
+TEST(LedbatControllerTest, RateNeverDropsBelowTheMinimum) {
+    LedbatController ledbat;
+    ledbat.OnDelay(milliseconds(1));
+    Feed(ledbat, milliseconds(500), 200);
+    EXPECT_EQ(ledbat.rate(), LedbatController::kMinRate);
+}
+
+TEST(LedbatControllerTest, RateRecoversOnceTheQueueDrains) {
+    LedbatController ledbat;
+    ledbat.OnDelay(milliseconds(1));
+    Feed(ledbat, milliseconds(100), 10);
+    double backed_off = ledbat.rate();
+    ASSERT_LT(backed_off, LedbatController::kInitialRate);
+
+    Feed(ledbat, milliseconds(1), 50);
+    EXPECT_GT(ledbat.rate(), backed_off);
+    // Without a measured send rate it doesn't grow past the initial rate
+    EXPECT_LE(ledbat.rate(), LedbatController::kInitialRate);
+}
+
+} // namespace lansend::core
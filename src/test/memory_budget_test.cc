@@ -0,0 +1,160 @@
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <core/network/server/memory_budget.h>
+#include <cstddef>
+#include <gtest/gtest.h>
+#include <optional>
+
+namespace net = boost::asio;
+
+namespace lansend::core {
+
+namespace {
+
+// Reserves `size` bytes into `reservation` on the io context
+void SpawnReserve(net::io_context& ioc,
+                  MemoryBudget& budget,
+                  std::optional<MemoryReservation>& reservation,
+                  std::size_t size) {
+    net::co_spawn(
+        ioc,
+        [&budget, &reservation, size]() -> net::awaitable<void> {
+            reservation = co_await budget.Reserve(size);
+        },
+        net::detached);
+}
+
+// Runs what is ready, the context stops whenever it runs out of work
+void Poll(net::io_context& ioc) {
+    ioc.restart();
+    ioc.poll();
+}
+
+} // namespace
+
+TEST(MemoryBudgetTest, ReservationsAreHandedBack) {
+    net::io_context ioc;
+    MemoryBudget budget(ioc, 100);
+
+    std::optional<MemoryReservation> first;
+    std::optional<MemoryReservation> second;
+    SpawnReserve(ioc, budget, first, 40);
+    SpawnReserve(ioc, budget, second, 30);
+    Poll(ioc);
+    ASSERT_TRUE(first && second);
+    EXPECT_EQ(budget.used(), 70);
+    EXPECT_EQ(first->size(), 40);
+
+    first->Release();
+    EXPECT_EQ(first->size(), 0);
+    EXPECT_EQ(budget.used(), 30);
+
+    // Moved reservations are handed back once
+    MemoryReservation moved = std::move(*second);
+    second.reset();
+    EXPECT_EQ(budget.used(), 30);
+    moved.Release();
+    EXPECT_EQ(budget.used(), 0);
+    EXPECT_EQ(budget.peak(), 70);
+    EXPECT_EQ(budget.waits(), 0);
+}
+
+TEST(MemoryBudgetTest, WaitsUntilMemoryIsReleased) {
+    net::io_context ioc;
+    MemoryBudget budget(ioc, 100);
+
+    std::optional<MemoryReservation> first;
+    std::optional<MemoryReservation> second;
+    SpawnReserve(ioc, budget, first, 80);
+    Poll(ioc);
+    SpawnReserve(ioc, budget, second, 30);
+    Poll(ioc);
+    ASSERT_TRUE(first);
+    EXPECT_FALSE(second);
+    EXPECT_EQ(budget.waits(), 1);
+
+    first.reset();
+    Poll(ioc);
+    ASSERT_TRUE(second);
+    EXPECT_EQ(budget.used(), 30);
+}
+
+TEST(MemoryBudgetTest, OversizedReservationWaitsForAnEmptyBudget) {
+    net::io_context ioc;
+    MemoryBudget budget(ioc, 100);
+
+    std::optional<MemoryReservation> small;
+    std::optional<MemoryReservation> oversized;
+    SpawnReserve(ioc, budget, small, 10);
+    Poll(ioc);
+    SpawnReserve(ioc, budget, oversized, 150);
+    Poll(ioc);
+    EXPECT_FALSE(oversized);
+
+    small.reset();
+    Poll(ioc);
+    ASSERT_TRUE(oversized);
+    EXPECT_EQ(budget.used(), 150);
+    EXPECT_EQ(budget.peak(), 150);
+}
+
+TEST(MemoryBudgetTest, GrowsWithinCapacity) {
+    net::io_context ioc;
+    MemoryBudget budget(ioc, 100);
+
+    std::optional<MemoryReservation> reservation;
+    SpawnReserve(ioc, budget, reservation, 20);
+    Poll(ioc);
+    ASSERT_TRUE(reservation);
+
+    bool grown = false;
+    net::co_spawn(
+        ioc,
+        [&]() -> net::awaitable<void> {
+            co_await budget.Grow(*reservation, 60);
+            // Growing to less than is held keeps the reservation
+            co_await budget.Grow(*reservation, 10);
+            grown = true;
+        },
+        net::detached);
+    Poll(ioc);
+    EXPECT_TRUE(grown);
+    EXPECT_EQ(reservation->size(), 60);
+    EXPECT_EQ(budget.used(), 60);
+    EXPECT_EQ(budget.waits(), 0);
+}
+
+TEST(MemoryBudgetTest, GrowHandsTheReservationBackWhileWaiting) {
+    net::io_context ioc;
+    MemoryBudget budget(ioc, 100);
+
+    std::optional<MemoryReservation> first;
+    std::optional<MemoryReservation> second;
+    SpawnReserve(ioc, budget, first, 50);
+    SpawnReserve(ioc, budget, second, 40);
+    Poll(ioc);
+    ASSERT_TRUE(first && second);
+
+    // Both grow past the budget, neither may keep the other waiting
+    int grown = 0;
+    for (auto* reservation : {&*first, &*second}) {
+        net::co_spawn(
+            ioc,
+            [&budget, &grown, reservation]() -> net::awaitable<void> {
+                co_await budget.Grow(*reservation, 70);
+                ++grown;
+            },
+            net::detached);
+    }
+    Poll(ioc);
+    EXPECT_EQ(grown, 1);
+    EXPECT_EQ(budget.used(), 70);
+
+    second.reset();
+    Poll(ioc);
+    EXPECT_EQ(grown, 2);
+    EXPECT_EQ(budget.used(), 70);
+}
+
+} // namespace lansend::core
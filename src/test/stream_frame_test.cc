@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/local/connect_pair.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/use_future.hpp>
+#include <core/network/stream/stream_frame.h>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace net = boost::asio;
+using Socket = net::local::stream_protocol::socket;
+
+namespace lansend::core {
+
+namespace {
+
+const std::string kChecksum(64, 'a');
+
+// Writes `bytes` to one end of a socket pair, closes it and reads a frame from the other end
+Frame ReadFrameFrom(std::span<const std::uint8_t> bytes) {
+    net::io_context ioc;
+    Socket writer(ioc);
+    Socket reader(ioc);
+    net::local::connect_pair(writer, reader);
+    net::write(writer, net::buffer(bytes.data(), bytes.size()));
+    writer.close();
+
+    boost::beast::flat_buffer buffer;
+    auto frame = net::co_spawn(ioc, ReadFrame(reader, buffer), net::use_future);
+    ioc.run();
+    return frame.get();
+}
+
+} // namespace
+
+TEST(StreamFrameTest, HeaderRoundTrips) {
+    FrameHeader header{
+        .type = FrameType::kAck,
+        .flags = frame_flag::kFinalized,
+        .stream_id = 0x01020304,
+        .length = 0xA0B0C0D0,
+    };
+    auto encoded = EncodeFrameHeader(header);
+    // Integers are big-endian
+    EXPECT_EQ(encoded[4], 0x01);
+    EXPECT_EQ(encoded[11], 0xD0);
+
+    auto decoded = DecodeFrameHeader(encoded);
+    EXPECT_EQ(decoded.type, header.type);
+    EXPECT_EQ(decoded.flags, header.flags);
+    EXPECT_EQ(decoded.stream_id, header.stream_id);
+    EXPECT_EQ(decoded.length, header.length);
+}
+
+TEST(StreamFrameTest, DataFrameInfoRoundTrips) {
+    DataFrameInfo info{
+        .chunk_index = 0x0102030405060708,
+        .compression = CompressionAlgorithm::kZstd,
+        .uncompressed_size = 1024 * 1024,
+        .chunk_checksum = kChecksum,
+    };
+    auto encoded = EncodeDataFrameInfo(info);
+    auto decoded = DecodeDataFrameInfo(encoded);
+    ASSERT_TRUE(decoded);
+    EXPECT_EQ(decoded->chunk_index, info.chunk_index);
+    EXPECT_EQ(decoded->compression, info.compression);
+    EXPECT_EQ(decoded->uncompressed_size, info.uncompressed_size);
+    EXPECT_EQ(decoded->chunk_checksum, info.chunk_checksum);
+}
+
+TEST(StreamFrameTest, RejectsTruncatedOrUnknownDataFrameInfo) {
+    auto encoded = EncodeDataFrameInfo({.chunk_index = 1, .chunk_checksum = kChecksum});
+    EXPECT_FALSE(DecodeDataFrameInfo(std::span(encoded).first(kDataFrameInfoSize - 1)));
+
+    encoded[8] = 0x7F;
+    EXPECT_FALSE(DecodeDataFrameInfo(encoded));
+}
+
+TEST(StreamFrameTest, AckPayloadRoundTrips) {
+    EXPECT_EQ(DecodeAckPayload(EncodeAckPayload(42)), 42);
+    // Acks of verify frames carry nothing
+    EXPECT_EQ(DecodeAckPayload({}), 0);
+}
+
+TEST(StreamFrameTest, ReadsWrittenFrames) {
+    net::io_context ioc;
+    Socket writer(ioc);
+    Socket reader(ioc);
+    net::local::connect_pair(writer, reader);
+
+    BinaryData chunk(100'000, 0x5A);
+    DataFrameInfo info{.chunk_index = 7, .chunk_checksum = kChecksum};
+    auto write = [&]() -> net::awaitable<void> {
+        co_await WriteFrame(writer, FrameType::kAck, 0, 3, EncodeAckPayload(7));
+        co_await WriteDataFrame(writer, frame_flag::kFinal, 3, info, chunk);
+        co_await WriteFrame(writer, FrameType::kEnd, 0, 0);
+    };
+    auto read = [&]() -> net::awaitable<std::vector<Frame>> {
+        // Frames may arrive in one read, the buffer keeps what belongs to the next one
+        boost::beast::flat_buffer buffer;
+        std::vector<Frame> frames;
+        for (int i = 0; i < 3; ++i) {
+            frames.push_back(co_await ReadFrame(reader, buffer));
+        }
+        co_return frames;
+    };
+    auto written = net::co_spawn(ioc, write(), net::use_future);
+    auto read_frames = net::co_spawn(ioc, read(), net::use_future);
+    ioc.run();
+    written.get();
+    auto frames = read_frames.get();
+
+    EXPECT_EQ(frames[0].header.type, FrameType::kAck);
+    EXPECT_EQ(DecodeAckPayload(frames[0].payload), 7);
+
+    EXPECT_EQ(frames[1].header.type, FrameType::kData);
+    EXPECT_EQ(frames[1].header.flags, frame_flag::kFinal);
+    EXPECT_EQ(frames[1].header.stream_id, 3);
+    ASSERT_EQ(frames[1].payload.size(), kDataFrameInfoSize + chunk.size());
+    auto decoded = DecodeDataFrameInfo(frames[1].payload);
+    ASSERT_TRUE(decoded);
+    EXPECT_EQ(decoded->chunk_index, 7);
+    EXPECT_TRUE(std::equal(chunk.begin(),
+                           chunk.end(),
+                           frames[1].payload.begin() + kDataFrameInfoSize));
+
+    EXPECT_EQ(frames[2].header.type, FrameType::kEnd);
+    EXPECT_TRUE(frames[2].payload.empty());
+}
+
+TEST(StreamFrameTest, TruncatedFramesFailToRead) {
+    auto header = EncodeFrameHeader({.type = FrameType::kData, .length = 100});
+    BinaryData bytes(header.begin(), header.end());
+    bytes.resize(bytes.size() + 50);
+    EXPECT_THROW(ReadFrameFrom(bytes), boost::system::system_error);
+
+    // The connection ends within the header
+    EXPECT_THROW(ReadFrameFrom(std::span(header).first(kFrameHeaderSize - 1)),
+                 boost::system::system_error);
+}
+
+TEST(StreamFrameTest, OversizedFramesFailToRead) {
+    auto header = EncodeFrameHeader(
+        {.type = FrameType::kData, .length = static_cast<std::uint32_t>(kMaxFramePayloadSize + 1)});
+    EXPECT_THROW(ReadFrameFrom(header), std::runtime_error);
+}
+
+} // namespace lansend::core